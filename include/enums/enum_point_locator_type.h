@@ -34,6 +34,7 @@ namespace MeshEnums {
   enum PointLocatorType {
     PointLocator_TREE = 0,
     PointLocator_LIST,
+    PointLocator_BVH,
     INVALID_PointLocator};
 }
 
@@ -121,6 +121,15 @@ namespace SolverSpecify
   };
 
 
+  /**
+   * enum how the Bernoulli function in S-G flux is evaluated
+   */
+  enum  BernoulliScheme
+  {
+    BernoulliReference=0,  // piecewise bern() in mathfunc.h
+    BernoulliRational      // branch-free batched kernel in jflux_batch.h
+  };
+
   /**
    * define order for ODE solver
    */
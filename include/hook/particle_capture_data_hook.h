@@ -98,6 +98,11 @@ private:
    */
   double    _resolution;
 
+  /**
+   * file to keep the dose rate octree, reused by later runs on the same structure
+   */
+  std::string _octree_file;
+
 
   bool   _first_g4_calculation_flag;
 
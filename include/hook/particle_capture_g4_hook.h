@@ -119,6 +119,11 @@ private:
 
   std::string   _dose_rate;
 
+  /**
+   * file to keep the dose rate octree, reused by later runs on the same structure
+   */
+  std::string   _octree_file;
+
 private:
 
   /// AMS hander
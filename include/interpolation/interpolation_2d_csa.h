@@ -42,6 +42,13 @@ public:
    */
   double get_interpolated_value(const Point & point, int group) const;
 
+protected:
+
+  /**
+   * interpolate a block of points, the group is looked up once for the block
+   */
+  virtual void _interpolated_values(const Point * points, unsigned int n, int group, double * value) const;
+
 private:
 
   std::map<int, CSA::csa *>  field_map;  //
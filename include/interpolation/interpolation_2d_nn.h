@@ -41,6 +41,14 @@ public:
    */
   double get_interpolated_value(const Point & point, int group) const;
 
+protected:
+
+  /**
+   * interpolate a block of points, the triangle walk of the block starts from
+   * its own seed so blocks can be evaluated at the same time
+   */
+  virtual void _interpolated_values(const Point * points, unsigned int n, int group, double * value) const;
+
 private:
 
 
@@ -58,8 +66,29 @@ private:
     NN::delaunay * d;
     /// linear interpolator
     NN::lpi      *li;
+    /// last triangle found by each thread, start of the next search
+    mutable std::vector<int> seed;
+    /// a triangle in each cell of a coarse grid over the bounding box, start of the first search of a block
+    std::vector<int> locator;
+    /// cells of the locator grid in x and y
+    unsigned int locator_nx, locator_ny;
   };
 
+  /**
+   * build the locator grid of the triangulation
+   */
+  void _build_locator(DATA & data) const;
+
+  /**
+   * the locator cell of location (x, y), clamped to the grid
+   */
+  unsigned int _locator_cell(const DATA & data, double x, double y) const;
+
+  /**
+   * interpolate n points, the triangle walk starts from and updates *seed
+   */
+  void _interpolate(const DATA & data, int group, const Point * points, unsigned int n, int * seed, double * value) const;
+
   std::map<int, DATA> field;
 
 
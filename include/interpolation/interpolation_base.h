@@ -4,6 +4,7 @@
 #include <cassert>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "point.h"
 
@@ -45,6 +46,12 @@ public:
   int group_code(const std::string & var) const
   { return _variable_group_map.find(var)->second; }
 
+  /**
+   * @return true if the variable string has a group code
+   */
+  bool has_group(const std::string & var) const
+  { return _variable_group_map.find(var)!=_variable_group_map.end(); }
+
 
   /**
    * add the data with GROUP_ID group in (N+1)D for interpolation
@@ -56,6 +63,14 @@ public:
    */
   virtual void setup(int /* group */)=0;
 
+  /**
+   * set the directory to keep the built interpolant. setup() loads it from the cache
+   * file named by the content hash of the scatter data, or saves it after it is built.
+   * interpolant without cache support ignores it
+   */
+  void set_cache_directory(const std::string & dir)
+  { _cache_directory = dir; }
+
   /**
    * virtual function to set the options of Interpolation.
    * each dirived class can override it
@@ -67,6 +82,13 @@ public:
    */
   virtual double get_interpolated_value(const Point & point, int group)const=0;
 
+  /**
+   * get interpolated values with GROUP_ID group at many locations, value[i] at points[i].
+   * the points are split into blocks which are evaluated by all the threads,
+   * the interpolant is not changed and the result does not depend on the number of threads
+   */
+  void get_interpolated_values(const std::vector<Point> & points, int group, std::vector<double> & values) const;
+
   /**
    * InterpolationType, should support linear (for potential, etc) and asinh (doping concentration and carrier density)
    */
@@ -89,6 +111,18 @@ protected:
 
   std::map<std::string, int> _variable_group_map;
 
+  /**
+   * directory to keep the built interpolant, empty for no cache
+   */
+  std::string _cache_directory;
+
+  /**
+   * interpolate n contiguous points of one block into value,
+   * called concurrently for different blocks. the default calls get_interpolated_value for each point,
+   * interpolant which keeps search state between points should override it and keep the state local
+   */
+  virtual void _interpolated_values(const Point * points, unsigned int n, int group, double * value) const;
+
   //how to store the point and their value?
 
   inline double scaleValue(InterpolationType type, const double value) const
@@ -0,0 +1,76 @@
+#ifndef __interpolation_cache_h__
+#define __interpolation_cache_h__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "mapped_file.h"
+
+/**
+ * binary cache file of a built interpolant.
+ * the file is named by the interpolation method and a content hash (64 bit FNV-1a)
+ * of the data the interpolant is built from. it starts with a 32 byte header
+ * (magic, method, hash and payload size) followed by the payload written by the
+ * interpolant. the file is memory mapped when loaded, the payload is 8 byte aligned.
+ */
+class InterpolationCache
+{
+public:
+
+  /**
+   * cache in directory for given method, an empty directory disables the cache
+   */
+  InterpolationCache(const std::string & directory, const std::string & method);
+
+  /**
+   * @return true when the cache is enabled
+   */
+  bool enabled() const { return !_directory.empty(); }
+
+  /**
+   * add data to the content hash
+   */
+  void hash(const void * data, std::size_t size);
+
+  /**
+   * add an array to the content hash
+   */
+  template <typename T>
+  void hash(const std::vector<T> & data)
+  {
+    unsigned int n = data.size();
+    hash(&n, sizeof(n));
+    if(n) hash(&data[0], n*sizeof(T));
+  }
+
+  /**
+   * cache file of current content hash
+   */
+  std::string file() const;
+
+  /**
+   * map the cache file of current content hash.
+   * @return the payload, NULL when the cache is disabled or the file does not exist
+   * or is not written for the same content. it is valid until the cache is destroyed
+   */
+  const void * load(std::size_t & size);
+
+  /**
+   * write the cache file of current content hash, only the first processor writes.
+   * failure to write is not an error, the interpolant is built again next time
+   */
+  void save(const void * data, std::size_t size) const;
+
+private:
+
+  std::string _directory;
+
+  std::string _method;
+
+  unsigned long long _hash;
+
+  MappedFile _file;
+};
+
+#endif
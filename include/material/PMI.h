@@ -56,6 +56,34 @@ class FVM_NodeData;
 // It links the main solver and material. The solver load required parameters from
 // re-implemented virtual functions.
 
+/**
+ * the highest version of the binary interface between genius and the PMI library
+ * supported by genius. increase it whenever the layout of PMI_Environment or the
+ * virtual table of PMI classes changes.
+ *
+ * version 1: library without PMI_abi_version()
+ * version 2: one material object (and its PMI objects) may be cloned per thread,
+ *            PMI objects must not keep evaluation state in static variables
+ */
+#define PMI_ABI_VERSION 2
+
+extern "C"
+{
+  /**
+   * @return the PMI ABI version the PMI library declares by PMI_DECLARE_ABI_VERSION
+   */
+  DLL_EXPORT_DECLARE unsigned int PMI_abi_version();
+}
+
+/**
+ * each PMI library declares the version it conforms to in exactly one of its
+ * own source files, i.e. PMI_DECLARE_ABI_VERSION(2) promises that the library
+ * keeps no evaluation state in static variables. it is not defined in the
+ * common PMI source, library without the declaration is version 1
+ */
+#define PMI_DECLARE_ABI_VERSION(version) \
+  extern "C" { DLL_EXPORT_DECLARE unsigned int PMI_abi_version() { return version; } }
+
 /**
  * PMI_Environment, this structure will be passed to PMI class when initializing.
  * It contains interface information for linking main genius code to each PMI class
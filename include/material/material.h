@@ -93,6 +93,28 @@ public:
    */
   void load_material( const std::string & material );
 
+  /**
+   * create an independent material object of the same region with the same
+   * PMI models and calibrations. PMI objects read the current point, node data
+   * and time from their owner material object, so each thread that evaluates
+   * material models concurrently should own one clone.
+   */
+  virtual MaterialBase * clone() const = 0;
+
+  /**
+   * @return number of set_pmi calls recorded, can be used to detect stale clones
+   */
+  unsigned int n_pmi_records() const
+  { return _pmi_records.size(); }
+
+  /**
+   * @return true when the PMI library allows clone() for concurrent evaluation,
+   * i.e. it declares PMI ABI version 2 or later. other library may keep
+   * evaluation state in static variables shared by all the clones
+   */
+  bool clone_safe() const
+  { return pmi_abi_version >= 2; }
+
 
   /**
    * function pointer to set_ad_number, set the independent variable
@@ -128,6 +150,36 @@ public:
 
 protected:
 
+  /**
+   * record of user's PMI model selection and calibration
+   */
+  struct PMI_Record
+  {
+    std::string type;
+    std::string model_name;
+    std::vector<Parser::Parameter> pmi_parameters;
+  };
+
+  /**
+   * all the set_pmi calls in order, replayed by clone()
+   */
+  std::vector<PMI_Record>  _pmi_records;
+
+  /**
+   * save set_pmi arguments
+   */
+  void record_pmi(const std::string &type, const std::string &model_name, const std::vector<Parser::Parameter> & pmi_parameters);
+
+  /**
+   * replay the recorded set_pmi calls to material object \p m
+   */
+  void replay_pmi(MaterialBase * m) const;
+
+  /**
+   * PMI ABI version of loaded library
+   */
+  unsigned int               pmi_abi_version;
+
   /**
    * const pointer to region
    */
@@ -228,6 +280,11 @@ public:
    */
   ~MaterialSemiconductor();
 
+  /**
+   * clone a material object with the same PMI setting
+   */
+  MaterialBase * clone() const;
+
   /**
    * set different model, calibrate parameters in PMI
    */
@@ -291,6 +348,11 @@ public:
    */
   ~MaterialInsulator();
 
+  /**
+   * clone a material object with the same PMI setting
+   */
+  MaterialBase * clone() const;
+
   /**
    * set different model, calibrate parameters in PMI
    */
@@ -349,6 +411,11 @@ public:
    */
   ~MaterialConductor();
 
+  /**
+   * clone a material object with the same PMI setting
+   */
+  MaterialBase * clone() const;
+
   /**
    * set different model, calibrate parameters in PMI
    */
@@ -406,6 +473,11 @@ public:
    */
   ~MaterialVacuum();
 
+  /**
+   * clone a material object with the same PMI setting
+   */
+  MaterialBase * clone() const;
+
   /**
    * set different model, calibrate parameters in PMI
    */
@@ -457,6 +529,11 @@ public:
    */
   ~MaterialPML();
 
+  /**
+   * clone a material object with the same PMI setting
+   */
+  MaterialBase * clone() const;
+
   /**
    * set different model, calibrate parameters in PMI
    */
@@ -1,6 +1,9 @@
 #ifndef __expr_evalute_h__
 #define __expr_evalute_h__
 
+#include <vector>
+#include <string>
+
 #include "expr_eval.h"
 
 
@@ -50,6 +53,13 @@ private:
 
 /**
  * evalute an expression in string
+ *
+ * after parse, the expression tree is lowered into a flat register bytecode:
+ * register 0-3 hold x, y, z and t, the constants follow, and each instruction
+ * writes a new register. constant sub-expressions are folded and the same
+ * operation on the same registers is emitted only once.
+ * expressions with functions the bytecode does not know (rand, rect2pol, ...)
+ * or with assignment are evaluated by walking the parsed tree as before.
  */
 class ExprEvalute
 {
@@ -65,12 +75,23 @@ public:
    */
   double eval(double x, double y, double z, double t);
 
+  /**
+   * evalute an expression at n points with the same time, value[i] = f(x[i], y[i], z[i], t)
+   */
+  void eval(unsigned int n, const double *x, const double *y, const double *z, double t, double *value);
+
   /**
    * evalute an expression, take coordinate(x, y, z) and time as independent variable
    */
   double operator () (double x, double y, double z, double t)
   { return eval(x,y,z,t); }
 
+  /**
+   * @return true when the expression is evaluated by bytecode
+   */
+  bool compiled() const
+  { return _compiled; }
+
 private:
 
   /**
@@ -88,6 +109,84 @@ private:
    */
   ExprEval::Expression e;
 
+  /**
+   * bytecode operations
+   */
+  enum OpCode
+  {
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG, OP_POW,
+    OP_ABS, OP_MOD, OP_IPART, OP_FPART, OP_MIN, OP_MAX,
+    OP_SQRT, OP_SIN, OP_COS, OP_TAN, OP_SINH, OP_COSH, OP_TANH,
+    OP_ASIN, OP_ACOS, OP_ATAN, OP_ATAN2, OP_LOG, OP_LN, OP_EXP,
+    OP_ERFC, OP_ERF, OP_CEIL, OP_FLOOR,
+    OP_EQUAL, OP_ABOVE, OP_BELOW, OP_CLIP, OP_NOT
+  };
+
+  /**
+   * one instruction, reg[dst] = op(reg[a], reg[b], reg[c])
+   */
+  struct Instruction
+  {
+    OpCode op;
+    unsigned int dst;
+    unsigned int a, b, c;
+  };
+
+  /**
+   * the bytecode
+   */
+  std::vector<Instruction> _code;
+
+  /**
+   * register file, constants are filled at compile time
+   */
+  std::vector<double> _register;
+
+  /**
+   * register holds the result
+   */
+  unsigned int _result;
+
+  /**
+   * true when the bytecode is valid
+   */
+  bool _compiled;
+
+  /**
+   * working registers of array evaluation, n_register x lanes
+   */
+  std::vector<double> _lanes;
+
+  /**
+   * state only used during compile
+   */
+  struct CompileState;
+
+  /**
+   * lower parsed expression into bytecode, false if the tree has unsupported node
+   */
+  bool _compile();
+
+  /**
+   * compile a node, return its register, or invalid_uint for unsupported node
+   */
+  unsigned int _compile_node(const ExprEval::Node *node, CompileState &state);
+
+  /**
+   * register of a constant
+   */
+  unsigned int _constant(double v, CompileState &state);
+
+  /**
+   * emit an instruction, fold constant operands and reuse the same instruction emitted before
+   */
+  unsigned int _emit(OpCode op, unsigned int a, unsigned int b, unsigned int c, CompileState &state);
+
+  /**
+   * apply one operation, throw ExprEval exception for math error as the tree nodes do
+   */
+  static double _apply(OpCode op, double a, double b, double c);
+
 };
 
 #endif
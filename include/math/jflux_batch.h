@@ -0,0 +1,240 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __jflux_batch_h__
+#define __jflux_batch_h__
+
+// branch-free Bernoulli function and batched S-G edge flux.
+//
+// the reference bern()/pd1bern() in mathfunc.h select one of five formulas by
+// the break points in brkpnts.h, which stops the compiler from vectorizing the
+// edge loop. here B(x), B(-x) and their derivatives are evaluated together with
+// straight-line code:
+//
+//   t = |x|,   B(-t) = B(t) + t,   B'(-t) = -1 - B'(t)
+//
+// and for t >= 0
+//
+//   t <  0.5 : Taylor series of B(t) and B'(t) up to t^16
+//   t >= 0.5 : B(t) = t*e/(1-e), B'(t) = ((1-t)*e - e*e)/(1-e)^2, e = exp(-t)
+//
+// exp(-t) is computed by Cody-Waite reduction t = k*ln2 + r, |r| <= ln2/2,
+// a degree 13 polynomial for exp(-r) and a bit-constructed 2^-k. both branches
+// are evaluated and blended, denominators are guarded so no FE_INVALID/FE_DIVBYZERO
+// is raised. the relative error of B(x), B(-x) is below 1e-15 for |x| < BERN_BATCH_XMAX,
+// the derivatives are within a few ulp of their magnitude. for t >= BERN_BATCH_XMAX
+// B(t) and B'(t) underflow to zero just as bern() does.
+
+#include <cstring>
+
+#include "mathfunc.h"
+
+/**
+ * above this argument B(x) and B'(x) are set to zero
+ */
+const double BERN_BATCH_XMAX = 700.0;
+
+/**
+ * argument where the series and the exponent formula are switched
+ */
+const double BERN_BATCH_XSW  = 0.5;
+
+
+/* ----------------------------------------------------------------------------
+ * exp(-t) for 0 <= t <= BERN_BATCH_XMAX without branch or libm call
+ */
+inline double bern_batch_expm ( double t )
+{
+  const double log2e  = 1.44269504088896340736;
+  const double ln2_hi = 6.93147180369123816490e-01;
+  const double ln2_lo = 1.90821492927058770002e-10;
+
+  // round to nearest integer by the 1.5*2^52 shifter, avoids floor()
+  const double shifter = 6755399441055744.0;
+  const double k = (t*log2e + shifter) - shifter;
+  // s = -r, exp(-t) = 2^-k * exp(s)
+  const double s = (k*ln2_hi - t) + k*ln2_lo;
+
+  double p = 1.0/6227020800.0;             // 1/13!
+  p = p*s + 1.0/479001600.0;
+  p = p*s + 1.0/39916800.0;
+  p = p*s + 1.0/3628800.0;
+  p = p*s + 1.0/362880.0;
+  p = p*s + 1.0/40320.0;
+  p = p*s + 1.0/5040.0;
+  p = p*s + 1.0/720.0;
+  p = p*s + 1.0/120.0;
+  p = p*s + 1.0/24.0;
+  p = p*s + 1.0/6.0;
+  p = p*s + 0.5;
+  p = p*s + 1.0;
+  p = p*s + 1.0;
+
+  // 2^-k, k <= 1010 keeps it a normal number. the low mantissa bits of
+  // (1023-k) + 1.5*2^52 hold the biased exponent, shift them into place.
+  // no double to integer conversion, which most SIMD sets lack
+  const double biased = (1023.0 - k) + shifter;
+  unsigned long long bits;
+  std::memcpy(&bits, &biased, sizeof(double));
+  bits <<= 52;
+  double scale;
+  std::memcpy(&scale, &bits, sizeof(double));
+
+  return p*scale;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * bern_pair:  evaluate B(x), B(-x) and the derivatives dB(x)/dx, dB(y)/dy at y=-x
+ * in one pass. no data dependent branch, suitable for vectorized loops.
+ */
+inline void bern_pair ( double x, double &Bp, double &Bm, double &dBp, double &dBm )
+{
+  const double t  = std::min(std::fabs(x), BERN_BATCH_XMAX);
+  const bool small = t < BERN_BATCH_XSW;
+
+  // series, B(t) = 1 - t/2 + sum B_2k t^2k/(2k)!
+  const double u = t*t;
+  double s = -3617.0/10670622842880000.0;
+  s = s*u + 1.0/74724249600.0;
+  s = s*u - 691.0/1307674368000.0;
+  s = s*u + 1.0/47900160.0;
+  s = s*u - 1.0/1209600.0;
+  s = s*u + 1.0/30240.0;
+  s = s*u - 1.0/720.0;
+  s = s*u + 1.0/12.0;
+  const double B_series = 1.0 - 0.5*t + u*s;
+
+  double ds = 16*(-3617.0/10670622842880000.0);
+  ds = ds*u + 14*(1.0/74724249600.0);
+  ds = ds*u - 12*(691.0/1307674368000.0);
+  ds = ds*u + 10*(1.0/47900160.0);
+  ds = ds*u - 8*(1.0/1209600.0);
+  ds = ds*u + 6*(1.0/30240.0);
+  ds = ds*u - 4*(1.0/720.0);
+  ds = ds*u + 2*(1.0/12.0);
+  const double dB_series = -0.5 + t*ds;
+
+  // exponent formula, the denominator is kept away from zero in the series range
+  const double y = bern_batch_expm(t);
+  const double z = small ? 1.0 : 1.0 - y;
+  const double rz = 1.0/z;
+  const double B_exp  = t*y*rz;
+  const double dB_exp = ((1.0 - t)*y - y*y)*rz*rz;
+
+  // saturate to zero as bern() does for large argument
+  const double cut = std::fabs(x) < BERN_BATCH_XMAX ? 1.0 : 0.0;
+  const double B  = (small ? B_series  : B_exp)*cut;
+  const double dB = (small ? dB_series : dB_exp)*cut;
+
+  // B(t) for t=|x|, then use B(-t) = B(t) + t
+  const double Bpos  = B;
+  const double Bneg  = B + std::fabs(x);
+  const double dBpos = dB;
+  const double dBneg = -1.0 - dB;
+
+  const bool positive = x >= 0.0;
+  Bp  = positive ? Bpos  : Bneg;
+  Bm  = positive ? Bneg  : Bpos;
+  dBp = positive ? dBpos : dBneg;
+  dBm = positive ? dBneg : dBpos;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * AutoDScalar flavour, returns B(x) and B(-x) with the derivative carried by x
+ */
+inline void bern_pair ( const AutoDScalar &x, AutoDScalar &Bp, AutoDScalar &Bm )
+{
+  double B1, B2, dB1, dB2;
+  bern_pair(x.getValue(), B1, B2, dB1, dB2);
+  Bp = dB1*x;   Bp.setValue(B1);
+  Bm = -dB2*x;  Bm.setValue(B2);
+}
+
+
+
+//-----------------------------------------------------------------------------
+// batched S-G current along edges, same formula as In_dd/Ip_dd in jflux1.h
+// J[i] = Vt*(n2[i]*B(-dV[i]/Vt) - n1[i]*B(dV[i]/Vt))/h[i]
+//-----------------------------------------------------------------------------
+
+inline void In_dd_batch ( unsigned int n, PetscScalar Vt, const PetscScalar *dVc,
+                          const PetscScalar *n1, const PetscScalar *n2, const PetscScalar *h,
+                          PetscScalar *J, bool reference=false )
+{
+  if( reference )
+  {
+    for(unsigned int i=0; i<n; ++i)
+      J[i] = Vt*(n2[i]*bern(-dVc[i]/Vt)-n1[i]*bern(dVc[i]/Vt))/h[i];
+    return;
+  }
+
+  const PetscScalar rVt = 1.0/Vt;
+  for(unsigned int i=0; i<n; ++i)
+  {
+    double Bp, Bm, dBp, dBm;
+    bern_pair(dVc[i]*rVt, Bp, Bm, dBp, dBm);
+    J[i] = Vt*(n2[i]*Bm - n1[i]*Bp)/h[i];
+  }
+}
+
+inline void Ip_dd_batch ( unsigned int n, PetscScalar Vt, const PetscScalar *dVv,
+                          const PetscScalar *p1, const PetscScalar *p2, const PetscScalar *h,
+                          PetscScalar *J, bool reference=false )
+{
+  if( reference )
+  {
+    for(unsigned int i=0; i<n; ++i)
+      J[i] = Vt*(p1[i]*bern(-dVv[i]/Vt)-p2[i]*bern(dVv[i]/Vt))/h[i];
+    return;
+  }
+
+  const PetscScalar rVt = 1.0/Vt;
+  for(unsigned int i=0; i<n; ++i)
+  {
+    double Bp, Bm, dBp, dBm;
+    bern_pair(dVv[i]*rVt, Bp, Bm, dBp, dBm);
+    J[i] = Vt*(p1[i]*Bm - p2[i]*Bp)/h[i];
+  }
+}
+
+
+//-----------------------------------------------------------------------------
+// single edge, AutoDScalar flavour of the branch-free kernel
+//-----------------------------------------------------------------------------
+
+inline AutoDScalar In_dd_fast(PetscScalar Vt, const AutoDScalar &dVc, const AutoDScalar &n1, const AutoDScalar &n2, PetscScalar h)
+{
+  AutoDScalar Bp, Bm;
+  bern_pair(dVc/Vt, Bp, Bm);
+  return Vt*(n2*Bm-n1*Bp)/h;
+}
+
+inline AutoDScalar Ip_dd_fast(PetscScalar Vt, const AutoDScalar &dVv, const AutoDScalar &p1, const AutoDScalar &p2, PetscScalar h)
+{
+  AutoDScalar Bp, Bm;
+  bern_pair(dVv/Vt, Bp, Bm);
+  return Vt*(p1*Bm-p2*Bp)/h;
+}
+
+
+#endif // #define __jflux_batch_h__
@@ -89,6 +89,13 @@ public:
    */
   void sync (BoundaryMesh& boundary_mesh);
 
+  /**
+   * build the flat boundary side/node index for fast query.
+   * any add/remove operator invalidates the index, queries then
+   * fall back to the map structures until it is built again.
+   */
+  void prepare_for_use ();
+
 
   /**
    * Create boundary_mesh with special boundary id.
@@ -421,6 +428,57 @@ public:
    */
   std::set<short int> _boundary_ids;
 
+  /**
+   * true when the flat index agrees with _boundary_side_id and _boundary_node_id
+   */
+  bool _index_valid;
+
+  /**
+   * CSR row offset of _index_elem_sides, indexed by elem id
+   */
+  std::vector<unsigned int> _index_elem_side_offset;
+
+  /**
+   * the elem each row of _index_elem_side_offset is built for,
+   * NULL when the row can not be trusted (i.e. elem renumbered)
+   */
+  std::vector<const Elem *> _index_elem;
+
+  /**
+   * (side, boundary id) of each boundary elem, grouped by elem id
+   */
+  std::vector<std::pair<unsigned short int, short int> > _index_elem_sides;
+
+  /**
+   * sorted boundary ids appear in the index
+   */
+  std::vector<short int> _index_bd_ids;
+
+  /**
+   * CSR row offset of _index_bd_sides, indexed by position in _index_bd_ids
+   */
+  std::vector<unsigned int> _index_bd_side_offset;
+
+  /**
+   * active (elem, side) pairs of each boundary id
+   */
+  std::vector<std::pair<const Elem *, unsigned int> > _index_bd_sides;
+
+  /**
+   * CSR row offset of _index_bd_nodes, indexed by position in _index_bd_ids
+   */
+  std::vector<unsigned int> _index_bd_node_offset;
+
+  /**
+   * nodes of each boundary id, sorted by node id
+   */
+  std::vector<const Node *> _index_bd_nodes;
+
+  /**
+   * @return position of boundary id in _index_bd_ids, invalid_uint if not find
+   */
+  unsigned int _index_bd_position(short int id) const;
+
 
   /**
    * data structure for convert label to index
@@ -40,6 +40,7 @@ class SurfaceLocatorHub;
 // Local Includes -----------------------------------
 #include "genius_common.h"
 #include "enum_elem_type.h"
+#include "enum_mesh_reorder.h"
 #include "variant_filter_iterator.h"
 #include "multi_predicates.h"
 #include "auto_ptr.h"
@@ -392,10 +393,11 @@ public:
 
 
   /**
-   * reorder the elems index by Reverse Cuthill-McKee Algorithm
-   * which can reduce filling in LU (ILU) Factorization
+   * reorder the elems index region by region, by Reverse Cuthill-McKee Algorithm
+   * which can reduce filling in LU (ILU) Factorization, or along Hilbert curve
+   * for cache locality. node index follows the new elem order
    */
-  virtual bool reorder_elems (std::string &) { return true; }
+  virtual bool reorder_elems (std::string &, MeshReorderType = MeshReorder_RCM) { return true; }
 
 
   /**
@@ -215,6 +215,17 @@ namespace MeshTools
    */
   unsigned int n_levels(const MeshBase& mesh);
 
+  /**
+   * Return the maximal difference of node ids in the same element,
+   * the bandwidth of the nodal matrix
+   */
+  unsigned int node_bandwidth(const MeshBase& mesh);
+
+  /**
+   * Return the maximal difference of ids between neighbor elements
+   */
+  unsigned int elem_bandwidth(const MeshBase& mesh);
+
   /**
    * Builds a set of node IDs for nodes which belong to non-subactive
    * elements.  Non-subactive elements are those which are either active
@@ -0,0 +1,353 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __packed_mesh_h__
+#define __packed_mesh_h__
+
+// C++ Includes   -----------------------------------
+#include <vector>
+
+// Local Includes -----------------------------------
+#include "genius_common.h"
+#include "enum_elem_type.h"
+#include "point.h"
+
+// Forward Declarations -----------------------------
+class MeshBase;
+class Elem;
+
+
+/**
+ * structure-of-arrays copy of the (active) mesh geometry.
+ *
+ * Node and Elem of SerialMesh are heap objects linked by pointers, which is
+ * convenient for topology operations but slow to traverse. PackedMesh keeps
+ * node coordinates in three contiguous arrays and element connectivity in one
+ * array grouped by element type, so each type is a range of elements with a
+ * fixed number of nodes. geometry kernels (e.g. centroid) run over these
+ * ranges directly, the original Elem can always be reached from the proxy.
+ *
+ * the packed mesh is a snapshot, it should be rebuilt after the mesh changes.
+ */
+class PackedMesh
+{
+public:
+
+  /**
+   * continuous range of elements with the same type
+   */
+  struct TypeRange
+  {
+    /**
+     * element type of this range
+     */
+    ElemType     type;
+
+    /**
+     * nodes per element
+     */
+    unsigned int n_nodes;
+
+    /**
+     * first packed element of this range
+     */
+    unsigned int begin;
+
+    /**
+     * one past the last packed element of this range
+     */
+    unsigned int end;
+
+    /**
+     * first connectivity entry of this range
+     */
+    unsigned int conn_begin;
+  };
+
+
+  /**
+   * light weight element view into the packed arrays
+   */
+  class ElemProxy
+  {
+  public:
+    ElemProxy(const PackedMesh &mesh, unsigned int e)
+      : _mesh(mesh), _e(e), _range(mesh._type_ranges[mesh._elem_range[e]])
+    {}
+
+    /**
+     * @return the packed index of this element
+     */
+    unsigned int index() const { return _e; }
+
+    /**
+     * @return the id of the original element
+     */
+    unsigned int id() const { return _mesh._elem_id[_e]; }
+
+    /**
+     * @return the subdomain of the element
+     */
+    unsigned int subdomain_id() const { return _mesh._elem_subdomain[_e]; }
+
+    /**
+     * @return the element type
+     */
+    ElemType type() const { return _range.type; }
+
+    /**
+     * @return number of nodes
+     */
+    unsigned int n_nodes() const { return _range.n_nodes; }
+
+    /**
+     * @return packed index of the i-th node
+     */
+    unsigned int node_index(unsigned int i) const
+    { return _mesh._conn[_range.conn_begin + (_e-_range.begin)*_range.n_nodes + i]; }
+
+    /**
+     * @return location of the i-th node
+     */
+    Point point(unsigned int i) const
+    { return _mesh.point(node_index(i)); }
+
+    /**
+     * @return the original element
+     */
+    const Elem * elem() const { return _mesh._elem_ptr[_e]; }
+
+  private:
+
+    const PackedMesh & _mesh;
+
+    unsigned int       _e;
+
+    const TypeRange &  _range;
+  };
+
+  /**
+   * empty packed mesh
+   */
+  PackedMesh() {}
+
+  /**
+   * pack the active elements of mesh
+   */
+  PackedMesh(const MeshBase &mesh) { this->pack(mesh); }
+
+  /**
+   * (re)pack the active elements of mesh and all of their nodes
+   */
+  void pack(const MeshBase &mesh);
+
+  /**
+   * clear all the data
+   */
+  void clear();
+
+  /**
+   * @return number of packed nodes
+   */
+  unsigned int n_nodes() const { return _node_id.size(); }
+
+  /**
+   * @return number of packed elements
+   */
+  unsigned int n_elem() const { return _elem_id.size(); }
+
+  /**
+   * @return the packed index of node id, invalid_uint if the node is not packed
+   */
+  unsigned int node_index(unsigned int id) const
+  { return id < _node_index.size() ? _node_index[id] : invalid_uint; }
+
+  /**
+   * @return the id of packed node n
+   */
+  unsigned int node_id(unsigned int n) const { return _node_id[n]; }
+
+  /**
+   * @return the location of packed node n
+   */
+  Point point(unsigned int n) const { return Point(_x[n], _y[n], _z[n]); }
+
+  /**
+   * coordinate arrays
+   */
+  const std::vector<Real> & x() const { return _x; }
+  const std::vector<Real> & y() const { return _y; }
+  const std::vector<Real> & z() const { return _z; }
+
+  /**
+   * element ranges grouped by type
+   */
+  const std::vector<TypeRange> & type_ranges() const { return _type_ranges; }
+
+  /**
+   * @return the proxy of packed element e
+   */
+  ElemProxy elem(unsigned int e) const { return ElemProxy(*this, e); }
+
+  /**
+   * vertex average of all the packed elements, the same as Elem::centroid()
+   */
+  void centroids(std::vector<Point> &cp) const;
+
+private:
+
+    const PackedMesh & _mesh;
+
+    unsigned int       _e;
+
+    const TypeRange &  _range;
+  };
+
+  /**
+   * empty packed mesh
+   */
+  PackedMesh() {}
+
+  /**
+   * pack the active elements of mesh
+   */
+  PackedMesh(const MeshBase &mesh) { this->pack(mesh); }
+
+  /**
+   * (re)pack the active elements of mesh and all of their nodes
+   */
+  void pack(const MeshBase &mesh);
+
+  /**
+   * clear all the data
+   */
+  void clear();
+
+  /**
+   * @return number of packed nodes
+   */
+  unsigned int n_nodes() const { return _node_id.size(); }
+
+  /**
+   * @return number of packed elements
+   */
+  unsigned int n_elem() const { return _elem_id.size(); }
+
+  /**
+   * @return the packed index of node id, invalid_uint if the node is not packed
+   */
+  unsigned int node_index(unsigned int id) const
+  { return id < _node_index.size() ? _node_index[id] : invalid_uint; }
+
+  /**
+   * @return the id of packed node n
+   */
+  unsigned int node_id(unsigned int n) const { return _node_id[n]; }
+
+  /**
+   * @return the location of packed node n
+   */
+  Point point(unsigned int n) const { return Point(_x[n], _y[n], _z[n]); }
+
+  /**
+   * coordinate arrays
+   */
+  const std::vector<Real> & x() const { return _x; }
+  const std::vector<Real> & y() const { return _y; }
+  const std::vector<Real> & z() const { return _z; }
+
+  /**
+   * element ranges grouped by type
+   */
+  const std::vector<TypeRange> & type_ranges() const { return _type_ranges; }
+
+  /**
+   * @return the proxy of packed element e
+   */
+  ElemProxy elem(unsigned int e) const { return ElemProxy(*this, e); }
+
+  /**
+   * vertex average of all the packed elements, the same as Elem::centroid()
+   */
+  void centroids(std::vector<Point> &cp) const;
+
+  /**
+   * @return the gradient of nodal value var (ordered as element nodes) in element e
+   */
+  VectorValue<PetscScalar> gradient(unsigned int e, const std::vector<PetscScalar> &var) const;
+
+  /**
+   * approx memory usage
+   */
+  size_t memory_size() const;
+
+private:
+
+  /**
+   * node coordinates
+   */
+  std::vector<Real>          _x, _y, _z;
+
+  /**
+   * node id of each packed node
+   */
+  std::vector<unsigned int>  _node_id;
+
+  /**
+   * node id to packed node index
+   */
+  std::vector<unsigned int>  _node_index;
+
+  /**
+   * connectivity of packed elements, as packed node index
+   */
+  std::vector<unsigned int>  _conn;
+
+  /**
+   * element ranges grouped by type
+   */
+  std::vector<TypeRange>     _type_ranges;
+
+  /**
+   * type range of each packed element
+   */
+  std::vector<unsigned char> _elem_range;
+
+  /**
+   * id of each packed element
+   */
+  std::vector<unsigned int>  _elem_id;
+
+  /**
+   * subdomain of each packed element
+   */
+  std::vector<unsigned int>  _elem_subdomain;
+
+  /**
+   * the original element
+   */
+  std::vector<const Elem *>  _elem_ptr;
+
+  friend class ElemProxy;
+};
+
+
+#endif
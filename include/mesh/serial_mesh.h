@@ -204,7 +204,7 @@ class SerialMesh : public UnstructuredMesh
   /**
    * functions for reordering elems
    */
-  virtual bool reorder_elems(std::string &err);
+  virtual bool reorder_elems(std::string &err, MeshReorderType type = MeshReorder_RCM);
 
   /**
    * functions for reordering nodes
@@ -437,6 +437,17 @@ private:
 
 private:
 
+  /**
+   * Reverse Cuthill-McKee order of elems in the same subdomain
+   */
+  void _rcm_order(const std::vector<Elem *> &elems, std::vector<Elem *> &order) const;
+
+  /**
+   * order elems by the Hilbert curve index of their centroid,
+   * centroids are indexed by elem id
+   */
+  void _hilbert_order(const std::vector<Elem *> &elems, const std::vector<Point> &centroids, std::vector<Elem *> &order) const;
+
   void _unpack_mesh (const std::vector<Real> &pts, const std::vector<int> &conn);
   void _unpack_bc_faces (const std::vector<unsigned int> &el_id,
                          const std::vector<unsigned short int> &side_id,
@@ -304,10 +304,10 @@ class FVM_Insulator_NodeData : public FVM_NodeData
     {
       switch ( variable )
       {
-        case POTENTIAL   :  psi() = value;                             /* potential */
-        case ELECTRON    :  n() = value;                               /* electron concentration */
-        case HOLE        :  p() = value;                               /* hole concentration */
-        case TEMPERATURE :  T() = value;                               /* lattice temperature */
+        case POTENTIAL   :  psi() = value; break;                       /* potential */
+        case ELECTRON    :  n() = value; break;                         /* electron concentration */
+        case HOLE        :  p() = value; break;                         /* hole concentration */
+        case TEMPERATURE :  T() = value; break;                         /* lattice temperature */
         default          :  return;
       }
     }
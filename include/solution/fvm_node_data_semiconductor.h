@@ -530,19 +530,19 @@ class FVM_Semiconductor_NodeData : public FVM_NodeData
     {
       switch ( variable )
       {
-        case POTENTIAL     :  psi() = value;                             /* potential */
-        case ELECTRON      :  n() = value;                               /* electron concentration */
-        case HOLE          :  p() = value;                               /* hole concentration */
-        case TEMPERATURE   :  T() = value;                               /* lattice temperature */
-        case E_TEMP        :  Tn() = value;                              /* electron temperature */
-        case H_TEMP        :  Tp() = value;                              /* hole temperature */
-        case DOPING_Na     :  Na() = value;                              /* acceptor */
-        case DOPING_Nd     :  Nd() = value;                              /* donor */
-        case OPTICAL_GEN   :  OptG() = value;                            /* charge genetated by optical ray */
-        case OPTICAL_HEAT  :  OptQ() = value;                            /* heat genetated by optical ray */
-        case PARTICLE_GEN  :  PatG() = value;                            /* charge genetated by particle ray */
-        case MOLE_X        :  mole_x() = value;
-        case MOLE_Y        :  mole_y() = value;
+        case POTENTIAL     :  psi() = value; break;                       /* potential */
+        case ELECTRON      :  n() = value; break;                         /* electron concentration */
+        case HOLE          :  p() = value; break;                         /* hole concentration */
+        case TEMPERATURE   :  T() = value; break;                         /* lattice temperature */
+        case E_TEMP        :  Tn() = value; break;                        /* electron temperature */
+        case H_TEMP        :  Tp() = value; break;                        /* hole temperature */
+        case DOPING_Na     :  Na() = value; break;                        /* acceptor */
+        case DOPING_Nd     :  Nd() = value; break;                        /* donor */
+        case OPTICAL_GEN   :  OptG() = value; break;                      /* charge genetated by optical ray */
+        case OPTICAL_HEAT  :  OptQ() = value; break;                      /* heat genetated by optical ray */
+        case PARTICLE_GEN  :  PatG() = value; break;                      /* charge genetated by particle ray */
+        case MOLE_X        :  mole_x() = value; break;
+        case MOLE_Y        :  mole_y() = value; break;
         default            :  return;
       }
     }
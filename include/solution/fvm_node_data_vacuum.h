@@ -197,7 +197,7 @@ class FVM_Vacuum_NodeData : public FVM_NodeData
     {
       switch ( variable )
       {
-        case POTENTIAL   :  psi() = value;                             /* potential */
+        case POTENTIAL   :  psi() = value; break;                       /* potential */
         default          :  return;
       }
     }
@@ -326,6 +326,17 @@ public:
    */
   void set_local_offset (unsigned int pos )  { _local_offset[_solver_index] = pos; }
 
+  /**
+   * @return dense index of this node in its region, in the order of global node id.
+   * it is invalid_uint before SimulationRegion::build_region_node_index()
+   */
+  unsigned int region_index () const    { return _region_index; }
+
+  /**
+   * function for set dense region index
+   */
+  void set_region_index (unsigned int idx )  { _region_index = idx; }
+
   /**
    * @return the volume of this FVM cell
    */
@@ -585,6 +596,11 @@ private:
    */
   unsigned int _local_offset[4];
 
+  /**
+   * dense index of this node in its region
+   */
+  unsigned int _region_index;
+
 };
 
 
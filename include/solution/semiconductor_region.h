@@ -122,6 +122,12 @@ public:
   Material::MaterialSemiconductor * material() const
     {return mt;}
 
+  /**
+   * @return the pointer to material data owned by thread \p tid
+   */
+  Material::MaterialSemiconductor * material(unsigned int tid) const
+    {return static_cast<Material::MaterialSemiconductor *>(material_instance(tid));}
+
   /**
    * @return the base class of material database
    */
@@ -149,6 +155,12 @@ public:
    */
   virtual Complex get_optical_refraction(const FVM_Node *, double lamda) const;
 
+  /**
+   * @return the optical refraction index at fvm node, evaluated by the material object of thread \p tid.
+   * prepare_material_instances() must be called before the parallel section
+   */
+  Complex get_optical_refraction(const FVM_Node *, double lamda, unsigned int tid) const;
+
   /**
    * @return the energy bandgap for optical simulation
    */
@@ -306,6 +318,17 @@ private:
    */
   Material::MaterialSemiconductor *mt;
 
+  /**
+   * edge arguments and S-G current of the batched flux kernel in DDM1_Function.
+   * kept by the region, the buffers are not allocated again for each residual
+   */
+  struct SGEdgeBuffer
+  {
+    std::vector<PetscScalar> dEc, dEv, n1, n2, p1, p2, length;
+    std::vector<PetscScalar> Jn, Jp;
+  };
+  SGEdgeBuffer _sg_edge_buffer;
+
 
 private:
 
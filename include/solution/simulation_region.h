@@ -242,6 +242,24 @@ public:
    */
   FVM_NodeData * region_node_data(unsigned int id) const;
 
+  /**
+   * batched version of region_fvm_node(unsigned int), NULL for ids not in this region.
+   * sorted ids are looked up in a single pass
+   */
+  void region_fvm_nodes(const std::vector<unsigned int> &ids, std::vector<FVM_Node *> &fvm_nodes) const;
+
+  /**
+   * @return the dense index of Node id in this region, invalid_uint if no find.
+   * the index is the same as FVM_Node::region_index()
+   */
+  unsigned int region_node_index(unsigned int id) const;
+
+  /**
+   * @return the fvm_node by its dense index in this region
+   */
+  FVM_Node * region_fvm_node_by_index(unsigned int idx) const
+  { return _region_node_index_ptr[idx]; }
+
   /**
    * @return region's name
    */
@@ -483,11 +501,35 @@ public:
   unsigned int elem_edge_index(const Elem* elem, unsigned int e) const
   { return _region_elem_edge_in_edges_index.find(elem)->second[e]; }
 
+  /**
+   * @return the control volume surface area between the two fvm_nodes of edge e,
+   * the same as edge.first->cv_surface_area(edge.second)
+   */
+  Real edge_cv_surface_area(unsigned int e) const
+  { return _region_edge_cv_area[e]; }
+
+  /**
+   * @return the absolute control volume surface area between the two fvm_nodes of edge e
+   */
+  Real edge_cv_abs_surface_area(unsigned int e) const
+  { return _region_edge_cv_abs_area[e]; }
+
+  /**
+   * (re)build edge area arrays from FVM_Node neighbor lists.
+   * must be called after the region edges are built and the cv surface areas are final
+   */
+  void build_region_edge_cv_area();
+
   /**
    * (re)build _region_local_node and _region_processor_node for fast iteration
    */
   void rebuild_region_fvm_node_list();
 
+  /**
+   * (re)build the dense node index from _region_node, also set FVM_Node::region_index()
+   */
+  void build_region_node_index();
+
   /**
    * for some pre process
    */
@@ -544,6 +586,24 @@ public:
    */
   virtual Material::MaterialBase * get_material_base() const=0;
 
+  /**
+   * build independent material objects for concurrent evaluation of material models.
+   * each of them holds its own PMI objects with the same models and calibrations
+   * as get_material_base(). must be called outside the parallel section.
+   * PMI library which does not declare ABI version 2 can not be cloned safely, no clone is built for it.
+   * @param n  number of threads
+   * @return the number of threads which may evaluate the material at the same time,
+   * n or 1 for the old PMI library
+   */
+  unsigned int prepare_material_instances(unsigned int n);
+
+  /**
+   * @return material object which belongs to thread \p tid. thread 0 gets
+   * get_material_base(), others get the clones built by prepare_material_instances().
+   * \p tid must be less than the thread count prepare_material_instances() returned
+   */
+  Material::MaterialBase * material_instance(unsigned int tid) const;
+
   /**
    * set the variables for this region
    */
@@ -798,6 +858,16 @@ protected:
    */
   std::string                    _region_material;
 
+  /**
+   * cloned material objects for thread 1, 2, ..., thread 0 uses the region's own one
+   */
+  std::vector<Material::MaterialBase *>  _material_instances;
+
+  /**
+   * the warning of material library which can not be cloned has been printed
+   */
+  bool                           _material_instances_warned;
+
 
   /**
    * region's default temperature
@@ -858,6 +928,32 @@ protected:
    */
   std::map< unsigned int, FVM_Node * > _region_node;
 
+  /**
+   * sorted node id of _region_node, used for lookup after the region is built.
+   * _region_node is only used while FVM nodes are inserted/removed
+   */
+  std::vector<unsigned int>  _region_node_index_id;
+
+  /**
+   * FVM_Node of _region_node_index_id
+   */
+  std::vector<FVM_Node *>    _region_node_index_ptr;
+
+  /**
+   * when node ids are compact, direct table from (id - _region_node_index_base) to dense index
+   */
+  std::vector<unsigned int>  _region_node_index_table;
+
+  /**
+   * smallest node id in this region
+   */
+  unsigned int               _region_node_index_base;
+
+  /**
+   * true when the index agrees with _region_node
+   */
+  bool                       _region_node_index_valid;
+
 
   /**
    * on local nodes (on processor nodes + ghost nodes) belong to this region.
@@ -890,6 +986,16 @@ protected:
    */
   std::vector< std::pair<FVM_Node *, FVM_Node *> > _region_edges;
 
+  /**
+   * cv surface area of each edge, parallel to _region_edges
+   */
+  std::vector<Real>          _region_edge_cv_area;
+
+  /**
+   * absolute cv surface area of each edge, parallel to _region_edges
+   */
+  std::vector<Real>          _region_edge_cv_abs_area;
+
   /**
    * the corresponding location of an element's edge in _region_edges
    * by given an element pointer, and the local index of the edge
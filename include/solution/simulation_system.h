@@ -29,6 +29,7 @@
 #include "tensor_value.h"
 #include "enum_solution.h"
 #include "enum_solver_specify.h"
+#include "enum_mesh_reorder.h"
 #include "error_vector.h"
 #include "physical_unit.h"
 #include "interpolation_base.h"
@@ -393,6 +394,20 @@ public:
    */
   void do_interpolation(const InterpolationBase *, const std::string &);
 
+  /**
+   * fill solution variables (potential, carrier density and temperatures)
+   * into interpolator, carrier density is interpolated in asinh scale.
+   */
+  void fill_solution_interpolator(InterpolationBase *) const;
+
+  /**
+   * set solution variables from interpolator after mesh refinement.
+   * node data is re-initialized from the interpolated values, as we did after import,
+   * so the next solve starts from this solution instead of equilibrium state.
+   * should be called after init_region()
+   */
+  void do_solution_interpolation(const InterpolationBase *);
+
   /**
    * set unique solver name to _solver_active_history
    */
@@ -464,6 +479,11 @@ private:
    */
   bool _block_partition;
 
+  /**
+   * renumber mesh elems/nodes before the FVM mesh is built
+   */
+  MeshReorderType _mesh_reorder;
+
   /**
    * data structure for fvm solver
    * only build nodes which belongs to local processor
@@ -28,6 +28,7 @@
 #include "parser.h"
 
 class DopingFunction;
+class FVM_Node;
 
 /**
  * this solver compute doping profile by anaytic expression inputted by user
@@ -167,16 +168,56 @@ private:
 
  std::vector<DopingFunction_t>  _custom_profile_funs;
  std::vector<DopingData_t>  _custom_profile_data;
+
+ /**
+  * coordinates of the local nodes, shared by all the doping functions.
+  * the root node shared by several regions appears only once
+  */
+ struct NodeSet
+ {
+   /**
+    * coordinates of the distinct root nodes
+    */
+   std::vector<double> x, y, z;
+
+   /**
+    * the FVM nodes of region r are fvm_nodes[ region_offset[r] ... region_offset[r+1] )
+    */
+   std::vector<unsigned int> region_offset;
+
+   /**
+    * local FVM nodes of all the regions
+    */
+   std::vector<FVM_Node *> fvm_nodes;
+
+   /**
+    * the index of the root node of fvm_nodes[k] in x/y/z
+    */
+   std::vector<unsigned int> node_index;
+ };
+
+ void _build_node_set(NodeSet &node_set) const;
+
+ /**
+  * evaluate doping function at the nodes of the regions which has region_flag set,
+  * each distinct node only once. value is indexed as node_set.x, zero for the nodes not used
+  */
+ void _doping_function_evaluate(DopingFunction * df, const NodeSet &node_set, const std::vector<bool> &region_flag,
+                                std::vector<double> &value) const;
+
+ void _doping_function_apply(DopingFunction * df, const std::string &region_app, const NodeSet &node_set);
+ void _custom_profile_function_apply(const std::string &ion, DopingFunction * df, const std::string &region_app, const NodeSet &node_set);
  
- void _doping_function_apply(DopingFunction * df, const std::string &region_app);
- void _custom_profile_function_apply(const std::string &ion, DopingFunction * df, const std::string &region_app);
- 
- 
- void _doping_data_apply(std::pair<int, InterpolationBase * > df, const std::string &region_app);
- void _custom_profile_data_apply(const std::string &ion, std::pair<int, InterpolationBase * > df, const std::string &region_app);
  
-  
- double _do_data_interp(std::pair<int, InterpolationBase * > df, const Node *node, const std::string &msg=std::string());
+ /**
+  * interpolate doping data file at the nodes of the regions which has region_flag set,
+  * all the nodes in one bulk query. value is indexed as node_set.x, zero for the nodes not used
+  */
+ void _doping_data_evaluate(std::pair<int, InterpolationBase * > df, const NodeSet &node_set, const std::vector<bool> &region_flag,
+                            std::vector<double> &value) const;
+
+ void _doping_data_apply(std::pair<int, InterpolationBase * > df, const std::string &region_app, const NodeSet &node_set);
+ void _custom_profile_data_apply(const std::string &ion, std::pair<int, InterpolationBase * > df, const std::string &region_app, const NodeSet &node_set);
 
 };
 
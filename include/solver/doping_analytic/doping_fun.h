@@ -72,12 +72,34 @@ public:
    */
   virtual double profile(double x, double y, double z)=0;
 
+  /**
+   * compute the profile at the points given by coordinate arrays (x[i], y[i], z[i]).
+   * points outside bounding_box() are set to zero without evaluation, the rest
+   * are gathered into contiguous arrays and evaluated by blocks in parallel
+   */
+  void profile(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &z,
+               std::vector<double> &value);
+
+  /**
+   * the box outside which the profile is zero, or negligible (below 1e-15 of its peak)
+   * @return false when the profile has no such box
+   */
+  virtual bool bounding_box(Point &, Point &) const
+  { return false; }
+
 protected:
   /**
    * impurity ion type N-ion or P-ion
    */
   double _ion;
 
+  /**
+   * compute the profile of n points given by coordinate arrays,
+   * the default calls profile(x,y,z) for each point.
+   * it is called from parallel threads, so it should not modify the object
+   */
+  virtual void _profile(const double *x, const double *y, const double *z, unsigned int n, double *value);
+
 
 };
 
@@ -106,6 +128,11 @@ public:
    */
   double profile(double x,double y,double z);
 
+  /**
+   * the doping box
+   */
+  bool bounding_box(Point &min, Point &max) const;
+
 private:
   /**
    * the peak value of doping concentration
@@ -173,6 +200,11 @@ public:
    */
   double profile(double x,double y,double z);
 
+  /**
+   * the doping box
+   */
+  bool bounding_box(Point &min, Point &max) const;
+
 
 private:
 
@@ -262,6 +294,18 @@ public:
    */
   double profile(double x, double y, double z);
 
+  /**
+   * the doping box extended by 6 characteristic lengths
+   */
+  bool bounding_box(Point &min, Point &max) const;
+
+protected:
+
+  /**
+   * compute the profile of n points, axis by axis
+   */
+  void _profile(const double *x, const double *y, const double *z, unsigned int n, double *value);
+
 private:
   /**
    * the peak value of doping concentration
@@ -353,6 +397,12 @@ public:
    */
   double profile(double x, double y, double z);
 
+  /**
+   * the box swept by the mask window along the doping line
+   */
+  bool bounding_box(Point &min, Point &max) const
+  { min = _doping_min; max = _doping_max; return true; }
+
 private:
 
   /**
@@ -393,6 +443,16 @@ private:
 
   PolygonUSample _mask_mesh;
 
+  /**
+   * doping bounding box
+   */
+  Point _doping_min;
+
+  /**
+   * doping bounding box
+   */
+  Point _doping_max;
+
 
   std::vector<double> prof_func_r(const std::vector<double> &rs) const;
 
@@ -430,6 +490,11 @@ public:
    */
   double profile(double x, double y, double z);
 
+  /**
+   * the box swept by the mask window along the doping line
+   */
+  bool bounding_box(Point &min, Point &max) const;
+
 private:
 
   /**
@@ -24,12 +24,17 @@
 #define __light_thread_h__
 
 
+// C++ include
+#include <vector>
+
 //local include
+#include "genius_common.h"
 #include "point.h"
 #include "elem_intersection.h"
 
 class Elem;
 class ARCoatings;
+class LightThreadPool;
 
 /**
  * class to define a light
@@ -40,9 +45,11 @@ public:
 
   LightThread(const Point & p, const Point & dir, const Point & E_dir, double wavelength, double init_power, double power)
       :_p(p), _dir(dir.unit()), _E_dir(E_dir), _wavelength(wavelength),
-      _init_power(init_power), _power(power)
+      _init_power(init_power), _power(power), _pool(NULL)
   {
     hit_elem = NULL;
+    path_segment = -1;
+    path_power = power;
   }
 
   /**
@@ -140,6 +147,18 @@ public:
    */
   IntersectionResult result;
 
+  /**
+   * the last recorded path segment of this light, -1 for none.
+   * the reflect/refract lights inherit it from their parent
+   */
+  int path_segment;
+
+  /**
+   * the power at the end of last recorded path segment
+   * (or the power of origin ray when no segment)
+   */
+  double path_power;
+
   /**
    * factor to determine it is dead
    */
@@ -165,18 +184,31 @@ private:
   /**
    * wave length of the light
    */
-  const double _wavelength;
+  double _wavelength;
 
   /**
    * initial power of this thread
    */
-  const double _init_power;
+  double _init_power;
 
   /**
    * current power of this thread
    */
   double _power;
 
+  /**
+   * the pool this light belongs to, NULL if created by new.
+   * the reflect/refract lights are created from the same pool
+   */
+  LightThreadPool * _pool;
+
+  /**
+   * create a new light, from the pool if this light has one
+   */
+  LightThread * _new_light(const Point & p, const Point & dir, const Point & E_dir, double wavelength, double init_power, double power) const;
+
+  friend class LightThreadPool;
+
   /// light refraction on simple interface
   std::pair<LightThread *, LightThread *> _interface_light_gen_linear_polarized_simple
       (const Point & in_p, const Point & norm, double n1, double n2 ) const;
@@ -188,6 +220,101 @@ private:
 
 };
 
+
+
+/**
+ * object pool of LightThread. released lights are kept alive and reused,
+ * so the memory of the light (and its intersection result) is allocated only
+ * when the number of living lights exceeds the peak before.
+ * the pool is not thread safe, each thread should have its own pool.
+ */
+class LightThreadPool
+{
+public:
+
+  LightThreadPool() {}
+
+  /**
+   * delete all the lights in the pool
+   */
+  ~LightThreadPool();
+
+  /**
+   * @return a light from the pool
+   */
+  LightThread * create(const Point & p, const Point & dir, const Point & E_dir, double wavelength, double init_power, double power);
+
+  /**
+   * @return a copy of given light from the pool
+   */
+  LightThread * create(const LightThread & light);
+
+  /**
+   * give the light back to the pool
+   */
+  void release(LightThread * light)
+  { _free.push_back(light); }
+
+private:
+
+  /**
+   * all the lights created by the pool
+   */
+  std::vector<LightThread *> _lights;
+
+  /**
+   * the released lights
+   */
+  std::vector<LightThread *> _free;
+
+  /**
+   * not copyable
+   */
+  LightThreadPool(const LightThreadPool &);
+  LightThreadPool & operator= (const LightThreadPool &);
+};
+
+
+
+/**
+ * fixed capacity stack of lights, the work list of ray tracing
+ */
+class LightThreadStack
+{
+public:
+
+  /**
+   * the capacity of the stack
+   */
+  static const unsigned int capacity = 4096;
+
+  LightThreadStack() : _size(0) {}
+
+  bool empty() const
+  { return _size == 0; }
+
+  unsigned int size() const
+  { return _size; }
+
+  void push(LightThread * light)
+  {
+    genius_assert(_size < capacity);
+    _lights[_size++] = light;
+  }
+
+  LightThread * top() const
+  { return _lights[_size-1]; }
+
+  void pop()
+  { --_size; }
+
+private:
+
+  LightThread * _lights[capacity];
+
+  unsigned int _size;
+};
+
 #endif
 
 
@@ -0,0 +1,139 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+
+#ifndef __ray_path_h__
+#define __ray_path_h__
+
+#include <vector>
+#include <map>
+
+
+/**
+ * the geometric path of rays recorded by ray tracing.
+ * each ray is a tree of segments, a segment is the part of a ray inside one elem.
+ * the power at the start of a segment is factor * (power at the end of parent segment),
+ * or factor * (power of origin ray) when it has no parent. all the reflection/refraction
+ * power split is linear, so the energy deposit can be recomputed from the path when only
+ * the absorption changed.
+ * segment and leak of ray k are [ray_segment_offset[k], ray_segment_offset[k+1]) and
+ * [ray_leak_offset[k], ray_leak_offset[k+1]). parent index is local to the ray.
+ */
+struct RayPath
+{
+  RayPath() { clear(); }
+
+  /**
+   * remove all the rays
+   */
+  void clear();
+
+  /**
+   * @return the number of recorded rays
+   */
+  unsigned int n_rays() const
+  { return static_cast<unsigned int>(ray_segment_offset.size()-1); }
+
+  /**
+   * add a segment to current ray, @return the local index of the segment
+   */
+  int add_segment(unsigned int elem, double length, int parent, double factor);
+
+  /**
+   * the last segment deposits weight of its energy into elem
+   */
+  void add_target(unsigned int elem, double weight);
+
+  /**
+   * power leaves current ray without absorption, pass through or escape from device
+   */
+  void add_leak(int parent, double factor, bool escape);
+
+  /**
+   * finish current ray, the following segments belong to next ray
+   */
+  void end_ray();
+
+  /**
+   * append all the rays of other path
+   */
+  void append(const RayPath & other);
+
+  std::vector<unsigned int> ray_segment_offset;
+  std::vector<unsigned int> ray_leak_offset;
+
+  /// the elem gives the absorption of segment
+  std::vector<unsigned int> seg_elem;
+  std::vector<double>       seg_length;
+  std::vector<int>          seg_parent;
+  std::vector<double>       seg_factor;
+
+  /// the elems share the energy deposit of segment s are target_elem[seg_target_offset[s] ... seg_target_offset[s+1]-1]
+  std::vector<unsigned int> seg_target_offset;
+  std::vector<unsigned int> target_elem;
+  std::vector<double>       target_weight;
+
+  std::vector<int>          leak_parent;
+  std::vector<double>       leak_factor;
+  std::vector<char>         leak_escape;
+};
+
+
+
+/**
+ * ray paths of each wavelength, kept by the light source between ray tracing runs.
+ * the path is valid as long as the real part of elem refractive index is not changed.
+ */
+class RayPathCache
+{
+public:
+
+  RayPathCache() {}
+
+  /**
+   * @return the cached path of wavelength, NULL if not exist or not valid for
+   * the given refractive index and number of rays
+   */
+  const RayPath * path(double wavelength, const std::vector<double> & refractive_index, unsigned int n_rays) const;
+
+  /**
+   * save the path of wavelength, path is cleared after it is copied into the cache
+   */
+  void set_path(double wavelength, const std::vector<double> & refractive_index, RayPath & path);
+
+  /**
+   * remove all the paths
+   */
+  void clear()
+  { _paths.clear(); }
+
+private:
+
+  struct CachedPath
+  {
+    std::vector<double> refractive_index;
+    RayPath path;
+  };
+
+  std::map<double, CachedPath> _paths;
+};
+
+#endif
@@ -33,12 +33,15 @@
 #include "edge_edge2.h"
 #include "parser.h"
 #include "solver_base.h"
+#include "ray_tracing/ray_path.h"
 
 
 class ObjectTree;
 class LightThread;
+class LightThreadPool;
 class LightLenses;
 class ARCoatings;
+class ExprEvalute;
 
 /**
  * Ray tracing program  to calculate photogeneration carriers, which is
@@ -79,6 +82,14 @@ public:
    */
   virtual int destroy_solver();
 
+  /**
+   * use the ray path cache, it is owned by caller and should live longer than solver.
+   * the paths recorded in this run are saved into cache, and the paths in cache are
+   * replayed when the refraction geometry is not changed
+   */
+  void set_path_cache(RayPathCache * cache)
+  { _path_cache = cache; }
+
 
 private:
 
@@ -133,6 +144,17 @@ private:
    */
   double get_free_carrier_absorption(const Elem*, double) const;
 
+  /**
+   * free carrier absorption of each elem for a special lamda,
+   * so that rays traced by threads do not call material functions
+   */
+  std::vector<double> _elem_fc_absorption;
+
+  /**
+   * build _elem_fc_absorption
+   */
+  void build_elem_free_carrier_absorption(double lamda);
+
   /**
    * record all the elements which contains this Node as its vertex
    */
@@ -234,6 +256,82 @@ private:
    */
   ObjectTree *surface_elem_tree;
 
+  /**
+   * the ray path cache, NULL for no cache
+   */
+  RayPathCache * _path_cache;
+
+  /**
+   * spectral packet mode. the path traced by one wavelength is replayed for the following
+   * wavelengths as long as the real part of refractive index of each elem is within
+   * relative tolerance _ray_packet_tol
+   */
+  bool _ray_packet;
+
+  /**
+   * relative tolerance of refractive index in a spectral packet
+   */
+  double _ray_packet_tol;
+
+  /**
+   * the path of current spectral packet
+   */
+  RayPath _packet_path;
+
+  /**
+   * the real part of elem refractive index of the first wavelength in current packet
+   */
+  std::vector<double> _packet_refractive_index;
+
+  /**
+   * @return true if the wavelength with given refractive index belongs to current packet
+   */
+  bool is_in_ray_packet(const std::vector<double> & refractive_index, unsigned int n_rays) const;
+
+  /**
+   * adaptive sampling mode. the wave plane is divided into strata, and each stratum is sampled
+   * by seeded jittered or quasi-random rays in rounds. the rays of next round are allocated to
+   * the strata by the standard deviation of region absorbed power (Neyman allocation), which puts
+   * more rays near textured surface and optical grating. sampling stops when the relative standard
+   * error of absorbed power of each region is below _adaptive_tol
+   */
+  bool _adaptive;
+
+  /**
+   * Halton sequence with random shift of each stratum, otherwise uniform random jitter
+   */
+  bool _adaptive_quasi_random;
+
+  /**
+   * seed of the sample sequence, the same seed gives the same rays on any number of processors
+   */
+  unsigned int _adaptive_seed;
+
+  /**
+   * relative tolerance of region absorbed power
+   */
+  double _adaptive_tol;
+
+  /**
+   * max sampling rounds for each wavelength
+   */
+  unsigned int _adaptive_max_rounds;
+
+  /**
+   * stratum size in the unit of ray distance
+   */
+  unsigned int _adaptive_coarsen;
+
+  /**
+   * the max relative standard error of region absorbed power achieved for all the wavelengths
+   */
+  double _adaptive_error;
+
+  /**
+   * total number of rays sampled for all the wavelengths
+   */
+  unsigned int _adaptive_rays;
+
   /**
    * when the light source can be considered as plane wave, this struct stores the plane norm to wave direction.
    * we will build a bounding sphere(C,R) of the mesh, then we build the plane with plane_norm = light_direction
@@ -284,6 +382,29 @@ private:
 
     const Point & ray_start_point(unsigned int n) const
     { return ray_start_points[n]; }
+
+    /**
+     * in adaptive sampling mode, ray_start_points are the centers of the strata. stratum is a square
+     * (segment in 2D) of stratum_size with edges along d1 and d2 (zero in 2D)
+     */
+    double stratum_size;
+
+    Point d1, d2;
+
+    /**
+     * global index of each stratum, to seed its sample sequence
+     */
+    std::vector<unsigned int> stratum_index;
+
+    /**
+     * the first boundary elem each ray hits, NULL for rays pass through.
+     * all the rays are traced in one batch when the ray start points are created.
+     * empty when lenses exist, since lenses change the ray
+     */
+    std::vector<const Elem *> ray_first_hit;
+
+    bool has_ray_first_hit() const
+    { return ray_first_hit.size() == ray_start_points.size(); }
   };
 
   WavePlane _wave_plane;
@@ -331,9 +452,97 @@ private:
   void define_lenses();
 
   /**
-   * do ray tracing of a single ray
+   * energy deposit and power statistics of the rays traced by one thread.
+   * they are merged into the solver in a fixed order after all the rays are traced
+   */
+  struct RayTraceAccumulator
+  {
+    RayTraceAccumulator(unsigned int n_elem=0)
+      : band_absorption_energy_in_elem(n_elem, 0.0), total_absorption_energy_in_elem(n_elem, 0.0),
+        incident_power(0.0), pass_power(0.0), escape_power(0.0), absorb_power(0.0)
+    {}
+
+    void add(const RayTraceAccumulator & other)
+    {
+      for(unsigned int n=0; n<band_absorption_energy_in_elem.size(); ++n)
+      {
+        band_absorption_energy_in_elem[n]  += other.band_absorption_energy_in_elem[n];
+        total_absorption_energy_in_elem[n] += other.total_absorption_energy_in_elem[n];
+      }
+      incident_power += other.incident_power;
+      pass_power     += other.pass_power;
+      escape_power   += other.escape_power;
+      absorb_power   += other.absorb_power;
+    }
+
+    std::vector<double> band_absorption_energy_in_elem;
+    std::vector<double> total_absorption_energy_in_elem;
+    double incident_power;
+    double pass_power;
+    double escape_power;
+    double absorb_power;
+  };
+
+  /**
+   * do ray tracing of a single ray, the result is added to accumulator.
+   * the given ray is not changed, the rays in tracing are taken from pool.
+   * the path of the ray is recorded when path is not NULL.
+   * when first_hit_known is true, first_hit is the boundary elem the ray hits first
+   */
+  void ray_tracing(const LightThread *, RayTraceAccumulator &, LightThreadPool &, RayPath * path,
+                   bool first_hit_known=false, const Elem * first_hit=NULL) const;
+
+  /**
+   * trace the rays by threads, or replay them along replay_path when it is not NULL.
+   * the paths are recorded into record_path when it is not NULL, and the first hit of wave plane
+   * rays is used when use_first_hit is true.
+   * rays are split into one contiguous block for each thread, each block has its own accumulator
+   * and the accumulators are added to result in block order, so the result only depends on the
+   * number of threads
+   */
+  void trace_rays(const std::vector<LightThread *> & rays, bool use_first_hit, const RayPath * replay_path,
+                  RayPath * record_path, RayTraceAccumulator & result) const;
+
+  /**
+   * @return the start point of m-th sample ray of stratum s
+   */
+  Point stratum_sample(unsigned int s, unsigned int m) const;
+
+  /**
+   * sample the rays of one wavelength adaptively, the energy deposit is added to result
+   */
+  void adaptive_sampling(double lamda, double intensity, ExprEvalute * grating, RayTraceAccumulator & result);
+
+  /**
+   * the power of ray leaves without absorption, to pass power or escape power.
+   * also record it in path if path is not NULL
+   */
+  void leak_power(RayTraceAccumulator &, RayPath * path, const LightThread *, bool escape) const;
+
+  /**
+   * recompute the energy deposit of ray k along its recorded path with current absorption.
+   * end_power is working space
+   */
+  void ray_replay(const RayPath & path, unsigned int k, double power, double wavelength,
+                  RayTraceAccumulator &, std::vector<double> & end_power) const;
+
+  /**
+   * add the power absorbed along the recorded path of ray k to the region of absorbing elem.
+   * end_power is working space
+   */
+  void ray_region_absorption(const RayPath & path, unsigned int k, double power, double wavelength,
+                             std::vector<double> & region_power, std::vector<double> & end_power) const;
+
+  /**
+   * @return the attenuation factor of a segment of length in elem, and the fraction of absorbed
+   * power by band absorption
+   */
+  double segment_attenuation(unsigned int elem_id, double length, double wavelength, double & band_fraction) const;
+
+  /**
+   * add the result in accumulator to solver
    */
-  void ray_tracing(LightThread *);
+  void merge_accumulator(const RayTraceAccumulator &);
 
   /**
    * save the energy deposit. for parallel simulation, we must gather this vector
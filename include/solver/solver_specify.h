@@ -109,6 +109,11 @@ namespace SolverSpecify
    */
   extern VoronoiTruncationFlag VoronoiTruncation;
 
+  /**
+   * evaluation scheme of Bernoulli function for S-G edge flux
+   */
+  extern BernoulliScheme Bernoulli;
+
 
   //--------------------------------------------
   // half implicit method
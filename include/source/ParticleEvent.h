@@ -241,9 +241,14 @@ public:
    * constructor.
    */
   Event(const CogendaHDF5::LookupTable &region_lut, const std::vector<std::string> &materials)
-  :  _regions(region_lut), _materials(materials),_energyDeposit(0)
+  :  _regions(region_lut), _materials(materials),_energyDeposit(0), _stepBase(0), _grp(-1)
   {}
 
+  /**
+   * destructor, close the Event group opened by openData()
+   */
+  ~Event() { closeData(); }
+
 
   /**
    * to be written to meta-fullname attribute
@@ -333,7 +338,7 @@ public:
      */
     Step operator*()
     {
-      size_t i = _track.StepOffset()+_offset;
+      size_t i = _track.StepOffset()-_base._stepBase+_offset;
       return Step(_base._steps[i]);
     }
 
@@ -431,6 +436,32 @@ public:
    */
   bool writeData(hid_t parent_grp, const std::string& name);
 
+  /**
+   * open the Event for reading its tracks chunk by chunk with readChunk(),
+   * only the tracks and steps of one chunk are kept in memory.
+   * @param parent_grp   id of the group containing the Event group.
+   * @param name         name of the Event group.
+   * @returns true if success, false otherwise
+   */
+  bool openData(hid_t parent_grp, const std::string& name);
+
+  /**
+   * @returns the number of tracks in the Event opened by openData()
+   */
+  size_t nTracks() const { return _tracks.dataSize(); }
+
+  /**
+   * read tracks [offset, offset+count) of the opened Event and all of their steps,
+   * they replace the tracks and steps in memory.
+   * @returns true if success, false otherwise
+   */
+  bool readChunk(size_t offset, size_t count);
+
+  /**
+   * close the Event opened by openData()
+   */
+  void closeData();
+
   /**
    * getter for event id
    */
@@ -476,6 +507,12 @@ private:
   unsigned long _ID;
   double _energyDeposit;
 
+  /// index of the first step in memory, nonzero when steps are read in chunks
+  size_t _stepBase;
+
+  /// Event group opened for chunked reading, negative if not opened
+  hid_t _grp;
+
 };
 
 }
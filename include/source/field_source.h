@@ -35,6 +35,7 @@ namespace Parser{
 }
 class LightLenses;
 class SimulationSystem;
+class FVM_NodeData;
 
 /**
  * manage all the field sources
@@ -171,6 +172,47 @@ private:
    */
   LightLenses  *_light_lenses;
 
+  /**
+   * the spatial generation of all the sources on the on processor nodes of one region.
+   * sources only change their time factor between update_source() calls, the generation
+   * at a time step is the sum of profile times time factor over the sources
+   */
+  struct RegionGeneration
+  {
+    /**
+     * node data of on processor nodes
+     */
+    std::vector<FVM_NodeData *> node_data;
+
+    /**
+     * PatG profile of particle source p at node i is particle_profile[p*n_nodes + i].
+     * empty for non-semiconductor region
+     */
+    std::vector<double> particle_profile;
+
+    /**
+     * OptG profile of light source l at node i is light_profile[l*n_nodes + i].
+     * empty for non-semiconductor region
+     */
+    std::vector<double> light_profile;
+  };
+
+  /**
+   * spatial generation of each region
+   */
+  std::vector<RegionGeneration> _region_generation;
+
+  /**
+   * gather the spatial generation of all the sources into _region_generation,
+   * called after the sources are updated
+   */
+  void build_spatial_generation();
+
+  /**
+   * @return false if the mesh is changed after _region_generation built
+   */
+  bool is_spatial_generation_valid() const;
+
   /**
    * all the waveforms
    */
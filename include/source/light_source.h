@@ -39,6 +39,7 @@ namespace Parser{
 class SimulationSystem;
 class FVM_Node;
 class Waveform;
+class RayPathCache;
 
 class Light_Source
 {
@@ -71,6 +72,22 @@ public:
    */
   virtual void update_source() {}
 
+  /**
+   * @return the time factor of carrier generation in the time step ends at t,
+   * the generation is spatial_generation() times this factor
+   */
+  virtual double time_factor(double t) const;
+
+  /**
+   * @return the spatial generation profile at on processor FVM node, which
+   * is fixed until update_source() called again
+   */
+  double spatial_generation(const FVM_Node * fvm_node) const
+  {
+    std::map<const FVM_Node *, double>::const_iterator it = _fvm_node_particle_deposit.find(fvm_node);
+    return it == _fvm_node_particle_deposit.end() ? 0.0 : it->second;
+  }
+
   /**
    * virtual function for limit the time step
    */
@@ -173,6 +190,11 @@ private:
   int _dim;
   int _skip_line;
 
+  /**
+   * directory to keep the built interpolant, empty for no cache
+   */
+  std::string _interpolation_cache;
+
   double _LUnit;
   double _FUnit;
 
@@ -192,13 +214,13 @@ class Light_Source_RayTracing : public Light_Source
   public:
 
     Light_Source_RayTracing(SimulationSystem &system, const Parser::Card &c)
-    :Light_Source(system),_card(c)
+    :Light_Source(system),_card(c),_ray_path_cache(0)
     {}
 
     /**
-     * virtual destructor
+     * virtual destructor, delete the ray path cache
      */
-    virtual ~Light_Source_RayTracing() {}
+    virtual ~Light_Source_RayTracing();
 
 
    /**
@@ -215,6 +237,12 @@ class Light_Source_RayTracing : public Light_Source
 
     const Parser::Card _card;
 
+    /**
+     * the ray paths kept between update_source() calls when ray.cache is set,
+     * only the absorption along the paths is recomputed while refraction geometry not changed
+     */
+    RayPathCache * _ray_path_cache;
+
 };
 
 
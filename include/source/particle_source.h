@@ -35,6 +35,7 @@ namespace Parser{
 class SimulationSystem;
 class SimulationRegion;
 class FVM_Node;
+class NearestNodeLocator;
 
 /**
  * set the carrier generation of Particle
@@ -62,6 +63,22 @@ public:
    */
   virtual void update_source()=0;
 
+  /**
+   * @return the time factor of carrier generation in the time step ends at t,
+   * the generation is spatial_generation() times this factor
+   */
+  virtual double time_factor(double t) const;
+
+  /**
+   * @return the spatial generation profile at on processor FVM node, which
+   * is fixed until update_source() called again
+   */
+  double spatial_generation(const FVM_Node * fvm_node) const
+  {
+    std::map<const FVM_Node *, double>::const_iterator it = _fvm_node_particle_deposit.find(fvm_node);
+    return it == _fvm_node_particle_deposit.end() ? 0.0 : it->second;
+  }
+
   /**
    * virtual function for limit the time step
    */
@@ -230,12 +247,70 @@ private:
     double       lateral_char;
   };
 
-  std::vector<track_t> _tracks;
+  /**
+   * track file in text format
+   */
+  std::string _track_file;
+
+  /**
+   * track file in hdf5 format, and the path of event in it
+   */
+  std::string _hdf5_file;
+  std::string _hdf5_path;
+
+  /**
+   * default lateral char. length of track
+   */
+  Real _lateral_char;
+
+  /**
+   * the tracks are streamed from file in chunks of this size,
+   * each chunk is deposited before the next one is read
+   */
+  unsigned int _chunk_size;
+
+  /**
+   * only the tracks overlap the box [_filter_min, _filter_max] are used when _filter_box is true
+   */
+  bool  _filter_box;
+  Point _filter_min;
+  Point _filter_max;
+
+  /**
+   * only the tracks with energy above this value are used
+   */
+  double _filter_energy;
 
-  void _read_particle_profile_track_evt(const std::string &, Real );
+  /**
+   * @return true if the track is not filtered out
+   */
+  bool _accept_track(const track_t &) const;
+
+  /**
+   * read the tracks chunk by chunk, only one chunk is in memory
+   */
+  class TrackReader;
+  class TrackReaderEvt;
 #ifdef HAVE_HDF5
-  void _read_particle_profile_track_hdf5(const std::string &, const std::string & path, Real );
+  class TrackReaderHDF5;
 #endif
+  class TrackReaderSequence;
+
+  /**
+   * @return a new reader at the beginning of track file
+   */
+  TrackReader * _open_track_reader() const;
+
+  /**
+   * flat index of on processor fvm nodes
+   */
+  struct NodeSlots;
+
+  /**
+   * deposit the energy of tracks to slot_energy_density
+   */
+  void _deposit_tracks(const std::vector<track_t> & tracks, const NearestNodeLocator & nn_locator,
+                       const NodeSlots & slots, std::vector<double> & slot_energy_density) const;
 };
 
 
@@ -126,7 +126,9 @@ namespace CogendaHDF5
   {
   public:
 
-    virtual ~RecordDataset() {}
+    RecordDataset() : _dset(-1) {}
+
+    virtual ~RecordDataset() { closeData(); }
 
     /**
      * @returns the number of data records, i.e. number of tracks
@@ -220,6 +222,68 @@ namespace CogendaHDF5
       return true;
     }
 
+    /**
+     * open the dataset <grp>/dName for reading in chunks by readChunk(),
+     * so that a dataset larger than memory can be processed.
+     * @returns true if success, false otherwise
+     */
+    bool openData(hid_t grp, const std::string& dName)
+    {
+      closeData();
+      _dset = H5Dopen(grp, dName.c_str(), H5P_DEFAULT);
+      return _dset>=0;
+    }
+
+    /**
+     * @returns the number of data records in the opened dataset
+     */
+    hsize_t dataSize() const
+    {
+      if (_dset<0) return 0;
+      hid_t dspace = H5Dget_space(_dset);
+      if (dspace<0) return 0;
+      hsize_t nelmts = H5Sget_simple_extent_npoints(dspace);
+      H5Sclose(dspace);
+      return nelmts;
+    }
+
+    /**
+     * read the records [offset, offset+count) of the opened dataset,
+     * they replace the records in memory.
+     * @returns true if success, false otherwise
+     */
+    bool readChunk(hsize_t offset, hsize_t count)
+    {
+      _data.clear();
+      if (_dset<0) return false;
+      if (count==0) return true;
+
+      hid_t fspace = H5Dget_space(_dset);
+      if (fspace<0) return false;
+      if (H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &offset, NULL, &count, NULL)<0)
+      {
+        H5Sclose(fspace);
+        return false;
+      }
+      hid_t mspace = H5Screate_simple(1, &count, NULL);
+
+      _data.resize(count, filler());
+      herr_t status = H5Dread(_dset, memDataType(), mspace, fspace, H5P_DEFAULT, &_data[0]);
+
+      H5Sclose(mspace);
+      H5Sclose(fspace);
+      return status>=0;
+    }
+
+    /**
+     * close the dataset opened by openData()
+     */
+    void closeData()
+    {
+      if (_dset>=0) H5Dclose(_dset);
+      _dset = -1;
+    }
+
   protected:
     virtual hid_t memDataType() const = 0;
     virtual hid_t diskDataType() const = 0;
@@ -227,6 +291,9 @@ namespace CogendaHDF5
 
   private:
     std::vector<RecordStruct> _data;
+
+    /// dataset opened for chunked reading, negative if not opened
+    hid_t _dset;
   };
 
 }
@@ -23,12 +23,23 @@
 #define __dose_rate_h__
 
 #include <vector>
+#include <string>
+#include <iostream>
 
-#include "octree.h"
+#include "linear_octree.h"
 
 class SimulationSystem;
 class MeshBase;
 
+/**
+ * accumulate the energy deposited by particle tracks on an octree which
+ * resolves the mesh regions, and convert it to dose (J/kg).
+ *
+ * the octree is a linear octree: leaf keys, levels, weighted density and
+ * deposited energy are stored in contiguous arrays indexed by leaf.
+ * the constrained tree depends only on the structure and the leaf size,
+ * it can be saved to a file and reused by later TID runs on the same structure.
+ */
 class DoseRate
 {
   public:
@@ -40,11 +51,17 @@ class DoseRate
     /**
      * set minimal leaf size
      */
-    void set_min_distance(double x) { min_leaf = x; }
+    void set_min_distance(double x) { _min_leaf = x; }
 
+    /**
+     * set the file which keeps the octree. refine() loads the tree from it
+     * when it was built for the same structure, otherwise saves the new tree to it
+     */
+    void set_octree_file(const std::string &file) { _octree_file = file; }
 
     /**
-     * refine the octree;
+     * build the octree with current minimal leaf size,
+     * the deposited energy is cleared when the tree is rebuilt
      */
     void refine();
 
@@ -54,6 +71,13 @@ class DoseRate
      */
     void energy_deposite(const Point &p1, const Point &p2, double e);
 
+    /**
+     * calculate energy deposite of a batch of tracks (p1[i], p2[i], e[i]).
+     * the tracks are split into one block for each thread, the result is
+     * the same for any number of threads
+     */
+    void energy_deposite(const std::vector<Point> &p1, const std::vector<Point> &p2, const std::vector<double> &e);
+
     /**
      * parallel sync
      */
@@ -104,29 +128,39 @@ class DoseRate
     const MeshBase & _mesh;
 
     /**
-     * density of each region
+     * minimal leaf size
      */
-    static std::vector<double> density;
+    double _min_leaf;
 
     /**
-     * build mesh constrain
+     * the leaf size current octree built with, negative before the first build
      */
-    static void build_region_density(const SimulationSystem & system) ;
+    double _built_min_leaf;
 
     /**
-     * mesh constrain for each region
+     * file to save/load the octree, empty for no file
      */
-    static std::vector<double> constrain;
+    std::string _octree_file;
 
     /**
-     * build mesh constrain
+     * density of each region
      */
-    static void build_mesh_constrain(const MeshBase & mesh) ;
+    std::vector<double> _density;
 
     /**
-     * minimal leaf size
+     * build density of each region
      */
-    static double min_leaf;
+    void build_region_density();
+
+    /**
+     * mesh constrain for each region
+     */
+    std::vector<double> _constrain;
+
+    /**
+     * build mesh constrain
+     */
+    void build_mesh_constrain();
 
     /**
      * compact elem
@@ -140,29 +174,52 @@ class DoseRate
 
     void mesh_elem(std::vector<CElem> &) const;
 
+    /**
+     * geometry octree
+     */
+    LinearOcTree _octree;
+
+    /**
+     * weighted density of each leaf
+     */
+    std::vector<double> _weighted_density;
 
-    class OcTreeDataDoseRate : public OcTreeDataBase
-    {
-      public:
-        OcTreeDataDoseRate()
-        : electron_energy(0.0), weighted_density(0.0)
-        {}
-        void calculate_density();
-
-        std::vector<CElem> elems;
-        std::vector<Point> electron_endpoint;
-        double electron_energy;
-        double weighted_density;
-
-        std::vector<OcTreeDataBase *> subdivide(const OcTreeNode & node);
-        bool refine(const OcTreeNode & node, const std::vector<OcTreeNode> &neighbor) const;
-        double value(const std::string &) const;
-    };
+    /**
+     * electron energy deposited in each leaf
+     */
+    std::vector<double> _electron_energy;
 
     /**
-     * geometry octree
+     * particle endpoints
+     */
+    std::vector<Point> _electron_endpoint;
+
+    /**
+     * build the octree from mesh elements
+     */
+    void _build_octree();
+
+    /**
+     * hash of the mesh geometry: node coordinates and elem connectivity, subdomain.
+     * the same on all the processors
+     */
+    unsigned long long _mesh_signature() const;
+
+    /**
+     * write octree and leaf density together with the structure signature
+     */
+    void _write_octree(std::ostream &out, unsigned long long mesh_signature) const;
+
+    /**
+     * read octree and leaf density, false when the stream is not
+     * written for current structure and leaf size
+     */
+    bool _read_octree(std::istream &in, unsigned long long mesh_signature);
+
+    /**
+     * root box of the octree: the cube bounding the mesh
      */
-    OcTree * _octree;
+    void _root_box(Point &low, Real &size) const;
 };
 
 #endif
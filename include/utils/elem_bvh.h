@@ -0,0 +1,214 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __elem_bvh_h__
+#define __elem_bvh_h__
+
+// C++ includes
+#include <vector>
+#include <utility>
+
+// Local includes
+#include "genius_common.h"
+#include "point.h"
+#include "tree_base.h"
+
+// Forward Declarations
+class MeshBase;
+class Elem;
+
+
+/**
+ * bounding volume hierarchy over element bounding boxes.
+ * the tree nodes are stored in a flat array in depth-first order,
+ * the first child of an inner node is the next node in the array, the node
+ * records the index of its second child. the split is selected by binned
+ * surface area heuristic along the longest axis of element centroids,
+ * fall back to median split when SAH can not separate the elements.
+ *
+ * point location and ray intersection are provided for single query and
+ * for batch of queries. the batch is sorted along a Morton curve before
+ * traversal so that consecutive queries visit the same tree nodes.
+ */
+class ElemBVH
+{
+public:
+
+  /**
+   * build the BVH from mesh elements, selected by build type
+   * as \p Trees::Tree does
+   */
+  ElemBVH (const MeshBase& mesh, Trees::BuildType type, unsigned int leaf_size=4);
+
+  /**
+   * build the BVH from given elements, which are not owned by BVH
+   */
+  ElemBVH (const std::vector<const Elem *> & elems, unsigned int dim, unsigned int leaf_size=4);
+
+  ~ElemBVH();
+
+  /**
+   * @return the dimension of the BVH, 2 for planar mesh and 3 otherwise
+   */
+  unsigned int dim() const
+  { return _dim; }
+
+  /**
+   * @return number of elements in the BVH
+   */
+  unsigned int n_elems() const
+  { return static_cast<unsigned int>(_elems.size()); }
+
+  /**
+   * @return number of tree nodes
+   */
+  unsigned int n_nodes() const
+  { return static_cast<unsigned int>(_nodes.size()); }
+
+  /**
+   * @return the bounding box of all the elements
+   */
+  std::pair<Point, Point> bounding_box() const;
+
+  /**
+   * @return the element contains point p, NULL if not found.
+   * hint is tested first when not NULL
+   */
+  const Elem * find_element(const Point & p, const Elem * hint=NULL) const;
+
+  /**
+   * locate a batch of points, elems[i] is the element contains points[i], or NULL
+   */
+  void find_elements(const std::vector<Point> & points, std::vector<const Elem *> & elems) const;
+
+  /**
+   * @return the first elem the ray(p,d) hit, NULL if not hit
+   */
+  const Elem * hit_element(const Point & p, const Point & dir) const;
+
+  /**
+   * intersect a batch of rays, elems[i] is the first elem hit by ray(p[i], dir[i]) or NULL
+   */
+  void hit_elements(const std::vector<Point> & p, const std::vector<Point> & dir, std::vector<const Elem *> & elems) const;
+
+  /**
+   * @return true if the ray(p,d) hit the bounding box of the elements
+   */
+  bool hit_boundbox(const Point & p, const Point & dir) const;
+
+  /**
+   * @return true when ray(p,d) hits the elements, t is the parameter of first and last hit point
+   */
+  bool hit_domain(const Point & p, const Point & dir, std::pair<double, double> &t) const;
+
+  /**
+   * @return the memory usage in bytes
+   */
+  size_t memory_size() const;
+
+private:
+
+  /**
+   * not copyable, the BVH may own the surface elements
+   */
+  ElemBVH (const ElemBVH &);
+  ElemBVH & operator= (const ElemBVH &);
+
+  /**
+   * node of the flat tree
+   */
+  struct BVHNode
+  {
+    /**
+     * bounding box of the node
+     */
+    Real min[3];
+    Real max[3];
+
+    /**
+     * leaf: first element in _elems; inner node: index of the second child
+     */
+    unsigned int offset;
+
+    /**
+     * number of elements in a leaf, 0 for inner node
+     */
+    unsigned int count;
+  };
+
+  /**
+   * the tree nodes in depth-first order
+   */
+  std::vector<BVHNode> _nodes;
+
+  /**
+   * the elements ordered by leaves
+   */
+  std::vector<const Elem *> _elems;
+
+  /**
+   * side elements built for Trees::SURFACE_ELEMENTS, owned by BVH
+   */
+  std::vector<const Elem *> _surface_elems;
+
+  /**
+   * dimension
+   */
+  unsigned int _dim;
+
+  /**
+   * max number of elements in a leaf
+   */
+  unsigned int _leaf_size;
+
+  /**
+   * build the tree from _elems
+   */
+  void _build();
+
+  /**
+   * build subtree for elements index[begin, end), return the node index
+   */
+  unsigned int _build_node(unsigned int begin, unsigned int end, unsigned int depth,
+                           std::vector<unsigned int> & index,
+                           const std::vector<Real> & bmin, const std::vector<Real> & bmax,
+                           const std::vector<Real> & centroid);
+
+  /**
+   * @return true when point p inside the box of node
+   */
+  bool _bounds_point(const BVHNode & node, const Point & p) const;
+
+  /**
+   * ray box intersection by slab method, inv_dir is the inverse of ray direction.
+   * t is clipped to [0, tmax]
+   */
+  bool _hit_box(const BVHNode & node, const Point & p, const Point & inv_dir, Real tmax, Real & t) const;
+
+  /**
+   * the order of points along Morton curve in the bounding box.
+   * when dir is given, the points are grouped by the octant of dir first
+   */
+  void _morton_order(const std::vector<Point> & points, std::vector<unsigned int> & order,
+                     const std::vector<Point> * dir=NULL) const;
+};
+
+#endif
@@ -0,0 +1,274 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __linear_octree_h__
+#define __linear_octree_h__
+
+// C++ includes
+#include <vector>
+#include <utility>
+#include <string>
+#include <iostream>
+
+// Local includes
+#include "genius_common.h"
+#include "point.h"
+
+
+/**
+ * linear octree over a cubic root box.
+ * only the leaves are stored, in contiguous arrays sorted by their Morton key,
+ * i.e. the interleaved integer coordinate of the leaf's lower corner at the
+ * finest level, together with the level of the leaf. since the leaves tile the
+ * root box, the leaf has point p is the last leaf whose key is not larger than
+ * the key of p, which is a binary search.
+ *
+ * the tree is built top down from a set of item points (e.g. element centroids)
+ * and a refine criterion. the items are kept sorted by key while building, so
+ * the items inside any cell is a contiguous range. they can be released once
+ * the caller has computed what it needs from them.
+ *
+ * the leaf index is stable between modifications, so the caller keeps per-leaf
+ * data in its own arrays indexed by leaf.
+ */
+class LinearOcTree
+{
+public:
+
+  typedef unsigned long long key_type;
+
+  /**
+   * max level of the tree, 3*max_level bits are used by the key
+   */
+  static const unsigned int max_level = 21;
+
+  /**
+   * refine criterion used by build()
+   */
+  class Refinement
+  {
+  public:
+    virtual ~Refinement() {}
+
+    /**
+     * @return true when the cell at \p level, which contains items [begin, end)
+     * should be subdivided. the items are given by their index in the item array
+     */
+    virtual bool refine(const LinearOcTree & tree, unsigned int level,
+                        const unsigned int * begin, const unsigned int * end) const = 0;
+  };
+
+  /**
+   * empty tree
+   */
+  LinearOcTree();
+
+  /**
+   * the tree with a single leaf: the cube with lower corner \p low and edge \p size
+   */
+  LinearOcTree(const Point & low, Real size);
+
+  /**
+   * reset the tree to a single leaf
+   */
+  void reinit(const Point & low, Real size);
+
+  /**
+   * build the tree: the root is subdivided to at least \p min_level,
+   * then each cell is subdivided as long as \p criterion requires
+   */
+  void build(const std::vector<Point> & items, const Refinement & criterion, unsigned int min_level=0);
+
+  /**
+   * subdivide leaves until the level of face neighbors differ at most by one
+   */
+  void balance();
+
+  /**
+   * @return the number of leaves
+   */
+  unsigned int n_leaves() const
+  { return static_cast<unsigned int>(_keys.size()); }
+
+  /**
+   * @return true if the tree has no leaf
+   */
+  bool empty() const
+  { return _keys.empty(); }
+
+  /**
+   * @return the lower corner of root box
+   */
+  const Point & low() const
+  { return _low; }
+
+  /**
+   * @return the edge length of root box
+   */
+  Real size() const
+  { return _size; }
+
+  /**
+   * @return Morton key of the leaf
+   */
+  key_type key(unsigned int leaf) const
+  { return _keys[leaf]; }
+
+  /**
+   * @return level of the leaf
+   */
+  unsigned int level(unsigned int leaf) const
+  { return _levels[leaf]; }
+
+  /**
+   * @return edge length of the cell at \p level
+   */
+  Real cell_size(unsigned int level) const;
+
+  /**
+   * @return volume of the cell at \p level
+   */
+  Real cell_volume(unsigned int level) const
+  { const Real h = cell_size(level); return h*h*h; }
+
+  /**
+   * @return volume of the leaf
+   */
+  Real volume(unsigned int leaf) const
+  { return cell_volume(_levels[leaf]); }
+
+  /**
+   * @return the lower and upper corner of the leaf
+   */
+  std::pair<Point, Point> leaf_box(unsigned int leaf) const;
+
+  /**
+   * @return the leaf has point \p p, invalid_uint when p is outside the root box
+   */
+  unsigned int find_leaf(const Point & p) const;
+
+  /**
+   * find the leaves cut by segment (p1, p2), the result is the leaf index
+   * and the length of the segment inside it, in the order from p1 to p2
+   */
+  void intersect(const Point & p1, const Point & p2, std::vector<std::pair<unsigned int, Real> > & result) const;
+
+  /**
+   * items of the leaf, as a range of item_order(). only valid before release_items()
+   */
+  std::pair<unsigned int, unsigned int> leaf_items(unsigned int leaf) const
+  { return cell_items(_keys[leaf], _levels[leaf]); }
+
+  /**
+   * items of any cell given by \p key and \p level
+   */
+  std::pair<unsigned int, unsigned int> cell_items(key_type key, unsigned int level) const;
+
+  /**
+   * @return the key of the ancestor of the cell at \p level
+   */
+  static key_type ancestor_key(key_type key, unsigned int level)
+  { return key & ~(_span(level) - 1); }
+
+  /**
+   * the item index sorted by key
+   */
+  const std::vector<unsigned int> & item_order() const
+  { return _item_order; }
+
+  /**
+   * drop the item information
+   */
+  void release_items();
+
+  /**
+   * write the tree to binary stream
+   */
+  void write(std::ostream & out) const;
+
+  /**
+   * read the tree from binary stream
+   * @return false if the stream does not contain a valid tree
+   */
+  bool read(std::istream & in);
+
+  /**
+   * write the leaves as VTK voxels with one value per leaf, debug only
+   */
+  void export_vtk(const std::string & file, const std::vector<Real> & value) const;
+
+private:
+
+  /**
+   * lower corner of root box
+   */
+  Point _low;
+
+  /**
+   * edge length of root box
+   */
+  Real _size;
+
+  /**
+   * sorted leaf keys
+   */
+  std::vector<key_type> _keys;
+
+  /**
+   * leaf levels
+   */
+  std::vector<unsigned char> _levels;
+
+  /**
+   * item keys at max_level, sorted
+   */
+  std::vector<key_type> _item_keys;
+
+  /**
+   * item index in the order of _item_keys
+   */
+  std::vector<unsigned int> _item_order;
+
+  /**
+   * key span of a cell at level, 8^(max_level-level): the number of
+   * finest cells inside it. the keys of the cell are [key, key+_span(level))
+   */
+  static key_type _span(unsigned int level)
+  { return static_cast<key_type>(1) << (3*(max_level-level)); }
+
+  /**
+   * integer coordinate of point p at max_level, false if p is outside root box
+   */
+  bool _coordinate(const Point & p, unsigned int c[3]) const;
+
+  /**
+   * @return the leaf has the finest cell with key \p k
+   */
+  unsigned int _find_leaf(key_type k) const;
+
+  /**
+   * replace the leaves by the subdivision given by flag
+   */
+  void _subdivide(const std::vector<bool> & flag);
+};
+
+
+#endif
@@ -0,0 +1,94 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __mapped_file_h__
+#define __mapped_file_h__
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+ * read only map of a whole file. the file is mapped by mmap where it is
+ * available, otherwise it is read into memory. the data is aligned to
+ * at least 8 bytes in both cases
+ */
+class MappedFile
+{
+public:
+
+  MappedFile();
+
+  ~MappedFile();
+
+  /**
+   * map the file, false if it can not be opened
+   */
+  bool open(const std::string &file);
+
+  /**
+   * unmap the file
+   */
+  void close();
+
+  /**
+   * @return true when a file is mapped
+   */
+  bool is_open() const { return _data != 0; }
+
+  /**
+   * @return the file content
+   */
+  const char * data() const { return _data; }
+
+  /**
+   * @return size of the file in bytes
+   */
+  std::size_t size() const { return _size; }
+
+  /**
+   * write a file through a temporary file which is renamed to file at last,
+   * so readers never see a partly written file. false on error
+   */
+  static bool write(const std::string &file, const void *data, std::size_t size);
+
+private:
+
+  const char * _data;
+
+  std::size_t _size;
+
+  /**
+   * true when _data is mapped by mmap
+   */
+  bool _mapped;
+
+  /**
+   * file content when mmap is not available
+   */
+  std::vector<double> _buffer;
+
+  // not copyable
+  MappedFile(const MappedFile &);
+  MappedFile & operator= (const MappedFile &);
+};
+
+#endif
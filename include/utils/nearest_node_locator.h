@@ -71,6 +71,13 @@ public:
    */
   void nearest_nodes(const Point &p1, const Point &p2, Real radius, unsigned int subdomain, std::set<const Node * >& nns) const;
 
+  /**
+   * batch version of segment query. the nodes in specified region within radius[k] of segment p1[k]-p2[k]
+   * are nodes[offset[k]] ... nodes[offset[k+1]-1], sorted by node id.
+   */
+  void nearest_nodes(const std::vector<Point> &p1, const std::vector<Point> &p2, const std::vector<Real> &radius,
+                     unsigned int subdomain, std::vector<unsigned int> &offset, std::vector<const Node *> &nodes) const;
+
 private:
 
   const MeshBase& _mesh;
@@ -81,6 +88,36 @@ private:
    * kdtree for each subdomain
    */
   std::vector<kdtree_type *> _kdtrees;
+
+  /**
+   * uniform grid of the nodes in a subdomain for segment queries.
+   * node coordinates are stored in flat arrays ordered by cell,
+   * nodes in cell c are [cell_offset[c], cell_offset[c+1])
+   */
+  struct NodeGrid
+  {
+    Real min[3];
+    Real h[3];
+    unsigned int n[3];
+    std::vector<unsigned int> cell_offset;
+    std::vector<Real> x, y, z;
+    std::vector<const Node *> nodes;
+  };
+
+  /**
+   * node grid for each subdomain
+   */
+  std::vector<NodeGrid> _grids;
+
+  /**
+   * build the grid of nodes
+   */
+  void _build_grid(const std::set<const Node *> & node_set, NodeGrid & grid);
+
+  /**
+   * the index (in grid) of nodes within radius of segment p1-p2
+   */
+  void _segment_nodes(const NodeGrid & grid, const Point &p1, const Point &p2, Real radius, std::vector<unsigned int> & hits) const;
 };
 
 
@@ -23,15 +23,18 @@
 #ifndef __object_tree_h__
 #define __object_tree_h__
 
+#include <vector>
+
 #include "tree_base.h"
 
 // Forward Declarations
 class MeshBase;
 class Elem;
+class ElemBVH;
 
 
 /**
- * an octree/quad tree for fast ray-elem intersection test
+ * bounding volume hierarchy for fast ray-elem intersection test
  */
 class ObjectTree
 {
@@ -41,17 +44,21 @@ public:
 
   ~ObjectTree();
 
-  bool is_octree() const
-  { return _tree->n_leaf() == 8; }
+  bool is_octree() const;
 
-  bool is_quadtree() const
-  { return _tree->n_leaf() == 4; }
+  bool is_quadtree() const;
 
   /**
    * @return the first elem the ray(p,d) hit
    */
   const Elem * hit(const Point & p, const Point & d) const;
 
+  /**
+   * the first elem each ray(p[i],d[i]) hit, NULL if missed.
+   * rays are traced in the order of spatial coherence
+   */
+  void hit(const std::vector<Point> & p, const std::vector<Point> & d, std::vector<const Elem *> & elems) const;
+
   /**
    * @return true if the ray(p,d) hit the bounding box of the mesh
    */
@@ -65,11 +72,9 @@ public:
 private:
 
   /**
-   * Pointer to our tree.  The tree is built at run-time
-   * through \p init().  For servant PointLocators (not master),
-   * this simply points to the tree of the master.
+   * Pointer to our BVH, build in constructor
    */
-  TreeBase* _tree;
+  ElemBVH* _bvh;
 };
 
 #endif
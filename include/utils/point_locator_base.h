@@ -101,6 +101,13 @@ public:
    */
   virtual const Elem* operator() (const Point& p) const = 0;
 
+  /**
+   * Locates the elements for a batch of points, elems[i] is the element
+   * contains points[i].  The default implementation calls operator() for
+   * each point, derived class may do better.
+   */
+  virtual void operator() (const std::vector<Point> & points, std::vector<const Elem *> & elems) const;
+
   /**
    * @returns \p true when this object is properly initialized
    * and ready for use, \p false otherwise.
@@ -0,0 +1,134 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __point_locator_bvh_h__
+#define __point_locator_bvh_h__
+
+// C++ includes
+#include <vector>
+
+// Local Includes
+#include "point_locator_base.h"
+#include "tree_base.h"
+
+
+// Forward Declarations
+class MeshBase;
+class Point;
+class Elem;
+class ElemBVH;
+
+
+/**
+ * Point locator based on bounding volume hierarchy of mesh elements.
+ * The BVH is a flat array of nodes, traversed without recursion, and
+ * batched queries are sorted along Morton curve so that consecutive
+ * points hit the same branch of the tree.
+ * Use \p PointLocatorBase::build() to create objects of this
+ * type at run time.
+ */
+class PointLocatorBVH : public PointLocatorBase
+{
+public:
+
+  /**
+   * Constructor.  Needs the \p mesh in which the points
+   * should be located.  Optionally takes a master locator,
+   * only the master holds the BVH, the others use the master's BVH.
+   */
+  PointLocatorBVH (const MeshBase& mesh,
+                   const PointLocatorBase* master = NULL);
+
+  /**
+   * Constructor, with the element set given by \p build_type
+   */
+  PointLocatorBVH (const MeshBase& mesh,
+                   const Trees::BuildType build_type,
+                   const PointLocatorBase* master = NULL);
+
+  /**
+   * Destructor.
+   */
+  ~PointLocatorBVH ();
+
+  /**
+   * Clears the locator.
+   */
+  virtual void clear();
+
+  /**
+   * Initializes the locator with given element set
+   */
+  void init(const Trees::BuildType build_type);
+
+  /**
+   * Initializes the locator
+   */
+  virtual void init() { this->init(Trees::NODES); };
+
+  /**
+   * Locates the element in which the point with global coordinates
+   * \p p is located. The element found last time is tested first.
+   */
+  virtual const Elem* operator() (const Point& p) const;
+
+  /**
+   * Locates the elements for a batch of points.
+   */
+  virtual void operator() (const std::vector<Point> & points, std::vector<const Elem *> & elems) const;
+
+  /**
+   * Enables out-of-mesh mode.
+   */
+  virtual void enable_out_of_mesh_mode (void);
+
+  /**
+   * Disables out-of-mesh mode.
+   */
+  virtual void disable_out_of_mesh_mode (void);
+
+protected:
+
+  /**
+   * search all the elements for point p, the fallback when BVH failed
+   * and out-of-mesh mode is disabled
+   */
+  const Elem* _linear_search (const Point& p) const;
+
+  /**
+   * Pointer to our BVH. For servant PointLocators (not master),
+   * this simply points to the BVH of the master.
+   */
+  ElemBVH* _bvh;
+
+  /**
+   * Pointer to the last element that was found
+   */
+  mutable const Elem* _element;
+
+  /**
+   * \p true if out-of-mesh mode is enabled.
+   */
+  bool _out_of_mesh_mode;
+};
+
+
+#endif
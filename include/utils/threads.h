@@ -0,0 +1,79 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+#ifndef __threads_h__
+#define __threads_h__
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include <vector>
+
+
+/**
+ * thin wrapper of the shared memory parallel (OpenMP) runtime.
+ * when genius is built without OpenMP, everything falls back to one thread.
+ * loops which use these should give the same result for any number of threads,
+ * i.e. each thread writes its own slot and the slots are merged in a fixed order.
+ */
+namespace Threads
+{
+
+  /**
+   * @return the number of threads a parallel loop may use
+   */
+  inline unsigned int n_threads()
+  {
+#ifdef _OPENMP
+    return static_cast<unsigned int>(omp_get_max_threads());
+#else
+    return 1;
+#endif
+  }
+
+  /**
+   * @return the id of calling thread, 0 outside a parallel region
+   */
+  inline unsigned int thread_id()
+  {
+#ifdef _OPENMP
+    return static_cast<unsigned int>(omp_get_thread_num());
+#else
+    return 0;
+#endif
+  }
+
+  /**
+   * split [0, n) into n_blocks contiguous blocks,
+   * block b is [offset[b], offset[b+1])
+   */
+  inline void block_partition(unsigned int n, unsigned int n_blocks, std::vector<unsigned int> &offset)
+  {
+    if(n_blocks == 0) n_blocks = 1;
+    offset.resize(n_blocks+1);
+    for(unsigned int b=0; b<=n_blocks; ++b)
+      offset[b] = static_cast<unsigned int>( (static_cast<unsigned long long>(n)*b)/n_blocks );
+  }
+}
+
+
+#endif
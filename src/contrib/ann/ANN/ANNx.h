@@ -55,6 +55,9 @@ enum ANNerr {ANNwarn = 0, ANNabort = 1};
 
 extern int		ANNmaxPtsVisited;	// maximum number of pts visited
 extern int		ANNptsVisited;		// number of pts visited in search
+#ifdef _OPENMP
+#pragma omp threadprivate(ANNptsVisited)	// one counter for each thread
+#endif
 
 //----------------------------------------------------------------------
 //	Global function declarations
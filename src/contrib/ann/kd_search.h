@@ -45,4 +45,10 @@ extern ANNpointArray	ANNkdPts;		// the points (static copy)
 extern ANNmin_k			*ANNkdPointMK;	// set of k closest points
 extern int				ANNptsVisited;	// number of points visited
 
+//	each thread keeps its own copy, so that threads may search the
+//	same tree at the same time
+#ifdef _OPENMP
+#pragma omp threadprivate(ANNkdDim, ANNkdQ, ANNkdMaxErr, ANNkdPts, ANNkdPointMK)
+#endif
+
 #endif
@@ -1461,6 +1461,89 @@ namespace CSA
       csa_approximatepoint(a, &points[ii]);
   }
 
+  /* Number of doubles in the flat form of a calculated spline:
+   * xmin, xmax, ymin, ymax, h, ni, nj, then hascoeffs[4] and coeffs[25]
+   * of each square in [j][i] order.
+   */
+  int csa_buffersize(csa* a)
+  {
+    return 7 + a->ni * a->nj * 29;
+  }
+
+  /* Writes the flat form of a calculated spline.
+   * @param buffer Array of csa_buffersize(a) doubles
+   */
+  void csa_savebuffer(csa* a, double* buffer)
+  {
+    int i, j, ii;
+
+    assert(a->squares != NULL);
+
+    *buffer++ = a->xmin;
+    *buffer++ = a->xmax;
+    *buffer++ = a->ymin;
+    *buffer++ = a->ymax;
+    *buffer++ = a->h;
+    *buffer++ = a->ni;
+    *buffer++ = a->nj;
+
+    for (j = 0; j < a->nj; ++j)
+      for (i = 0; i < a->ni; ++i)
+      {
+        square* s = a->squares[j][i];
+
+        for (ii = 0; ii < 4; ++ii)
+          *buffer++ = s->hascoeffs[ii];
+        for (ii = 0; ii < 25; ++ii)
+          *buffer++ = s->coeffs[ii];
+      }
+  }
+
+  /* Creates a spline from its flat form, it can only be used by
+   * csa_approximatepoint().
+   * @param buffer Flat form written by csa_savebuffer()
+   * @param n Number of doubles in buffer
+   * @return Spline, or NULL when the buffer size does not match
+   */
+  csa* csa_loadbuffer(const double* buffer, int n)
+  {
+    csa* a;
+    int ni, nj, i, j, ii;
+
+    if (n < 7)
+      return NULL;
+    ni = (int) buffer[5];
+    nj = (int) buffer[6];
+    if (ni <= 0 || nj <= 0 || n != 7 + ni * nj * 29)
+      return NULL;
+
+    a = csa_create();
+    a->xmin = *buffer++;
+    a->xmax = *buffer++;
+    a->ymin = *buffer++;
+    a->ymax = *buffer++;
+    a->h = *buffer++;
+    a->ni = ni;
+    a->nj = nj;
+    buffer += 2;
+
+    /* the same squares as csa_squarize() creates */
+    a->squares = (square ***)alloc2d(a->ni, a->nj, sizeof(void*));
+    for (j = 0; j < a->nj; ++j)
+      for (i = 0; i < a->ni; ++i)
+      {
+        square* s = square_create(a, a->xmin + a->h * (i - 1), a->ymin + a->h * (j - 1), i, j);
+
+        for (ii = 0; ii < 4; ++ii)
+          s->hascoeffs[ii] = (int) *buffer++;
+        for (ii = 0; ii < 25; ++ii)
+          s->coeffs[ii] = *buffer++;
+        a->squares[j][i] = s;
+      }
+
+    return a;
+  }
+
   void csa_setnpmin(csa* a, int npmin)
   {
     a->npmin = npmin;
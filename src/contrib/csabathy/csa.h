@@ -124,6 +124,13 @@ namespace CSA
   void csa_approximatepoint(csa* a, point* p);
   void csa_approximatepoints(csa* a, int n, point* points);
 
+  /* flat form of a calculated spline, keeps only the data read by
+   * csa_approximatepoint(): the grid and the coefficients of each square
+   */
+  int csa_buffersize(csa* a);
+  void csa_savebuffer(csa* a, double* buffer);
+  csa* csa_loadbuffer(const double* buffer, int n);
+
   void csa_setnpmin(csa* a, int npmin);
   void csa_setnpmax(csa* a, int npmax);
   void csa_setk(csa* a, int k);
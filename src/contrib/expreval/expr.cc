@@ -45,6 +45,12 @@ ValueList *Expression::GetValueList() const
     return m_vlist;
     }
 
+// Get root node
+const Node *Expression::GetNode() const
+    {
+    return m_expr;
+    }
+
 // Set function list
 void Expression::SetFunctionList(FunctionList *flist)
     {
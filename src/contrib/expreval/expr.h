@@ -52,6 +52,9 @@ namespace ExprEval
             
             // Evaluate expression
             double Evaluate();
+
+            // Root node of the parsed expression, 0 before parse
+            const Node *GetNode() const;
             
         protected:
             ValueList *m_vlist;
@@ -43,6 +43,12 @@ double Node::Evaluate()
     return DoEvaluate();
     }
 
+// Describe
+bool Node::Describe(NodeInfo &) const
+    {
+    return false;
+    }
+
 // Function node
 //------------------------------------------------------------------------------
 
@@ -70,6 +76,20 @@ string FunctionNode::GetName() const
     return m_factory->GetName();
     }
 
+// Describe
+bool FunctionNode::Describe(NodeInfo &info) const
+    {
+    // Functions writing references or reading data are not pure
+    if(!m_refs.empty() || !m_data.empty())
+        return false;
+
+    info.type = NodeInfo::FUNCTION;
+    info.name = GetName();
+    info.args = m_nodes;
+
+    return true;
+    }
+
 // Set argument count
 void FunctionNode::SetArgumentCount(long argMin, long argMax, long refMin, long refMax,
         long dataMin, long dataMax)
@@ -563,6 +583,16 @@ double AddNode::DoEvaluate()
     return m_lhs->Evaluate() + m_rhs->Evaluate();
     }
 
+// Describe
+bool AddNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::ADD;
+    info.args.push_back(m_lhs);
+    info.args.push_back(m_rhs);
+
+    return true;
+    }
+
 // Parse
 void AddNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -607,6 +637,16 @@ double SubtractNode::DoEvaluate()
     return m_lhs->Evaluate() - m_rhs->Evaluate();
     }
 
+// Describe
+bool SubtractNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::SUBTRACT;
+    info.args.push_back(m_lhs);
+    info.args.push_back(m_rhs);
+
+    return true;
+    }
+
 // Parse
 void SubtractNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -651,6 +691,16 @@ double MultiplyNode::DoEvaluate()
     return m_lhs->Evaluate() * m_rhs->Evaluate();
     }
 
+// Describe
+bool MultiplyNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::MULTIPLY;
+    info.args.push_back(m_lhs);
+    info.args.push_back(m_rhs);
+
+    return true;
+    }
+
 // Parse
 void MultiplyNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -704,6 +754,16 @@ double DivideNode::DoEvaluate()
         }
     }
 
+// Describe
+bool DivideNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::DIVIDE;
+    info.args.push_back(m_lhs);
+    info.args.push_back(m_rhs);
+
+    return true;
+    }
+
 // Parse
 void DivideNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -747,6 +807,15 @@ double NegateNode::DoEvaluate()
     return -(m_rhs->Evaluate());
     }
 
+// Describe
+bool NegateNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::NEGATE;
+    info.args.push_back(m_rhs);
+
+    return true;
+    }
+
 // Parse
 void NegateNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -796,6 +865,16 @@ double ExponentNode::DoEvaluate()
     return result;
     }
 
+// Describe
+bool ExponentNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::EXPONENT;
+    info.args.push_back(m_lhs);
+    info.args.push_back(m_rhs);
+
+    return true;
+    }
+
 // Parse
 void ExponentNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -837,6 +916,15 @@ double VariableNode::DoEvaluate()
     return *m_var;
     }
 
+// Describe
+bool VariableNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::VARIABLE;
+    info.var = m_var;
+
+    return true;
+    }
+
 // Parse
 void VariableNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -907,6 +995,15 @@ double ValueNode::DoEvaluate()
     return m_val;
     }
 
+// Describe
+bool ValueNode::Describe(NodeInfo &info) const
+    {
+    info.type = NodeInfo::VALUE;
+    info.value = m_val;
+
+    return true;
+    }
+
 // Parse
 void ValueNode::Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
         Parser::size_type v1)
@@ -9,6 +9,7 @@
 
 // Includes
 #include <vector>
+#include <string>
 
 #include "expr_parser.h"
 
@@ -19,6 +20,37 @@ namespace ExprEval
     class Expression;
     class FunctionFactory;
     class DataEntry;
+    class Node;
+
+    // Node description, lets an expression compiler walk the parsed tree
+    //--------------------------------------------------------------------------
+    class NodeInfo
+        {
+        public:
+            enum Type
+                {
+                NONE,
+                VALUE,      // value holds the constant
+                VARIABLE,   // var holds the address in the value list
+                ADD,
+                SUBTRACT,
+                MULTIPLY,
+                DIVIDE,
+                NEGATE,
+                EXPONENT,
+                FUNCTION    // name holds the function name
+                };
+
+            NodeInfo() : type(NONE), value(0.0), var(0) {}
+
+            Type type;
+            double value;
+            double *var;
+            ::std::string name;
+
+            // Operands in evaluation order
+            ::std::vector<Node*> args;
+        };
 
     // Node class
     //--------------------------------------------------------------------------
@@ -34,6 +66,10 @@ namespace ExprEval
 
             double Evaluate(); // Calls Expression::TestAbort, then DoEvaluate
 
+            // Describe the node, false for nodes which can not be described
+            // (assignment, multiple expressions, functions with references or data)
+            virtual bool Describe(NodeInfo &info) const;
+
         protected:
             Expression *m_expr;
         };
@@ -50,6 +86,7 @@ namespace ExprEval
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
 
+            bool Describe(NodeInfo &info) const;
 
         private:
             // Function factory
@@ -123,6 +160,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             Node *m_lhs;
@@ -140,6 +178,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             Node *m_lhs;
@@ -157,6 +196,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             Node *m_lhs;
@@ -174,6 +214,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             Node *m_lhs;
@@ -191,6 +232,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             Node *m_rhs;
@@ -207,6 +249,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             Node *m_lhs;
@@ -224,6 +267,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             double *m_var;
@@ -240,6 +284,7 @@ namespace ExprEval
             double DoEvaluate();
             void Parse(Parser &parser, Parser::size_type start, Parser::size_type end,
                     Parser::size_type v1 = 0);
+            bool Describe(NodeInfo &info) const;
 
         private:
             double m_val;
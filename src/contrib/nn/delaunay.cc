@@ -142,19 +142,13 @@ namespace NN
     return d;
   }
 
-  static void tio2delaunay(struct triangulateio* tio_out, delaunay* d)
+  /* Completes a triangulation whose points, triangles and neighbours are set:
+   * bounding box, circumcircles and point to triangle map.
+   */
+  static void delaunay_complete(delaunay* d)
   {
     int i, j;
 
-    /*
-     * I assume that all input points appear in tio_out in the same order as
-     * they were written to tio_in. I have seen no exceptions so far, even
-     * if duplicate points were presented. Just in case, let us make a couple
-     * of checks.
-     */
-    assert(tio_out->numberofpoints == d->npoints);
-    assert(tio_out->pointlist[2 * d->npoints - 2] == d->points[d->npoints - 1].x && tio_out->pointlist[2 * d->npoints - 1] == d->points[d->npoints - 1].y);
-
     for (i = 0, j = 0; i < d->npoints; ++i)
     {
       point* p = &d->points[i];
@@ -169,11 +163,8 @@ namespace NN
         d->ymax = p->y;
     }
 
-    d->ntriangles = tio_out->numberoftriangles;
     if (d->ntriangles > 0)
     {
-      d->triangles = (triangle*)malloc(d->ntriangles * sizeof(triangle));
-      d->neighbours = (triangle_neighbours*)malloc(d->ntriangles * sizeof(triangle_neighbours));
       d->circles = (circle*)malloc(d->ntriangles * sizeof(circle));
       d->n_point_triangles = (int *)calloc(d->npoints, sizeof(int));
       d->point_triangles = (int **)malloc(d->npoints * sizeof(int*));
@@ -182,20 +173,10 @@ namespace NN
 
     for (i = 0; i < d->ntriangles; ++i)
     {
-      int offset = i * 3;
       triangle* t = &d->triangles[i];
-      triangle_neighbours* n = &d->neighbours[i];
       circle* c = &d->circles[i];
       int status;
 
-      t->vids[0] = tio_out->trianglelist[offset];
-      t->vids[1] = tio_out->trianglelist[offset + 1];
-      t->vids[2] = tio_out->trianglelist[offset + 2];
-
-      n->tids[0] = tio_out->neighborlist[offset];
-      n->tids[1] = tio_out->neighborlist[offset + 1];
-      n->tids[2] = tio_out->neighborlist[offset + 2];
-
       status = circle_build1(c, &d->points[t->vids[0]], &d->points[t->vids[1]], &d->points[t->vids[2]]);
       assert(status);
 
@@ -231,6 +212,44 @@ namespace NN
         d->n_point_triangles[vid]++;
       }
     }
+  }
+
+  static void tio2delaunay(struct triangulateio* tio_out, delaunay* d)
+  {
+    int i;
+
+    /*
+     * I assume that all input points appear in tio_out in the same order as
+     * they were written to tio_in. I have seen no exceptions so far, even
+     * if duplicate points were presented. Just in case, let us make a couple
+     * of checks.
+     */
+    assert(tio_out->numberofpoints == d->npoints);
+    assert(tio_out->pointlist[2 * d->npoints - 2] == d->points[d->npoints - 1].x && tio_out->pointlist[2 * d->npoints - 1] == d->points[d->npoints - 1].y);
+
+    d->ntriangles = tio_out->numberoftriangles;
+    if (d->ntriangles > 0)
+    {
+      d->triangles = (triangle*)malloc(d->ntriangles * sizeof(triangle));
+      d->neighbours = (triangle_neighbours*)malloc(d->ntriangles * sizeof(triangle_neighbours));
+    }
+
+    for (i = 0; i < d->ntriangles; ++i)
+    {
+      int offset = i * 3;
+      triangle* t = &d->triangles[i];
+      triangle_neighbours* n = &d->neighbours[i];
+
+      t->vids[0] = tio_out->trianglelist[offset];
+      t->vids[1] = tio_out->trianglelist[offset + 1];
+      t->vids[2] = tio_out->trianglelist[offset + 2];
+
+      n->tids[0] = tio_out->neighborlist[offset];
+      n->tids[1] = tio_out->neighborlist[offset + 1];
+      n->tids[2] = tio_out->neighborlist[offset + 2];
+    }
+
+    delaunay_complete(d);
 
     if (tio_out->edgelist != NULL)
     {
@@ -313,6 +332,51 @@ namespace NN
     return d;
   }
 
+  /* Builds Delaunay triangulation from triangles and neighbours of a
+   * triangulation built before by delaunay_build() on the same points.
+   *
+   * @param np Number of points
+   * @param points Array of points [np] (input)
+   * @param nt Number of triangles
+   * @param vids Point indices of triangles [3*nt]
+   * @param tids Neighbour triangle indices of triangles [3*nt]
+   * @param ne Number of edges
+   * @param edges Point indices of edges [2*ne]
+   * @return Delaunay triangulation structure
+   */
+  delaunay* delaunay_build_from(int np, point points[], int nt, const int vids[], const int tids[], int ne, const int edges[])
+  {
+    delaunay* d;
+
+    if (np == 0)
+      return NULL;
+
+    d = delaunay_create();
+    d->npoints = np;
+    d->points = (point *)malloc(np * sizeof(point));
+    memcpy(d->points, points, np * sizeof(point));
+
+    d->ntriangles = nt;
+    if (nt > 0)
+    {
+      d->triangles = (triangle*)malloc(nt * sizeof(triangle));
+      d->neighbours = (triangle_neighbours*)malloc(nt * sizeof(triangle_neighbours));
+      memcpy(d->triangles, vids, nt * 3 * sizeof(int));
+      memcpy(d->neighbours, tids, nt * 3 * sizeof(int));
+    }
+
+    delaunay_complete(d);
+
+    if (ne > 0)
+    {
+      d->nedges = ne;
+      d->edges = (int *)malloc(ne * 2 * sizeof(int));
+      memcpy(d->edges, edges, ne * 2 * sizeof(int));
+    }
+
+    return d;
+  }
+
   /* Destroys Delaunay triangulation.
    *
    * @param d Structure to be destroyed
@@ -115,13 +115,26 @@ namespace NN
    */
   void lpi_interpolate_point(lpi* l, point* p)
   {
-    delaunay* d = l->d;
-    int tid = delaunay_xytoi(d, p, d->first_id);
+    lpi_interpolate_point_seed(l, p, &l->d->first_id);
+  }
+
+  /* Finds linearly interpolated value in a point, the search starts from
+   * the triangle in *seed and the triangle found is written back to it.
+   * The interpolator is not changed, threads with their own seed may
+   * query it at the same time.
+   *
+   * @param l Linear interpolation
+   * @param p Point to be interpolated (p->x, p->y -- input; p->z -- output)
+   * @param seed Triangle index to start with (-1 for none)
+   */
+  void lpi_interpolate_point_seed(lpi* l, point* p, int* seed)
+  {
+    int tid = delaunay_xytoi(l->d, p, *seed);
     if (tid >= 0)
     {
       lweights* lw = &l->weights[tid];
 
-      d->first_id = tid;
+      *seed = tid;
       p->z = p->x * lw->w[0] + p->y * lw->w[1] + lw->w[2];
     }
     else
@@ -57,6 +57,20 @@ namespace NN
    */
   delaunay* delaunay_build(int np, point points[], int ns, int segments[], int nh, double holes[]);
 
+  /** Builds Delaunay triangulation from triangles and neighbours of a
+   ** triangulation built before by delaunay_build() on the same points.
+   *
+   * @param np Number of points
+   * @param points Array of points [np] (input)
+   * @param nt Number of triangles
+   * @param vids Point indices of triangles [3*nt]
+   * @param tids Neighbour triangle indices of triangles [3*nt]
+   * @param ne Number of edges
+   * @param edges Point indices of edges [2*ne]
+   * @return Delaunay triangulation structure
+   */
+  delaunay* delaunay_build_from(int np, point points[], int nt, const int vids[], const int tids[], int ne, const int edges[]);
+
   /** Destroys Delaunay triangulation.
    *
    * @param d Structure to be destroyed
@@ -94,6 +108,16 @@ namespace NN
    */
   void lpi_interpolate_point(lpi* l, point* p);
 
+  /** Finds linearly interpolated value in a point without changing the
+   * interpolator, the search starts from (and updates) the triangle in *seed.
+   * Safe for concurrent calls with different seeds.
+   *
+   * @param l Linear point interpolator
+   * @param p Point to be interpolated (p->x, p->y -- input; p->z -- output)
+   * @param seed Triangle index to start with (-1 for none)
+   */
+  void lpi_interpolate_point_seed(lpi* l, point* p, int* seed);
+
   /** Linearly interpolates data in an array of points.
    *
    * @param nin Number of input points
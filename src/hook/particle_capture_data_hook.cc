@@ -71,6 +71,9 @@ ParticleCaptureDataHook::ParticleCaptureDataHook(SolverBase & solver, const std:
     if(parm_it->name() == "resolution" && parm_it->type() == Parser::REAL)
       _resolution = parm_it->get_real()*mm;
 
+    if(parm_it->name() == "octree.file" && parm_it->type() == Parser::STRING)
+      _octree_file = parm_it->get_string();
+
     if(parm_it->name() == "particle.run" && parm_it->type() == Parser::REAL)
       _particle_num_per_run = parm_it->get_real();
 
@@ -125,6 +128,7 @@ void ParticleCaptureDataHook::pre_solve()
 
   dose_rate = new DoseRate(_solver.get_system());
   dose_rate->set_min_distance(_resolution);
+  dose_rate->set_octree_file(_octree_file);
   dose_rate->refine();
 
 
@@ -239,13 +243,18 @@ bool ParticleCaptureDataHook::build_particles_block(std::istream * in, unsigned
   const SimulationSystem & system = _solver.get_system();
   const PointLocatorBase & point_locator = system.mesh().point_locator();
 
+  // locate all the particles in one batch
+  std::vector<Point> points;
+  for(unsigned int n=particle_begin; n<particle_end; n++)
+    points.push_back(Point(particle_points[4*n+0], particle_points[4*n+1], particle_points[4*n+2]));
+
+  std::vector<const Elem *> elems;
+  point_locator(points, elems);
+
   for(unsigned int n=particle_begin; n<particle_end; n++)
   {
-    double x = particle_points[4*n+0];
-    double y = particle_points[4*n+1];
-    double z = particle_points[4*n+2];
     double c = particle_points[4*n+3];
-    const Elem * elem = point_locator(Point(x, y, z));
+    const Elem * elem = elems[n-particle_begin];
     if(elem) elem_deposite[elem->id()] += e*c;
   }
 
@@ -398,6 +407,8 @@ bool ParticleCaptureDataHook::build_tracks_block(std::istream * in, unsigned int
   unsigned int track_begin = Genius::processor_id()*track_part;
   unsigned int track_end   = std::min((Genius::processor_id()+1)*track_part, n_track);
 
+  std::vector<Point> p1, p2;
+  std::vector<double> track_energy;
   for(unsigned int n=track_begin; n<track_end; n++)
   {
     double x1 = track_data[7*n+0];
@@ -408,8 +419,11 @@ bool ParticleCaptureDataHook::build_tracks_block(std::istream * in, unsigned int
     double z2 = track_data[7*n+5];
     double energy = track_data[7*n+6];
 
-    dose_rate->energy_deposite(Point(x1,y1,z1), Point(x2,y2,z2), _weight*energy);
+    p1.push_back(Point(x1,y1,z1));
+    p2.push_back(Point(x2,y2,z2));
+    track_energy.push_back(_weight*energy);
   }
+  dose_rate->energy_deposite(p1, p2, track_energy);
 
   return true;
 
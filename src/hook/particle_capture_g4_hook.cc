@@ -19,6 +19,8 @@
 /*                                                                              */
 /********************************************************************************/
 
+#include <algorithm>
+
 #include "solver_base.h"
 #include "mesh_base.h"
 #include "simulation_system.h"
@@ -69,6 +71,8 @@ ParticleCaptureG4Hook::ParticleCaptureG4Hook(SolverBase & solver, const std::str
       _const_flux = parm_it->get_bool();
     if(parm_it->name() == "doserate" && parm_it->type() == Parser::STRING)
       _dose_rate = parm_it->get_string();
+    if(parm_it->name() == "octree.file" && parm_it->type() == Parser::STRING)
+      _octree_file = parm_it->get_string();
   }
   
   //std::cout<<_resolution/mm << std::endl;
@@ -77,6 +81,7 @@ ParticleCaptureG4Hook::ParticleCaptureG4Hook(SolverBase & solver, const std::str
 
   dose_rate = new DoseRate(solver.get_system());
   dose_rate->set_min_distance(_resolution);
+  dose_rate->set_octree_file(_octree_file);
   dose_rate->refine();
 }
 
@@ -414,9 +419,11 @@ void ParticleCaptureG4Hook::process_particle_gen()
   }
 
   const PointLocatorBase & point_locator = system.mesh().point_locator();
+  std::vector<const Elem *> particle_elems;
+  point_locator(particles, particle_elems);
   for(unsigned int i=0; i<particles.size(); i++)
   {
-    const Elem * elem = point_locator(particles[i]);
+    const Elem * elem = particle_elems[i];
     if(!elem || !elem->on_processor()) continue;
 
     double c = ParticleWeight[i];
@@ -528,8 +535,29 @@ void ParticleCaptureG4Hook::process_particle_dose_nodal()
 
   AutoPtr<NearestNodeLocator> nn_locator( new NearestNodeLocator(system.mesh()) );
 
+  // the nodes near the tracks are searched in blocks of tracks,
+  // nodes of track t in region r are nn_nodes[r][ nn_offset[r][t%track_block] ... ]
+  const unsigned int track_block = 1024;
+  std::vector< std::vector<unsigned int> > nn_offset(system.n_regions());
+  std::vector< std::vector<const Node *> > nn_nodes(system.n_regions());
+
   for(unsigned int t=0; t<tracks.size(); ++t)
   {
+    if( t%track_block == 0 )
+    {
+      const unsigned int t_end = std::min(t+track_block, static_cast<unsigned int>(tracks.size()));
+      std::vector<Point> p1, p2;
+      std::vector<Real>  radius;
+      for(unsigned int k=t; k<t_end; ++k)
+      {
+        p1.push_back(tracks[k].start);
+        p2.push_back(tracks[k].end);
+        radius.push_back(5*tracks[k].lateral_char);
+      }
+      for(unsigned int r=0; r<system.n_regions(); r++)
+        nn_locator->nearest_nodes(p1, p2, radius, r, nn_offset[r], nn_nodes[r]);
+    }
+
     const track_t & track = tracks[t];
     genius_assert(track.energy > 0.0 && (track.end - track.start).size() > 0.0);
 
@@ -551,7 +579,8 @@ void ParticleCaptureG4Hook::process_particle_dose_nodal()
       if( (bsphere.first - cent).size() > bsphere.second + diag + 5*lateral_char ) continue;
 
 
-      std::vector<const Node *> nn = nn_locator->nearest_nodes(track.start, track.end, 5*lateral_char, r);
+      const unsigned int tb = t%track_block;
+      std::vector<const Node *> nn(nn_nodes[r].begin()+nn_offset[r][tb], nn_nodes[r].begin()+nn_offset[r][tb+1]);
       for(unsigned int n=0; n<nn.size(); ++n)
       {
         Point loc = *nn[n];
@@ -650,13 +679,19 @@ void ParticleCaptureG4Hook::process_particle_dose_octree()
   unsigned int bin_size = tracks.size()/Genius::n_processors();
   unsigned int begin = bin_size*Genius::processor_id();
   unsigned int end   = std::min(begin+bin_size, tracks.size());
+
+  std::vector<Point> p1, p2;
+  std::vector<double> energy;
   for(unsigned int t=begin; t<end; ++t)
   {
     const track_t & track = tracks[t];
     genius_assert(track.energy > 0.0 && (track.end - track.start).size() > 0.0);
 
-    dose_rate->energy_deposite(track.start, track.end, track.energy);
+    p1.push_back(track.start);
+    p2.push_back(track.end);
+    energy.push_back(track.energy);
   }
+  dose_rate->energy_deposite(p1, p2, energy);
 
 }
 
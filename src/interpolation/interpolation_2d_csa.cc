@@ -4,6 +4,7 @@
 #include "config.h"
 #include "asinh.hpp"
 #include "interpolation_2d_csa.h"
+#include "interpolation_cache.h"
 #include "parallel.h"
 
 Interpolation2D_CSA::Interpolation2D_CSA()
@@ -56,10 +57,33 @@ void Interpolation2D_CSA::add_scatter_data(const Point & point, int group, doubl
 
 void Interpolation2D_CSA::setup(int group)
 {
-  CSA::csa * field=CSA::csa_create();
+  std::vector<CSA::point> & points = csa_points[group];
+
+  // the spline only depends on the scattered data
+  InterpolationCache cache(_cache_directory, "csa");
+  cache.hash(points);
+
+  CSA::csa * field = 0;
+  std::size_t size = 0;
+  const void * buffer = cache.load(size);
+  if(buffer)
+    field = CSA::csa_loadbuffer(static_cast<const double *>(buffer), size/sizeof(double));
+
+  if(!field)
+  {
+    field=CSA::csa_create();
+    CSA::csa_addpoints(field, points.size(), &(points[0]));
+    CSA::csa_calculatespline(field);
+
+    if(cache.enabled())
+    {
+      std::vector<double> flat(CSA::csa_buffersize(field));
+      CSA::csa_savebuffer(field, &flat[0]);
+      cache.save(&flat[0], flat.size()*sizeof(double));
+    }
+  }
+
   field_map[group] = field;
-  CSA::csa_addpoints(field, csa_points[group].size(), &(csa_points[group][0]));
-  CSA::csa_calculatespline(field);
 #if defined(HAVE_FENV_H) && defined(DEBUG)
   feclearexcept(FE_INVALID);
 #endif
@@ -111,31 +135,41 @@ void Interpolation2D_CSA::broadcast(unsigned int root)
 
 double Interpolation2D_CSA::get_interpolated_value(const Point & point, int group) const
 {
-  CSA::csa * field = field_map.find(group)->second;
+  double value;
+  this->_interpolated_values(&point, 1, group, &value);
+  return value;
+}
 
-  CSA::point pout;
-  pout.x = point.x();
-  pout.y = point.y();
-  CSA::csa_approximatepoints(field, 1, &pout);
 
+void Interpolation2D_CSA::_interpolated_values(const Point * points, unsigned int n, int group, double * value) const
+{
+  // csa_approximatepoint only reads the spline, blocks can be evaluated at the same time
+  CSA::csa * field = field_map.find(group)->second;
   InterpolationType type = _interpolation_type.find(group)->second;
+  double vmin = field_limit.find(group)->second.first;
+  double vmax = field_limit.find(group)->second.second;
 
-  switch(type)
+  for(unsigned int i=0; i<n; ++i)
   {
-  case Linear    : break;
-  case SignedLog : pout.z = pout.z>0 ? exp(pout.z)-1 : 1-exp(-pout.z) ; break;
-  case Asinh     : pout.z = sinh(pout.z); break;
+    CSA::point pout;
+    pout.x = points[i].x();
+    pout.y = points[i].y();
+    CSA::csa_approximatepoint(field, &pout);
+
+    switch(type)
+    {
+    case Linear    : break;
+    case SignedLog : pout.z = pout.z>0 ? exp(pout.z)-1 : 1-exp(-pout.z) ; break;
+    case Asinh     : pout.z = sinh(pout.z); break;
+    }
+
+    if(pout.z<vmin) pout.z = vmin;
+    if(pout.z>vmax) pout.z = vmax;
+    value[i] = pout.z;
   }
 
-  double vmin = field_limit.find(group)->second.first;
-  double vmax = field_limit.find(group)->second.second;
-  if(pout.z<vmin) pout.z = vmin;
-  if(pout.z>vmax) pout.z = vmax;
-
 #if defined(HAVE_FENV_H) && defined(DEBUG)
   feclearexcept(FE_INVALID);
 #endif
-
-  return pout.z;
 }
 
@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
 #include "genius_common.h"
 #include "asinh.hpp"
 #include "interpolation_2d_nn.h"
+#include "interpolation_cache.h"
+#include "delaunay.h"
 #include "parallel.h"
+#include "threads.h"
 
 #include "log.h"
 
@@ -50,6 +54,25 @@ void Interpolation2D_NN::add_scatter_data(const Point & point, int group, double
 
 
 
+namespace {
+  /**
+   * check the triangulation loaded from the cache file before it is used:
+   * point indices of triangles and edges in [0,np), neighbour triangles in [-1,nt)
+   */
+  bool valid_cached_triangulation(int np, int nt, const int * vids, const int * tids, int ne, const int * edges)
+  {
+    for( int i=0; i<3*nt; ++i )
+    {
+      if( vids[i] < 0 || vids[i] >= np ) return false;
+      if( tids[i] < -1 || tids[i] >= nt ) return false;
+    }
+    for( int i=0; i<2*ne; ++i )
+      if( edges[i] < 0 || edges[i] >= np ) return false;
+    return true;
+  }
+}
+
+
 void Interpolation2D_NN::setup(int group)
 {
   DATA & data = field[group];
@@ -59,8 +82,49 @@ void Interpolation2D_NN::setup(int group)
     NN::point  p = { data.x[i], data.y[i], data.f[i] };
     points.push_back(p);
   }
-  data.d = NN::delaunay_build(data.n, &points[0], 0, 0, 0, 0 );
+
+  // the triangulation only depends on the location of the data,
+  // profiles of different wavelength on the same grid share it
+  InterpolationCache cache(_cache_directory, "nn");
+  cache.hash(data.x);
+  cache.hash(data.y);
+
+  // cache payload: number of triangles and edges, point indices and neighbours of triangles, edges
+  data.d = 0;
+  std::size_t size = 0;
+  const int * buffer = static_cast<const int *>(cache.load(size));
+  if( buffer && size >= 2*sizeof(int) )
+  {
+    int nt = buffer[0];
+    int ne = buffer[1];
+    // a damaged or foreign file is ignored, the triangulation is built again
+    if( nt >= 0 && ne >= 0 &&
+        size == (2 + 6*static_cast<std::size_t>(nt) + 2*static_cast<std::size_t>(ne))*sizeof(int) &&
+        valid_cached_triangulation(static_cast<int>(data.n), nt, buffer+2, buffer+2+3*nt, ne, buffer+2+6*nt) )
+      data.d = NN::delaunay_build_from(data.n, &points[0], nt, buffer+2, buffer+2+3*nt, ne, buffer+2+6*nt);
+  }
+
+  if( !data.d )
+  {
+    data.d = NN::delaunay_build(data.n, &points[0], 0, 0, 0, 0 );
+
+    if( cache.enabled() && data.d )
+    {
+      std::vector<int> flat;
+      flat.push_back(data.d->ntriangles);
+      flat.push_back(data.d->nedges);
+      for( int i=0; i<data.d->ntriangles; ++i )
+        flat.insert(flat.end(), data.d->triangles[i].vids, data.d->triangles[i].vids+3);
+      for( int i=0; i<data.d->ntriangles; ++i )
+        flat.insert(flat.end(), data.d->neighbours[i].tids, data.d->neighbours[i].tids+3);
+      flat.insert(flat.end(), data.d->edges, data.d->edges+2*data.d->nedges);
+      cache.save(&flat[0], flat.size()*sizeof(int));
+    }
+  }
+
   data.li = NN::lpi_build(data.d);
+  data.seed.assign(Threads::n_threads(), -1);
+  this->_build_locator(data);
 }
 
 
@@ -86,18 +150,84 @@ void Interpolation2D_NN::broadcast(unsigned int root)
 double Interpolation2D_NN::get_interpolated_value(const Point & point, int group) const
 {
   const DATA & data = field.find(group)->second;
-  NN::point  p = { point.x(), point.y(), 0 };
-  NN::lpi_interpolate_point(data.li, &p);
-  
+
+  // each thread starts the triangle walk from its own last result
+  unsigned int tid = Threads::thread_id();
+  int local_seed = -1;
+  int * seed = tid < data.seed.size() ? &data.seed[tid] : &local_seed;
+  if( *seed < 0 ) *seed = data.locator[this->_locator_cell(data, point.x(), point.y())];
+
+  double value;
+  this->_interpolate(data, group, &point, 1, seed, &value);
+  return value;
+}
+
+
+void Interpolation2D_NN::_interpolated_values(const Point * points, unsigned int n, int group, double * value) const
+{
+  const DATA & data = field.find(group)->second;
+  int seed = n ? data.locator[this->_locator_cell(data, points[0].x(), points[0].y())] : -1;
+  this->_interpolate(data, group, points, n, &seed, value);
+}
+
+
+void Interpolation2D_NN::_interpolate(const DATA & data, int group, const Point * points, unsigned int n, int * seed, double * value) const
+{
   InterpolationType type = _interpolation_type.find(group)->second;
 
-  switch(type)
+  for(unsigned int i=0; i<n; ++i)
   {
-  case Linear    : break;
-  case SignedLog : p.z = p.z>0 ? exp(p.z)-1 : 1-exp(-p.z) ; break;
-  case Asinh     : p.z = sinh(p.z); break;
+    NN::point  p = { points[i].x(), points[i].y(), 0 };
+    NN::lpi_interpolate_point_seed(data.li, &p, seed);
+
+    switch(type)
+    {
+    case Linear    : break;
+    case SignedLog : p.z = p.z>0 ? exp(p.z)-1 : 1-exp(-p.z) ; break;
+    case Asinh     : p.z = sinh(p.z); break;
+    }
+    value[i] = p.z;
+  }
+}
+
+
+
+void Interpolation2D_NN::_build_locator(DATA & data) const
+{
+  const NN::delaunay * d = data.d;
+
+  // about 16 triangles each cell, the walk from a cell to the point is short
+  unsigned int n_cell = std::max(1, d->ntriangles/16);
+  double w = d->xmax - d->xmin;
+  double h = d->ymax - d->ymin;
+  if( w > 0 && h > 0 )
+  {
+    data.locator_nx = std::max(1u, static_cast<unsigned int>(std::sqrt(n_cell*w/h)));
+    data.locator_ny = std::max(1u, n_cell/data.locator_nx);
+  }
+  else
+    data.locator_nx = data.locator_ny = 1;
+
+  data.locator.assign(data.locator_nx*data.locator_ny, -1);
+  for( int t=0; t<d->ntriangles; ++t )
+  {
+    const int * v = d->triangles[t].vids;
+    double x = (d->points[v[0]].x + d->points[v[1]].x + d->points[v[2]].x)/3;
+    double y = (d->points[v[0]].y + d->points[v[1]].y + d->points[v[2]].y)/3;
+    data.locator[this->_locator_cell(data, x, y)] = t;
   }
-  
-  return p.z;
+}
+
+
+unsigned int Interpolation2D_NN::_locator_cell(const DATA & data, double x, double y) const
+{
+  const NN::delaunay * d = data.d;
+  double fx = d->xmax > d->xmin ? (x - d->xmin)/(d->xmax - d->xmin) : 0.0;
+  double fy = d->ymax > d->ymin ? (y - d->ymin)/(d->ymax - d->ymin) : 0.0;
+  int i = static_cast<int>(fx*data.locator_nx);
+  int j = static_cast<int>(fy*data.locator_ny);
+  i = std::min(std::max(i, 0), static_cast<int>(data.locator_nx)-1);
+  j = std::min(std::max(j, 0), static_cast<int>(data.locator_ny)-1);
+  return j*data.locator_nx + i;
 }
 
@@ -118,31 +118,28 @@ ANNResultType ANNSession::search(const Point &pt, const unsigned int k) const
   assert(_tree_built);
   assert(_kdTree);
 
-  ANNpoint ann_pt = new ANNcoord[_dim];  // allocate search point
+  ANNcoord ann_pt[3];  // search point
   ann_pt[0] = pt(0);
   ann_pt[1] = pt(1);
   if (_dim==3)
     ann_pt[2] = pt(2);
 
   ANNResultType res;
-  ANNidxArray  _residx;       // indices of result points
-  ANNdistArray _resdist;      // distances of result points
 
   if (_pts.size()<k)
     return res;
 
-  _residx  = new ANNidx[k];            // allocate near neighbor indices
-  _resdist = new ANNdist[k];           // allocate near neighbor dists
-  _kdTree->annkSearch(ann_pt, k, _residx, _resdist, 0);
+  // result buffers are local to the call, the kd-tree search state of ANN is kept per thread,
+  // so concurrent searches on the same tree are safe
+  std::vector<ANNidx>  residx(k);       // indices of result points
+  std::vector<ANNdist> resdist(k);      // distances of result points
+  _kdTree->annkSearch(ann_pt, k, &residx[0], &resdist[0], 0);
 
   for(unsigned int i=0; i<k; i++)
   {
-    res.push_back(std::pair<int, double>(_residx[i],_resdist[i]));
+    res.push_back(std::pair<int, double>(residx[i],resdist[i]));
   }
 
-  delete _residx;
-  delete _resdist;
-
   return res;
 }
 
@@ -314,7 +311,12 @@ double Interpolation3D_nbtet::get_interpolated_value(const Point & pt, int group
   }
   else
   {
-    MESSAGE << "Interpolation: warning: interpolation failed, assume zero at this point." << std::endl; RECORD();
+#ifdef _OPENMP
+    #pragma omp critical (interpolation_message)
+#endif
+    {
+      MESSAGE << "Interpolation: warning: interpolation failed, assume zero at this point." << std::endl; RECORD();
+    }
     return 0.0;
   }
 }
@@ -0,0 +1,35 @@
+#include <algorithm>
+
+#include "genius_common.h"
+#include "interpolation_base.h"
+#include "threads.h"
+
+
+void InterpolationBase::get_interpolated_values(const std::vector<Point> & points, int group, std::vector<double> & values) const
+{
+  const unsigned int n = points.size();
+  values.resize(n);
+  if( n == 0 ) return;
+
+  // contiguous blocks keep neighbouring mesh nodes together, search state in a block stays warm.
+  // the cost of one point varies (walking a triangulation, nearest neighbour search), blocks are scheduled dynamically
+  const unsigned int block_size = 1024;
+  const int n_blocks = (n + block_size - 1)/block_size;
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(int b=0; b<n_blocks; ++b)
+  {
+    const unsigned int begin = b*block_size;
+    const unsigned int end = std::min(begin + block_size, n);
+    this->_interpolated_values(&points[begin], end - begin, group, &values[begin]);
+  }
+}
+
+
+void InterpolationBase::_interpolated_values(const Point * points, unsigned int n, int group, double * value) const
+{
+  for(unsigned int i=0; i<n; ++i)
+    value[i] = this->get_interpolated_value(points[i], group);
+}
+
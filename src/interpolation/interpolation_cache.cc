@@ -0,0 +1,95 @@
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+#include "genius_common.h"
+#include "genius_env.h"
+#include "interpolation_cache.h"
+
+namespace
+{
+  const char cache_magic[8] = {'G', 'I', 'N', 'T', 'C', '0', '1', '\0'};
+
+  /**
+   * file header, 32 bytes so the payload is 8 byte aligned
+   */
+  struct CacheHeader
+  {
+    char magic[8];
+    char method[8];
+    unsigned long long hash;
+    unsigned long long size;
+  };
+}
+
+
+InterpolationCache::InterpolationCache(const std::string & directory, const std::string & method)
+  : _directory(directory), _method(method.substr(0, 7)), _hash(14695981039346656037ULL)
+{}
+
+
+void InterpolationCache::hash(const void * data, std::size_t size)
+{
+  const unsigned char * p = static_cast<const unsigned char *>(data);
+  for(std::size_t i=0; i<size; ++i)
+  {
+    _hash ^= p[i];
+    _hash *= 1099511628211ULL;
+  }
+}
+
+
+std::string InterpolationCache::file() const
+{
+  std::ostringstream name;
+  name << _directory << '/' << _method << '-' << std::hex << std::setw(16) << std::setfill('0') << _hash << ".cache";
+  return name.str();
+}
+
+
+const void * InterpolationCache::load(std::size_t & size)
+{
+  if( !enabled() ) return 0;
+
+  if( !_file.open(file()) ) return 0;
+
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  if( _file.size() >= sizeof(header) )
+    std::memcpy(&header, _file.data(), sizeof(header));
+
+  char method[8];
+  std::memset(method, 0, sizeof(method));
+  std::memcpy(method, _method.c_str(), _method.size());
+
+  if( std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+      std::memcmp(header.method, method, sizeof(method)) != 0 ||
+      header.hash != _hash ||
+      header.size + sizeof(header) != _file.size() )
+  {
+    _file.close();
+    return 0;
+  }
+
+  size = header.size;
+  return _file.data() + sizeof(header);
+}
+
+
+void InterpolationCache::save(const void * data, std::size_t size) const
+{
+  if( !enabled() || Genius::processor_id() != 0 ) return;
+
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  std::memcpy(header.method, _method.c_str(), _method.size());
+  header.hash = _hash;
+  header.size = size;
+
+  std::vector<char> buffer(sizeof(header) + size);
+  std::memcpy(&buffer[0], &header, sizeof(header));
+  if( size ) std::memcpy(&buffer[sizeof(header)], data, size);
+
+  MappedFile::write(file(), &buffer[0], buffer.size());
+}
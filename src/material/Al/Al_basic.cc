@@ -94,3 +94,5 @@ extern "C"
     return new GSS_Al_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
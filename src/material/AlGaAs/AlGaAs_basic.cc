@@ -125,3 +125,5 @@ extern "C"
     return new GSS_AlGaAs_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
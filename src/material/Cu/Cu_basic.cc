@@ -94,3 +94,5 @@ extern "C"
     return new GSS_Cu_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
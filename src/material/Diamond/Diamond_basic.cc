@@ -78,3 +78,5 @@ extern "C"
     return new GSS_Diamond_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
@@ -93,3 +93,5 @@ extern "C"
     return new GSS_Elec_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
@@ -75,3 +75,5 @@ extern "C"
     return new GSS_GaAs_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
@@ -74,3 +74,5 @@ extern "C"
     return new GSS_Ge_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
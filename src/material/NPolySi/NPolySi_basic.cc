@@ -95,3 +95,5 @@ extern "C"
     return new GSS_NPolySi_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
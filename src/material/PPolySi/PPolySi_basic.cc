@@ -98,3 +98,5 @@ extern "C"
     return new GSS_PPolySi_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
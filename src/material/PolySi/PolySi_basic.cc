@@ -76,3 +76,5 @@ extern "C"
     return new GSS_PolySi_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
@@ -114,3 +114,5 @@ extern "C"
     return new GSS_Si_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
@@ -136,3 +136,5 @@ extern "C"
     return new GSS_SiO2_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
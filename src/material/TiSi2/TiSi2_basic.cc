@@ -96,3 +96,5 @@ extern "C"
     return new GSS_TiSi2_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
@@ -92,3 +92,5 @@ extern "C"
     return new GSS_W_BasicParameter(env);
   }
 }
+
+PMI_DECLARE_ABI_VERSION(2)
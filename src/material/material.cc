@@ -51,7 +51,7 @@ namespace Material
 {
 
   MaterialBase::MaterialBase(const SimulationRegion * reg)
-  : set_ad_num(0),  region(reg) , material(reg->material()), p_point(0), p_node_data(0), dll_file(0)
+  : set_ad_num(0),  region(reg) , material(reg->material()), p_point(0), p_node_data(0), pmi_abi_version(1), dll_file(0)
   {
     point_variables = &(region->region_point_variables());
     cell_variables = &(region->region_cell_variables());
@@ -68,6 +68,27 @@ namespace Material
   }
 
 
+  void MaterialBase::record_pmi(const std::string &type, const std::string &model_name, const std::vector<Parser::Parameter> & pmi_parameters)
+  {
+    PMI_Record record;
+    record.type = type;
+    record.model_name = model_name;
+    record.pmi_parameters = pmi_parameters;
+    _pmi_records.push_back(record);
+  }
+
+
+  void MaterialBase::replay_pmi(MaterialBase * m) const
+  {
+    for(unsigned int n=0; n<_pmi_records.size(); ++n)
+    {
+      std::vector<Parser::Parameter> pmi_parameters = _pmi_records[n].pmi_parameters;
+      m->set_pmi(_pmi_records[n].type, _pmi_records[n].model_name, pmi_parameters);
+    }
+    m->clock = clock;
+  }
+
+
   PMI_Environment MaterialBase::build_PMI_Environment()
   {
      PMI_Environment env(  &p_point, &p_node_data, &clock, &point_variables,
@@ -105,6 +126,15 @@ namespace Material
       genius_error();
     }
 #endif
+    // check the binary interface of the library, old library has no version symbol
+    unsigned int (*abi_version)() = (unsigned int (*)())LDFUN(dll_file, "PMI_abi_version");
+    pmi_abi_version = abi_version ? abi_version() : 1;
+    if( pmi_abi_version > PMI_ABI_VERSION )
+    {
+      MESSAGE<<"Material file lib"<< _material <<" has PMI ABI version " << pmi_abi_version
+             <<", which is newer than the supported version " << PMI_ABI_VERSION << '\n'; RECORD();
+      genius_error();
+    }
   }
 
 
@@ -199,6 +229,14 @@ namespace Material
     delete trap;
   }
 
+  MaterialBase * MaterialSemiconductor::clone() const
+  {
+    MaterialSemiconductor * m = new MaterialSemiconductor(region);
+    replay_pmi(m);
+    return m;
+  }
+
+
   void MaterialSemiconductor::init_node(const std::string &type, const Point* point, FVM_NodeData* node_data)
   {
     mapping(point, node_data, clock);
@@ -283,6 +321,7 @@ namespace Material
   void MaterialSemiconductor::set_pmi(const std::string &type, const std::string &model_name,
                                       std::vector<Parser::Parameter> & pmi_parameters)
   {
+    record_pmi(type, model_name, pmi_parameters);
 
     std::string _material = FormatMaterialString(material);
 
@@ -517,6 +556,14 @@ namespace Material
     delete optical;
   }
 
+  MaterialBase * MaterialInsulator::clone() const
+  {
+    MaterialInsulator * m = new MaterialInsulator(region);
+    replay_pmi(m);
+    return m;
+  }
+
+
   void MaterialInsulator::init_node(const std::string &type, const Point* point, FVM_NodeData* node_data)
   {
     mapping(point, node_data, clock);
@@ -581,6 +628,7 @@ namespace Material
   void MaterialInsulator::set_pmi(const std::string &type, const std::string &model_name,
                                   std::vector<Parser::Parameter> & pmi_parameters)
   {
+    record_pmi(type, model_name, pmi_parameters);
     std::string _material = FormatMaterialString(material);
 
     PMII_BasicParameter*(*wbasic)    (const PMI_Environment& env);
@@ -738,6 +786,14 @@ namespace Material
     delete optical;
   }
 
+  MaterialBase * MaterialConductor::clone() const
+  {
+    MaterialConductor * m = new MaterialConductor(region);
+    replay_pmi(m);
+    return m;
+  }
+
+
   void MaterialConductor::init_node(const std::string &type, const Point* point, FVM_NodeData* node_data)
   {
     mapping(point, node_data, clock);
@@ -798,6 +854,7 @@ namespace Material
   void MaterialConductor::set_pmi(const std::string &type, const std::string &model_name,
                                   std::vector<Parser::Parameter> & pmi_parameters)
   {
+    record_pmi(type, model_name, pmi_parameters);
 
     std::string _material = FormatMaterialString(material);
 
@@ -935,6 +992,14 @@ namespace Material
     delete optical;
   }
 
+  MaterialBase * MaterialVacuum::clone() const
+  {
+    MaterialVacuum * m = new MaterialVacuum(region);
+    replay_pmi(m);
+    return m;
+  }
+
+
   void MaterialVacuum::init_node(const std::string &type, const Point* point, FVM_NodeData* node_data)
   {
     mapping(point, node_data, clock);
@@ -994,6 +1059,7 @@ namespace Material
   void MaterialVacuum::set_pmi(const std::string &type, const std::string &model_name,
                                std::vector<Parser::Parameter> & pmi_parameters)
   {
+    record_pmi(type, model_name, pmi_parameters);
 
     std::string _material = FormatMaterialString(material);
 
@@ -1114,6 +1180,14 @@ namespace Material
     delete thermal;
   }
 
+  MaterialBase * MaterialPML::clone() const
+  {
+    MaterialPML * m = new MaterialPML(region);
+    replay_pmi(m);
+    return m;
+  }
+
+
   void MaterialPML::init_node(const std::string &type, const Point* point, FVM_NodeData* node_data)
   {
     mapping(point, node_data, clock);
@@ -1167,6 +1241,7 @@ namespace Material
   void MaterialPML::set_pmi(const std::string &type, const std::string &model_name,
                             std::vector<Parser::Parameter> & pmi_parameters)
   {
+    record_pmi(type, model_name, pmi_parameters);
 
     std::string _material = FormatMaterialString(material);
 
@@ -1,6 +1,70 @@
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <algorithm>
+
+#include "genius_common.h"
 #include "expr_evaluate.h"
 #include "physical_unit.h"
 
+
+namespace
+{
+  /**
+   * name and number of operands of each bytecode operation, in the order of ExprEvalute::OpCode.
+   * the name is the function name used by the expression, it is reported by MathException
+   */
+  struct OpTable
+  {
+    const char * name;
+    unsigned int n_operand;
+  };
+
+  const OpTable op_table[] =
+  {
+    {"+", 2}, {"-", 2}, {"*", 2}, {"/", 2}, {"-", 1}, {"^", 2},
+    {"abs", 1}, {"mod", 2}, {"ipart", 1}, {"fpart", 1}, {"min", 2}, {"max", 2},
+    {"sqrt", 1}, {"sin", 1}, {"cos", 1}, {"tan", 1}, {"sinh", 1}, {"cosh", 1}, {"tanh", 1},
+    {"asin", 1}, {"acos", 1}, {"atan", 1}, {"atan2", 2}, {"log", 1}, {"ln", 1}, {"exp", 1},
+    {"erfc", 1}, {"erf", 1}, {"ceil", 1}, {"floor", 1},
+    {"equal", 2}, {"above", 2}, {"below", 2}, {"clip", 3}, {"not", 1}
+  };
+
+  const unsigned int n_op = sizeof(op_table)/sizeof(OpTable);
+
+  // the first operation which is a function in expression
+  const unsigned int first_function_op = 6;
+
+  /**
+   * points evaluated together by array evaluation
+   */
+  const unsigned int lanes = 64;
+
+  /**
+   * Chebyshev fit of erfc, the same as the erfc function of expreval
+   */
+  double expr_erfc(double x)
+  {
+    const double a1 = -1.26551223,   a2 = 1.00002368,
+                 a3 =  0.37409196,   a4 = 0.09678418,
+                 a5 = -0.18628806,   a6 = 0.27886807,
+                 a7 = -1.13520398,   a8 = 1.48851587,
+                 a9 = -0.82215223,  a10 = 0.17087277;
+
+    double result = 1;
+    double z = fabs(x);
+    if (z <= 0) return result;
+
+    double t = 1/(1+0.5*z);
+    result = t*exp((-z*z) +a1+t*(a2+t*(a3+t*(a4+t*(a5+t*(a6+t*(a7+t*(a8+t*(a9+t*a10)))))))));
+    if (x < 0) result = 2-result;
+
+    return result;
+  }
+}
+
+
 ConstanteExprEvalute::ConstanteExprEvalute(const std::string & expr)
 {
   // use default function set
@@ -98,18 +162,342 @@ ExprEvalute::ExprEvalute(const std::string & expr)
   e.SetValueList(&vlist);
 
   e.Parse(expr);
+
+  _compiled = _compile();
 }
 
 
 
 double ExprEvalute::eval(double x, double y, double z, double t)
 {
-  //assign variable value to the expr
-  *(vlist.GetAddress("x")) = x;
-  *(vlist.GetAddress("y")) = y;
-  *(vlist.GetAddress("z")) = z;
-  *(vlist.GetAddress("t")) = t;
+  if(!_compiled)
+  {
+    //assign variable value to the expr
+    *(vlist.GetAddress("x")) = x;
+    *(vlist.GetAddress("y")) = y;
+    *(vlist.GetAddress("z")) = z;
+    *(vlist.GetAddress("t")) = t;
 
-  return e.Evaluate();
+    return e.Evaluate();
+  }
+
+  double * reg = &_register[0];
+  reg[0] = x;
+  reg[1] = y;
+  reg[2] = z;
+  reg[3] = t;
+
+  for(std::vector<Instruction>::const_iterator it=_code.begin(); it!=_code.end(); ++it)
+    reg[it->dst] = _apply(it->op, reg[it->a], reg[it->b], reg[it->c]);
+
+  return reg[_result];
+}
+
+
+
+void ExprEvalute::eval(unsigned int n, const double *x, const double *y, const double *z, double t, double *value)
+{
+  if(!_compiled)
+  {
+    for(unsigned int i=0; i<n; ++i)
+      value[i] = eval(x[i], y[i], z[i], t);
+    return;
+  }
+
+  // each register holds the value of all the lanes, constant registers are filled once
+  const unsigned int n_register = _register.size();
+  if(_lanes.size() != n_register*lanes)
+  {
+    _lanes.resize(n_register*lanes);
+    for(unsigned int r=0; r<n_register; ++r)
+      std::fill(_lanes.begin()+r*lanes, _lanes.begin()+(r+1)*lanes, _register[r]);
+  }
+  std::fill(_lanes.begin()+3*lanes, _lanes.begin()+4*lanes, t);
+
+  for(unsigned int begin=0; begin<n; begin+=lanes)
+  {
+    const unsigned int m = std::min(lanes, n-begin);
+    std::copy(x+begin, x+begin+m, &_lanes[0*lanes]);
+    std::copy(y+begin, y+begin+m, &_lanes[1*lanes]);
+    std::copy(z+begin, z+begin+m, &_lanes[2*lanes]);
+
+    for(std::vector<Instruction>::const_iterator it=_code.begin(); it!=_code.end(); ++it)
+    {
+      double * d = &_lanes[it->dst*lanes];
+      const double * a = &_lanes[it->a*lanes];
+      const double * b = &_lanes[it->b*lanes];
+      const double * c = &_lanes[it->c*lanes];
+
+      // arithmetic has plain loops, others go through _apply for the error check
+      switch(it->op)
+      {
+        case OP_ADD :
+          for(unsigned int l=0; l<m; ++l) d[l] = a[l] + b[l];
+          break;
+        case OP_SUB :
+          for(unsigned int l=0; l<m; ++l) d[l] = a[l] - b[l];
+          break;
+        case OP_MUL :
+          for(unsigned int l=0; l<m; ++l) d[l] = a[l] * b[l];
+          break;
+        case OP_NEG :
+          for(unsigned int l=0; l<m; ++l) d[l] = -a[l];
+          break;
+        case OP_DIV :
+          for(unsigned int l=0; l<m; ++l)
+            if(b[l] == 0.0) throw(ExprEval::DivideByZeroException());
+          for(unsigned int l=0; l<m; ++l) d[l] = a[l] / b[l];
+          break;
+        default :
+          for(unsigned int l=0; l<m; ++l) d[l] = _apply(it->op, a[l], b[l], c[l]);
+      }
+    }
+
+    const double * r = &_lanes[_result*lanes];
+    std::copy(r, r+m, value+begin);
+  }
+}
+
+
+
+struct ExprEvalute::CompileState
+{
+  /**
+   * address of the independent variables in vlist
+   */
+  const double *x, *y, *z, *t;
+
+  /**
+   * register of each constant, keyed by bit pattern so that -0 and NaN are kept as they are
+   */
+  std::map<unsigned long long, unsigned int> constant;
+
+  /**
+   * register of each emitted instruction (op, a, b, c)
+   */
+  std::map<std::pair<std::pair<int, unsigned int>, std::pair<unsigned int, unsigned int> >, unsigned int> emitted;
+
+  /**
+   * register holds a constant
+   */
+  std::vector<bool> is_constant;
+};
+
+
+
+bool ExprEvalute::_compile()
+{
+  _code.clear();
+  _register.assign(4, 0.0);
+  _lanes.clear();
+
+  CompileState state;
+  state.x = vlist.GetAddress("x");
+  state.y = vlist.GetAddress("y");
+  state.z = vlist.GetAddress("z");
+  state.t = vlist.GetAddress("t");
+  state.is_constant.assign(4, false);
+
+  _result = _compile_node(e.GetNode(), state);
+  if(_result == invalid_uint)
+  {
+    _code.clear();
+    _register.clear();
+    return false;
+  }
+
+  return true;
+}
+
+
+
+unsigned int ExprEvalute::_compile_node(const ExprEval::Node *node, CompileState &state)
+{
+  ExprEval::NodeInfo info;
+  if(node == 0 || !node->Describe(info)) return invalid_uint;
+
+  switch(info.type)
+  {
+    case ExprEval::NodeInfo::VALUE :
+      return _constant(info.value, state);
+    case ExprEval::NodeInfo::VARIABLE :
+      if(info.var == state.x) return 0;
+      if(info.var == state.y) return 1;
+      if(info.var == state.z) return 2;
+      if(info.var == state.t) return 3;
+      // without assignment, other variables keep the value they have at parse
+      return _constant(*info.var, state);
+    default : break;
+  }
+
+  std::vector<unsigned int> args;
+  for(unsigned int i=0; i<info.args.size(); ++i)
+  {
+    unsigned int r = _compile_node(info.args[i], state);
+    if(r == invalid_uint) return invalid_uint;
+    args.push_back(r);
+  }
+
+  switch(info.type)
+  {
+    case ExprEval::NodeInfo::ADD      : return _emit(OP_ADD, args[0], args[1], 0, state);
+    case ExprEval::NodeInfo::SUBTRACT : return _emit(OP_SUB, args[0], args[1], 0, state);
+    case ExprEval::NodeInfo::MULTIPLY : return _emit(OP_MUL, args[0], args[1], 0, state);
+    case ExprEval::NodeInfo::DIVIDE   : return _emit(OP_DIV, args[0], args[1], 0, state);
+    case ExprEval::NodeInfo::NEGATE   : return _emit(OP_NEG, args[0], 0, 0, state);
+    case ExprEval::NodeInfo::EXPONENT : return _emit(OP_POW, args[0], args[1], 0, state);
+    case ExprEval::NodeInfo::FUNCTION : break;
+    default : return invalid_uint;
+  }
+
+  if(args.empty()) return invalid_uint;
+
+  // deg and rad are evaluated in the same order as expreval
+  if(info.name == "deg")
+    return _emit(OP_DIV, _emit(OP_MUL, args[0], _constant(180.0, state), 0, state), _constant(3.1415926535897932, state), 0, state);
+  if(info.name == "rad")
+    return _emit(OP_DIV, _emit(OP_MUL, args[0], _constant(3.1415926535897932, state), 0, state), _constant(180.0, state), 0, state);
+
+  // min and max take any number of arguments
+  if(info.name == "min" || info.name == "max")
+  {
+    OpCode op = info.name == "min" ? OP_MIN : OP_MAX;
+    unsigned int r = args[0];
+    for(unsigned int i=1; i<args.size(); ++i)
+      r = _emit(op, r, args[i], 0, state);
+    return r;
+  }
+
+  for(unsigned int op=first_function_op; op<n_op; ++op)
+    if(info.name == op_table[op].name && args.size() == op_table[op].n_operand)
+      return _emit(static_cast<OpCode>(op), args[0], args.size()>1 ? args[1] : 0, args.size()>2 ? args[2] : 0, state);
+
+  return invalid_uint;
+}
+
+
+
+unsigned int ExprEvalute::_constant(double v, CompileState &state)
+{
+  unsigned long long bits;
+  std::memcpy(&bits, &v, sizeof(double));
+
+  std::map<unsigned long long, unsigned int>::const_iterator it = state.constant.find(bits);
+  if(it != state.constant.end()) return it->second;
+
+  unsigned int r = _register.size();
+  _register.push_back(v);
+  state.is_constant.push_back(true);
+  state.constant[bits] = r;
+  return r;
+}
+
+
+
+unsigned int ExprEvalute::_emit(OpCode op, unsigned int a, unsigned int b, unsigned int c, CompileState &state)
+{
+  const unsigned int n_operand = op_table[op].n_operand;
+  if(n_operand < 2) b = 0;
+  if(n_operand < 3) c = 0;
+
+  // the result of commutative operation does not depend on the operand order
+  if((op == OP_ADD || op == OP_MUL || op == OP_EQUAL) && b < a) std::swap(a, b);
+
+  std::pair<std::pair<int, unsigned int>, std::pair<unsigned int, unsigned int> > key =
+    std::make_pair(std::make_pair(static_cast<int>(op), a), std::make_pair(b, c));
+  if(state.emitted.find(key) != state.emitted.end()) return state.emitted[key];
+
+  unsigned int r = invalid_uint;
+
+  bool constant_operand = state.is_constant[a] && (n_operand < 2 || state.is_constant[b]) && (n_operand < 3 || state.is_constant[c]);
+  if(constant_operand)
+  {
+    // math error is left to the evaluation, as the parsed tree does
+    try
+    {
+      r = _constant(_apply(op, _register[a], _register[b], _register[c]), state);
+    }
+    catch(ExprEval::Exception &) {}
+  }
+
+  if(r == invalid_uint)
+  {
+    r = _register.size();
+    _register.push_back(0.0);
+    state.is_constant.push_back(false);
+
+    Instruction inst;
+    inst.op  = op;
+    inst.dst = r;
+    inst.a   = a;
+    inst.b   = b;
+    inst.c   = c;
+    _code.push_back(inst);
+  }
+
+  state.emitted[key] = r;
+  return r;
+}
+
+
+
+double ExprEvalute::_apply(OpCode op, double a, double b, double c)
+{
+  // operations without error check
+  switch(op)
+  {
+    case OP_ADD   : return a + b;
+    case OP_SUB   : return a - b;
+    case OP_MUL   : return a * b;
+    case OP_DIV   :
+      if(b == 0.0) throw(ExprEval::DivideByZeroException());
+      return a / b;
+    case OP_NEG   : return -a;
+    case OP_ABS   : return fabs(a);
+    case OP_IPART : { double ip; modf(a, &ip); return ip; }
+    case OP_FPART : { double ip; return modf(a, &ip); }
+    case OP_MIN   : return b < a ? b : a;
+    case OP_MAX   : return b > a ? b : a;
+    case OP_ERFC  : return expr_erfc(a);
+    case OP_ERF   : return 1.0 - expr_erfc(a);
+    case OP_CEIL  : return ceil(a);
+    case OP_FLOOR : return floor(a);
+    case OP_EQUAL : return a == b ? 1.0 : 0.0;
+    case OP_ABOVE : return a > b ? 1.0 : 0.0;
+    case OP_BELOW : return a < b ? 1.0 : 0.0;
+    case OP_CLIP  : return a < b ? b : (a > c ? c : a);
+    case OP_NOT   : return a == 0.0 ? 1.0 : 0.0;
+    default : break;
+  }
+
+  // math functions check errno as expreval does
+  errno = 0;
+
+  double result = 0.0;
+  switch(op)
+  {
+    case OP_POW   : result = pow(a, b);   break;
+    case OP_MOD   : result = fmod(a, b);  break;
+    case OP_SQRT  : result = sqrt(a);     break;
+    case OP_SIN   : result = sin(a);      break;
+    case OP_COS   : result = cos(a);      break;
+    case OP_TAN   : result = tan(a);      break;
+    case OP_SINH  : result = sinh(a);     break;
+    case OP_COSH  : result = cosh(a);     break;
+    case OP_TANH  : result = tanh(a);     break;
+    case OP_ASIN  : result = asin(a);     break;
+    case OP_ACOS  : result = acos(a);     break;
+    case OP_ATAN  : result = atan(a);     break;
+    case OP_ATAN2 : result = atan2(a, b); break;
+    case OP_LOG   : result = log10(a);    break;
+    case OP_LN    : result = log(a);      break;
+    case OP_EXP   : result = exp(a);      break;
+    default : break;
+  }
+
+  if(errno)
+    throw(ExprEval::MathException(op_table[op].name));
+
+  return result;
 }
 
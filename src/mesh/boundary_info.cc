@@ -20,6 +20,7 @@
 
 
 // C++ includes
+#include <algorithm>
 
 
 // Local includes
@@ -47,7 +48,7 @@ const short int BoundaryInfo::invalid_id = -1234;
 //------------------------------------------------------
 // BoundaryInfo functions
 BoundaryInfo::BoundaryInfo(const MeshBase& m) :
-    _mesh (m)
+    _mesh (m), _index_valid(false)
 {}
 
 
@@ -69,6 +70,149 @@ void BoundaryInfo::clear()
   _boundary_id_has_user_defined_label.clear();
   _boundary_ids_to_descriptions.clear();
   _extra_descriptions.clear();
+
+  _index_valid = false;
+  _index_elem_side_offset.clear();
+  _index_elem.clear();
+  _index_elem_sides.clear();
+  _index_bd_ids.clear();
+  _index_bd_side_offset.clear();
+  _index_bd_sides.clear();
+  _index_bd_node_offset.clear();
+  _index_bd_nodes.clear();
+}
+
+
+
+namespace {
+  /**
+   * order nodes by id
+   */
+  struct NodeIdLess
+  {
+    bool operator() (const Node *a, const Node *b) const
+    { return a->id() < b->id(); }
+  };
+}
+
+
+void BoundaryInfo::prepare_for_use()
+{
+  typedef std::multimap<const Elem*, std::pair<unsigned short int, short int> >::const_iterator CIter;
+
+  _index_valid = false;
+
+  // all the boundary ids
+  {
+    std::set<short int> ids;
+    for (CIter pos=_boundary_side_id.begin(); pos != _boundary_side_id.end(); ++pos)
+      ids.insert(pos->second.second);
+    std::map<const Node*, short int>::const_iterator node_it = _boundary_node_id.begin();
+    for(; node_it != _boundary_node_id.end(); ++node_it)
+      ids.insert(node_it->second);
+    _index_bd_ids.assign(ids.begin(), ids.end());
+  }
+
+  // side to boundary id table, indexed by elem id.
+  // the rows take the mesh elem of that id, a boundary elem which does not
+  // match it (not in the mesh or renumbered) is left to the map structure
+  {
+    const unsigned int n_rows = _mesh.max_elem_id();
+    _index_elem.assign(n_rows, static_cast<const Elem *>(NULL));
+
+    MeshBase::const_element_iterator       el  = _mesh.elements_begin();
+    const MeshBase::const_element_iterator end = _mesh.elements_end();
+    for (; el != end; ++el)
+      if( (*el)->id() < n_rows ) _index_elem[(*el)->id()] = *el;
+
+    std::vector<unsigned int> count(n_rows, 0);
+    for (CIter pos=_boundary_side_id.begin(); pos != _boundary_side_id.end(); ++pos)
+    {
+      const unsigned int id = pos->first->id();
+      if( id >= n_rows ) continue;
+      if( _index_elem[id] == pos->first ) count[id]++;
+    }
+
+    _index_elem_side_offset.resize(n_rows+1);
+    _index_elem_side_offset[0] = 0;
+    for(unsigned int n=0; n<n_rows; ++n)
+      _index_elem_side_offset[n+1] = _index_elem_side_offset[n] + count[n];
+
+    // keep the order of the multimap inside each row
+    _index_elem_sides.resize(_index_elem_side_offset[n_rows]);
+    for (CIter pos=_boundary_side_id.begin(); pos != _boundary_side_id.end(); ++pos)
+    {
+      const unsigned int id = pos->first->id();
+      if( id >= n_rows || _index_elem[id] != pos->first ) continue;
+      unsigned int k = _index_elem_side_offset[id+1] - count[id]--;
+      _index_elem_sides[k] = pos->second;
+    }
+
+    // boundary elem with the id of another elem, the row can not be used
+    for (CIter pos=_boundary_side_id.begin(); pos != _boundary_side_id.end(); ++pos)
+    {
+      const unsigned int id = pos->first->id();
+      if( id < n_rows && _index_elem[id] != pos->first ) _index_elem[id] = NULL;
+    }
+  }
+
+  // active (elem, side) pairs of each boundary, in the order of the multimap
+  {
+    std::vector< std::vector<std::pair<const Elem *, unsigned int> > > bd_sides(_index_bd_ids.size());
+    for (CIter pos=_boundary_side_id.begin(); pos != _boundary_side_id.end(); ++pos)
+    {
+      const Elem * elem = pos->first;
+      unsigned short int side = pos->second.first;
+      std::vector<std::pair<const Elem *, unsigned int> > & sides = bd_sides[_index_bd_position(pos->second.second)];
+      if (elem->active() )
+        sides.push_back(std::make_pair(elem, side));
+      else
+      {
+        std::vector<const Elem*> family;
+        elem->active_family_tree_by_side(family, side);
+        for(unsigned int n=0; n<family.size(); ++n)
+          sides.push_back(std::make_pair(family[n], side));
+      }
+    }
+
+    _index_bd_side_offset.resize(_index_bd_ids.size()+1);
+    _index_bd_side_offset[0] = 0;
+    _index_bd_sides.clear();
+    for(unsigned int b=0; b<bd_sides.size(); ++b)
+    {
+      _index_bd_sides.insert(_index_bd_sides.end(), bd_sides[b].begin(), bd_sides[b].end());
+      _index_bd_side_offset[b+1] = _index_bd_sides.size();
+    }
+  }
+
+  // nodes of each boundary, sorted by id
+  {
+    std::vector< std::vector<const Node *> > bd_nodes(_index_bd_ids.size());
+    std::map<const Node*, short int>::const_iterator node_it = _boundary_node_id.begin();
+    for(; node_it != _boundary_node_id.end(); ++node_it)
+      bd_nodes[_index_bd_position(node_it->second)].push_back(node_it->first);
+
+    _index_bd_node_offset.resize(_index_bd_ids.size()+1);
+    _index_bd_node_offset[0] = 0;
+    _index_bd_nodes.clear();
+    _index_bd_nodes.reserve(_boundary_node_id.size());
+    for(unsigned int b=0; b<bd_nodes.size(); ++b)
+    {
+      std::sort(bd_nodes[b].begin(), bd_nodes[b].end(), NodeIdLess());
+      _index_bd_nodes.insert(_index_bd_nodes.end(), bd_nodes[b].begin(), bd_nodes[b].end());
+      _index_bd_node_offset[b+1] = _index_bd_nodes.size();
+    }
+  }
+
+  _index_valid = true;
+}
+
+
+unsigned int BoundaryInfo::_index_bd_position(short int id) const
+{
+  std::vector<short int>::const_iterator it = std::lower_bound(_index_bd_ids.begin(), _index_bd_ids.end(), id);
+  if( it == _index_bd_ids.end() || *it != id ) return invalid_uint;
+  return static_cast<unsigned int>(it - _index_bd_ids.begin());
 }
 
 
@@ -227,6 +371,7 @@ void BoundaryInfo::add_node(const Node* node, const short int id)
 
   _boundary_node_id[node] = id;
   _boundary_ids.insert(id);
+  _index_valid = false;
 }
 
 
@@ -275,6 +420,7 @@ void BoundaryInfo::add_side(const Elem* elem,
 
   _boundary_side_id.insert(kv);
   _boundary_ids.insert(id);
+  _index_valid = false;
 
   // Possilby add the nodes of the side,
   // no matter they are already there.
@@ -373,6 +519,8 @@ void BoundaryInfo::build_node_ids_from_priority_order(const std::map<short int,
     }
   }
 
+  // node ids are final now
+  this->prepare_for_use();
 }
 
 
@@ -382,6 +530,7 @@ void BoundaryInfo::remove (const Node* node)
 
   // Erase everything associated with node
   _boundary_node_id.erase (node);
+  _index_valid = false;
 
   // for efficency reason, we don't do it here.
   // please call rebuild_ids() after all the remove operator
@@ -398,6 +547,7 @@ void BoundaryInfo::remove (const Elem* elem)
 
   // Erase everything associated with elem
   _boundary_side_id.erase (elem);
+  _index_valid = false;
 
 
   // for efficency reason, we don't do it here.
@@ -430,6 +580,7 @@ void BoundaryInfo::remove (const Elem* elem, unsigned short int side)
   // erase here
   for(size_t n=0; n<its.size(); n++)
     _boundary_side_id.erase (its[n]);
+  _index_valid = false;
 
 
   // for efficency reason, we don't do it here.
@@ -483,6 +634,17 @@ short int BoundaryInfo::boundary_id(const Elem* const elem,  const unsigned shor
   if ( to_top_parent && elem->level() != 0)
     searched_elem = elem->top_parent ();
 
+  if( _index_valid )
+  {
+    const unsigned int id = searched_elem->id();
+    if( id < _index_elem.size() && _index_elem[id] == searched_elem )
+    {
+      for(unsigned int k=_index_elem_side_offset[id]; k<_index_elem_side_offset[id+1]; ++k)
+        if( _index_elem_sides[k].first == side ) return _index_elem_sides[k].second;
+      return invalid_id;
+    }
+  }
+
   std::pair<std::multimap<const Elem*,
   std::pair<unsigned short int, short int> >::const_iterator,
   std::multimap<const Elem*,
@@ -523,6 +685,17 @@ bool BoundaryInfo::is_boundary_elem_side(const Elem * elem, unsigned int side) c
   if ( elem->level() != 0)
     searched_elem = elem->top_parent ();
 
+  if( _index_valid )
+  {
+    const unsigned int id = searched_elem->id();
+    if( id < _index_elem.size() && _index_elem[id] == searched_elem )
+    {
+      for(unsigned int k=_index_elem_side_offset[id]; k<_index_elem_side_offset[id+1]; ++k)
+        if( _index_elem_sides[k].first == side ) return true;
+      return false;
+    }
+  }
+
   std::pair<std::multimap<const Elem*,
   std::pair<unsigned short int, short int> >::const_iterator,
   std::multimap<const Elem*,
@@ -554,6 +727,17 @@ unsigned int BoundaryInfo::side_with_boundary_id(const Elem* const elem, short i
   if (elem->level() != 0)
     searched_elem = elem->top_parent();
 
+  if( _index_valid )
+  {
+    const unsigned int id = searched_elem->id();
+    if( id < _index_elem.size() && _index_elem[id] == searched_elem )
+    {
+      for(unsigned int k=_index_elem_side_offset[id]; k<_index_elem_side_offset[id+1]; ++k)
+        if( _index_elem_sides[k].second == boundary_id ) return _index_elem_sides[k].first;
+      return invalid_uint;
+    }
+  }
+
   typedef  std::multimap<const Elem*, std::pair<unsigned short int, short int> >::const_iterator CIter;
   std::pair<CIter,CIter> e = _boundary_side_id.equal_range(searched_elem);
 
@@ -701,6 +885,16 @@ void BoundaryInfo::build_on_processor_side_list (std::vector<unsigned int>&
 void BoundaryInfo::nodes_with_boundary_id (std::vector<unsigned int>& nl, short int boundary_id) const
 {
   nl.clear();
+
+  if( _index_valid )
+  {
+    unsigned int b = _index_bd_position(boundary_id);
+    if( b == invalid_uint ) return;
+    for(unsigned int k=_index_bd_node_offset[b]; k<_index_bd_node_offset[b+1]; ++k)
+      nl.push_back(_index_bd_nodes[k]->id());
+    return;
+  }
+
   // use set to reorder the nodes by their id
   std::set<unsigned int> bd_node_set;
 
@@ -720,6 +914,15 @@ void BoundaryInfo::nodes_with_boundary_id (std::vector<unsigned int>& nl, short
 void BoundaryInfo::nodes_with_boundary_id (std::vector<const Node *>& nl, short int boundary_id) const
 {
   nl.clear();
+
+  if( _index_valid )
+  {
+    unsigned int b = _index_bd_position(boundary_id);
+    if( b == invalid_uint ) return;
+    nl.assign(_index_bd_nodes.begin() + _index_bd_node_offset[b], _index_bd_nodes.begin() + _index_bd_node_offset[b+1]);
+    return;
+  }
+
   // use map to reorder the nodes by their id
   std::map<unsigned int, const Node *> bd_node_map;
 
@@ -739,6 +942,18 @@ void BoundaryInfo::nodes_with_boundary_id ( std::map<short int, std::vector<cons
 {
   node_boundary_id_map.clear();
 
+  if( _index_valid )
+  {
+    for(unsigned int b=0; b<_index_bd_ids.size(); ++b)
+    {
+      if( _index_bd_node_offset[b] == _index_bd_node_offset[b+1] ) continue;
+      node_boundary_id_map[_index_bd_ids[b]].assign(_index_bd_nodes.begin() + _index_bd_node_offset[b],
+                                                    _index_bd_nodes.begin() + _index_bd_node_offset[b+1]);
+    }
+    return;
+  }
+
+
   std::map<const Node*, short int>::const_iterator pos = _boundary_node_id.begin();
   for (; pos != _boundary_node_id.end(); ++pos)
   {
@@ -784,6 +999,18 @@ void BoundaryInfo::active_elem_with_boundary_id (std::vector<const Elem *>& el,
   el.clear();
   sl.clear();
 
+  if( _index_valid )
+  {
+    unsigned int b = _index_bd_position(boundary_id);
+    if( b == invalid_uint ) return;
+    for(unsigned int k=_index_bd_side_offset[b]; k<_index_bd_side_offset[b+1]; ++k)
+    {
+      el.push_back(_index_bd_sides[k].first);
+      sl.push_back(_index_bd_sides[k].second);
+    }
+    return;
+  }
+
   std::multimap<const Elem*, std::pair<unsigned short int, short int> >::const_iterator pos;
 
   for (pos=_boundary_side_id.begin(); pos != _boundary_side_id.end();
@@ -825,6 +1052,17 @@ void BoundaryInfo::active_elem_with_boundary_id (
 {
   boundary_elem_side_map.clear();
 
+  if( _index_valid )
+  {
+    for(unsigned int b=0; b<_index_bd_ids.size(); ++b)
+    {
+      if( _index_bd_side_offset[b] == _index_bd_side_offset[b+1] ) continue;
+      boundary_elem_side_map[_index_bd_ids[b]].assign(_index_bd_sides.begin() + _index_bd_side_offset[b],
+                                                      _index_bd_sides.begin() + _index_bd_side_offset[b+1]);
+    }
+    return;
+  }
+
   std::multimap<const Elem*, std::pair<unsigned short int, short int> >::const_iterator pos;
   for (pos=_boundary_side_id.begin(); pos != _boundary_side_id.end(); ++pos)
   {
@@ -843,7 +1081,7 @@ void BoundaryInfo::active_elem_with_boundary_id (
 
       for(unsigned int n=0; n<family.size(); ++n)
       {
-        boundary_elem_side_map[pos->second.second].push_back(std::make_pair(pos->first, pos->second.first));
+        boundary_elem_side_map[pos->second.second].push_back(std::make_pair(family[n], side));
       }
     }
   }
@@ -112,6 +112,9 @@ void MeshBase::prepare_for_use (const bool skip_renumber_nodes_and_elements)
   this->clear_point_locator();
   this->clear_surface_locator();
 
+  // Flat boundary side/node tables for the final elem numbering
+  this->boundary_info->prepare_for_use();
+
   // The mesh is now prepared for use.
   _is_prepared = true;
 }
@@ -364,7 +367,7 @@ unsigned int MeshBase::recalculate_n_partitions()
 const PointLocatorBase & MeshBase::point_locator () const
 {
   if (_point_locator.get() == NULL)
-    _point_locator.reset (PointLocatorBase::build(PointLocator_TREE, *this).release());
+    _point_locator.reset (PointLocatorBase::build(PointLocator_BVH, *this).release());
 
   return *_point_locator;
 }
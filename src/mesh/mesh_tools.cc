@@ -482,6 +482,50 @@ unsigned int MeshTools::n_levels(const MeshBase& mesh)
 
 
 
+unsigned int MeshTools::node_bandwidth(const MeshBase& mesh)
+{
+  unsigned int bandwidth = 0;
+
+  MeshBase::const_element_iterator el = mesh.active_elements_begin();
+  const MeshBase::const_element_iterator end_el = mesh.active_elements_end();
+
+  for( ; el != end_el; ++el)
+  {
+    unsigned int min_id = invalid_uint, max_id = 0;
+    for (unsigned int n=0; n<(*el)->n_nodes(); ++n)
+    {
+      min_id = std::min(min_id, (*el)->node(n));
+      max_id = std::max(max_id, (*el)->node(n));
+    }
+    bandwidth = std::max(bandwidth, max_id - min_id);
+  }
+
+  return bandwidth;
+}
+
+
+
+unsigned int MeshTools::elem_bandwidth(const MeshBase& mesh)
+{
+  unsigned int bandwidth = 0;
+
+  MeshBase::const_element_iterator el = mesh.active_elements_begin();
+  const MeshBase::const_element_iterator end_el = mesh.active_elements_end();
+
+  for( ; el != end_el; ++el)
+    for (unsigned int n=0; n<(*el)->n_neighbors(); ++n)
+    {
+      const Elem * neighbor = (*el)->neighbor(n);
+      if( neighbor == NULL ) continue;
+      const unsigned int id1 = (*el)->id(), id2 = neighbor->id();
+      bandwidth = std::max(bandwidth, id1 > id2 ? id1 - id2 : id2 - id1);
+    }
+
+  return bandwidth;
+}
+
+
+
 void MeshTools::get_not_subactive_node_ids(const MeshBase& mesh,
     std::set<unsigned int>& not_subactive_node_ids)
 {
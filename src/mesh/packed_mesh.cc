@@ -0,0 +1,136 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+// C++ includes
+#include <vector>
+
+// Local includes
+#include "packed_mesh.h"
+#include "mesh_base.h"
+#include "elem.h"
+#include "perf_log.h"
+
+
+
+void PackedMesh::clear()
+{
+  _x.clear();
+  _y.clear();
+  _z.clear();
+  _node_id.clear();
+  _node_index.clear();
+  _conn.clear();
+  _type_ranges.clear();
+  _elem_range.clear();
+  _elem_id.clear();
+  _elem_subdomain.clear();
+  _elem_ptr.clear();
+}
+
+
+void PackedMesh::pack(const MeshBase &mesh)
+{
+  START_LOG("pack()", "PackedMesh");
+
+  this->clear();
+
+  // group active elements by type, keep the mesh order inside each group
+  std::vector< std::vector<const Elem *> > type_elems(INVALID_ELEM);
+  {
+    MeshBase::const_element_iterator       el  = mesh.active_elements_begin();
+    const MeshBase::const_element_iterator end = mesh.active_elements_end();
+    for (; el != end; ++el)
+      type_elems[(*el)->type()].push_back(*el);
+  }
+
+  // nodes are packed in the order they are first used, which follows the
+  // element order so the coordinates of an element are usually close in memory
+  _node_index.resize(mesh.max_node_id(), invalid_uint);
+
+  for(unsigned int t=0; t<type_elems.size(); ++t)
+  {
+    const std::vector<const Elem *> & elems = type_elems[t];
+    if( elems.empty() ) continue;
+
+    TypeRange range;
+    range.type       = static_cast<ElemType>(t);
+    range.n_nodes    = elems[0]->n_nodes();
+    range.begin      = _elem_id.size();
+    range.end        = range.begin + elems.size();
+    range.conn_begin = _conn.size();
+
+    _conn.reserve(_conn.size() + elems.size()*range.n_nodes);
+    for(unsigned int e=0; e<elems.size(); ++e)
+    {
+      const Elem * elem = elems[e];
+      for(unsigned int n=0; n<range.n_nodes; ++n)
+      {
+        const Node * node = elem->get_node(n);
+        unsigned int & index = _node_index[node->id()];
+        if( index == invalid_uint )
+        {
+          index = _node_id.size();
+          _node_id.push_back(node->id());
+          _x.push_back((*node)(0));
+          _y.push_back((*node)(1));
+          _z.push_back((*node)(2));
+        }
+        _conn.push_back(index);
+      }
+      _elem_range.push_back(static_cast<unsigned char>(_type_ranges.size()));
+      _elem_id.push_back(elem->id());
+      _elem_subdomain.push_back(elem->subdomain_id());
+      _elem_ptr.push_back(elem);
+    }
+
+    _type_ranges.push_back(range);
+  }
+
+  STOP_LOG("pack()", "PackedMesh");
+}
+
+
+void PackedMesh::centroids(std::vector<Point> &cp) const
+{
+  cp.resize(this->n_elem());
+
+  for(unsigned int r=0; r<_type_ranges.size(); ++r)
+  {
+    const TypeRange & range = _type_ranges[r];
+    if( range.begin == range.end ) continue;
+
+    // centroid is the average of vertices, not of all the nodes
+    const unsigned int n_vertices = _elem_ptr[range.begin]->n_vertices();
+    const Real w = 1.0/n_vertices;
+    const unsigned int * conn = &_conn[0] + range.conn_begin;
+    for(unsigned int e=range.begin; e<range.end; ++e, conn+=range.n_nodes)
+    {
+      Real x=0, y=0, z=0;
+      for(unsigned int n=0; n<n_vertices; ++n)
+      {
+        x += _x[conn[n]];
+        y += _y[conn[n]];
+        z += _z[conn[n]];
+      }
+      cp[e] = Point(x*w, y*w, z*w);
+    }
+  }
+}
@@ -24,6 +24,7 @@
 // Local includes
 #include "boundary_info.h"
 #include "elem.h"
+#include "packed_mesh.h"
 #include "perf_log.h"
 #include "serial_mesh.h"
 #include "mesh_tools.h"
@@ -312,78 +313,270 @@ void SerialMesh::delete_node(Node* n)
 
 
 
-bool SerialMesh::reorder_elems(std::string &err)
+namespace {
+
+  /**
+   * Hilbert index of integer coordinates x (bits per axis), from
+   * J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707, 2004
+   */
+  unsigned long long hilbert_index(unsigned int x[3], unsigned int dim, unsigned int bits)
+  {
+    const unsigned int M = 1u << (bits-1);
+
+    // inverse undo excess work
+    for(unsigned int Q=M; Q>1; Q>>=1)
+    {
+      const unsigned int P = Q-1;
+      for(unsigned int i=0; i<dim; ++i)
+      {
+        if( x[i] & Q ) x[0] ^= P;
+        else
+        {
+          const unsigned int t = (x[0]^x[i]) & P;
+          x[0] ^= t;
+          x[i] ^= t;
+        }
+      }
+    }
+
+    // gray encode
+    for(unsigned int i=1; i<dim; ++i) x[i] ^= x[i-1];
+    unsigned int t = 0;
+    for(unsigned int Q=M; Q>1; Q>>=1)
+      if( x[dim-1] & Q ) t ^= Q-1;
+    for(unsigned int i=0; i<dim; ++i) x[i] ^= t;
+
+    // interleave the transposed bits
+    unsigned long long key = 0;
+    for(int b=bits-1; b>=0; --b)
+      for(unsigned int i=0; i<dim; ++i)
+        key = (key << 1) | ((x[i] >> b) & 1);
+    return key;
+  }
+
+  /**
+   * sort elems by key, ties broken by the old elem id
+   */
+  struct HilbertLess
+  {
+    bool operator() (const std::pair<unsigned long long, Elem *> &a, const std::pair<unsigned long long, Elem *> &b) const
+    {
+      if( a.first != b.first ) return a.first < b.first;
+      return a.second->id() < b.second->id();
+    }
+  };
+}
+
+
+void SerialMesh::_rcm_order(const std::vector<Elem *> &elems, std::vector<Elem *> &order) const
 {
+  if( elems.empty() ) return;
 
-  // do it only on serial mesh
-  assert(_is_serial);
+  const unsigned int subdomain = elems[0]->subdomain_id();
 
+  // degree of elem in the graph of this subdomain
+  std::vector<unsigned int> degree(_elements.size(), 0);
+  for(unsigned int n=0; n<elems.size(); ++n)
+    for(unsigned int e=0; e<elems[n]->n_neighbors(); ++e)
+    {
+      const Elem * neighbor = elems[n]->neighbor(e);
+      if( neighbor && neighbor->subdomain_id() == subdomain ) degree[elems[n]->id()]++;
+    }
+
+  std::vector<bool> visit_flag(_elements.size(), false);
+  std::vector<bool> level_flag(_elements.size(), false);
+
+  const unsigned int order_begin = order.size();
+  std::vector< std::pair<unsigned int, Elem *> > neighbors;
+
+  // each connected component of the subdomain
+  for(unsigned int n=0; n<elems.size(); ++n)
   {
-    const Elem * elem_begin = _elements[0];
-    for(unsigned int n=0; n<_elements.size(); ++n)
-      if( _elements[n]->centroid().all_less(elem_begin->centroid()) )
-        elem_begin = _elements[n];
+    if( visit_flag[elems[n]->id()] ) continue;
 
-    // the visited flag array
-    std::vector<bool> visit_flag(n_elem(), false);
-    unsigned int new_index = 0;
-    // a queue for Breadth-First Search
-    std::queue<const Elem *> Q;
-    std::vector<unsigned int> new_order(_elements.size(), invalid_uint);
+    // the unvisited elem with minimal degree
+    Elem * start = elems[n];
+    for(unsigned int m=n+1; m<elems.size(); ++m)
+      if( !visit_flag[elems[m]->id()] && degree[elems[m]->id()] < degree[start->id()] )
+        start = elems[m];
 
-    // do Breadth-First Search
-    // begin at this node.
-    visit_flag[elem_begin->id()] = true;
-    Q.push( elem_begin );
+    // one Breadth-First Search to move the start elem to the periphery of the component
+    {
+      std::vector<Elem *> level;
+      std::queue<Elem *> Q;
+      Q.push(start);
+      level_flag[start->id()] = true;
+      while(!Q.empty())
+      {
+        Elem * current = Q.front();
+        Q.pop();
+        level.push_back(current);
+        for(unsigned int e=0; e<current->n_neighbors(); ++e)
+        {
+          Elem * neighbor = current->neighbor(e);
+          if( neighbor && neighbor->subdomain_id() == subdomain && !level_flag[neighbor->id()] )
+          {
+            level_flag[neighbor->id()] = true;
+            Q.push(neighbor);
+          }
+        }
+      }
+      start = level.back();
+      for(unsigned int m=0; m<level.size(); ++m)
+        level_flag[level[m]->id()] = false;
+    }
 
+    // Cuthill-McKee, visit neighbors by increasing degree
+    std::queue<Elem *> Q;
+    Q.push(start);
+    visit_flag[start->id()] = true;
     while(!Q.empty())
     {
-      const Elem * current = Q.front();
+      Elem * current = Q.front();
       Q.pop();
-      new_order[current->id()] = new_index++;
-
-      // here just use a simple neighbor search method.
-      // the neighbor is in arbitrary ordered.
-      // however, one may use other nodal reordering
-      // i.e. sort neighbor nodes by Degree of the neighboring nodes,
-      // Physical distance of the neighboring nodes to current node
-      // or even the solution based sort
+      order.push_back(current);
+
+      neighbors.clear();
       for(unsigned int e=0; e<current->n_neighbors(); ++e)
       {
-        const Elem * neighbor = current->neighbor(e);
-        if(neighbor && !visit_flag[neighbor->id()] )
+        Elem * neighbor = current->neighbor(e);
+        if( neighbor && neighbor->subdomain_id() == subdomain && !visit_flag[neighbor->id()] )
         {
-          Q.push(neighbor);
           visit_flag[neighbor->id()] = true;
+          neighbors.push_back(std::make_pair(degree[neighbor->id()], neighbor));
         }
       }
+      // degree then old id, independent of neighbor storage order
+      for(unsigned int i=1; i<neighbors.size(); ++i)
+        for(unsigned int j=i; j>0; --j)
+        {
+          const std::pair<unsigned int, Elem *> & a = neighbors[j-1];
+          const std::pair<unsigned int, Elem *> & b = neighbors[j];
+          if( a.first > b.first || (a.first == b.first && a.second->id() > b.second->id()) )
+            std::swap(neighbors[j-1], neighbors[j]);
+          else break;
+        }
+      for(unsigned int i=0; i<neighbors.size(); ++i)
+        Q.push(neighbors[i].second);
     }
+  }
 
-    // ok, assign ordered index to each elem
-    std::set<unsigned int> disconnect_regions;
-    for(unsigned int n=0; n<_elements.size(); ++n)
+  // reverse
+  std::reverse(order.begin() + order_begin, order.end());
+}
+
+
+void SerialMesh::_hilbert_order(const std::vector<Elem *> &elems, const std::vector<Point> &centroids, std::vector<Elem *> &order) const
+{
+  if( elems.empty() ) return;
+
+  const unsigned int dim = this->mesh_dimension() == 2 ? 2 : 3;
+  // 63 bits key in 3D, 42 bits in 2D
+  const unsigned int bits = 21;
+  const Real scale = static_cast<Real>((1u << bits) - 1);
+
+  Point min( 1.e30,  1.e30,  1.e30);
+  Point max(-1.e30, -1.e30, -1.e30);
+  for(unsigned int n=0; n<elems.size(); ++n)
+  {
+    const Point & c = centroids[elems[n]->id()];
+    for(unsigned int i=0; i<3; ++i)
     {
-      unsigned int new_id = new_order[_elements[n]->id()];
-      if(new_id == invalid_uint)
-        disconnect_regions.insert(_elements[n]->subdomain_id());
-      _elements[n]->set_id () = new_order[_elements[n]->id()];
+      min(i) = std::min(min(i), c(i));
+      max(i) = std::max(max(i), c(i));
     }
+  }
+
+  // keep aspect ratio, use the same scale for all the axis
+  Real extent = 0.0;
+  for(unsigned int i=0; i<dim; ++i)
+    extent = std::max(extent, max(i) - min(i));
+  if( extent <= 0.0 ) extent = 1.0;
+
+  std::vector< std::pair<unsigned long long, Elem *> > keys(elems.size());
+  for(unsigned int n=0; n<elems.size(); ++n)
+  {
+    unsigned int x[3] = {0, 0, 0};
+    for(unsigned int i=0; i<dim; ++i)
+      x[i] = static_cast<unsigned int>( (centroids[elems[n]->id()](i) - min(i))/extent*scale );
+    keys[n] = std::make_pair(hilbert_index(x, dim, bits), elems[n]);
+  }
+
+  std::sort(keys.begin(), keys.end(), HilbertLess());
 
-    if(!disconnect_regions.empty())
+  for(unsigned int n=0; n<keys.size(); ++n)
+    order.push_back(keys[n].second);
+}
+
+
+bool SerialMesh::reorder_elems(std::string &err, MeshReorderType type)
+{
+
+  // do it only on serial mesh
+  assert(_is_serial);
+
+  if( type == MeshReorder_NONE ) return true;
+
+  // the elem id is used as index below
+  for(unsigned int n=0; n<_elements.size(); ++n)
+    if( _elements[n] == NULL || _elements[n]->id() != n )
     {
-      std::set<unsigned int>::const_iterator it = disconnect_regions.begin();
-      for( ; it != disconnect_regions.end(); ++it)
-        err += "Error: disconnect elem in region " + subdomain_label_by_id(*it) + '\n';
+      err += "Error: mesh should be renumbered before reorder.\n";
       return false;
     }
 
+  {
+    // elems of each region are kept together, region by region
+    std::map<unsigned int, std::vector<Elem *> > region_elems;
+    for(unsigned int n=0; n<_elements.size(); ++n)
+      region_elems[_elements[n]->subdomain_id()].push_back(_elements[n]);
+
+    // centroid of each elem, indexed by elem id. computed over the packed
+    // geometry, only the elems that are not active (if any) ask the Elem
+    std::vector<Point> centroids;
+    if( type == MeshReorder_HILBERT )
+    {
+      PackedMesh packed(*this);
+      std::vector<Point> packed_centroids;
+      packed.centroids(packed_centroids);
+
+      centroids.resize(_elements.size());
+      std::vector<bool> packed_flag(_elements.size(), false);
+      for(unsigned int e=0; e<packed.n_elem(); ++e)
+      {
+        const unsigned int id = packed.elem(e).id();
+        centroids[id] = packed_centroids[e];
+        packed_flag[id] = true;
+      }
+      for(unsigned int n=0; n<_elements.size(); ++n)
+        if( !packed_flag[n] ) centroids[n] = _elements[n]->centroid();
+    }
+
+    std::vector<Elem *> order;
+    order.reserve(_elements.size());
+
+    std::map<unsigned int, std::vector<Elem *> >::const_iterator it = region_elems.begin();
+    for( ; it != region_elems.end(); ++it)
+    {
+      switch(type)
+      {
+        case MeshReorder_RCM     : _rcm_order(it->second, order); break;
+        case MeshReorder_HILBERT : _hilbert_order(it->second, centroids, order); break;
+        default : genius_error();
+      }
+    }
+    genius_assert(order.size() == _elements.size());
+
+    // ok, assign ordered index to each elem
+    for(unsigned int n=0; n<order.size(); ++n)
+      order[n]->set_id () = n;
+
     // sort the elems by new ID
-    DofObject::Less less;
-    std::sort( _elements.begin(), _elements.end(), less );
+    _elements = order;
   }
 
 
-  // also sort nodes
+  // also sort nodes, in the order they are first used by the elems
   {
     std::vector<bool> visit_flag(n_nodes(), false);
     std::vector<unsigned int> new_order(n_nodes(), invalid_uint);
@@ -403,6 +596,11 @@ bool SerialMesh::reorder_elems(std::string &err)
       }
     }
 
+    // nodes not used by any elem go to the end
+    for (unsigned int n=0; n<_nodes.size(); ++n)
+      if( !visit_flag[_nodes[n]->id()] )
+        new_order[_nodes[n]->id()] = new_index++;
+
     // ok, assign ordered index to each node
     for (unsigned int n=0; n<_nodes.size(); ++n)
       _nodes[n]->set_id() = new_order[_nodes[n]->id()];
@@ -412,6 +610,9 @@ bool SerialMesh::reorder_elems(std::string &err)
     std::sort( _nodes.begin(), _nodes.end(), less );
   }
 
+  // elem ids changed, rebuild the flat boundary index
+  this->boundary_info->prepare_for_use();
+
   return true;
 }
 
@@ -550,12 +550,41 @@ void UnstructuredMesh::all_first_order ()
 
 
 
+// ------------------------------------------------------------
+// helper functions
+namespace {
+
+  /**
+   * compute the control volume geometry of FVM elements.
+   * each element only reads its nodes and writes its own data,
+   * the loop is split over threads without changing the result
+   */
+  void prepare_fvm_elems(const std::vector<Elem *> & fvm_elems)
+  {
+    START_LOG("prepare_for_fvm()", "UnstructuredMesh");
+
+    const int n_elems = static_cast<int>(fvm_elems.size());
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for(int n=0; n<n_elems; ++n)
+      fvm_elems[n]->prepare_for_fvm();
+
+    STOP_LOG("prepare_for_fvm()", "UnstructuredMesh");
+  }
+
+}
+
+
+
 bool UnstructuredMesh::convert_to_fvm_mesh (std::string &error)
 {
   genius_assert(this->_is_prepared);
 
   // here we convert all the active FEM element to FVM element, maybe only element belongs to local
   // procesor needs to be converted.
+  std::vector<Elem *> fvm_elems;
+
   const_element_iterator endit = local_elements_end();
   for (const_element_iterator it = local_elements_begin();  it != endit; ++it )
   {
@@ -614,9 +643,9 @@ bool UnstructuredMesh::convert_to_fvm_mesh (std::string &error)
       fvm_elem->set_node(v) = fem_elem->get_node(v);
 
     /*
-     * build cell's geometry information for FVM usage
+     * cell's geometry information for FVM usage is built later, all the cells together
      */
-    fvm_elem->prepare_for_fvm();
+    fvm_elems.push_back(fvm_elem);
 
     /*
      * set the subdomain id
@@ -674,6 +703,12 @@ bool UnstructuredMesh::convert_to_fvm_mesh (std::string &error)
   }
 
 
+  // build cell's geometry information for FVM usage
+  prepare_fvm_elems(fvm_elems);
+
+  // boundary sides now belong to the FVM elems
+  this->boundary_info->prepare_for_use();
+
   return true;
 }
 
@@ -686,6 +721,8 @@ bool UnstructuredMesh::convert_to_cylindrical_fvm_mesh (std::string &error)
 
   // here we convert all the active FEM element to FVM element, maybe only element belongs to local
   // procesor needs to be converted.
+  std::vector<Elem *> fvm_elems;
+
   const_element_iterator endit = local_elements_end();
   for (const_element_iterator it = local_elements_begin();  it != endit; ++it )
   {
@@ -763,9 +800,9 @@ bool UnstructuredMesh::convert_to_cylindrical_fvm_mesh (std::string &error)
       fvm_elem->set_node(v) = fem_elem->get_node(v);
 
     /*
-     * build cell's geometry information for FVM usage
+     * cell's geometry information for FVM usage is built later, all the cells together
      */
-    fvm_elem->prepare_for_fvm();
+    fvm_elems.push_back(fvm_elem);
 
     /*
      * set the subdomain id
@@ -822,6 +859,12 @@ bool UnstructuredMesh::convert_to_cylindrical_fvm_mesh (std::string &error)
 
   }
 
+  // build cell's geometry information for FVM usage
+  prepare_fvm_elems(fvm_elems);
+
+  // boundary sides now belong to the FVM elems
+  this->boundary_info->prepare_for_use();
+
   return true;
 }
 
@@ -441,6 +441,13 @@ int SolverControl::set_method ( const Parser::Card & c )
     if (c.is_enum_value("truncation", "always"))        SolverSpecify::VoronoiTruncation = SolverSpecify::VoronoiTruncationAlways;
   }
 
+  // set Bernoulli function evaluation scheme
+  if(c.is_parameter_exist("bernoulli"))
+  {
+    if (c.is_enum_value("bernoulli", "reference"))      SolverSpecify::Bernoulli = SolverSpecify::BernoulliReference;
+    if (c.is_enum_value("bernoulli", "rational"))       SolverSpecify::Bernoulli = SolverSpecify::BernoulliRational;
+  }
+
 
   // set linear solver type for half implicit method
   SolverSpecify::LS_CARRIER = SolverSpecify::linear_solver_type(c.get_string("ls.carrier", "gmres"));
@@ -1785,6 +1792,93 @@ int  SolverControl::set_initial_node_voltage  ( const Parser::Card & c )
 
 
 
+namespace {
+
+  /**
+   * state of electrode external circuit, which should survive
+   * the system rebuild after mesh refinement
+   */
+  struct ElectrodeState
+  {
+    Real Vapp;
+    Real Iapp;
+    Real potential;
+    Real potential_old;
+    Real current;
+    ExternalCircuit::DRIVEN drv;
+  };
+
+  void save_electrode_state(const SimulationSystem & system, std::map<std::string, ElectrodeState> & states)
+  {
+    states.clear();
+    const BoundaryConditionCollector * bcs = system.get_bcs();
+    for(unsigned int n=0; n<bcs->n_bcs(); ++n)
+    {
+      const BoundaryCondition * bc = bcs->get_bc(n);
+      if( !bc->is_electrode() ) continue;
+
+      const ExternalCircuit * ckt = bc->ext_circuit();
+      ElectrodeState state;
+      state.Vapp          = ckt->Vapp();
+      state.Iapp          = ckt->Iapp();
+      state.potential     = ckt->potential();
+      state.potential_old = ckt->potential_old();
+      state.current       = ckt->current();
+      state.drv           = ckt->driven_state();
+      states[bc->label()] = state;
+    }
+  }
+
+  void restore_electrode_state(SimulationSystem & system, const std::map<std::string, ElectrodeState> & states)
+  {
+    std::map<std::string, ElectrodeState>::const_iterator it = states.begin();
+    for(; it != states.end(); ++it)
+    {
+      BoundaryCondition * bc = system.get_bcs()->get_bc(it->first);
+      if( bc == NULL || !bc->is_electrode() ) continue;
+
+      ExternalCircuit * ckt = bc->ext_circuit();
+      const ElectrodeState & state = it->second;
+      ckt->Vapp()          = state.Vapp;
+      ckt->Iapp()          = state.Iapp;
+      ckt->potential()     = state.potential;
+      ckt->potential_old() = state.potential_old;
+      ckt->current()       = state.current;
+      switch(state.drv)
+      {
+        case ExternalCircuit::VDRIVEN : ckt->set_voltage_driven(); break;
+        case ExternalCircuit::IDRIVEN : ckt->set_current_driven(); break;
+        case ExternalCircuit::FLOAT   : ckt->set_float(); break;
+      }
+    }
+  }
+
+  /**
+   * solvers whose solution data is carried by SimulationSystem::do_solution_interpolation
+   */
+  bool is_solution_transferred(SolverSpecify::SolverType type)
+  {
+    switch(type)
+    {
+      case SolverSpecify::POISSON   :
+      case SolverSpecify::DDML1     :
+      case SolverSpecify::DDML1MIX  :
+      case SolverSpecify::DDML1MIXA :
+      case SolverSpecify::HALLDDML1 :
+      case SolverSpecify::DDML2     :
+      case SolverSpecify::DDML2MIX  :
+      case SolverSpecify::DDML2MIXA :
+      case SolverSpecify::EBML3     :
+      case SolverSpecify::EBML3MIX  :
+      case SolverSpecify::EBML3MIXA :
+      case SolverSpecify::GUMMEL    :
+      case SolverSpecify::HALF_IMPLICIT : return true;
+      default : return false;
+    }
+  }
+}
+
+
 int SolverControl::do_refine_conform(const Parser::Card & c)
 {
   // TODO can we refine during the solver solution processing?
@@ -1811,6 +1905,17 @@ int SolverControl::do_refine_conform(const Parser::Card & c)
     system().fill_interpolator(interpolator.get(), "mole.y", InterpolationBase::Linear);
   }
 
+  // carry the solution and electrode state to the refined mesh as initial guess,
+  // only meaningful when some solver has been performed
+  std::vector<SolverSpecify::SolverType> solve_history = system().solve_history();
+  const bool warm_start = !solve_history.empty();
+  std::map<std::string, ElectrodeState> electrode_state;
+  if( warm_start )
+  {
+    system().fill_solution_interpolator(interpolator.get());
+    save_electrode_state(system(), electrode_state);
+  }
+
   // fill error vector from system level
   ErrorVector error_per_cell;
   system().estimate_error(c, error_per_cell);
@@ -1901,6 +2006,17 @@ int SolverControl::do_refine_conform(const Parser::Card & c)
 
   // after doping profile is set, we can init system data.
   system().init_region();
+
+  // replace the equilibrium state by previous solution
+  if( warm_start )
+  {
+    system().do_solution_interpolation(interpolator.get());
+    restore_electrode_state(system(), electrode_state);
+    for(unsigned int n=0; n<solve_history.size(); ++n)
+      if( is_solution_transferred(solve_history[n]) )
+        system().record_active_solver(solve_history[n]);
+  }
+
   system().init_region_post_process();
 #if defined(HAVE_FENV_H) && defined(DEBUG)
   genius_assert( !fetestexcept(FE_INVALID) );
@@ -1939,6 +2055,17 @@ int SolverControl::do_refine_hierarchical(const Parser::Card & c)
     system().fill_interpolator(interpolator.get(), "mole.y", InterpolationBase::Linear);
   }
 
+  // carry the solution and electrode state to the refined mesh as initial guess,
+  // only meaningful when some solver has been performed
+  std::vector<SolverSpecify::SolverType> solve_history = system().solve_history();
+  const bool warm_start = !solve_history.empty();
+  std::map<std::string, ElectrodeState> electrode_state;
+  if( warm_start )
+  {
+    system().fill_solution_interpolator(interpolator.get());
+    save_electrode_state(system(), electrode_state);
+  }
+
   // fill error vector from system level
   ErrorVector error_per_cell;
   system().estimate_error(c, error_per_cell);
@@ -2003,6 +2130,17 @@ int SolverControl::do_refine_hierarchical(const Parser::Card & c)
 
   // after doping profile is set, we can init system data.
   system().init_region();
+
+  // replace the equilibrium state by previous solution
+  if( warm_start )
+  {
+    system().do_solution_interpolation(interpolator.get());
+    restore_electrode_state(system(), electrode_state);
+    for(unsigned int n=0; n<solve_history.size(); ++n)
+      if( is_solution_transferred(solve_history[n]) )
+        system().record_active_solver(solve_history[n]);
+  }
+
   system().init_region_post_process();
   return 0;
 
@@ -42,7 +42,8 @@ FVM_Node::FVM_Node(const Node *n)
     _volume(0),
     _boundary_id(BoundaryInfo::invalid_id),
     _bc_type(INVALID_BC_TYPE),
-    _subdomain_id(invalid_uint)
+    _subdomain_id(invalid_uint),
+    _region_index(invalid_uint)
 {
   for(unsigned int n=0; n<4; ++n)
   {
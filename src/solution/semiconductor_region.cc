@@ -94,6 +94,7 @@ void SemiconductorSimulationRegion::insert_fvm_node(FVM_Node * fn)
     fn->hold_node_data( new FVM_Semiconductor_NodeData(&_node_data_storage, _region_point_variables) );
 
   _region_node[fn->root_node()->id()] = fn;
+  _region_node_index_valid = false;
 }
 
 
@@ -675,8 +676,14 @@ Real SemiconductorSimulationRegion::fvm_cell_quality() const
 
 Complex SemiconductorSimulationRegion::get_optical_refraction(const FVM_Node *fvm_node, double lambda) const
 {
-  mt->mapping(fvm_node->root_node(), fvm_node->node_data(), 0.0);
-  std::complex<PetscScalar> r = mt->optical->RefractionIndex(lambda, fvm_node->node_data()->T());
+  return get_optical_refraction(fvm_node, lambda, 0);
+}
+
+Complex SemiconductorSimulationRegion::get_optical_refraction(const FVM_Node *fvm_node, double lambda, unsigned int tid) const
+{
+  Material::MaterialSemiconductor * mt_tid = material(tid);
+  mt_tid->mapping(fvm_node->root_node(), fvm_node->node_data(), 0.0);
+  std::complex<PetscScalar> r = mt_tid->optical->RefractionIndex(lambda, fvm_node->node_data()->T());
   return Complex(r.real(), r.imag());
 }
 
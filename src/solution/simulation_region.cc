@@ -19,11 +19,14 @@
 /*                                                                              */
 /********************************************************************************/
 
+#include <algorithm>
+
 #include "elem.h"
 #include "simulation_region.h"
 #include "boundary_condition.h"
 #include "material.h"
 #include "parallel.h"
+#include "log.h"
 
 // static member
 std::map<unsigned int,  SimulationRegion *>  SimulationRegion::_subdomain_id_to_region_map;
@@ -31,13 +34,61 @@ std::map<unsigned int,  SimulationRegion *>  SimulationRegion::_subdomain_id_to_
 
 
 SimulationRegion::SimulationRegion(const std::string &name, const std::string &material, const double T, unsigned int dim, const double z)
-  :_region_name(name), _region_material(material), _T_external(T), _mesh_dim(dim), _z_width(z)
+  :_region_name(name), _region_material(material), _material_instances_warned(false), _T_external(T), _mesh_dim(dim), _z_width(z),
+   _region_node_index_base(0), _region_node_index_valid(false)
 {}
 
 
 SimulationRegion::~SimulationRegion()
 {
   this->clear();
+
+  for(unsigned int n=0; n<_material_instances.size(); ++n)
+    delete _material_instances[n];
+  _material_instances.clear();
+}
+
+
+unsigned int SimulationRegion::prepare_material_instances(unsigned int n)
+{
+  const Material::MaterialBase * mt = get_material_base();
+
+  // PMI library which does not declare ABI version 2 may keep evaluation state in static variables,
+  // clones of it are not independent. only the material object itself can be used
+  if( !mt->clone_safe() )
+  {
+    if( n > 1 && !_material_instances_warned )
+    {
+      _material_instances_warned = true;
+      MESSAGE<<"Warning: material library of region " << _region_name
+             <<" does not declare PMI ABI version 2, its material models are evaluated by one thread." << std::endl; RECORD();
+    }
+    for(unsigned int i=0; i<_material_instances.size(); ++i)
+      delete _material_instances[i];
+    _material_instances.clear();
+    return 1;
+  }
+
+  // clones made before the last PMI statement are stale
+  if( !_material_instances.empty() && _material_instances[0]->n_pmi_records() != mt->n_pmi_records() )
+  {
+    for(unsigned int i=0; i<_material_instances.size(); ++i)
+      delete _material_instances[i];
+    _material_instances.clear();
+  }
+
+  while( _material_instances.size()+1 < n )
+    _material_instances.push_back( mt->clone() );
+
+  return std::max(n, 1u);
+}
+
+
+Material::MaterialBase * SimulationRegion::material_instance(unsigned int tid) const
+{
+  if( tid == 0 ) return get_material_base();
+  genius_assert( tid <= _material_instances.size() );
+  return _material_instances[tid-1];
 }
 
 
@@ -111,15 +162,18 @@ void SimulationRegion::region_node_vol(std::vector<double> & vols) const
 
 FVM_Node * SimulationRegion::region_fvm_node(const Node* node) const
 {
-  std::map<unsigned int, FVM_Node *>::const_iterator it = _region_node.find( node->id() );
-  if( it!=_region_node.end() )
-    return (*it).second;
-  return NULL;
+  return region_fvm_node(node->id());
 }
 
 
 FVM_Node * SimulationRegion::region_fvm_node(unsigned int id) const
 {
+  if( _region_node_index_valid )
+  {
+    unsigned int idx = region_node_index(id);
+    return idx != invalid_uint ? _region_node_index_ptr[idx] : NULL;
+  }
+
   std::map<unsigned int, FVM_Node *>::const_iterator it = _region_node.find( id );
   if( it!=_region_node.end() )
     return (*it).second;
@@ -129,22 +183,117 @@ FVM_Node * SimulationRegion::region_fvm_node(unsigned int id) const
 
 FVM_NodeData * SimulationRegion::region_node_data(const Node* node) const
 {
-  std::map<unsigned int, FVM_Node *>::const_iterator it = _region_node.find( node->id() );
-  if( it!=_region_node.end() )
-    return (*it).second->node_data();
-  return NULL;
+  return region_node_data(node->id());
 }
 
 
 FVM_NodeData * SimulationRegion::region_node_data(unsigned int id) const
 {
-  std::map<unsigned int, FVM_Node *>::const_iterator it = _region_node.find( id );
-  if( it!=_region_node.end() )
-    return (*it).second->node_data();
+  FVM_Node * fvm_node = region_fvm_node(id);
+  if( fvm_node )
+    return fvm_node->node_data();
   return NULL;
 }
 
 
+unsigned int SimulationRegion::region_node_index(unsigned int id) const
+{
+  genius_assert(_region_node_index_valid);
+
+  if( !_region_node_index_table.empty() )
+  {
+    if( id < _region_node_index_base || id - _region_node_index_base >= _region_node_index_table.size() )
+      return invalid_uint;
+    return _region_node_index_table[id - _region_node_index_base];
+  }
+
+  std::vector<unsigned int>::const_iterator it =
+    std::lower_bound(_region_node_index_id.begin(), _region_node_index_id.end(), id);
+  if( it != _region_node_index_id.end() && *it == id )
+    return static_cast<unsigned int>(it - _region_node_index_id.begin());
+  return invalid_uint;
+}
+
+
+void SimulationRegion::region_fvm_nodes(const std::vector<unsigned int> &ids, std::vector<FVM_Node *> &fvm_nodes) const
+{
+  fvm_nodes.resize(ids.size());
+
+  if( !_region_node_index_valid || !_region_node_index_table.empty() )
+  {
+    for(unsigned int n=0; n<ids.size(); ++n)
+      fvm_nodes[n] = region_fvm_node(ids[n]);
+    return;
+  }
+
+  // the lower bound of the search moves forward as long as ids are ascending
+  std::vector<unsigned int>::const_iterator lo = _region_node_index_id.begin();
+  const std::vector<unsigned int>::const_iterator end = _region_node_index_id.end();
+  for(unsigned int n=0; n<ids.size(); ++n)
+  {
+    if( n && ids[n] < ids[n-1] ) lo = _region_node_index_id.begin();
+    lo = std::lower_bound(lo, end, ids[n]);
+    if( lo != end && *lo == ids[n] )
+      fvm_nodes[n] = _region_node_index_ptr[lo - _region_node_index_id.begin()];
+    else
+      fvm_nodes[n] = NULL;
+  }
+}
+
+
+void SimulationRegion::build_region_node_index()
+{
+  _region_node_index_id.clear();
+  _region_node_index_ptr.clear();
+  _region_node_index_table.clear();
+  _region_node_index_base = 0;
+
+  _region_node_index_id.reserve(_region_node.size());
+  _region_node_index_ptr.reserve(_region_node.size());
+
+  // std::map is ordered by id, the dense index follows the same order
+  std::map<unsigned int, FVM_Node *>::iterator it = _region_node.begin();
+  for( ; it != _region_node.end(); ++it)
+  {
+    it->second->set_region_index(_region_node_index_ptr.size());
+    _region_node_index_id.push_back(it->first);
+    _region_node_index_ptr.push_back(it->second);
+  }
+
+  // node ids of a region are usually contiguous blocks, use a direct table when
+  // it wastes no more than the sorted array itself
+  if( !_region_node_index_id.empty() )
+  {
+    const unsigned int base  = _region_node_index_id.front();
+    const unsigned int range = _region_node_index_id.back() - base + 1;
+    if( range <= 2*_region_node_index_id.size() )
+    {
+      _region_node_index_base = base;
+      _region_node_index_table.resize(range, invalid_uint);
+      for(unsigned int n=0; n<_region_node_index_id.size(); ++n)
+        _region_node_index_table[_region_node_index_id[n] - base] = n;
+    }
+  }
+
+  _region_node_index_valid = true;
+}
+
+
+void SimulationRegion::build_region_edge_cv_area()
+{
+  // edge areas, the neighbor lookup is done once here instead of in each assembly
+  _region_edge_cv_area.resize(_region_edges.size());
+  _region_edge_cv_abs_area.resize(_region_edges.size());
+  for(unsigned int n=0; n<_region_edges.size(); ++n)
+  {
+    const FVM_Node * fvm_n1 = _region_edges[n].first;
+    const FVM_Node * fvm_n2 = _region_edges[n].second;
+    _region_edge_cv_area[n] = fvm_n1->cv_surface_area(fvm_n2);
+    _region_edge_cv_abs_area[n] = fvm_n1->cv_abs_surface_area(fvm_n2);
+  }
+}
+
+
 void SimulationRegion::clear()
 {
   _region_cell.clear();
@@ -162,6 +311,10 @@ void SimulationRegion::clear()
   }
 
   _region_node.clear();
+  _region_node_index_id.clear();
+  _region_node_index_ptr.clear();
+  _region_node_index_table.clear();
+  _region_node_index_valid = false;
   _region_local_node.clear();
   _region_processor_node.clear();
   _region_ghost_node.clear();
@@ -172,6 +325,8 @@ void SimulationRegion::clear()
   _node_data_storage.clear();
 
   _region_edges.clear();
+  _region_edge_cv_area.clear();
+  _region_edge_cv_abs_area.clear();
   _region_elem_edge_in_edges_index.clear();
   _region_neighbors.clear();
   _region_boundaries.clear();
@@ -191,6 +346,8 @@ void SimulationRegion::reserve_data_block(unsigned int n_cell_data, unsigned int
 
 void SimulationRegion::rebuild_region_fvm_node_list()
 {
+  build_region_node_index();
+
   _region_local_node.clear();
   _region_processor_node.clear();
   _region_ghost_node.clear();
@@ -221,9 +378,9 @@ void SimulationRegion::rebuild_region_fvm_node_list()
   for( ; it != ghost_nodes.end(); ++it)
   {
     unsigned int id = *it;
-    if( _region_node.find(id) == _region_node.end() ) continue;
+    FVM_Node * fvm_node = region_fvm_node(id);
+    if( !fvm_node ) continue;
 
-    FVM_Node * fvm_node = _region_node.find(id)->second;
     if( fvm_node->on_processor() )
       _region_image_node.push_back(fvm_node);
   }
@@ -235,6 +392,9 @@ void SimulationRegion::prepare_for_use()
 {
   START_LOG("prepare_for_use()", "SimulationRegion");
 
+  // all the FVM nodes are inserted now
+  build_region_node_index();
+
   std::map<unsigned int, FVM_Node *>::iterator nodes_it = _region_node.begin();
   for(; nodes_it != _region_node.end(); ++nodes_it)
   {
@@ -322,6 +482,9 @@ void SimulationRegion::prepare_for_use()
     }
   }
 
+  // cv surface areas are fixed now
+  build_region_edge_cv_area();
+
   STOP_LOG("prepare_for_use()", "SimulationRegion");
 }
 
@@ -470,6 +633,8 @@ void SimulationRegion::remove_remote_object()
 
   for(unsigned int n=0; n<remote_nodes.size(); ++n)
     _region_node.erase( remote_nodes[n] );
+
+  build_region_node_index();
 }
 
 
@@ -874,20 +1039,18 @@ BoundaryCondition * SimulationRegion::floating_metal() const
 
 void SimulationRegion::add_hanging_node_on_side(const Node * node, const Elem * elem, unsigned int s)
 {
-  std::map<unsigned int, FVM_Node *>::iterator it = _region_node.find(node->id());
-  genius_assert( it!=_region_node.end() );
+  const FVM_Node * fvm_node = region_fvm_node(node->id());
+  genius_assert( fvm_node );
 
-  const FVM_Node * fvm_node = (*it).second;
   _hanging_node_on_elem_side[fvm_node] = std::pair<const Elem *, unsigned int>(elem, s);
 }
 
 
 void SimulationRegion::add_hanging_node_on_edge(const Node * node, const Elem * elem, unsigned int e)
 {
-  std::map<unsigned int, FVM_Node *>::iterator it = _region_node.find(node->id());
-  genius_assert( it!=_region_node.end() );
+  const FVM_Node * fvm_node = region_fvm_node(node->id());
+  genius_assert( fvm_node );
 
-  const FVM_Node * fvm_node = (*it).second;
   _hanging_node_on_elem_edge[fvm_node] = std::pair<const Elem *, unsigned int>(elem, e);
 
 }
@@ -913,8 +1076,13 @@ size_t SimulationRegion::memory_size() const
   counter += _region_processor_node.capacity()*sizeof(FVM_Node *);
   counter += _region_ghost_node.capacity()*sizeof(FVM_Node *);
   counter += _region_image_node.capacity()*sizeof(FVM_Node *);
+  counter += _region_node_index_id.capacity()*sizeof(unsigned int);
+  counter += _region_node_index_ptr.capacity()*sizeof(FVM_Node *);
+  counter += _region_node_index_table.capacity()*sizeof(unsigned int);
   counter +=  _node_data_storage.memory_size();
   counter += _region_edges.capacity()*sizeof(std::pair<FVM_Node *, FVM_Node *>);
+  counter += _region_edge_cv_area.capacity()*sizeof(Real);
+  counter += _region_edge_cv_abs_area.capacity()*sizeof(Real);
 
   return counter;
 }
@@ -28,6 +28,7 @@
 
 #include "parser.h"
 #include "unstructured_mesh.h"
+#include "mesh_tools.h"
 #include "simulation_system.h"
 #include "simulation_region.h"
 #include "semiconductor_region.h"
@@ -73,7 +74,7 @@
 
 
 SimulationSystem::SimulationSystem(MeshBase & mesh)
-  : _mesh(mesh), _cylindrical_mesh(false), _distributed_mesh(true), _resistive_metal_mode(false), _block_partition(true),
+  : _mesh(mesh), _cylindrical_mesh(false), _distributed_mesh(true), _resistive_metal_mode(false), _block_partition(true), _mesh_reorder(MeshReorder_NONE),
     _bcs(0), _electrical_source(0),
     _field_source(0), _spice_ckt(0), _global_z_width(false)
 {
@@ -87,7 +88,7 @@ SimulationSystem::SimulationSystem(MeshBase & mesh)
 
 
 SimulationSystem::SimulationSystem(MeshBase & mesh, Parser::InputParser & _decks)
-  :  _T_external(300.0), _mesh(mesh), _cylindrical_mesh(false), _distributed_mesh(true), _resistive_metal_mode(false), _block_partition(true),
+  :  _T_external(300.0), _mesh(mesh), _cylindrical_mesh(false), _distributed_mesh(true), _resistive_metal_mode(false), _block_partition(true), _mesh_reorder(MeshReorder_NONE),
     _bcs(0), _electrical_source(0),
     _field_source(0), _spice_ckt(0), _global_z_width(false), _z_width(1.0)
 {
@@ -170,6 +171,19 @@ SimulationSystem::SimulationSystem(MeshBase & mesh, Parser::InputParser & _decks
 
   if(_cylindrical_mesh) _z_width = 1.0;
 
+  // mesh renumbering, given by MESH or IMPORT card
+  for( _decks.begin(); !_decks.end(); _decks.next() )
+  {
+    Parser::Card c = _decks.get_current_card();
+    if( (c.key() == "MESH" || c.key() == "IMPORT") && c.is_parameter_exist("reorder") )
+    {
+      std::string reorder = c.get_string("reorder", "none");
+      if( reorder == "rcm" )          _mesh_reorder = MeshReorder_RCM;
+      else if( reorder == "hilbert" ) _mesh_reorder = MeshReorder_HILBERT;
+      else                             _mesh_reorder = MeshReorder_NONE;
+    }
+  }
+
 
   MESSAGE<< "External Temperature = " << _T_external/PhysicalUnit::K << 'K' <<std::endl; RECORD();
 
@@ -496,16 +510,31 @@ void SimulationSystem::build_region_fvm_mesh()
     // let all the elements find their neighbors
     mesh.find_neighbors();
 
-#if 0
-    // reorder the elem/node index by Reverse Cuthill-McKee Algorithm
-    std::string err;
-    if(!mesh.reorder_elems(err))
+    MESSAGE<<std::endl;  RECORD();
+
+    // reorder the elem/node index region by region for cache locality.
+    // the refined mesh keeps its order, parent/child relationship should not be disturbed
+    if( _mesh_reorder != MeshReorder_NONE && MeshTools::n_levels(mesh) == 0 )
     {
-      MESSAGE<<err;RECORD();
-      genius_error();
+      START_LOG("reorder_elems()", "SimulationSystem");
+
+      MESSAGE<<"  Reorder mesh by "<< (_mesh_reorder == MeshReorder_RCM ? "Reverse Cuthill-McKee" : "Hilbert curve") <<"...";  RECORD();
+
+      unsigned int node_bw = MeshTools::node_bandwidth(mesh);
+      unsigned int elem_bw = MeshTools::elem_bandwidth(mesh);
+
+      std::string err;
+      if(!mesh.reorder_elems(err, _mesh_reorder))
+      {
+        MESSAGE<<err;RECORD();
+        genius_error();
+      }
+
+      MESSAGE<<" node bandwidth "<<node_bw<<" -> "<<MeshTools::node_bandwidth(mesh)
+             <<", elem bandwidth "<<elem_bw<<" -> "<<MeshTools::elem_bandwidth(mesh)<<std::endl;  RECORD();
+
+      STOP_LOG("reorder_elems()", "SimulationSystem");
     }
-#endif
-    MESSAGE<<std::endl;  RECORD();
 
 
     MESSAGE<<"  Partition mesh...";  RECORD();
@@ -1275,8 +1304,6 @@ void SimulationSystem::fill_interpolator(InterpolationBase *interpolator,
   genius_assert(variable!=INVALID_Variable);
   genius_assert(variable_data_type(variable)==SCALAR);
 
-  int group_code = interpolator->set_group_code(variable_string);
-
   std::map<unsigned int, double> value_map;
   for( unsigned int r=0; r<this->n_regions(); r++)
   {
@@ -1304,6 +1331,11 @@ void SimulationSystem::fill_interpolator(InterpolationBase *interpolator,
   }
   Parallel::allgather(value_map);
 
+  // no region carries this variable, leave it without a group.
+  // value_map is global here, all the processors skip it together
+  if( value_map.empty() ) return;
+
+  int group_code = interpolator->set_group_code(variable_string);
   interpolator->set_interpolation_type(group_code, type);
 
   // fill the interpolator
@@ -1324,9 +1356,14 @@ void SimulationSystem::do_interpolation(const InterpolationBase * interpolator ,
   genius_assert(variable!=INVALID_Variable);
   genius_assert(variable_data_type(variable)==SCALAR);
 
+  // the variable had no data before refinement, see fill_interpolator
+  if( !interpolator->has_group(variable_string) ) return;
+
   int group_code = interpolator->group_code(variable_string);
 
-  // fill gradient of var for all the cells in each region
+  // collect the nodes which have the variable in all the regions
+  std::vector<FVM_NodeData *> node_data_list;
+  std::vector<Point> points;
   for(unsigned int n=0; n<n_regions(); n++)
   {
     SimulationRegion * region = this->region(n);
@@ -1340,11 +1377,60 @@ void SimulationSystem::do_interpolation(const InterpolationBase * interpolator ,
       FVM_NodeData * node_data = fvm_node->node_data();
       if(node_data->is_variable_valid(variable))
       {
-        double value = interpolator->get_interpolated_value(*(fvm_node->root_node()), group_code);
-        node_data->set_variable_real(variable, value);
+        node_data_list.push_back(node_data);
+        points.push_back(*(fvm_node->root_node()));
       }
     }
   }
+
+  // and interpolate them in one bulk query
+  std::vector<double> values;
+  interpolator->get_interpolated_values(points, group_code, values);
+
+  for(unsigned int i=0; i<node_data_list.size(); ++i)
+    node_data_list[i]->set_variable_real(variable, values[i]);
+}
+
+
+
+namespace {
+  /**
+   * solution variables carried across mesh refinement
+   */
+  struct SolutionVariableTransfer
+  {
+    const char * variable;
+    InterpolationBase::InterpolationType type;
+  };
+
+  const SolutionVariableTransfer solution_variable_transfer[] =
+  {
+    { "potential",   InterpolationBase::Linear },
+    { "electron",    InterpolationBase::Asinh  },
+    { "hole",        InterpolationBase::Asinh  },
+    { "temperature", InterpolationBase::Linear },
+    { "e.temp",      InterpolationBase::Linear },
+    { "h.temp",      InterpolationBase::Linear }
+  };
+
+  const unsigned int n_solution_variable_transfer = sizeof(solution_variable_transfer)/sizeof(SolutionVariableTransfer);
+}
+
+
+void SimulationSystem::fill_solution_interpolator(InterpolationBase *interpolator) const
+{
+  for(unsigned int n=0; n<n_solution_variable_transfer; ++n)
+    this->fill_interpolator(interpolator, solution_variable_transfer[n].variable, solution_variable_transfer[n].type);
+}
+
+
+void SimulationSystem::do_solution_interpolation(const InterpolationBase *interpolator)
+{
+  for(unsigned int n=0; n<n_solution_variable_transfer; ++n)
+    this->do_interpolation(interpolator, solution_variable_transfer[n].variable);
+
+  // n_last/p_last, band structure and mobility follow the new solution
+  this->reinit_region_after_import();
 }
 
 
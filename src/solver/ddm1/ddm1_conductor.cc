@@ -94,7 +94,7 @@ void ElectrodeSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, InsertMode
   // search all the edges of this region, do integral over control volume...
   const_edge_iterator it = edges_begin();
   const_edge_iterator it_end = edges_end();
-  for(; it!=it_end; ++it)
+  for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
   {
     // fvm_node of node1
     const FVM_Node * fvm_n1 = (*it).first;
@@ -121,7 +121,7 @@ void ElectrodeSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, InsertMode
       PetscScalar eps = 0.5*(eps1+eps2);
 
       // "flux" from node 2 to node 1
-      PetscScalar f =  eps*fvm_n1->cv_surface_area(fvm_n2)*(V2 - V1)/fvm_n1->distance(fvm_n2) ;
+      PetscScalar f =  eps*edge_cv_surface_area(edge_index)*(V2 - V1)/fvm_n1->distance(fvm_n2) ;
 
       // ignore thoese ghost nodes
       if( fvm_n1->on_processor() )
@@ -166,7 +166,7 @@ void ElectrodeSimulationRegion::DDM1_Jacobian(PetscScalar * x, SparseMatrix<Pets
   // search all the edges of this region, do integral over control volume...
   const_edge_iterator it = edges_begin();
   const_edge_iterator it_end = edges_end();
-  for(; it!=it_end; ++it)
+  for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
   {
     // fvm_node of node1
     const FVM_Node * fvm_n1 = (*it).first;
@@ -198,7 +198,7 @@ void ElectrodeSimulationRegion::DDM1_Jacobian(PetscScalar * x, SparseMatrix<Pets
 
       PetscScalar eps = 0.5*(eps1+eps2);
 
-      AutoDScalar f =  eps*fvm_n1->cv_surface_area(fvm_n2)*(V2 - V1)/fvm_n1->distance(fvm_n2) ;
+      AutoDScalar f =  eps*edge_cv_surface_area(edge_index)*(V2 - V1)/fvm_n1->distance(fvm_n2) ;
 
       // ignore thoese ghost nodes
       if( fvm_n1->on_processor() )
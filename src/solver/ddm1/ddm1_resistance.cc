@@ -103,7 +103,7 @@ void MetalSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, InsertMode &ad
   // search all the edges of this region, do integral over control volume...
   const_edge_iterator it = edges_begin();
   const_edge_iterator it_end = edges_end();
-  for(; it!=it_end; ++it)
+  for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
   {
     // fvm_node of node1
     const FVM_Node * fvm_n1 = (*it).first;
@@ -125,7 +125,7 @@ void MetalSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, InsertMode &ad
       PetscScalar E    = (V2-V1)/fvm_n1->distance(fvm_n2);
 
       // truncated to positive
-      double S = std::abs(fvm_n1->cv_surface_area(fvm_n2));
+      double S = std::abs(edge_cv_surface_area(edge_index));
 
       // "flux" from node 2 to node 1
       PetscScalar f = mt->basic->CurrentDensity(E, T)*S;
@@ -199,7 +199,7 @@ void MetalSimulationRegion::DDM1_Jacobian(PetscScalar * x, SparseMatrix<PetscSca
   // search all the edges of this region, do integral over control volume...
   const_edge_iterator it = edges_begin();
   const_edge_iterator it_end = edges_end();
-  for(; it!=it_end; ++it)
+  for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
   {
     // fvm_node of node1
     const FVM_Node * fvm_n1 = (*it).first;
@@ -227,7 +227,7 @@ void MetalSimulationRegion::DDM1_Jacobian(PetscScalar * x, SparseMatrix<PetscSca
       AutoDScalar E    = (V2-V1)/fvm_n1->distance(fvm_n2);
 
       // truncated to positive
-      double S = std::abs(fvm_n1->cv_surface_area(fvm_n2));
+      double S = std::abs(edge_cv_surface_area(edge_index));
       AutoDScalar f = mt->basic->CurrentDensity(E, T)*S;
 
       // ignore thoese ghost nodes
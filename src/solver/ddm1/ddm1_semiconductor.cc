@@ -28,6 +28,7 @@
 #include "log.h"
 
 #include "jflux1.h"
+#include "jflux_batch.h"
 
 using PhysicalUnit::kb;
 using PhysicalUnit::e;
@@ -152,16 +153,37 @@ void SemiconductorSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, Insert
   bool  highfield_mob   = highfield_mobility() && SolverSpecify::Type!=SolverSpecify::EQUILIBRIUM;
 
   // precompute S-G current on each edge
-  std::vector<PetscScalar> Jn_edge_buffer;
-  std::vector<PetscScalar> Jp_edge_buffer;
+  std::vector<PetscScalar> & Jn_edge_buffer = _sg_edge_buffer.Jn;
+  std::vector<PetscScalar> & Jp_edge_buffer = _sg_edge_buffer.Jp;
   {
-    Jn_edge_buffer.reserve(n_edge());
-    Jp_edge_buffer.reserve(n_edge());
+    // edge arguments are gathered first, then S-G current of all the edges
+    // is evaluated by the batched kernel. clear() keeps the capacity of last call
+    std::vector<PetscScalar> & dEc_edge = _sg_edge_buffer.dEc;
+    std::vector<PetscScalar> & dEv_edge = _sg_edge_buffer.dEv;
+    std::vector<PetscScalar> & n1_edge = _sg_edge_buffer.n1;
+    std::vector<PetscScalar> & n2_edge = _sg_edge_buffer.n2;
+    std::vector<PetscScalar> & p1_edge = _sg_edge_buffer.p1;
+    std::vector<PetscScalar> & p2_edge = _sg_edge_buffer.p2;
+    std::vector<PetscScalar> & length_edge = _sg_edge_buffer.length;
+    dEc_edge.clear();
+    dEv_edge.clear();
+    n1_edge.clear();
+    n2_edge.clear();
+    p1_edge.clear();
+    p2_edge.clear();
+    length_edge.clear();
+    dEc_edge.reserve(n_edge());
+    dEv_edge.reserve(n_edge());
+    n1_edge.reserve(n_edge());
+    n2_edge.reserve(n_edge());
+    p1_edge.reserve(n_edge());
+    p2_edge.reserve(n_edge());
+    length_edge.reserve(n_edge());
 
     // search all the edges of this region
     const_edge_iterator it = edges_begin();
     const_edge_iterator it_end = edges_end();
-    for(; it!=it_end; ++it)
+    for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
     {
       // fvm_node of node1
       const FVM_Node * fvm_n1 = (*it).first;
@@ -218,9 +240,14 @@ void SemiconductorSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, Insert
       }
       const PetscScalar eps2 =  n2_data->eps();
 
-      // S-G current along the edge
-      Jn_edge_buffer.push_back( In_dd(Vt,(Ec2-Ec1)/e,n1,n2,length) );
-      Jp_edge_buffer.push_back( Ip_dd(Vt,(Ev2-Ev1)/e,p1,p2,length) );
+      // S-G current along the edge, evaluated after the loop
+      dEc_edge.push_back((Ec2-Ec1)/e);
+      dEv_edge.push_back((Ev2-Ev1)/e);
+      n1_edge.push_back(n1);
+      n2_edge.push_back(n2);
+      p1_edge.push_back(p1);
+      p2_edge.push_back(p2);
+      length_edge.push_back(length);
 
 
       // poisson's equation
@@ -228,7 +255,7 @@ void SemiconductorSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, Insert
       PetscScalar eps = 0.5*(eps1+eps2);
 
       // "flux" from node 2 to node 1
-      PetscScalar f =  eps*fvm_n1->cv_surface_area(fvm_n2)*(V2 - V1)/fvm_n1->distance(fvm_n2) ;
+      PetscScalar f =  eps*edge_cv_surface_area(edge_index)*(V2 - V1)/length ;
 
       // ignore thoese ghost nodes
       if( fvm_n1->on_processor() )
@@ -243,6 +270,16 @@ void SemiconductorSimulationRegion::DDM1_Function(PetscScalar * x, Vec f, Insert
         flux.push_back(-f);
       }
     }
+
+    const unsigned int n_edges = length_edge.size();
+    const bool reference = SolverSpecify::Bernoulli == SolverSpecify::BernoulliReference;
+    Jn_edge_buffer.resize(n_edges);
+    Jp_edge_buffer.resize(n_edges);
+    if( n_edges )
+    {
+      In_dd_batch(n_edges, Vt, &dEc_edge[0], &n1_edge[0], &n2_edge[0], &length_edge[0], &Jn_edge_buffer[0], reference);
+      Ip_dd_batch(n_edges, Vt, &dEv_edge[0], &p1_edge[0], &p2_edge[0], &length_edge[0], &Jp_edge_buffer[0], reference);
+    }
   }
 
   // then, search all the element in this region and process "cell" related terms
@@ -794,7 +831,7 @@ void SemiconductorSimulationRegion::DDM1_Jacobian(PetscScalar * x, SparseMatrix<
     // search all the edges of this region
     const_edge_iterator it = edges_begin();
     const_edge_iterator it_end = edges_end();
-    for(; it!=it_end; ++it)
+    for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
     {
       // fvm_node of node1
       const FVM_Node * fvm_n1 = (*it).first;
@@ -853,13 +890,21 @@ void SemiconductorSimulationRegion::DDM1_Jacobian(PetscScalar * x, SparseMatrix<
       const PetscScalar eps2 =  n2_data->eps();
 
       // S-G current along the edge
-      Jn_edge_buffer.push_back( In_dd(Vt,(Ec2-Ec1)/e,n1,n2,length) );
-      Jp_edge_buffer.push_back( Ip_dd(Vt,(Ev2-Ev1)/e,p1,p2,length) );
+      if( SolverSpecify::Bernoulli == SolverSpecify::BernoulliReference )
+      {
+        Jn_edge_buffer.push_back( In_dd(Vt,(Ec2-Ec1)/e,n1,n2,length) );
+        Jp_edge_buffer.push_back( Ip_dd(Vt,(Ev2-Ev1)/e,p1,p2,length) );
+      }
+      else
+      {
+        Jn_edge_buffer.push_back( In_dd_fast(Vt,(Ec2-Ec1)/e,n1,n2,length) );
+        Jp_edge_buffer.push_back( Ip_dd_fast(Vt,(Ev2-Ev1)/e,p1,p2,length) );
+      }
 
       // poisson's equation
 
       const PetscScalar eps = 0.5*(eps1+eps2);
-      AutoDScalar f_phi =  eps*fvm_n1->cv_surface_area(fvm_n2)*(V2 - V1)/length ;
+      AutoDScalar f_phi =  eps*edge_cv_surface_area(edge_index)*(V2 - V1)/length ;
 
       PetscInt row[2],col[2];
       row[0] = col[0] = fvm_n1->global_offset();
@@ -21,6 +21,8 @@
 
 //  $Id: doping_analytic.cc,v 1.10 2008/07/09 05:58:16 gdiso Exp $
 
+#include <limits>
+#include <cmath>
 
 #include "polygon.h"
 #include "mesh_base.h"
@@ -33,6 +35,7 @@
 #include "interpolation_2d_nn.h"
 //#include "interpolation_3d_qshep.h"
 #include "interpolation_3d_nbtet.h"
+#include "perf_log.h"
 
 using PhysicalUnit::cm;
 using PhysicalUnit::um;
@@ -119,6 +122,11 @@ int DopingAnalytic::post_solve_process()
  */
 int DopingAnalytic::solve()
 {
+  // the node coordinates are collected once for all the doping functions and data files
+  NodeSet node_set;
+  if( !_custom_profile_funs.empty() || !_custom_profile_data.empty() )
+    _build_node_set(node_set);
+
   for(size_t i=0; i<_custom_profile_funs.size(); ++i)
   {
     const std::string & ion = _custom_profile_funs[i].label;
@@ -127,11 +135,11 @@ int DopingAnalytic::solve()
     
     if(ion == "Na" || ion == "Nd")
     {
-      _doping_function_apply(df, region_app);
+      _doping_function_apply(df, region_app, node_set);
     }
     else 
     {
-      _custom_profile_function_apply(ion, df, region_app);
+      _custom_profile_function_apply(ion, df, region_app, node_set);
     }
   }
   
@@ -143,11 +151,11 @@ int DopingAnalytic::solve()
     
     if(ion == "Na" || ion == "Nd")
     {
-      _doping_data_apply(df, region_app);
+      _doping_data_apply(df, region_app, node_set);
     }
     else 
     {
-      _custom_profile_data_apply(ion, df, region_app);
+      _custom_profile_data_apply(ion, df, region_app, node_set);
     }
   }
  
@@ -262,6 +270,7 @@ void DopingAnalytic::set_doping_function_file(const Parser::Card & c)
   }
 
   interpolator->set_interpolation_type(0, InterpolationBase::Linear);
+  interpolator->set_cache_directory(c.get_string("interpolation.cache", ""));
 
   Point p;
   double doping;
@@ -865,24 +874,117 @@ void DopingAnalytic::set_doping_function_analytic2_poly_mask(const Parser::Card
 }
 
 
-void DopingAnalytic::_doping_function_apply(DopingFunction * df, const std::string &region_app)
+void DopingAnalytic::_build_node_set(NodeSet &node_set) const
+{
+  START_LOG("build_node_set()", "DopingAnalytic");
+
+  std::vector<unsigned int> node_map(_system.mesh().max_node_id(), invalid_uint);
+
+  node_set.region_offset.push_back(0);
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    const SimulationRegion * region = _system.region(n);
+
+    SimulationRegion::const_local_node_iterator node_it = region->on_local_nodes_begin();
+    SimulationRegion::const_local_node_iterator node_it_end = region->on_local_nodes_end();
+    for(; node_it!=node_it_end; ++node_it)
+    {
+      FVM_Node * fvm_node = *node_it;
+      const Node * node = fvm_node->root_node();
+      if( node_map[node->id()] == invalid_uint )
+      {
+        node_map[node->id()] = node_set.x.size();
+        node_set.x.push_back((*node)(0));
+        node_set.y.push_back((*node)(1));
+        node_set.z.push_back((*node)(2));
+      }
+      node_set.fvm_nodes.push_back(fvm_node);
+      node_set.node_index.push_back(node_map[node->id()]);
+    }
+    node_set.region_offset.push_back(node_set.fvm_nodes.size());
+  }
+
+  STOP_LOG("build_node_set()", "DopingAnalytic");
+}
+
+
+void DopingAnalytic::_doping_function_evaluate(DopingFunction * df, const NodeSet &node_set, const std::vector<bool> &region_flag,
+                                               std::vector<double> &value) const
+{
+  START_LOG("doping_function_evaluate()", "DopingAnalytic");
+
+  const unsigned int n_nodes = node_set.x.size();
+
+  std::vector<bool> used(n_nodes, false);
+  unsigned int n_used = 0;
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    if( !region_flag[n] ) continue;
+    for(unsigned int k=node_set.region_offset[n]; k<node_set.region_offset[n+1]; ++k)
+      if( !used[node_set.node_index[k]] )
+      {
+        used[node_set.node_index[k]] = true;
+        n_used++;
+      }
+  }
+
+  // all the nodes are used, no need to gather
+  if( n_used == n_nodes )
+  {
+    df->profile(node_set.x, node_set.y, node_set.z, value);
+    STOP_LOG("doping_function_evaluate()", "DopingAnalytic");
+    return;
+  }
+
+  std::vector<unsigned int> index;
+  std::vector<double> x, y, z, v;
+  index.reserve(n_used);
+  x.reserve(n_used);
+  y.reserve(n_used);
+  z.reserve(n_used);
+  for(unsigned int i=0; i<n_nodes; ++i)
+  {
+    if( !used[i] ) continue;
+    index.push_back(i);
+    x.push_back(node_set.x[i]);
+    y.push_back(node_set.y[i]);
+    z.push_back(node_set.z[i]);
+  }
+
+  df->profile(x, y, z, v);
+
+  value.assign(n_nodes, 0.0);
+  for(unsigned int k=0; k<index.size(); ++k)
+    value[index[k]] = v[k];
+
+  STOP_LOG("doping_function_evaluate()", "DopingAnalytic");
+}
+
+
+void DopingAnalytic::_doping_function_apply(DopingFunction * df, const std::string &region_app, const NodeSet &node_set)
 {
+  std::vector<bool> region_flag(_system.n_regions(), false);
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
     SimulationRegion * region = _system.region(n);
     if(region->type() != SemiconductorRegion) continue;
     if( !region_app.empty() && region->name()!=region_app) continue;
-        
-    SimulationRegion::local_node_iterator node_it = region->on_local_nodes_begin();
-    SimulationRegion::local_node_iterator node_it_end = region->on_local_nodes_end();
-    for(; node_it!=node_it_end; ++node_it)
+    region_flag[n] = true;
+  }
+
+  std::vector<double> value;
+  _doping_function_evaluate(df, node_set, region_flag, value);
+
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    if( !region_flag[n] ) continue;
+
+    for(unsigned int k=node_set.region_offset[n]; k<node_set.region_offset[n+1]; ++k)
     {
-      FVM_Node * fvm_node = *node_it;
-      FVM_NodeData * node_data = fvm_node->node_data();
+      FVM_NodeData * node_data = node_set.fvm_nodes[k]->node_data();
       genius_assert(node_data!=NULL);
 
-      const Node * node = fvm_node->root_node();
-      double d = df->profile((*node)(0),(*node)(1),(*node)(2));
+      double d = value[node_set.node_index[k]];
       double dop_Na = std::abs(d < 0.0 ? d: 0.0);  
       double dop_Nd = std::abs(d > 0.0 ? d: 0.0);  
 
@@ -893,27 +995,34 @@ void DopingAnalytic::_doping_function_apply(DopingFunction * df, const std::stri
 }
 
 
-void DopingAnalytic::_custom_profile_function_apply(const std::string &ion, DopingFunction * df, const std::string &region_app)
+void DopingAnalytic::_custom_profile_function_apply(const std::string &ion, DopingFunction * df, const std::string &region_app, const NodeSet &node_set)
 {
+  std::vector<bool> region_flag(_system.n_regions(), false);
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
     SimulationRegion * region = _system.region(n);
     if( !region_app.empty() && region->name()!=region_app) continue;
+    region_flag[n] = true;
+  }
+
+  std::vector<double> value;
+  _doping_function_evaluate(df, node_set, region_flag, value);
+
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    if( !region_flag[n] ) continue;
+    SimulationRegion * region = _system.region(n);
 
     SemiconductorSimulationRegion * semiconductor_region = dynamic_cast<SemiconductorSimulationRegion *>(region);
     unsigned int ion_index = region->add_variable(SimulationVariable(ion, SCALAR, POINT_CENTER, "cm^-3", invalid_uint, true, true));
     int ion_type = semiconductor_region ? semiconductor_region->material()->band->IonType(ion) : 0;
     
-    SimulationRegion::local_node_iterator node_it = region->on_local_nodes_begin();
-    SimulationRegion::local_node_iterator node_it_end = region->on_local_nodes_end();
-    for(; node_it!=node_it_end; ++node_it)
+    for(unsigned int k=node_set.region_offset[n]; k<node_set.region_offset[n+1]; ++k)
     {
-      FVM_Node * fvm_node = *node_it;
-      FVM_NodeData * node_data = fvm_node->node_data();
+      FVM_NodeData * node_data = node_set.fvm_nodes[k]->node_data();
       genius_assert(node_data!=NULL);
 
-      const Node * node = fvm_node->root_node();
-      double d = df->profile((*node)(0),(*node)(1),(*node)(2));
+      double d = value[node_set.node_index[k]];
       
       node_data->data<PetscScalar>(ion_index) = d;
       if(ion_type < 0 ) node_data->Na() += d;
@@ -1020,24 +1129,115 @@ void DopingAnalytic::set_doping_function_analytic2_rec_mask(const Parser::Card &
 
 }
 
-void DopingAnalytic::_doping_data_apply(std::pair<int, InterpolationBase * > df, const std::string &region_app)
+void DopingAnalytic::_doping_data_evaluate(std::pair<int, InterpolationBase * > df, const NodeSet &node_set, const std::vector<bool> &region_flag,
+                                           std::vector<double> &value) const
 {
+  START_LOG("doping_data_evaluate()", "DopingAnalytic");
+
+  int axes = df.first;
+  const InterpolationBase * interp = df.second;
+
+  const unsigned int n_nodes = node_set.x.size();
+
+  std::vector<bool> used(n_nodes, false);
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    if( !region_flag[n] ) continue;
+    for(unsigned int k=node_set.region_offset[n]; k<node_set.region_offset[n+1]; ++k)
+      used[node_set.node_index[k]] = true;
+  }
+
+  // project the used nodes to the coordinates of the data file
+  std::vector<unsigned int> index;
+  std::vector<Point> points;
+  for(unsigned int i=0; i<n_nodes; ++i)
+  {
+    if( !used[i] ) continue;
+
+    Point p;
+    switch(axes)
+    {
+      case AXES_X:
+        p[0]=node_set.x[i];
+        break;
+      case AXES_Y:
+        p[0]=node_set.y[i];
+        break;
+      case AXES_Z:
+        p[0]=node_set.z[i];
+        break;
+      case AXES_XY:
+        p[0]=node_set.x[i];
+        p[1]=node_set.y[i];
+        break;
+      case AXES_XZ:
+        p[0]=node_set.x[i];
+        p[1]=node_set.z[i];
+        break;
+      case AXES_YZ:
+        p[0]=node_set.y[i];
+        p[1]=node_set.z[i];
+        break;
+      case AXES_XYZ:
+        p[0]=node_set.x[i];
+        p[1]=node_set.y[i];
+        p[2]=node_set.z[i];
+        break;
+    }
+    index.push_back(i);
+    points.push_back(p);
+  }
+
+  // all the points are interpolated at once by the threads
+  std::vector<double> v;
+  interp->get_interpolated_values(points, 0, v);
+#ifdef DEBUG
+  // the FP exception flags are per thread and can not be tested here, check the values instead
+  for(unsigned int k=0; k<index.size(); ++k)
+  {
+    if( std::abs(v[k]) <= std::numeric_limits<double>::max() ) continue;
+    const unsigned int i = index[k];
+    MESSAGE<< "Warning: problem in interpolating doping data at ";
+    MESSAGE<< node_set.x[i]/um << "\t";
+    MESSAGE<< node_set.y[i]/um << "\t";
+    MESSAGE<< node_set.z[i]/um << " " << v[k] << " , ignored.\n";
+    RECORD();
+  }
+#endif
+
+  double unit = 1.0/std::pow(PhysicalUnit::cm,3.0);
+  value.assign(n_nodes, 0.0);
+  for(unsigned int k=0; k<index.size(); ++k)
+    value[index[k]] = unit*v[k];
+
+  STOP_LOG("doping_data_evaluate()", "DopingAnalytic");
+}
+
+
+void DopingAnalytic::_doping_data_apply(std::pair<int, InterpolationBase * > df, const std::string &region_app, const NodeSet &node_set)
+{
+  std::vector<bool> region_flag(_system.n_regions(), false);
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
     SimulationRegion * region = _system.region(n);
     if(region->type() != SemiconductorRegion) continue;
     if( !region_app.empty() && region->name()!=region_app) continue;
-        
-    SimulationRegion::local_node_iterator node_it = region->on_local_nodes_begin();
-    SimulationRegion::local_node_iterator node_it_end = region->on_local_nodes_end();
-    for(; node_it!=node_it_end; ++node_it)
+    region_flag[n] = true;
+  }
+
+  std::vector<double> value;
+  _doping_data_evaluate(df, node_set, region_flag, value);
+
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    if( !region_flag[n] ) continue;
+
+    for(unsigned int k=node_set.region_offset[n]; k<node_set.region_offset[n+1]; ++k)
     {
-      FVM_Node * fvm_node = *node_it;
-      FVM_NodeData * node_data = fvm_node->node_data();
+      FVM_NodeData * node_data = node_set.fvm_nodes[k]->node_data();
       genius_assert(node_data!=NULL);
 
-      const Node * node = fvm_node->root_node();
-      double d = _do_data_interp(df, node);
+      double d = value[node_set.node_index[k]];
       double dop_Na = std::abs(d < 0.0 ? d: 0.0);  
       double dop_Nd = std::abs(d > 0.0 ? d: 0.0);  
 
@@ -1048,27 +1248,34 @@ void DopingAnalytic::_doping_data_apply(std::pair<int, InterpolationBase * > df,
 }
 
 
-void DopingAnalytic::_custom_profile_data_apply(const std::string &ion, std::pair<int, InterpolationBase * > df, const std::string &region_app)
+void DopingAnalytic::_custom_profile_data_apply(const std::string &ion, std::pair<int, InterpolationBase * > df, const std::string &region_app, const NodeSet &node_set)
 {
+  std::vector<bool> region_flag(_system.n_regions(), false);
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
     SimulationRegion * region = _system.region(n);
     if( !region_app.empty() && region->name()!=region_app) continue;
+    region_flag[n] = true;
+  }
+
+  std::vector<double> value;
+  _doping_data_evaluate(df, node_set, region_flag, value);
+
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    if( !region_flag[n] ) continue;
+    SimulationRegion * region = _system.region(n);
 
     SemiconductorSimulationRegion * semiconductor_region = dynamic_cast<SemiconductorSimulationRegion *>(region);
     unsigned int ion_index = region->add_variable(SimulationVariable(ion, SCALAR, POINT_CENTER, "cm^-3", invalid_uint, true, true));
     int ion_type = semiconductor_region ? semiconductor_region->material()->band->IonType(ion) : 0;
     
-    SimulationRegion::local_node_iterator node_it = region->on_local_nodes_begin();
-    SimulationRegion::local_node_iterator node_it_end = region->on_local_nodes_end();
-    for(; node_it!=node_it_end; ++node_it)
+    for(unsigned int k=node_set.region_offset[n]; k<node_set.region_offset[n+1]; ++k)
     {
-      FVM_Node * fvm_node = *node_it;
-      FVM_NodeData * node_data = fvm_node->node_data();
+      FVM_NodeData * node_data = node_set.fvm_nodes[k]->node_data();
       genius_assert(node_data!=NULL);
 
-      const Node * node = fvm_node->root_node();
-      double d = _do_data_interp(df, node);
+      double d = value[node_set.node_index[k]];
       
       node_data->data<PetscScalar>(ion_index) = d;
       if(ion_type < 0 ) node_data->Na() += d;
@@ -1079,56 +1286,3 @@ void DopingAnalytic::_custom_profile_data_apply(const std::string &ion, std::pai
 }
 
 
-double DopingAnalytic::_do_data_interp(std::pair<int, InterpolationBase * > df, const Node *node, const std::string &msg)
-{
-  int axes = df.first;
-  InterpolationBase * interp = df.second;
-
-  Point p;
-  switch(axes)
-  {
-    case AXES_X:
-      p[0]=(*node)(0);
-      break;
-    case AXES_Y:
-      p[0]=(*node)(1);
-      break;
-    case AXES_Z:
-      p[0]=(*node)(2);
-      break;
-    case AXES_XY:
-      p[0]=(*node)(0);
-      p[1]=(*node)(1);
-      break;
-    case AXES_XZ:
-      p[0]=(*node)(0);
-      p[1]=(*node)(2);
-      break;
-    case AXES_YZ:
-      p[0]=(*node)(1);
-      p[1]=(*node)(2);
-      break;
-    case AXES_XYZ:
-      p[0]=(*node)(0);
-      p[1]=(*node)(1);
-      p[2]=(*node)(2);
-      break;
-  }
-
-  double d = interp->get_interpolated_value(p, 0);
-#if defined(HAVE_FENV_H) && defined(DEBUG)
-  if(fetestexcept(FE_INVALID|FE_DIVBYZERO|FE_OVERFLOW))
-  {
-    MESSAGE<< "Warning: problem in interpolating " << msg << " at ";
-    MESSAGE<< (*node)(0)/um << "\t";
-    MESSAGE<< (*node)(1)/um << "\t";
-    MESSAGE<< (*node)(2)/um << " " << d << " , ignored.\n";
-    RECORD();
-    feclearexcept(FE_ALL_EXCEPT);
-  }
-#endif
-  double unit = 1.0/std::pow(PhysicalUnit::cm,3.0);
-  return unit*d;
-}
-
-
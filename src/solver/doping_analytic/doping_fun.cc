@@ -1,14 +1,115 @@
 #include "doping_fun.h"
 
 #include <cmath>
+#include <algorithm>
 //win32 does not have erfc function
 #ifdef WINDOWS
 #include "mathfunc.h"
 #endif
 #include "physical_unit.h"
+#include "threads.h"
 
 using PhysicalUnit::um;
 
+
+namespace {
+
+  /**
+   * multiply value by the (gauss or erfc) factor of doping range [lo, hi] along one axis.
+   * the loops have no branch inside, so the compiler is free to vectorize exp/erfc
+   */
+  void analytic_axis_factor(const double *x, unsigned int n, double lo, double hi, double c, bool use_erfc, double *value)
+  {
+    // zero char length is a step: 1 inside [lo, hi], 0 outside. both formulas below give 0/0 there
+    if ( c == 0.0 )
+    {
+      for(unsigned int i=0; i<n; ++i)
+        if( x[i] < lo || x[i] > hi ) value[i] = 0.0;
+      return;
+    }
+
+    if ( use_erfc )
+    {
+      for(unsigned int i=0; i<n; ++i)
+#ifdef WINDOWS
+        value[i] *= (Erfc((x[i]-hi)/c)-Erfc((x[i]-lo)/c))/2.0;
+#else
+        value[i] *= (erfc((x[i]-hi)/c)-erfc((x[i]-lo)/c))/2.0;
+#endif
+    }
+    else
+    {
+      // d is the distance to [lo, hi], zero inside
+      for(unsigned int i=0; i<n; ++i)
+      {
+        const double d = std::min(x[i]-lo, 0.0) + std::max(x[i]-hi, 0.0);
+        value[i] *= exp(-d*d/(c*c));
+      }
+    }
+  }
+
+}
+
+
+//------------------------------------------------------------------
+
+
+void DopingFunction::profile(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &z,
+                             std::vector<double> &value)
+{
+  const unsigned int n = x.size();
+  value.assign(n, 0.0);
+
+  // reject the points outside bounding box
+  Point bmin, bmax;
+  const bool bounded = this->bounding_box(bmin, bmax);
+
+  std::vector<unsigned int> index;
+  index.reserve(n);
+  for(unsigned int i=0; i<n; ++i)
+  {
+    if( bounded && ( x[i] < bmin.x() || x[i] > bmax.x() ||
+                     y[i] < bmin.y() || y[i] > bmax.y() ||
+                     z[i] < bmin.z() || z[i] > bmax.z() ) ) continue;
+    index.push_back(i);
+  }
+  if( index.empty() ) return;
+
+  const unsigned int m = index.size();
+  std::vector<double> bx(m), by(m), bz(m), bv(m, 0.0);
+  for(unsigned int k=0; k<m; ++k)
+  {
+    bx[k] = x[index[k]];
+    by[k] = y[index[k]];
+    bz[k] = z[index[k]];
+  }
+
+  // the cost of mask profiles varies from point to point, small blocks are scheduled dynamically.
+  // each block writes its own range, the result does not depend on the number of threads
+  const unsigned int block_size = 256;
+  const int n_blocks = (m + block_size - 1)/block_size;
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+#endif
+  for(int b=0; b<n_blocks; ++b)
+  {
+    const unsigned int begin = b*block_size;
+    const unsigned int end = std::min(begin + block_size, m);
+    this->_profile(&bx[begin], &by[begin], &bz[begin], end - begin, &bv[begin]);
+  }
+
+  for(unsigned int k=0; k<m; ++k)
+    value[index[k]] = bv[k];
+}
+
+
+void DopingFunction::_profile(const double *x, const double *y, const double *z, unsigned int n, double *value)
+{
+  for(unsigned int i=0; i<n; ++i)
+    value[i] = this->profile(x[i], y[i], z[i]);
+}
+
+
 //------------------------------------------------------------------
 
 double UniformDopingFunction::profile(double x,double y,double z)
@@ -22,6 +123,14 @@ double UniformDopingFunction::profile(double x,double y,double z)
 }
 
 
+bool UniformDopingFunction::bounding_box(Point &min, Point &max) const
+{
+  min = Point(_xmin-1e-6*um, _ymin-1e-6*um, _zmin-1e-6*um);
+  max = Point(_xmax+1e-6*um, _ymax+1e-6*um, _zmax+1e-6*um);
+  return true;
+}
+
+
 //------------------------------------------------------------------
 
 
@@ -54,6 +163,14 @@ double LinearDopingFunction::profile(double x,double y,double z)
 }
 
 
+bool LinearDopingFunction::bounding_box(Point &min, Point &max) const
+{
+  min = Point(_xmin-1e-6*um, _ymin-1e-6*um, _zmin-1e-6*um);
+  max = Point(_xmax+1e-6*um, _ymax+1e-6*um, _zmax+1e-6*um);
+  return true;
+}
+
+
 //------------------------------------------------------------------
 
 /**
@@ -114,6 +231,28 @@ double AnalyticDopingFunction::profile(double x, double y, double z)
 }
 
 
+/**
+ * exp(-36) and erfc(6) are both below 1e-15
+ */
+bool AnalyticDopingFunction::bounding_box(Point &min, Point &max) const
+{
+  min = Point(_xmin-6*_XCHAR, _ymin-6*_YCHAR, _zmin-6*_ZCHAR);
+  max = Point(_xmax+6*_XCHAR, _ymax+6*_YCHAR, _zmax+6*_ZCHAR);
+  return true;
+}
+
+
+void AnalyticDopingFunction::_profile(const double *x, const double *y, const double *z, unsigned int n, double *value)
+{
+  for(unsigned int i=0; i<n; ++i)
+    value[i] = _ion*_peak;
+
+  analytic_axis_factor(x, n, _xmin, _xmax, _XCHAR, _XERFC, value);
+  analytic_axis_factor(y, n, _ymin, _ymax, _YCHAR, _YERFC, value);
+  analytic_axis_factor(z, n, _zmin, _zmax, _ZCHAR, _ZERFC, value);
+}
+
+
 //------------------------------------------------------------------
 
 PolyMaskDopingFunction::PolyMaskDopingFunction(double ion, const std::vector<Point> &poly, double theta, double phi,
@@ -126,6 +265,53 @@ PolyMaskDopingFunction::PolyMaskDopingFunction(double ion, const std::vector<Poi
     // doping line direction
   double deg = 3.14159265359/180.0;
   _dir = Point( sin(theta*deg)*cos(phi*deg), cos(theta*deg), sin(theta*deg)*sin(phi*deg));
+
+  // doping bounding box. a doped point is p = q + r*_dir, q on the mask plane is inside the 5*_char_lateral
+  // window around the mask mesh (in the projected coordinates a, b) and r in [_rmin, _rmax] +- 5*_char_lateral.
+  // the window is lifted to the mask plane by its corners, then swept along the doping line
+  {
+    const Plane mask_plane = _mask_mesh.plane();
+    const Point & pp = mask_plane.point();
+    const Point & pn = mask_plane.normal();
+
+    // the projected axis is the dominant axis of plane normal, the same as PolygonUSample
+    unsigned int c = 0;
+    for(unsigned int d=1; d<3; ++d)
+      if( std::abs(pn(d)) >= std::abs(pn(c)) ) c = d;
+    const unsigned int a = (c+1)%3;
+    const unsigned int b = (c+2)%3;
+
+    const double margin = 5*_char_lateral + 2*_char_lateral/_resolution_factor;
+    double amin = poly[0](a), amax = poly[0](a), bmin = poly[0](b), bmax = poly[0](b);
+    for(unsigned int n=1; n<poly.size(); ++n)
+    {
+      amin = std::min(amin, poly[n](a));  amax = std::max(amax, poly[n](a));
+      bmin = std::min(bmin, poly[n](b));  bmax = std::max(bmax, poly[n](b));
+    }
+    amin -= margin;  amax += margin;
+    bmin -= margin;  bmax += margin;
+
+    const double r0 = _rmin - 5*_char_lateral;
+    const double r1 = _rmax + 5*_char_lateral;
+
+    for(unsigned int k=0; k<4; ++k)
+    {
+      Point q;
+      q(a) = (k & 1) ? amax : amin;
+      q(b) = (k & 2) ? bmax : bmin;
+      q(c) = pp(c) - (pn(a)*(q(a)-pp(a)) + pn(b)*(q(b)-pp(b)))/pn(c);
+
+      const Point q0 = q + _dir*r0;
+      const Point q1 = q + _dir*r1;
+      for(unsigned int d=0; d<3; ++d)
+      {
+        const double lo = std::min(q0(d), q1(d));
+        const double hi = std::max(q0(d), q1(d));
+        _doping_min(d) = k==0 ? lo : std::min(_doping_min(d), lo);
+        _doping_max(d) = k==0 ? hi : std::max(_doping_max(d), hi);
+      }
+    }
+  }
 }
 
 
@@ -260,6 +446,37 @@ void RecMaskDopingFunction::_init(double xmin, double xmax, double ymin, double
 
 
 
+bool RecMaskDopingFunction::bounding_box(Point &min, Point &max) const
+{
+  // the axis normal to mask
+  unsigned int n;
+  if( _mask.is_xy_plane() )      n = 2;
+  else if( _mask.is_xz_plane() ) n = 1;
+  else if( _mask.is_yz_plane() ) n = 0;
+  else return false;
+
+  if( std::abs(_dir(n)) < 1e-10 ) return false;
+
+  // a doped point is p = q + s*_dir, q on the mask plane is inside the mask extended by 5*_char_depth,
+  // and the normal coordinate of p inside the doping range gives the range of s
+  const double s0 = (_doping_min(n) - _mask.point()(n))/_dir(n);
+  const double s1 = (_doping_max(n) - _mask.point()(n))/_dir(n);
+  for(unsigned int d=0; d<3; ++d)
+  {
+    if( d == n )
+    {
+      min(d) = _doping_min(d);
+      max(d) = _doping_max(d);
+      continue;
+    }
+    min(d) = _mask_min(d) - 5*_char_depth + std::min(_dir(d)*s0, _dir(d)*s1) - 1e-6*um;
+    max(d) = _mask_max(d) + 5*_char_depth + std::max(_dir(d)*s0, _dir(d)*s1) + 1e-6*um;
+  }
+  return true;
+}
+
+
+
 double RecMaskDopingFunction::profile(double x, double y, double z)
 {
   Point p(x,y,z);
@@ -184,6 +184,8 @@ void MoleAnalytic::set_mole_function_file(const Parser::Card & c)
 
   interpolatorX->set_interpolation_type(0, InterpolationBase::Linear);
   interpolatorY->set_interpolation_type(0, InterpolationBase::Linear);
+  interpolatorX->set_cache_directory(c.get_string("interpolation.cache", ""));
+  interpolatorY->set_cache_directory(c.get_string("interpolation.cache", ""));
 
   Point p;
   double moleX, moleY;
@@ -97,7 +97,7 @@ void MetalSimulationRegion::Poissin_Function(PetscScalar * x, Vec f, InsertMode
   // search all the edges of this region, do integral over control volume...
   const_edge_iterator it = edges_begin();
   const_edge_iterator it_end = edges_end();
-  for(; it!=it_end; ++it)
+  for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
   {
     // fvm_node of node1
     const FVM_Node * fvm_n1 = (*it).first;
@@ -124,7 +124,7 @@ void MetalSimulationRegion::Poissin_Function(PetscScalar * x, Vec f, InsertMode
       PetscScalar E    = (V2-V1)/fvm_n1->distance(fvm_n2);
       PetscScalar eps  = 0.5*(eps1+eps2);
       
-      double S = std::abs(fvm_n1->cv_surface_area(fvm_n2));
+      double S = std::abs(edge_cv_surface_area(edge_index));
 
       // "flux" from node 2 to node 1
       PetscScalar f = mt->basic->CurrentDensity(E, T)*S;
@@ -176,7 +176,7 @@ void MetalSimulationRegion::Poissin_Jacobian(PetscScalar * x, SparseMatrix<Petsc
   // search all the edges of this region, do integral over control volume...
   const_edge_iterator it = edges_begin();
   const_edge_iterator it_end = edges_end();
-  for(; it!=it_end; ++it)
+  for(unsigned int edge_index=0; it!=it_end; ++it, ++edge_index)
   {
     // fvm_node of node1
     const FVM_Node * fvm_n1 = (*it).first;
@@ -209,7 +209,7 @@ void MetalSimulationRegion::Poissin_Jacobian(PetscScalar * x, SparseMatrix<Petsc
       AutoDScalar E    = (V2-V1)/fvm_n1->distance(fvm_n2);
       PetscScalar eps = 0.5*(eps1+eps2);
 
-      double S = std::abs(fvm_n1->cv_surface_area(fvm_n2));
+      double S = std::abs(edge_cv_surface_area(edge_index));
       AutoDScalar f = mt->basic->CurrentDensity(E, T)*S;
 
       // ignore thoese ghost nodes
@@ -35,6 +35,63 @@ using PhysicalUnit::mu0;
 double LightThread::dead_factor = 1e-3;
 
 
+LightThread * LightThread::_new_light(const Point & p, const Point & dir, const Point & E_dir, double wavelength, double init_power, double power) const
+{
+  LightThread * light = _pool ? _pool->create(p, dir, E_dir, wavelength, init_power, power) :
+                        new LightThread(p, dir, E_dir, wavelength, init_power, power);
+  light->path_segment = path_segment;
+  light->path_power   = path_power;
+  return light;
+}
+
+
+
+LightThreadPool::~LightThreadPool()
+{
+  for(unsigned int n=0; n<_lights.size(); ++n)
+    delete _lights[n];
+}
+
+
+LightThread * LightThreadPool::create(const Point & p, const Point & dir, const Point & E_dir, double wavelength, double init_power, double power)
+{
+  if(_free.empty())
+  {
+    LightThread * light = new LightThread(p, dir, E_dir, wavelength, init_power, power);
+    light->_pool = this;
+    _lights.push_back(light);
+    return light;
+  }
+
+  // reuse a released light, the capacity of its intersection result is kept
+  LightThread * light = _free.back();
+  _free.pop_back();
+  light->_p          = p;
+  light->_dir        = dir.unit();
+  light->_E_dir      = E_dir;
+  light->_wavelength = wavelength;
+  light->_init_power = init_power;
+  light->_power      = power;
+  light->hit_elem    = NULL;
+  light->result.hit_points.clear();
+  light->path_segment = -1;
+  light->path_power   = power;
+  return light;
+}
+
+
+LightThread * LightThreadPool::create(const LightThread & l)
+{
+  LightThread * light = this->create(l._p, l._dir, l._E_dir, l._wavelength, l._init_power, l._power);
+  light->hit_elem = l.hit_elem;
+  light->result   = l.result;
+  light->path_segment = l.path_segment;
+  light->path_power   = l.path_power;
+  return light;
+}
+
+
+
 std::vector<double> LightThread::advance_to(const Point & p_end, double a_band, double a_tail, double a_fc)
 {
   const double length = (_p - p_end).size();
@@ -60,7 +117,7 @@ std::vector<double> LightThread::advance_to(const Point & p_end, double a_band,
 LightThread * LightThread::reflection(const Point & in_p, const Point & norm) const
 {
   Point reflect_dir = (_dir-2*(norm.dot(_dir))*norm).unit();
-  return  new LightThread(in_p, reflect_dir, _E_dir, _wavelength, _init_power, _power);
+  return  _new_light(in_p, reflect_dir, _E_dir, _wavelength, _init_power, _power);
 }
 
 #if 0
@@ -130,14 +187,14 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
           _E_dir_reflect = (sqrt(reflect_parallel)*E_parallel_reflect - sqrt(reflect_perpendicular)*E_perpendicular).unit(true);
         else
           _E_dir_reflect = (sqrt(reflect_parallel)*E_parallel_reflect + sqrt(reflect_perpendicular)*E_perpendicular).unit(true);
-        reflect_light = new LightThread(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, reflect_eff*_power);
+        reflect_light = _new_light(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, reflect_eff*_power);
       }
 
       if( refract_eff >=1e-9 )
       {
         Point E_parallel_refract = E_parallel.size()*B_perpendicular.cross(refract_dir);
         Point _E_dir_refract = (sqrt(refract_parallel)*E_parallel_refract + sqrt(refract_perpendicular)*E_perpendicular).unit(true);
-        refract_light = new LightThread(in_p, refract_dir, _E_dir_refract, _wavelength, _init_power, refract_eff*_power);
+        refract_light = _new_light(in_p, refract_dir, _E_dir_refract, _wavelength, _init_power, refract_eff*_power);
       }
 
       return std::make_pair(reflect_light, refract_light);
@@ -145,7 +202,7 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
     else //for full reflection
     {
       Point _E_dir_reflect = (reflect_dir.cross(incident_plane.unit_normal()) + E_perpendicular).unit(true);
-      LightThread * reflect_light = new LightThread(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, _power);
+      LightThread * reflect_light = _new_light(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, _power);
 
       return std::make_pair(reflect_light, (LightThread *)0);
     }
@@ -155,8 +212,8 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
     double reflect_eff = (n-1)*(n-1)/((n+1)*(n+1));
     double refract_eff = 4*n/((n+1)*(n+1));
 
-    LightThread * reflect_light = new LightThread(in_p, -_dir, -_E_dir, _wavelength, _init_power, reflect_eff*_power);
-    LightThread * refract_light = new LightThread(in_p,  _dir,  _E_dir, _wavelength, _init_power, refract_eff*_power);
+    LightThread * reflect_light = _new_light(in_p, -_dir, -_E_dir, _wavelength, _init_power, reflect_eff*_power);
+    LightThread * refract_light = _new_light(in_p,  _dir,  _E_dir, _wavelength, _init_power, refract_eff*_power);
 
     return std::make_pair(reflect_light, refract_light);
   }
@@ -244,14 +301,14 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
         Point _E_dir_reflect;
         Point E_parallel_reflect = E_parallel.size()*B_perpendicular.cross(reflect_dir);
         _E_dir_reflect = (reflect_parallel*E_parallel_reflect + reflect_perpendicular*E_perpendicular).unit(true);
-        reflect_light = new LightThread(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, reflect_eff*_power);
+        reflect_light = _new_light(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, reflect_eff*_power);
       }
 
       if( refract_eff >=1e-9 )
       {
         Point E_parallel_refract = E_parallel.size()*B_perpendicular.cross(refract_dir);
         Point _E_dir_refract = (refract_parallel*E_parallel_refract + refract_perpendicular*E_perpendicular).unit(true);
-        refract_light = new LightThread(in_p, refract_dir, _E_dir_refract, _wavelength, _init_power, refract_eff*_power);
+        refract_light = _new_light(in_p, refract_dir, _E_dir_refract, _wavelength, _init_power, refract_eff*_power);
       }
 
 
@@ -261,7 +318,7 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
     {
       Point E_parallel_reflect = E_parallel.size()*B_perpendicular.cross(reflect_dir);
       Point _E_dir_reflect = (E_parallel_reflect + E_perpendicular).unit(true);
-      LightThread * reflect_light = new LightThread(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, _power);
+      LightThread * reflect_light = _new_light(in_p, reflect_dir, _E_dir_reflect, _wavelength, _init_power, _power);
 
       return std::make_pair(reflect_light, (LightThread *)0);
     }
@@ -271,8 +328,8 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
     double reflect_eff = (n-1)*(n-1)/((n+1)*(n+1));
     double refract_eff = 4*n/((n+1)*(n+1));
 
-    LightThread * reflect_light = new LightThread(in_p, -_dir, -_E_dir, _wavelength, _init_power, reflect_eff*_power);
-    LightThread * refract_light = new LightThread(in_p,  _dir,  _E_dir, _wavelength, _init_power, refract_eff*_power);
+    LightThread * reflect_light = _new_light(in_p, -_dir, -_E_dir, _wavelength, _init_power, reflect_eff*_power);
+    LightThread * refract_light = _new_light(in_p,  _dir,  _E_dir, _wavelength, _init_power, refract_eff*_power);
 
     return std::make_pair(reflect_light, refract_light);
   }
@@ -397,10 +454,10 @@ std::pair<LightThread *, LightThread *> LightThread::_interface_light_gen_linear
   //std::cout<<"COFF " << R_TE << " " << R_TM << " " << T_TE << " " << T_TM << std::endl;
 
   if( reflect_power > 1e-10*_power )
-    reflect_light = new LightThread(in_p, reflect_dir, E_dir_reflect, _wavelength, _init_power, reflect_power);
+    reflect_light = _new_light(in_p, reflect_dir, E_dir_reflect, _wavelength, _init_power, reflect_power);
 
   if( refract_power > 1e-10*_power )
-    refract_light = new LightThread(in_p, refract_dir, E_dir_refract, _wavelength, _init_power, refract_power);
+    refract_light = _new_light(in_p, refract_dir, E_dir_refract, _wavelength, _init_power, refract_power);
 
   return std::make_pair(reflect_light, refract_light);
 }
@@ -0,0 +1,122 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+
+#include "ray_tracing/ray_path.h"
+
+
+void RayPath::clear()
+{
+  ray_segment_offset.assign(1, 0);
+  ray_leak_offset.assign(1, 0);
+  seg_elem.clear();
+  seg_length.clear();
+  seg_parent.clear();
+  seg_factor.clear();
+  seg_target_offset.assign(1, 0);
+  target_elem.clear();
+  target_weight.clear();
+  leak_parent.clear();
+  leak_factor.clear();
+  leak_escape.clear();
+}
+
+
+int RayPath::add_segment(unsigned int elem, double length, int parent, double factor)
+{
+  seg_elem.push_back(elem);
+  seg_length.push_back(length);
+  seg_parent.push_back(parent);
+  seg_factor.push_back(factor);
+  seg_target_offset.push_back(target_elem.size());
+  return static_cast<int>(seg_elem.size() - ray_segment_offset.back()) - 1;
+}
+
+
+void RayPath::add_target(unsigned int elem, double weight)
+{
+  target_elem.push_back(elem);
+  target_weight.push_back(weight);
+  seg_target_offset.back() = target_elem.size();
+}
+
+
+void RayPath::add_leak(int parent, double factor, bool escape)
+{
+  leak_parent.push_back(parent);
+  leak_factor.push_back(factor);
+  leak_escape.push_back(escape ? 1 : 0);
+}
+
+
+void RayPath::end_ray()
+{
+  ray_segment_offset.push_back(seg_elem.size());
+  ray_leak_offset.push_back(leak_parent.size());
+}
+
+
+void RayPath::append(const RayPath & other)
+{
+  const unsigned int seg_base    = seg_elem.size();
+  const unsigned int leak_base   = leak_parent.size();
+  const unsigned int target_base = target_elem.size();
+
+  for(unsigned int k=1; k<other.ray_segment_offset.size(); ++k)
+  {
+    ray_segment_offset.push_back(seg_base + other.ray_segment_offset[k]);
+    ray_leak_offset.push_back(leak_base + other.ray_leak_offset[k]);
+  }
+
+  seg_elem.insert(seg_elem.end(), other.seg_elem.begin(), other.seg_elem.end());
+  seg_length.insert(seg_length.end(), other.seg_length.begin(), other.seg_length.end());
+  seg_parent.insert(seg_parent.end(), other.seg_parent.begin(), other.seg_parent.end());
+  seg_factor.insert(seg_factor.end(), other.seg_factor.begin(), other.seg_factor.end());
+  for(unsigned int s=1; s<other.seg_target_offset.size(); ++s)
+    seg_target_offset.push_back(target_base + other.seg_target_offset[s]);
+
+  target_elem.insert(target_elem.end(), other.target_elem.begin(), other.target_elem.end());
+  target_weight.insert(target_weight.end(), other.target_weight.begin(), other.target_weight.end());
+
+  leak_parent.insert(leak_parent.end(), other.leak_parent.begin(), other.leak_parent.end());
+  leak_factor.insert(leak_factor.end(), other.leak_factor.begin(), other.leak_factor.end());
+  leak_escape.insert(leak_escape.end(), other.leak_escape.begin(), other.leak_escape.end());
+}
+
+
+const RayPath * RayPathCache::path(double wavelength, const std::vector<double> & refractive_index, unsigned int n_rays) const
+{
+  std::map<double, CachedPath>::const_iterator it = _paths.find(wavelength);
+  if( it == _paths.end() ) return 0;
+  if( it->second.path.n_rays() != n_rays ) return 0;
+  // geometry of refraction/reflection changed
+  if( it->second.refractive_index != refractive_index ) return 0;
+  return &(it->second.path);
+}
+
+
+void RayPathCache::set_path(double wavelength, const std::vector<double> & refractive_index, RayPath & path)
+{
+  CachedPath & cached_path = _paths[wavelength];
+  cached_path.refractive_index = refractive_index;
+  cached_path.path = path;
+  path.clear();
+}
@@ -19,9 +19,11 @@
 /*                                                                              */
 /********************************************************************************/
 
-#include <stack>
 #include <iomanip>
 #include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
 
 
 #include "sphere.h"
@@ -37,6 +39,7 @@
 #include "ray_tracing/anti_reflection_coating.h"
 #include "parallel.h"
 #include "expr_evaluate.h"
+#include "threads.h"
 
 #define DEBUG
 
@@ -53,8 +56,48 @@ using PhysicalUnit::h;
 using PhysicalUnit::W;
 
 
+namespace
+{
+  // 32bit integer hash
+  inline unsigned int hash_uint(unsigned int x)
+  {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+  }
+
+  // uniform random number in [0, 1) determined by (seed, a, b)
+  inline double hash_uniform(unsigned int seed, unsigned int a, unsigned int b)
+  {
+    return hash_uint(hash_uint(hash_uint(seed) ^ a) ^ b)/4294967296.0;
+  }
+
+  // radical inverse of i in given base, the Halton sequence
+  inline double radical_inverse(unsigned int i, unsigned int base)
+  {
+    double inv_base = 1.0/base;
+    double f = inv_base;
+    double r = 0.0;
+    for(; i>0; i/=base, f*=inv_base)
+      r += f*(i%base);
+    return r;
+  }
+
+  // false for NaN and Inf
+  inline bool is_finite(double x)
+  {
+    return std::abs(x) <= std::numeric_limits<double>::max();
+  }
+}
+
+
 RayTraceSolver::RayTraceSolver(SimulationSystem & system, const Parser::Card & c)
-  : SolverBase(system), _card(c), surface_elem_tree(0),
+  : SolverBase(system), _card(c), surface_elem_tree(0), _path_cache(0), _ray_packet(false), _ray_packet_tol(0.0),
+   _adaptive(false), _adaptive_quasi_random(true), _adaptive_seed(0), _adaptive_tol(0.0), _adaptive_max_rounds(0),
+   _adaptive_coarsen(1), _adaptive_error(0.0), _adaptive_rays(0),
    _incident_power(0.0), _pass_power(0.0), _escape_power(0.0), _absorb_power(0.0)
 {
   system.record_active_solver(this->solver_type());
@@ -78,10 +121,32 @@ int RayTraceSolver::create_solver()
   build_anti_reflection_coating_surface_map();
   build_elem_carrier_density();
   // parse input deck
+  _adaptive              = _card.get_bool("ray.adaptive", false);
+  _adaptive_quasi_random = !_card.is_enum_value("ray.sampling", "jitter");
+  _adaptive_seed         = static_cast<unsigned int>(_card.get_int("ray.seed", 0));
+  _adaptive_tol          = _card.get_real("ray.tol", 1e-2);
+  _adaptive_max_rounds   = std::max(1, _card.get_int("ray.adaptive.rounds", 8));
+  _adaptive_coarsen      = std::max(1, _card.get_int("ray.adaptive.coarsen", 4));
+
   define_lenses();
   create_rays();
 
-  MESSAGE<< _total_rays <<" rays for each wave length."<<std::endl;
+  // spectral packet, the path depends on wavelength by anti reflection coating.
+  // the sample rays of adaptive sampling differ for each wavelength, no packet either
+  _ray_packet     = _card.get_bool("ray.packet", false) && _optical_sources.size() > 1 && _arc_surface.empty() && !_adaptive;
+  _ray_packet_tol = _card.get_real("ray.packet.tol", 1e-2);
+
+  // for the same reason, the paths of adaptive sampling are not cached
+  if(_adaptive && _path_cache)
+  {
+    MESSAGE<<"\nWarning: ray.cache has no effect with ray.adaptive, the ray paths are traced each time.\n";
+    RECORD();
+  }
+
+  if(_adaptive)
+    MESSAGE<< _total_rays <<" strata for adaptive ray sampling."<<std::endl;
+  else
+    MESSAGE<< _total_rays <<" rays for each wave length."<<std::endl;
   RECORD();
 
   return 0;
@@ -95,6 +160,24 @@ int RayTraceSolver::solve()
   ExprEvalute * grating_expr_eva = 0;
   if(!_grating_expr.empty()) grating_expr_eva = new ExprEvalute(_grating_expr);
 
+  // the ray start points do not depend on wavelength, evaluate the grating of all the rays once
+  std::vector<double> grating_factor;
+  if(grating_expr_eva && !_adaptive)
+  {
+    unsigned int n_on_processor_rays = _wave_plane.n_on_processor_rays();
+    std::vector<double> ox(n_on_processor_rays), oy(n_on_processor_rays), oz(n_on_processor_rays);
+    for(unsigned int k=0; k<n_on_processor_rays; ++k)
+    {
+      Point offset = _wave_plane.ray_start_point(k) - _wave_plane.center;
+      ox[k] = offset.x();
+      oy[k] = offset.y();
+      oz[k] = offset.z();
+    }
+    grating_factor.resize(n_on_processor_rays);
+    if(n_on_processor_rays)
+      grating_expr_eva->eval(n_on_processor_rays, &ox[0], &oy[0], &oz[0], 0.0, &grating_factor[0]);
+  }
+
   // for each wavelentgh
   for(unsigned int n=0; n<_optical_sources.size(); ++n)
   {
@@ -103,6 +186,7 @@ int RayTraceSolver::solve()
     double power     = _dim==2 ? intensity*_wave_plane.min_dist : intensity*_wave_plane.ray_area();
 
     build_elem_refractive_index(lamda);
+    build_elem_free_carrier_absorption(lamda);
 
     // clear and re-create the array to record energy deposition
     _band_absorption_energy_in_elem.clear();
@@ -114,47 +198,87 @@ int RayTraceSolver::solve()
     MESSAGE<< "  process light of " /*<< std::setiosflags(std::ios::fixed)*/  << lamda/um << " um";
     RECORD();
 
-    //process all the rays
-    unsigned int n_on_processor_rays = _wave_plane.n_on_processor_rays();
-    for(unsigned int k=0; k<n_on_processor_rays; ++k)
+    if(_adaptive)
+    {
+      RayTraceAccumulator acc(_system.mesh().n_elem());
+      adaptive_sampling(lamda, intensity, grating_expr_eva, acc);
+      merge_accumulator(acc);
+    }
+    else
     {
-      double ray_power = power;
-      if(grating_expr_eva)
+      // create all the rays first, lenses are evaluated in serial
+      unsigned int n_on_processor_rays = _wave_plane.n_on_processor_rays();
+      std::vector<LightThread *> rays(n_on_processor_rays, static_cast<LightThread *>(0));
+      for(unsigned int k=0; k<n_on_processor_rays; ++k)
       {
-        Point offset = _wave_plane.ray_start_point(k) - _wave_plane.center;
-        ray_power *= grating_expr_eva->eval(offset.x(), offset.y(), offset.z(), 0.0);
+        double ray_power = power;
+        if(grating_expr_eva)
+          ray_power *= grating_factor[k];
+
+        // create ray
+        LightThread * light = new  LightThread(_wave_plane.ray_start_point(k),
+                                               _wave_plane.norm,
+                                               _wave_plane.E_dir,
+                                               lamda,
+                                               ray_power,
+                                               ray_power
+                                              );
+
+        if(!_lenses->empty())
+          light = (*_lenses) << light;
+
+        rays[k] = light;
       }
 
-      // create ray
-      LightThread * light = new  LightThread(_wave_plane.ray_start_point(k),
-                                             _wave_plane.norm,
-                                             _wave_plane.E_dir,
-                                             lamda,
-                                             ray_power,
-                                             ray_power
-                                            );
-
-      if(!_lenses->empty())
+      // the ray paths recorded before can be used when refraction geometry not changed,
+      // only the attenuation along the path is recomputed
+      const RayPath * cached_path = 0;
+      std::vector<double> refractive_index_re;
+      if(_path_cache || _ray_packet)
       {
-        light = (*_lenses) << light;
-        if(!light) continue;
+        refractive_index_re.resize(_elem_refractive_index.size());
+        for(unsigned int e=0; e<_elem_refractive_index.size(); ++e)
+          refractive_index_re[e] = _elem_refractive_index[e].real();
       }
+      if(_path_cache)
+        cached_path = _path_cache->path(lamda, refractive_index_re, n_on_processor_rays);
 
-      // call function ray_tracing to process a single ray
-      ray_tracing(light);
+      // spectral packet: wavelengths with nearly the same refractive index share the path
+      // traced by the first wavelength of the packet
+      if(_ray_packet && !cached_path && is_in_ray_packet(refractive_index_re, n_on_processor_rays))
+        cached_path = &_packet_path;
 
-      //indicator
-      if(k%(1+(n_on_processor_rays)/20)==0) // +1 for prevent divide by zero error
+      const bool record_path = (_path_cache || _ray_packet) && !cached_path;
+
+      // process all the rays
+      RayTraceAccumulator acc(_system.mesh().n_elem());
+      RayPath path;
+      trace_rays(rays, true, cached_path, record_path ? &path : 0, acc);
+      merge_accumulator(acc);
+
+      if(record_path)
       {
-        MESSAGE<< ".";
-        RECORD();
+        // this wavelength starts a new packet
+        if(_ray_packet)
+        {
+          _packet_path = path;
+          _packet_refractive_index = refractive_index_re;
+        }
+
+        if(_path_cache)
+          _path_cache->set_path(lamda, refractive_index_re, path);
       }
-#if defined(HAVE_FENV_H) && defined(DEBUG)
-      genius_assert( !fetestexcept(FE_INVALID) );
-#endif
 
+      for(unsigned int k=0; k<n_on_processor_rays; ++k)
+        delete rays[k];
     }
 
+#ifdef DEBUG
+    // the rays are traced by the threads, the FP exception flags of this thread tell nothing. check the results instead
+    for(unsigned int e=0; e<_total_absorption_energy_in_elem.size(); ++e)
+      genius_assert( is_finite(_band_absorption_energy_in_elem[e]) && is_finite(_total_absorption_energy_in_elem[e]) );
+#endif
+
 
     // gather energy deposit from all the processors
     Parallel::sum(_band_absorption_energy_in_elem);
@@ -168,11 +292,14 @@ int RayTraceSolver::solve()
   }
 
 
+  _packet_path.clear();
+  _packet_refractive_index.clear();
+
   statistic();
 
 
-#if defined(HAVE_FENV_H) && defined(DEBUG)
-  genius_assert( !fetestexcept(FE_INVALID) );
+#ifdef DEBUG
+  genius_assert( is_finite(_incident_power) && is_finite(_pass_power) && is_finite(_escape_power) && is_finite(_absorb_power) );
 #endif
 
 #if defined(HAVE_FENV_H)
@@ -375,28 +502,41 @@ void RayTraceSolver::create_rays()
       d2 = dir.cross(d1);
     }
 
+    // the distance between rays, or the stratum size for adaptive sampling
+    const double dist = _adaptive ? _adaptive_coarsen*_wave_plane.min_dist : _wave_plane.min_dist;
+    _wave_plane.stratum_size = dist;
+    _wave_plane.d1 = d1;
+    _wave_plane.d2 = d2;
+
     // how many rays in one of the direction
-    int n_rays_half = int(ceil(_wave_plane.R/_wave_plane.min_dist));
+    int n_rays_half = int(ceil(_wave_plane.R/dist));
 
     unsigned int count=0;
     for(int i=-n_rays_half; i<=n_rays_half; ++i)
       for(int j=-n_rays_half; j<=n_rays_half; ++j)
       {
+        const unsigned int index = count;
         if(Genius::processor_id() != (count++)%Genius::n_processors()) continue;
 
-        Point s = _wave_plane.center + i*_wave_plane.min_dist*d1 + j*_wave_plane.min_dist*d2;
+        Point s = _wave_plane.center + i*dist*d1 + j*dist*d2;
         // limit the ray start point inside the radius
         if( (s - _wave_plane.center).size() > _wave_plane.R ) continue;
 
+        bool hit = true;
         if(_lenses->empty())
         {
-          //skip rays not hit the boundbox of surface_elem_tree
-          if(surface_elem_tree->hit_boundbox(s, dir))
-            _wave_plane.ray_start_points.push_back(s);
-        }else
+          //skip rays not hit the boundbox of surface_elem_tree, a stratum is skipped
+          //only when the rays from its center and corners all miss the boundbox
+          hit = surface_elem_tree->hit_boundbox(s, dir);
+          for(unsigned int c=0; _adaptive && !hit && c<4; ++c)
+            hit = surface_elem_tree->hit_boundbox(s + (c%2 ? 0.5 : -0.5)*dist*d1 + (c/2 ? 0.5 : -0.5)*dist*d2, dir);
+        }
+        // no optimize when lens exist
+
+        if(hit)
         {
-          // no optimize when lens exist
           _wave_plane.ray_start_points.push_back(s);
+          if(_adaptive) _wave_plane.stratum_index.push_back(index);
         }
       }
     _dim = 3;
@@ -408,29 +548,49 @@ void RayTraceSolver::create_rays()
     const Point z_axis(0,0,1);
     Point d = dir.cross(z_axis);
 
-    int n_rays_half = int(ceil(_wave_plane.R/_wave_plane.min_dist));
+    const double dist = _adaptive ? _adaptive_coarsen*_wave_plane.min_dist : _wave_plane.min_dist;
+    _wave_plane.stratum_size = dist;
+    _wave_plane.d1 = d;
+    _wave_plane.d2 = Point(0, 0, 0);
+
+    int n_rays_half = int(ceil(_wave_plane.R/dist));
 
     unsigned int count=0;
     for(int i=-n_rays_half; i<=n_rays_half; ++i)
     {
+      const unsigned int index = count;
       if(Genius::processor_id() != (count++)%Genius::n_processors()) continue;
 
-      Point s = _wave_plane.center + i*_wave_plane.min_dist*d;
+      Point s = _wave_plane.center + i*dist*d;
+
+      bool hit = true;
       if(_lenses->empty())
       {
         //skip rays not hit the boundbox of surface_elem_tree
-        if(surface_elem_tree->hit_boundbox(s, dir))
-          _wave_plane.ray_start_points.push_back(s);
-      }else
+        hit = surface_elem_tree->hit_boundbox(s, dir);
+        for(unsigned int c=0; _adaptive && !hit && c<2; ++c)
+          hit = surface_elem_tree->hit_boundbox(s + (c ? 0.5 : -0.5)*dist*d, dir);
+      }
+      // no optimize when lens exist
+
+      if(hit)
       {
-        // no optimize when lens exist
         _wave_plane.ray_start_points.push_back(s);
+        if(_adaptive) _wave_plane.stratum_index.push_back(index);
       }
     }
 
     _dim = 2;
   }
 
+  // the first hit of all the rays, traced in batch
+  _wave_plane.ray_first_hit.clear();
+  if(_lenses->empty() && !_adaptive)
+  {
+    std::vector<Point> ray_dirs(_wave_plane.ray_start_points.size(), dir);
+    surface_elem_tree->hit(_wave_plane.ray_start_points, ray_dirs, _wave_plane.ray_first_hit);
+  }
+
   // compute start point on all the processors
   _total_rays = _wave_plane.ray_start_points.size();
   Parallel::sum(_total_rays);
@@ -551,6 +711,15 @@ void RayTraceSolver::build_elem_refractive_index(double lambda)
 
   std::map<unsigned int, Complex> r_table;
 
+  // the refraction index of semiconductor depends on the node, its material models are
+  // evaluated by the threads, each with its own material object
+  unsigned int n_threads = Threads::n_threads();
+  for(unsigned int r=0; r<_system.n_regions(); ++r)
+    if( _system.region(r)->type() == SemiconductorRegion )
+      n_threads = std::min(n_threads, _system.region(r)->prepare_material_instances(Threads::n_threads()));
+
+  std::vector<const Elem *> semiconductor_elems;
+
   const MeshBase & mesh = _system.mesh();
   MeshBase::const_element_iterator       el  = mesh.elements_begin();
   const MeshBase::const_element_iterator end = mesh.elements_end();
@@ -560,6 +729,11 @@ void RayTraceSolver::build_elem_refractive_index(double lambda)
     if(!elem->on_processor()) continue;
 
     const SimulationRegion * region = _system.region(elem->subdomain_id());
+    if( region->type() == SemiconductorRegion )
+    {
+      semiconductor_elems.push_back(elem);
+      continue;
+    }
 
     Complex r_index;
     for(unsigned int nd = 0; nd < elem->n_nodes(); nd++)
@@ -572,6 +746,35 @@ void RayTraceSolver::build_elem_refractive_index(double lambda)
     r_table.insert( std::make_pair(elem->id(), r_index) );
   }
 
+  std::vector<Complex> semiconductor_index(semiconductor_elems.size());
+#ifdef _OPENMP
+  #pragma omp parallel num_threads(n_threads)
+#endif
+  {
+    const unsigned int tid = Threads::thread_id();
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(int i=0; i<static_cast<int>(semiconductor_elems.size()); ++i)
+    {
+      const Elem * elem = semiconductor_elems[i];
+      const SemiconductorSimulationRegion * region = static_cast<const SemiconductorSimulationRegion *>(_system.region(elem->subdomain_id()));
+
+      Complex r_index;
+      for(unsigned int nd = 0; nd < elem->n_nodes(); nd++)
+      {
+        const FVM_Node * fvm_node = elem->get_fvm_node(nd);
+        r_index += region->get_optical_refraction(fvm_node, lambda, tid);
+      }
+
+      r_index /= elem->n_nodes();
+      semiconductor_index[i] = r_index;
+    }
+  }
+
+  for(unsigned int i=0; i<semiconductor_elems.size(); ++i)
+    r_table.insert( std::make_pair(semiconductor_elems[i]->id(), semiconductor_index[i]) );
+
   Parallel::allgather(r_table);
 
 
@@ -660,6 +863,20 @@ double RayTraceSolver::get_free_carrier_absorption(const Elem* elem, double wave
 }
 
 
+void RayTraceSolver::build_elem_free_carrier_absorption(double lamda)
+{
+  const MeshBase &mesh = _system.mesh();
+  _elem_fc_absorption.clear();
+  _elem_fc_absorption.resize(mesh.n_elem(), 0.0);
+
+  MeshBase::const_element_iterator       el  = mesh.active_elements_begin();
+  const MeshBase::const_element_iterator el_end = mesh.active_elements_end();
+  for (; el != el_end; ++el)
+    _elem_fc_absorption[(*el)->id()] = get_free_carrier_absorption(*el, lamda);
+}
+
+
+
 
 void RayTraceSolver::build_elems_node_map()
 {
@@ -854,14 +1071,15 @@ const Elem * RayTraceSolver::ray_hit(const Point &p, const Point &dir, const Ele
 
 
 
-void RayTraceSolver::ray_tracing(LightThread *ray)
+void RayTraceSolver::ray_tracing(const LightThread *ray, RayTraceAccumulator & acc, LightThreadPool & pool, RayPath * path,
+                                 bool first_hit_known, const Elem * first_hit) const
 {
 
-  // use stack to save all the rays (origin and secondary)
-  std::stack<LightThread *> ray_stack;
-  ray_stack.push(ray);
+  // use stack to save all the rays (origin and secondary), the rays are taken from pool
+  LightThreadStack ray_stack;
+  ray_stack.push(pool.create(*ray));
 
-  _incident_power += ray->power();
+  acc.incident_power += ray->power();
 
   while(!ray_stack.empty())
   {
@@ -873,13 +1091,19 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
     // the ray doesn't hit any elem yet?
     if(current_ray->hit_elem==NULL)
     {
-      // find the first element this ray hit
-      const Elem * elem = surface_elem_tree->hit(current_ray->start_point(), current_ray->dir());
+      // find the first element this ray hit.
+      // the origin ray, which is the first one popped from stack, may know it already
+      const Elem * elem = NULL;
+      if(first_hit_known)
+        elem = first_hit;
+      else
+        elem = surface_elem_tree->hit(current_ray->start_point(), current_ray->dir());
+      first_hit_known = false;
 
       // not hit any elem
       if(elem==NULL)
       {
-        _pass_power+=current_ray->power(); delete current_ray; continue;
+        leak_power(acc, path, current_ray, false); pool.release(current_ray); continue;
       }
 
       current_ray->hit_elem = elem;
@@ -908,7 +1132,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
           unsigned int edge_index = hit_point.mark;
           AutoPtr<Elem> edge = elem->build_edge(edge_index);
           if(_boundary_edge_to_elem_side_map.find(edge.get())==_boundary_edge_to_elem_side_map.end())
-          { _pass_power+=current_ray->power(); delete current_ray; continue;}
+          { leak_power(acc, path, current_ray, false); pool.release(current_ray); continue;}
           hit_elems = _boundary_edge_to_elem_side_map.find(edge.get())->second;
           break;
         }
@@ -917,7 +1141,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
           unsigned int vertex_index = hit_point.mark;
           const Node * current_node = elem->get_node(vertex_index);
           if(_boundary_node_to_elem_side_map.find(current_node)==_boundary_node_to_elem_side_map.end())
-          { _pass_power+=current_ray->power(); delete current_ray; continue;}
+          { leak_power(acc, path, current_ray, false); pool.release(current_ray); continue;}
           hit_elems = _boundary_node_to_elem_side_map.find(current_node)->second;
           break;
         }
@@ -934,7 +1158,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
         Point norm = boundary_elem->outside_unit_normal(side);
         //the surface norm should has a angle >90 degree to ray dir
         if(norm.dot(current_ray->dir()) > -1e-10)
-        { _pass_power+=current_ray->power(); continue; }
+        { leak_power(acc, path, current_ray, false); continue; }
 
         // if reflect surface
         if(is_full_reflect_surface(boundary_elem, side))
@@ -951,14 +1175,14 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
               ray_stack.push(reflect_ray);
             else
             {
-              _escape_power += reflect_ray->power();
-              delete reflect_ray;
+              leak_power(acc, path, reflect_ray, true);
+              pool.release(reflect_ray);
             }
           }
           else
           {
-            _escape_power += reflect_ray->power();
-            delete reflect_ray;
+            leak_power(acc, path, reflect_ray, true);
+            pool.release(reflect_ray);
           }
           continue;
         }
@@ -983,8 +1207,8 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
             ray_stack.push(refract_ray);
           else
           { // the refract ray has already penetrat through the device?
-            _escape_power += refract_ray->power();
-            delete refract_ray;
+            leak_power(acc, path, refract_ray, true);
+            pool.release(refract_ray);
           }
         }
 
@@ -1003,19 +1227,19 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
               ray_stack.push(reflect_ray);
             else
             {
-              _escape_power += reflect_ray->power();
-              delete reflect_ray;
+              leak_power(acc, path, reflect_ray, true);
+              pool.release(reflect_ray);
             }
           }
           else
           {
-            _escape_power += reflect_ray->power();
-            delete reflect_ray;
+            leak_power(acc, path, reflect_ray, true);
+            pool.release(reflect_ray);
           }
         }
       }
 
-      delete current_ray;
+      pool.release(current_ray);
       continue;
     }
 
@@ -1024,7 +1248,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
     if( current_ray->result.hit_points.size() != 2 )
     {
       // FIXME, should not happen...
-      _pass_power += current_ray->power(); delete current_ray; continue;
+      leak_power(acc, path, current_ray, false); pool.release(current_ray); continue;
     }
 
     // calculate energy deposit
@@ -1034,30 +1258,44 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
 
     double a_band = 4*3.14159265358979*this->get_refractive_index_im(elem)/current_ray->wavelength();
     double a_tail = 0.0;
-    double a_fc   = this->get_free_carrier_absorption(elem, current_ray->wavelength());
+    double a_fc   = _elem_fc_absorption[elem->id()];
+
+    const Point  segment_start = current_ray->start_point();
+    const double segment_power = current_ray->power();
 
     std::vector<double> energy_deposit = current_ray->advance_to(end_point.p, a_band, a_tail, a_fc);
     double total_energy_deposit = std::accumulate(energy_deposit.begin(), energy_deposit.end(), 0.0);
-    _absorb_power+= total_energy_deposit;
+    acc.absorb_power+= total_energy_deposit;
+
+    // record the segment, the power relative to parent segment
+    if(path)
+    {
+      double factor = current_ray->path_power > 0.0 ? segment_power/current_ray->path_power : 0.0;
+      current_ray->path_segment = path->add_segment(elem->id(), (end_point.p - segment_start).size(), current_ray->path_segment, factor);
+      current_ray->path_power   = current_ray->power();
+    }
 
     switch(current_ray->result.state)
     {
       // all the energy deposited in this elem
     case Intersect_Body :
-      _band_absorption_energy_in_elem[elem->id()] += energy_deposit[0];
-      _total_absorption_energy_in_elem[elem->id()] += total_energy_deposit;
+      acc.band_absorption_energy_in_elem[elem->id()] += energy_deposit[0];
+      acc.total_absorption_energy_in_elem[elem->id()] += total_energy_deposit;
+      if(path) path->add_target(elem->id(), 1.0);
       break;
       // two elem shares the energy deposite
     case On_Face        :
       {
-        _band_absorption_energy_in_elem[elem->id()] += 0.5*energy_deposit[0];
-        _total_absorption_energy_in_elem[elem->id()] += 0.5*total_energy_deposit;
+        acc.band_absorption_energy_in_elem[elem->id()] += 0.5*energy_deposit[0];
+        acc.total_absorption_energy_in_elem[elem->id()] += 0.5*total_energy_deposit;
+        if(path) path->add_target(elem->id(), 0.5);
         unsigned int side = current_ray->result.mark;
         const Elem * neighbor = elem->neighbor(side);
         if(neighbor)
         {
-          _band_absorption_energy_in_elem[neighbor->id()] += 0.5*energy_deposit[0];
-          _total_absorption_energy_in_elem[neighbor->id()] += 0.5*total_energy_deposit;
+          acc.band_absorption_energy_in_elem[neighbor->id()] += 0.5*energy_deposit[0];
+          acc.total_absorption_energy_in_elem[neighbor->id()] += 0.5*total_energy_deposit;
+          if(path) path->add_target(neighbor->id(), 0.5);
         }
         break;
       }
@@ -1070,8 +1308,9 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
         assert(elems.size());
         for(unsigned int n=0; n<elems.size(); ++n)
         {
-          _band_absorption_energy_in_elem[elems[n]->id()] += energy_deposit[0]/elems.size();
-          _total_absorption_energy_in_elem[elems[n]->id()] += total_energy_deposit/elems.size();
+          acc.band_absorption_energy_in_elem[elems[n]->id()] += energy_deposit[0]/elems.size();
+          acc.total_absorption_energy_in_elem[elems[n]->id()] += total_energy_deposit/elems.size();
+          if(path) path->add_target(elems[n]->id(), 1.0/elems.size());
         }
         break;
       }
@@ -1081,7 +1320,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
 
 
     if(current_ray->is_dead())
-    { _pass_power += current_ray->power(); delete current_ray; continue; }
+    { leak_power(acc, path, current_ray, false); pool.release(current_ray); continue; }
 
     // safe guard: when the number of rays in stack exceed 1000, we may fall into endless loop
     // force to exit
@@ -1091,8 +1330,8 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
       {
         LightThread * current_ray = ray_stack.top();
         ray_stack.pop();
-        _pass_power += current_ray->power();
-        delete current_ray;
+        leak_power(acc, path, current_ray, false);
+        pool.release(current_ray);
       }
       return;
     }
@@ -1117,7 +1356,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
         {
           // if reflect surface
           if(is_surface(elem, side) && is_full_reflect_surface(elem, side))
-          {  _escape_power += current_ray->power(); delete current_ray; continue; }
+          {  leak_power(acc, path, current_ray, true); pool.release(current_ray); continue; }
 
           Point p = end_point.p;
           Point norm = - elem->outside_unit_normal(side);
@@ -1147,7 +1386,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
             assert(reflect_ray->result.state!=Missed);
             ray_stack.push(reflect_ray);
           }
-          delete current_ray;
+          pool.release(current_ray);
         }
       }
       break;
@@ -1194,11 +1433,11 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
 
             // if reflect surface
             if(is_surface(boundary_elem, side) && is_full_reflect_surface(boundary_elem, side))
-            { _escape_power += current_ray->power();  continue; }
+            { leak_power(acc, path, current_ray, true);  continue; }
 
             Point norm = boundary_elem->outside_unit_normal(side);
             //the surface norm should has a angle >90 degree to ray dir
-            if(norm.dot(current_ray->dir()) > -1e-10) { _escape_power += current_ray->power();  continue; }
+            if(norm.dot(current_ray->dir()) > -1e-10) { leak_power(acc, path, current_ray, true);  continue; }
 
             double n1 = get_refractive_index_re(boundary_elem->neighbor(side));
             double n2 = get_refractive_index_re(boundary_elem);
@@ -1214,8 +1453,8 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
                 ray_stack.push(refract_ray);
               else
               {
-                _escape_power += refract_ray->power();
-                delete refract_ray;
+                leak_power(acc, path, refract_ray, true);
+                pool.release(refract_ray);
               }
             }
 
@@ -1228,13 +1467,13 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
                 ray_stack.push(reflect_ray);
               else
               {
-                _escape_power += reflect_ray->power();
-                delete reflect_ray;
+                leak_power(acc, path, reflect_ray, true);
+                pool.release(reflect_ray);
               }
             }
           }
 
-          delete current_ray;
+          pool.release(current_ray);
         }
       }
       break;
@@ -1242,7 +1481,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
       {
         unsigned int vertex_index = end_point.mark;
         const Node * node = elem->get_node(vertex_index);
-        std::vector<const Elem *> & elems = _elems_shared_this_node[node->id()];
+        const std::vector<const Elem *> & elems = _elems_shared_this_node[node->id()];
         // the node is not on boundary
         if( _boundary_node_to_elem_side_map.find(node)==_boundary_node_to_elem_side_map.end())
         {
@@ -1269,7 +1508,7 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
             effective_faces++;
           }
           if(effective_faces ==0)
-          { _escape_power += current_ray->power(); delete current_ray; continue; }
+          { leak_power(acc, path, current_ray, true); pool.release(current_ray); continue; }
 
           current_ray->power() = current_ray->power()/effective_faces;
 
@@ -1280,11 +1519,11 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
 
             // if reflect surface
             if(is_surface(boundary_elem, side) && is_full_reflect_surface(boundary_elem, side))
-            { _escape_power += current_ray->power(); continue; }
+            { leak_power(acc, path, current_ray, true); continue; }
 
             Point norm = boundary_elem->outside_unit_normal(side);
             //the surface norm should has a angle >90 degree to ray dir
-            if(norm.dot(current_ray->dir()) > -1e-10) { _escape_power += current_ray->power(); continue; }
+            if(norm.dot(current_ray->dir()) > -1e-10) { leak_power(acc, path, current_ray, true); continue; }
 
             double n1 = get_refractive_index_re(boundary_elem->neighbor(side));
             double n2 = get_refractive_index_re(boundary_elem);
@@ -1300,8 +1539,8 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
                 ray_stack.push(refract_ray);
               else
               {
-                _escape_power += refract_ray->power();
-                delete refract_ray;
+                leak_power(acc, path, refract_ray, true);
+                pool.release(refract_ray);
               }
             }
 
@@ -1314,12 +1553,12 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
                 ray_stack.push(reflect_ray);
               else
               {
-                _escape_power += reflect_ray->power();
-                delete reflect_ray;
+                leak_power(acc, path, reflect_ray, true);
+                pool.release(reflect_ray);
               }
             }
           }
-          delete current_ray;
+          pool.release(current_ray);
         }
       }
       break;
@@ -1332,6 +1571,366 @@ void RayTraceSolver::ray_tracing(LightThread *ray)
 
 
 
+bool RayTraceSolver::is_in_ray_packet(const std::vector<double> & refractive_index, unsigned int n_rays) const
+{
+  if( _packet_path.n_rays() != n_rays ) return false;
+  if( _packet_refractive_index.size() != refractive_index.size() ) return false;
+
+  for(unsigned int e=0; e<refractive_index.size(); ++e)
+    if( std::abs(refractive_index[e] - _packet_refractive_index[e]) > _ray_packet_tol*std::abs(_packet_refractive_index[e]) )
+      return false;
+
+  return true;
+}
+
+
+
+void RayTraceSolver::trace_rays(const std::vector<LightThread *> & rays, bool use_first_hit, const RayPath * replay_path,
+                                RayPath * record_path, RayTraceAccumulator & result) const
+{
+  const unsigned int n_rays = rays.size();
+  const bool first_hit = use_first_hit && _wave_plane.has_ray_first_hit();
+
+  const unsigned int n_blocks = Threads::n_threads();
+  std::vector<unsigned int> block_offset;
+  Threads::block_partition(n_rays, n_blocks, block_offset);
+  std::vector<RayTraceAccumulator> accumulators(n_blocks, RayTraceAccumulator(_system.mesh().n_elem()));
+  std::vector<RayPath> block_paths(record_path ? n_blocks : 0);
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static, 1)
+#endif
+  for(int b=0; b<static_cast<int>(n_blocks); ++b)
+  {
+    RayTraceAccumulator & acc = accumulators[b];
+    RayPath * path = record_path ? &block_paths[b] : 0;
+    LightThreadPool pool;
+    std::vector<double> end_power;
+    const unsigned int block_size = block_offset[b+1] - block_offset[b];
+    for(unsigned int k=block_offset[b]; k<block_offset[b+1]; ++k)
+    {
+      if(rays[k])
+      {
+        if(replay_path)
+          ray_replay(*replay_path, k, rays[k]->power(), rays[k]->wavelength(), acc, end_power);
+        // call function ray_tracing to process a single ray
+        else if(first_hit)
+          ray_tracing(rays[k], acc, pool, path, true, _wave_plane.ray_first_hit[k]);
+        else
+          ray_tracing(rays[k], acc, pool, path);
+      }
+
+      if(path) path->end_ray();
+
+      //indicator, by the first block
+      if(b==0 && (k-block_offset[b])%(1+block_size/20)==0) // +1 for prevent divide by zero error
+      {
+        MESSAGE<< ".";
+        RECORD();
+      }
+    }
+  }
+
+  for(unsigned int b=0; b<n_blocks; ++b)
+  {
+    result.add(accumulators[b]);
+    if(record_path)
+      record_path->append(block_paths[b]);
+  }
+}
+
+
+
+Point RayTraceSolver::stratum_sample(unsigned int s, unsigned int m) const
+{
+  const unsigned int index = _wave_plane.stratum_index[s];
+
+  double u, v;
+  if(_adaptive_quasi_random)
+  {
+    // Halton sequence with a random shift for each stratum (Cranley-Patterson rotation)
+    u = radical_inverse(m+1, 2) + hash_uniform(_adaptive_seed, index, 0);
+    v = radical_inverse(m+1, 3) + hash_uniform(_adaptive_seed, index, 1);
+    u -= floor(u);
+    v -= floor(v);
+  }
+  else
+  {
+    // uniform random jitter in the stratum
+    u = hash_uniform(_adaptive_seed, index, 2*m+2);
+    v = hash_uniform(_adaptive_seed, index, 2*m+3);
+  }
+
+  const double size = _wave_plane.stratum_size;
+  return _wave_plane.ray_start_point(s) + (u-0.5)*size*_wave_plane.d1 + (v-0.5)*size*_wave_plane.d2;
+}
+
+
+
+void RayTraceSolver::adaptive_sampling(double lamda, double intensity, ExprEvalute * grating, RayTraceAccumulator & result)
+{
+  const unsigned int n_elem    = _system.mesh().n_elem();
+  const unsigned int n_regions = _system.n_regions();
+  const unsigned int n_strata  = _wave_plane.n_on_processor_rays();
+  const double size = _wave_plane.stratum_size;
+  const double area = _dim==2 ? size : size*size;
+
+  unsigned int n_global_strata = n_strata;
+  Parallel::sum(n_global_strata);
+
+  // each sample ray carries the power of the whole stratum, so its region absorbed power is an
+  // estimate of the stratum. record the sum and square sum of the estimates
+  std::vector<unsigned int> n_samples(n_strata, 0);
+  std::vector<unsigned int> n_new(n_strata, 2); // at least 2 samples to estimate the variance
+  std::vector<double> sum(n_strata*n_regions, 0.0);
+  std::vector<double> sum2(n_strata*n_regions, 0.0);
+
+  // all the sample rays and their paths
+  std::vector<LightThread *> samples;
+  std::vector<unsigned int>  sample_stratum;
+  RayPath sample_paths;
+
+  std::vector<double> region_total(n_regions), region_var(n_regions), region_power(n_regions);
+  std::vector<double> end_power;
+  double error = 0.0;
+
+  for(unsigned int round=0; round<_adaptive_max_rounds; ++round)
+  {
+    // sample points of this round
+    std::vector<Point> ray_start;
+    std::vector<unsigned int> ray_stratum;
+    for(unsigned int s=0; s<n_strata; ++s)
+      for(unsigned int m=0; m<n_new[s]; ++m)
+      {
+        ray_start.push_back(stratum_sample(s, n_samples[s]++));
+        ray_stratum.push_back(s);
+      }
+
+    // grating expression is evaluated for all the sample points together
+    std::vector<double> grating_factor(ray_start.size(), 1.0);
+    if(grating && !ray_start.empty())
+    {
+      std::vector<double> ox(ray_start.size()), oy(ray_start.size()), oz(ray_start.size());
+      for(unsigned int k=0; k<ray_start.size(); ++k)
+      {
+        Point offset = ray_start[k] - _wave_plane.center;
+        ox[k] = offset.x();
+        oy[k] = offset.y();
+        oz[k] = offset.z();
+      }
+      grating->eval(ray_start.size(), &ox[0], &oy[0], &oz[0], 0.0, &grating_factor[0]);
+    }
+
+    // create the rays of this round, lenses are evaluated in serial
+    std::vector<LightThread *> rays;
+    for(unsigned int k=0; k<ray_start.size(); ++k)
+    {
+      double ray_power = intensity*area*grating_factor[k];
+
+      LightThread * light = new LightThread(ray_start[k], _wave_plane.norm, _wave_plane.E_dir, lamda, ray_power, ray_power);
+      if(!_lenses->empty())
+        light = (*_lenses) << light;
+
+      rays.push_back(light);
+    }
+
+    // only the path is kept, the energy deposit is replayed with the final weight of each sample
+    RayTraceAccumulator scratch(n_elem);
+    RayPath path;
+    trace_rays(rays, false, 0, &path, scratch);
+
+    for(unsigned int k=0; k<rays.size(); ++k)
+    {
+      std::fill(region_power.begin(), region_power.end(), 0.0);
+      if(rays[k])
+        ray_region_absorption(path, k, rays[k]->power(), lamda, region_power, end_power);
+
+      const unsigned int s = ray_stratum[k];
+      for(unsigned int r=0; r<n_regions; ++r)
+      {
+        sum[s*n_regions+r]  += region_power[r];
+        sum2[s*n_regions+r] += region_power[r]*region_power[r];
+      }
+    }
+
+    sample_paths.append(path);
+    samples.insert(samples.end(), rays.begin(), rays.end());
+    sample_stratum.insert(sample_stratum.end(), ray_stratum.begin(), ray_stratum.end());
+
+    // region absorbed power is the sum of stratum mean, its variance is the sum of the variance of stratum mean
+    std::fill(region_total.begin(), region_total.end(), 0.0);
+    std::fill(region_var.begin(), region_var.end(), 0.0);
+    for(unsigned int s=0; s<n_strata; ++s)
+      for(unsigned int r=0; r<n_regions; ++r)
+      {
+        const double n = n_samples[s];
+        const double mean = sum[s*n_regions+r]/n;
+        const double var  = std::max(0.0, (sum2[s*n_regions+r] - n*mean*mean)/(n-1));
+        region_total[r] += mean;
+        region_var[r]   += var/n;
+      }
+    Parallel::sum(region_total);
+    Parallel::sum(region_var);
+
+    // relative standard error, regions absorb nearly nothing are not considered
+    const double threshold = 1e-6*(*std::max_element(region_total.begin(), region_total.end()));
+    error = 0.0;
+    for(unsigned int r=0; r<n_regions; ++r)
+      if(region_total[r] > threshold)
+        error = std::max(error, sqrt(region_var[r])/region_total[r]);
+
+    if(error <= _adaptive_tol || round+1 == _adaptive_max_rounds) break;
+
+    // Neyman allocation: as many new rays as strata, each stratum takes rays in proportion
+    // to the relative standard deviation of its estimate. strata that cover flat surface
+    // get no more rays, and strata on textured surface or grating edge are refined
+    std::vector<double> weight(n_strata, 0.0);
+    double weight_sum = 0.0;
+    for(unsigned int s=0; s<n_strata; ++s)
+    {
+      for(unsigned int r=0; r<n_regions; ++r)
+      {
+        if(region_total[r] <= threshold) continue;
+        const double n = n_samples[s];
+        const double mean = sum[s*n_regions+r]/n;
+        const double var  = std::max(0.0, (sum2[s*n_regions+r] - n*mean*mean)/(n-1));
+        weight[s] += sqrt(var)/region_total[r];
+      }
+      weight_sum += weight[s];
+    }
+    Parallel::sum(weight_sum);
+    if(weight_sum <= 0.0) break;
+
+    for(unsigned int s=0; s<n_strata; ++s)
+      n_new[s] = static_cast<unsigned int>(ceil(n_global_strata*weight[s]/weight_sum));
+  }
+
+  // deposit the energy of all the samples, each sample is weighted by 1/(number of samples in its stratum)
+  for(unsigned int k=0; k<samples.size(); ++k)
+    if(samples[k])
+      samples[k]->power() /= n_samples[sample_stratum[k]];
+  trace_rays(samples, false, &sample_paths, 0, result);
+
+  for(unsigned int k=0; k<samples.size(); ++k)
+    delete samples[k];
+
+  unsigned int n_rays = samples.size();
+  Parallel::sum(n_rays);
+
+  _adaptive_rays += n_rays;
+  _adaptive_error = std::max(_adaptive_error, error);
+}
+
+
+
+void RayTraceSolver::leak_power(RayTraceAccumulator & acc, RayPath * path, const LightThread * ray, bool escape) const
+{
+  if(escape)
+    acc.escape_power += ray->power();
+  else
+    acc.pass_power += ray->power();
+
+  if(path)
+    path->add_leak(ray->path_segment, ray->path_power > 0.0 ? ray->power()/ray->path_power : 0.0, escape);
+}
+
+
+
+void RayTraceSolver::ray_replay(const RayPath & path, unsigned int k, double power, double wavelength,
+                                RayTraceAccumulator & acc, std::vector<double> & end_power) const
+{
+  acc.incident_power += power;
+
+  const unsigned int seg_begin = path.ray_segment_offset[k];
+  const unsigned int seg_end   = path.ray_segment_offset[k+1];
+  end_power.resize(seg_end - seg_begin);
+
+  // parent segment is always recorded before its children
+  for(unsigned int s=seg_begin; s<seg_end; ++s)
+  {
+    const int parent = path.seg_parent[s];
+    const double start_power = path.seg_factor[s]*(parent < 0 ? power : end_power[parent]);
+
+    double band_fraction;
+    end_power[s-seg_begin] = start_power*segment_attenuation(path.seg_elem[s], path.seg_length[s], wavelength, band_fraction);
+
+    const double dpower = start_power - end_power[s-seg_begin];
+    const double band_energy_deposit = dpower*band_fraction;
+    acc.absorb_power += dpower;
+
+    for(unsigned int t=path.seg_target_offset[s]; t<path.seg_target_offset[s+1]; ++t)
+    {
+      acc.band_absorption_energy_in_elem[path.target_elem[t]]  += path.target_weight[t]*band_energy_deposit;
+      acc.total_absorption_energy_in_elem[path.target_elem[t]] += path.target_weight[t]*dpower;
+    }
+  }
+
+  for(unsigned int l=path.ray_leak_offset[k]; l<path.ray_leak_offset[k+1]; ++l)
+  {
+    const int parent = path.leak_parent[l];
+    const double leak = path.leak_factor[l]*(parent < 0 ? power : end_power[parent]);
+    if(path.leak_escape[l])
+      acc.escape_power += leak;
+    else
+      acc.pass_power += leak;
+  }
+}
+
+
+
+void RayTraceSolver::ray_region_absorption(const RayPath & path, unsigned int k, double power, double wavelength,
+                                           std::vector<double> & region_power, std::vector<double> & end_power) const
+{
+  const MeshBase & mesh = _system.mesh();
+
+  const unsigned int seg_begin = path.ray_segment_offset[k];
+  const unsigned int seg_end   = path.ray_segment_offset[k+1];
+  end_power.resize(seg_end - seg_begin);
+
+  for(unsigned int s=seg_begin; s<seg_end; ++s)
+  {
+    const int parent = path.seg_parent[s];
+    const double start_power = path.seg_factor[s]*(parent < 0 ? power : end_power[parent]);
+
+    double band_fraction;
+    end_power[s-seg_begin] = start_power*segment_attenuation(path.seg_elem[s], path.seg_length[s], wavelength, band_fraction);
+
+    const double dpower = start_power - end_power[s-seg_begin];
+    for(unsigned int t=path.seg_target_offset[s]; t<path.seg_target_offset[s+1]; ++t)
+      region_power[mesh.elem(path.target_elem[t])->subdomain_id()] += path.target_weight[t]*dpower;
+  }
+}
+
+
+
+double RayTraceSolver::segment_attenuation(unsigned int elem_id, double length, double wavelength, double & band_fraction) const
+{
+  const double a_band = 4*3.14159265358979*_elem_refractive_index[elem_id].imag()/wavelength;
+  const double a_fc   = _elem_fc_absorption[elem_id];
+  band_fraction = a_band/(a_band+a_fc+1e-30);
+
+  // the same attenuation as LightThread::advance_to
+  return exp(-a_band*length)*exp(-a_fc*length);
+}
+
+
+
+void RayTraceSolver::merge_accumulator(const RayTraceAccumulator & acc)
+{
+  for(unsigned int n=0; n<_band_absorption_energy_in_elem.size(); ++n)
+  {
+    _band_absorption_energy_in_elem[n]  += acc.band_absorption_energy_in_elem[n];
+    _total_absorption_energy_in_elem[n] += acc.total_absorption_energy_in_elem[n];
+  }
+
+  _incident_power += acc.incident_power;
+  _pass_power     += acc.pass_power;
+  _escape_power   += acc.escape_power;
+  _absorb_power   += acc.absorb_power;
+}
+
+
+
 void RayTraceSolver::optical_generation(unsigned int n)
 {
   const MeshBase &mesh = _system.mesh();
@@ -1450,6 +2049,11 @@ void RayTraceSolver::statistic()
   MESSAGE<<"    Pass away power : " << _pass_power/unit     << ' ' << unit_string << std::endl;
   MESSAGE<<"    Escaped power   : " << _escape_power/unit   << ' ' << unit_string << std::endl;
   MESSAGE<<"    Absorbed power  : " << _absorb_power/unit   << ' ' << unit_string << std::endl;
+  if(_adaptive)
+  {
+    MESSAGE<<"  Adaptive sampling rays  : " << _adaptive_rays << std::endl;
+    MESSAGE<<"    Max relative error of region absorbed power : " << _adaptive_error << " (tolerance " << _adaptive_tol << ")" << std::endl;
+  }
   MESSAGE<< std::endl;
   RECORD();
 
@@ -111,6 +111,11 @@ namespace SolverSpecify
    */
   VoronoiTruncationFlag VoronoiTruncation;
 
+  /**
+   * evaluation scheme of Bernoulli function for S-G edge flux
+   */
+  BernoulliScheme Bernoulli;
+
   //--------------------------------------------
   // half implicit method
   //--------------------------------------------
@@ -719,6 +724,7 @@ namespace SolverSpecify
 
     Damping           = DampingPotential;
     VoronoiTruncation = VoronoiTruncationAlways;
+    Bernoulli         = BernoulliRational;
 
     LS_POISSON        = GMRES;
     PC_POISSON        = ASM_PRECOND;
@@ -1,5 +1,7 @@
 #include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 
 #include "ParticleEvent.h"
@@ -156,11 +158,66 @@ bool Event::readData(hid_t parent_grp, const std::string &name)
 
   ret = ret && _tracks.readData(grp, "Tracks");
   ret = ret && _steps.readData(grp, "Steps");
+  _stepBase = 0;
 
   H5Gclose(grp);
   return ret;
 }
 
+bool Event::openData(hid_t parent_grp, const std::string &name)
+{
+  closeData();
+
+  if (fullname!=CogendaHDF5::getAttribute<std::string>(parent_grp, name, ATTR_fullname)) return false;
+
+  _grp = H5Gopen(parent_grp, name.c_str(), H5P_DEFAULT);
+  if (_grp<0)
+    return false;
+
+  setID(CogendaHDF5::getAttribute(_grp, ".", "ID", 0));
+  setEnergyDeposit(CogendaHDF5::getAttribute(_grp, ".", "EnergyDeposit", 0.0));
+
+  bool ret = true;
+
+  ret = ret && _tracks.openData(_grp, "Tracks");
+  ret = ret && _steps.openData(_grp, "Steps");
+
+  if (!ret) closeData();
+  return ret;
+}
+
+bool Event::readChunk(size_t offset, size_t count)
+{
+  const size_t n_tracks = nTracks();
+  if (offset>=n_tracks) count = 0;
+  else if (count>n_tracks-offset) count = n_tracks-offset;
+
+  if (!_tracks.readChunk(offset, count)) return false;
+
+  // steps of the tracks in chunk
+  size_t step_begin = std::numeric_limits<size_t>::max();
+  size_t step_end   = 0;
+  for (size_t i=0; i<_tracks.size(); i++)
+  {
+    Track track(_tracks[i]);
+    if (track.NumSteps()==0) continue;
+    step_begin = std::min(step_begin, track.StepOffset());
+    step_end   = std::max(step_end, track.StepOffset()+track.NumSteps());
+  }
+  if (step_end==0) step_begin = 0;
+
+  _stepBase = step_begin;
+  return _steps.readChunk(step_begin, step_end-step_begin);
+}
+
+void Event::closeData()
+{
+  _tracks.closeData();
+  _steps.closeData();
+  if (_grp>=0) H5Gclose(_grp);
+  _grp = -1;
+}
+
 bool Event::writeData(hid_t parent_grp, const std::string &name)
 {
   hid_t grp;
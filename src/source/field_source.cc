@@ -271,66 +271,71 @@ void FieldSource::update(double time, bool force_update_source)
 
   if( force_update_source )    this->update_source();
 
-  if( _applied_to_system == false ) this->update_source();
+  // the spatial generation is computed when source or mesh changed
+  if( _applied_to_system == false || !is_spatial_generation_valid() ) this->update_source();
 
+  START_LOG("update()", "FieldSource");
 
-  // clear old particle and optical generation
-  for(unsigned int n=0; n<_system.n_regions(); n++)
-  {
-    SimulationRegion * region = _system.region(n);
-    {
-      SimulationRegion::processor_node_iterator it = region->on_local_nodes_begin();
-      SimulationRegion::processor_node_iterator it_end = region->on_local_nodes_end();
-      for(; it!=it_end; ++it)
-      {
-        FVM_Node * fvm_node = (*it);
-        FVM_NodeData * fvm_node_data = fvm_node->node_data();
-        fvm_node_data->PatG() = 0.0;
-        fvm_node_data->OptG() = 0.0;
-      }
-    }
-  }
-
-  // let particle source update the PatG
-  std::vector<Particle_Source *>::iterator pit = _particle_sources.begin();
-  for(; pit!=_particle_sources.end(); ++pit)
-  {
-    (*pit)->carrier_generation(time);
-  }
-
-  // let light source update the OptG
-  std::vector<Light_Source *>::iterator lit = _light_sources.begin();
-  for(; lit!=_light_sources.end(); ++lit)
-    (*lit)->carrier_generation(time);
+  // time factor of each source
+  std::vector<double> particle_factor(_particle_sources.size());
+  for(unsigned int p=0; p<_particle_sources.size(); ++p)
+    particle_factor[p] = _particle_sources[p]->time_factor(time);
 
+  std::vector<double> light_factor(_light_sources.size());
+  for(unsigned int l=0; l<_light_sources.size(); ++l)
+    light_factor[l] = _light_sources[l]->time_factor(time);
 
-  for(unsigned int n=0; n<_system.n_regions(); n++)
+  // sum the spatial generation scaled by time factor into PatG, OptG and Field_G in one pass,
+  // the sources with zero time factor are skipped
+  for(unsigned int n=0; n<_region_generation.size(); n++)
   {
-    SimulationRegion * region = _system.region(n);
+    const RegionGeneration & generation = _region_generation[n];
+    const unsigned int n_nodes = generation.node_data.size();
+
+    std::vector<std::pair<double, const double *> > particle_terms;
+    if(!generation.particle_profile.empty())
+      for(unsigned int p=0; p<particle_factor.size(); ++p)
+        if(particle_factor[p] != 0.0)
+          particle_terms.push_back(std::make_pair(particle_factor[p], &generation.particle_profile[p*n_nodes]));
+
+    std::vector<std::pair<double, const double *> > light_terms;
+    if(!generation.light_profile.empty())
+      for(unsigned int l=0; l<light_factor.size(); ++l)
+        if(light_factor[l] != 0.0)
+          light_terms.push_back(std::make_pair(light_factor[l], &generation.light_profile[l*n_nodes]));
+
+    for(unsigned int i=0; i<n_nodes; ++i)
     {
-      SimulationRegion::processor_node_iterator it = region->on_processor_nodes_begin();
-      SimulationRegion::processor_node_iterator it_end = region->on_processor_nodes_end();
-      for(; it!=it_end; ++it)
-      {
-        FVM_Node * fvm_node = (*it);
-        FVM_NodeData * fvm_node_data = fvm_node->node_data();
+      double patg = 0.0;
+      for(unsigned int p=0; p<particle_terms.size(); ++p)
+        patg += particle_terms[p].second[i]*particle_terms[p].first;
 
-        double G=0;
+      double optg = 0.0;
+      for(unsigned int l=0; l<light_terms.size(); ++l)
+        optg += light_terms[l].second[i]*light_terms[l].first;
 
-        if(SolverSpecify::PatG)
-        {
-          G += fvm_node_data->PatG();
-        }
+      FVM_NodeData * fvm_node_data = generation.node_data[i];
+      fvm_node_data->PatG() = patg;
+      fvm_node_data->OptG() = optg;
 
-        if(SolverSpecify::OptG)
-        {
-          G += fvm_node_data->OptG();
-        }
+      double G=0;
 
-        fvm_node_data->Field_G() = G;
+      if(SolverSpecify::PatG)
+      {
+        G += patg;
       }
+
+      if(SolverSpecify::OptG)
+      {
+        G += optg;
+      }
+
+      fvm_node_data->Field_G() = G;
     }
   }
+
+  STOP_LOG("update()", "FieldSource");
+
 #if defined(HAVE_FENV_H) && defined(DEBUG)
   genius_assert( !fetestexcept(FE_INVALID) );
 #endif
@@ -370,10 +375,65 @@ void FieldSource::update_source()
   genius_assert( !fetestexcept(FE_INVALID) );
 #endif
 
+  build_spatial_generation();
+
   _applied_to_system = true;
 }
 
 
+void FieldSource::build_spatial_generation()
+{
+  _region_generation.clear();
+  _region_generation.resize(_system.n_regions());
+
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    SimulationRegion * region = _system.region(n);
+    RegionGeneration & generation = _region_generation[n];
+
+    std::vector<const FVM_Node *> nodes;
+    SimulationRegion::processor_node_iterator it = region->on_processor_nodes_begin();
+    SimulationRegion::processor_node_iterator it_end = region->on_processor_nodes_end();
+    for(; it!=it_end; ++it)
+    {
+      nodes.push_back(*it);
+      generation.node_data.push_back((*it)->node_data());
+    }
+
+    // sources only generate carriers in semiconductor region
+    if( region->type() != SemiconductorRegion ) continue;
+
+    const unsigned int n_nodes = nodes.size();
+
+    generation.particle_profile.resize(_particle_sources.size()*n_nodes);
+    for(unsigned int p=0; p<_particle_sources.size(); ++p)
+      for(unsigned int i=0; i<n_nodes; ++i)
+        generation.particle_profile[p*n_nodes + i] = _particle_sources[p]->spatial_generation(nodes[i]);
+
+    generation.light_profile.resize(_light_sources.size()*n_nodes);
+    for(unsigned int l=0; l<_light_sources.size(); ++l)
+      for(unsigned int i=0; i<n_nodes; ++i)
+        generation.light_profile[l*n_nodes + i] = _light_sources[l]->spatial_generation(nodes[i]);
+  }
+}
+
+
+bool FieldSource::is_spatial_generation_valid() const
+{
+  if( _region_generation.size() != _system.n_regions() ) return false;
+
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    const SimulationRegion * region = _system.region(n);
+    const RegionGeneration & generation = _region_generation[n];
+    if( generation.node_data.size() != region->n_on_processor_node() ) return false;
+    if( !generation.node_data.empty() && generation.node_data[0] != (*region->on_processor_nodes_begin())->node_data() ) return false;
+  }
+
+  return true;
+}
+
+
 
 double FieldSource::limit_dt(double time, double dt, double dt_min) const
 {
@@ -47,7 +47,7 @@ using PhysicalUnit::h;
 
 
 
-void Light_Source::carrier_generation(double t)
+double Light_Source::time_factor(double t) const
 {
   double optical_gen_waveform = 1.0;
   if(SolverSpecify::TimeDependent)
@@ -57,6 +57,13 @@ void Light_Source::carrier_generation(double t)
     else if(_waveform)
       optical_gen_waveform = 0.5*(_waveform->waveform(t) + _waveform->waveform(t-SolverSpecify::dt));
   }
+  return optical_gen_waveform;
+}
+
+
+void Light_Source::carrier_generation(double t)
+{
+  double optical_gen_waveform = time_factor(t);
 
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
@@ -176,6 +183,8 @@ Light_Source_From_File::Light_Source_From_File(SimulationSystem &system, const P
 
   _skip_line      = c.get_int("skipline", 0);
 
+  _interpolation_cache = c.get_string("interpolation.cache", "");
+
   // set Light profile here.
   if(c.is_enum_value("profile","efile2d") || c.is_enum_value("profile","pfile2d"))
     _dim = 2;
@@ -356,6 +365,7 @@ void Light_Source_From_File::update_source()
   //interpolator = new Interpolation3D_qshep;
 
   interpolator->set_interpolation_type(0, InterpolationBase::Linear);
+  interpolator->set_cache_directory(_interpolation_cache);
 
   if(Genius::processor_id()==0)
   {
@@ -384,7 +394,8 @@ void Light_Source_From_File::update_source()
 
 
 
-  // interpolate to mesh node
+  // interpolate to mesh node, all the nodes in one bulk query
+  std::vector<Point> points;
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
     const SimulationRegion * region = _system.region(n);
@@ -392,6 +403,20 @@ void Light_Source_From_File::update_source()
     SimulationRegion::const_processor_node_iterator it = region->on_processor_nodes_begin();
     SimulationRegion::const_processor_node_iterator it_end = region->on_processor_nodes_end();
     for(; it!=it_end; ++it)
+      points.push_back(*((*it)->root_node()));
+  }
+
+  std::vector<double> field;
+  interpolator->get_interpolated_values(points, 0, field);
+
+  unsigned int index = 0;
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    const SimulationRegion * region = _system.region(n);
+
+    SimulationRegion::const_processor_node_iterator it = region->on_processor_nodes_begin();
+    SimulationRegion::const_processor_node_iterator it_end = region->on_processor_nodes_end();
+    for(; it!=it_end; ++it, ++index)
     {
       const FVM_Node * fvm_node = (*it);
 
@@ -406,7 +431,7 @@ void Light_Source_From_File::update_source()
 
       if(_field_type=="efield")
       {
-        double E_field = interpolator->get_interpolated_value(*(fvm_node->root_node()), 0);
+        double E_field = field[index];
         // optical energy is J \cdot E, here J=\sigma E,
         // and \sigma has the relationship with eps imag part as \eps^{''} = \frac{\sigma}{\omega}, here  \omega = 2\pi\nu
         // so J \cdot E can be expressed as J \cdot E = \sigma E^2 = 2\pi\nu\eps^{''} E^2
@@ -417,7 +442,7 @@ void Light_Source_From_File::update_source()
 
       if(_field_type=="pfield")
       {
-        double Power = interpolator->get_interpolated_value(*(fvm_node->root_node()), 0);
+        double Power = field[index];
         // Power = eps^{'}eps_0E^2, here E is RMS value
         double energy = 2*pi*nu*Power*eps.imag()/eps.real()*scale;
         _fvm_node_particle_deposit[fvm_node] = eta*energy/photon;
@@ -516,9 +541,20 @@ void Light_Source_Xray::update_source()
 #ifdef TCAD_SOLVERS
 
 #include "ray_tracing/ray_tracing.h"
+#include "ray_tracing/ray_path.h"
+Light_Source_RayTracing::~Light_Source_RayTracing()
+{
+  delete _ray_path_cache;
+}
+
+
 void Light_Source_RayTracing::update_source()
 {
+  if(!_ray_path_cache && _card.get_bool("ray.cache", false))
+    _ray_path_cache = new RayPathCache;
+
   RayTraceSolver * solver = new RayTraceSolver(_system, _card);
+  solver->set_path_cache(_ray_path_cache);
   solver->create_solver();
   solver->solve();
   solver->destroy_solver();
@@ -568,6 +604,7 @@ void Light_Source_EMFEM2D::update_source()
 }
 
 #else
+Light_Source_RayTracing::~Light_Source_RayTracing() {}
 void Light_Source_RayTracing::update_source() {}
 void Light_Source_EMFEM2D::update_source() {}
 #endif
@@ -20,6 +20,7 @@
 /********************************************************************************/
 
 #include <limits>
+#include <algorithm>
 #include <fstream>
 
 #include "parser.h"
@@ -38,6 +39,7 @@
 #include "mathfunc.h"
 #include "solver_specify.h"
 #include "log.h"
+#include "threads.h"
 
 //#define DEBUG
 
@@ -52,9 +54,15 @@ using PhysicalUnit::g;
 
 
 
+double Particle_Source::time_factor(double t) const
+{
+  return 0.5*(carrier_generation_t(t+0.5*SolverSpecify::dt) + carrier_generation_t(t-0.5*SolverSpecify::dt));
+}
+
+
 void Particle_Source::carrier_generation(double t)
 {
-  double ct = 0.5*(carrier_generation_t(t+0.5*SolverSpecify::dt) + carrier_generation_t(t-0.5*SolverSpecify::dt));
+  double ct = time_factor(t);
 
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
@@ -154,6 +162,7 @@ void Particle_Source_DataFile::set_particle_profile_fromfile2d(const Parser::Car
 {
   interpolator = AutoPtr<InterpolationBase>(new Interpolation2D_CSA);
   interpolator->set_interpolation_type(0, InterpolationBase::Asinh);
+  interpolator->set_cache_directory(c.get_string("interpolation.cache", ""));
 
   if(Genius::processor_id()==0)
   {
@@ -292,21 +301,38 @@ void Particle_Source_DataFile::set_particle_profile_fromfile3d(const Parser::Car
 
 void Particle_Source_DataFile::update_source()
 {
-  // interpolate to mesh node
+  // interpolate to the nodes of semiconductor regions, all the nodes in one bulk query
+  std::vector<Point> points;
   for(unsigned int n=0; n<_system.n_regions(); n++)
   {
     const SimulationRegion * region = _system.region(n);
 
     if( region->type() != SemiconductorRegion ) continue;
-    double _quan_eff = quan_eff(region);
 
     SimulationRegion::const_processor_node_iterator it = region->on_processor_nodes_begin();
     SimulationRegion::const_processor_node_iterator it_end = region->on_processor_nodes_end();
     for(; it!=it_end; ++it)
+      points.push_back(*((*it)->root_node()));
+  }
+
+  std::vector<double> energy;
+  interpolator->get_interpolated_values(points, 0, energy);
+
+  unsigned int index = 0;
+  for(unsigned int n=0; n<_system.n_regions(); n++)
+  {
+    const SimulationRegion * region = _system.region(n);
+
+    if( region->type() != SemiconductorRegion ) continue;
+    double _quan_eff = quan_eff(region);
+
+    SimulationRegion::const_processor_node_iterator it = region->on_processor_nodes_begin();
+    SimulationRegion::const_processor_node_iterator it_end = region->on_processor_nodes_end();
+    for(; it!=it_end; ++it, ++index)
     {
       const FVM_Node * fvm_node = (*it);
 
-      double E = interpolator->get_interpolated_value(*(fvm_node->root_node()), 0);
+      double E = energy[index];
       _fvm_node_particle_deposit[fvm_node] = 2*E/_quan_eff/_t_char/sqrt(3.1415926536)/(1+Erf((_t_max-_t0)/_t_char));
     }
   }
@@ -483,38 +509,169 @@ Particle_Source_Track::Particle_Source_Track(SimulationSystem &system, const Par
   _t_char = c.get_real("t.char", 2e-12)*s;
 
 
-  std::string track_file = c.get_string("profile.file", "");
-  std::string hdf5_file = c.get_string("profile.hdf5", "");
-  std::string event_path = c.get_string("hdf5.path", "");
+  _track_file   = c.get_string("profile.file", "");
+  _hdf5_file    = c.get_string("profile.hdf5", "");
+  _hdf5_path    = c.get_string("hdf5.path", "");
+  _lateral_char = c.get_real("lateral.char", 0.1);
+  _chunk_size   = std::max(1, c.get_int("track.chunk", 100000));
 
-  MESSAGE<<"Setting Radiation Source from particle event file " << track_file << "..."; RECORD();
-  if(!track_file.empty())
-    _read_particle_profile_track_evt(track_file, c.get_real("lateral.char", 0.1));
-#ifdef HAVE_HDF5
-  if(!hdf5_file.empty())
-    _read_particle_profile_track_hdf5(hdf5_file, event_path, c.get_real("lateral.char", 0.1));
-#endif
+  // track filter
+  _filter_box = c.is_parameter_exist("track.box");
+  if(_filter_box)
+  {
+    std::vector<double> box = c.get_array<double>("track.box");
+    if(box.size() != 6)
+    {
+      MESSAGE<<"ERROR at " << c.get_fileline() <<" PARTICLE: track.box should be xmin ymin zmin xmax ymax zmax."<<std::endl; RECORD();
+      genius_error();
+    }
+    _filter_min = Point(box[0], box[1], box[2])*um;
+    _filter_max = Point(box[3], box[4], box[5])*um;
+  }
+  _filter_energy = c.get_real("track.emin", 0.0)*1e6*eV;
+
+  // the tracks are streamed from file when source is updated, only check the file here
+  MESSAGE<<"Setting Radiation Source from particle event file " << _track_file << "..."; RECORD();
+  {
+    AutoPtr<TrackReader> reader(_open_track_reader());
+  }
   MESSAGE<<"ok\n"<<std::endl; RECORD();
 }
 
 
 
-void Particle_Source_Track::_read_particle_profile_track_evt(const std::string & filename, Real lateral_char)
+bool Particle_Source_Track::_accept_track(const track_t & track) const
 {
-  std::vector<double> meta_data;
-  if(Genius::processor_id()==0)
+  if( track.energy <= _filter_energy ) return false;
+
+  if( _filter_box )
   {
-    std::ifstream in(filename.c_str());
-    if(!in.good())
+    // the bounding box of track, enlarged by its lateral range
+    const double range = 5*track.lateral_char;
+    for(unsigned int d=0; d<3; ++d)
     {
-      MESSAGE<<"ERROR PARTICLE: file "<<filename<<" can't be opened."<<std::endl; RECORD();
-      genius_error();
+      if( std::max(track.start(d), track.end(d)) + range < _filter_min(d) ) return false;
+      if( std::min(track.start(d), track.end(d)) - range > _filter_max(d) ) return false;
     }
+  }
 
-    while(!in.eof())
+  return true;
+}
+
+
+
+/**
+ * read the tracks chunk by chunk. tracks are read and filtered by the first
+ * processor, and broadcast to all the processors
+ */
+class Particle_Source_Track::TrackReader
+{
+public:
+
+  TrackReader(const Particle_Source_Track & source) : _source(source) {}
+
+  virtual ~TrackReader() {}
+
+  /**
+   * read next chunk of about n tracks
+   * @return false when all the tracks have been read
+   */
+  bool next_chunk(std::vector<track_t> & tracks, unsigned int n)
+  {
+    std::vector<double> meta_data;
+    if(Genius::processor_id()==0)
+      this->_read(meta_data, n);
+
+    Parallel::broadcast(meta_data);
+
+    tracks.clear();
+    for(unsigned int k=0; k<meta_data.size()/8; ++k)
+    {
+      track_t track;
+      track.start.x()    = meta_data[8*k+0];
+      track.start.y()    = meta_data[8*k+1];
+      track.start.z()    = meta_data[8*k+2];
+      track.end.x()      = meta_data[8*k+3];
+      track.end.y()      = meta_data[8*k+4];
+      track.end.z()      = meta_data[8*k+5];
+      track.energy       = meta_data[8*k+6];
+      track.lateral_char = meta_data[8*k+7];
+      tracks.push_back(track);
+    }
+
+    return !tracks.empty();
+  }
+
+protected:
+
+  /**
+   * on the first processor, read tracks until n tracks accepted or file end.
+   * each track takes 8 values in meta_data
+   * @return the number of tracks accepted, less than n only at file end
+   */
+  virtual unsigned int _read(std::vector<double> & meta_data, unsigned int n)=0;
+
+  /**
+   * add the track to meta_data if it is accepted by source filter
+   * @return true if accepted
+   */
+  bool _add_track(std::vector<double> & meta_data, const Point & start, const Point & end, double energy, double lateral_char) const
+  {
+    track_t track;
+    track.start        = start;
+    track.end          = end;
+    track.energy       = energy;
+    track.lateral_char = lateral_char;
+    if( !_source._accept_track(track) ) return false;
+
+    meta_data.push_back(start.x());
+    meta_data.push_back(start.y());
+    meta_data.push_back(start.z());
+    meta_data.push_back(end.x());
+    meta_data.push_back(end.y());
+    meta_data.push_back(end.z());
+    meta_data.push_back(energy);
+    meta_data.push_back(lateral_char);
+    return true;
+  }
+
+  const Particle_Source_Track & _source;
+
+  friend class Particle_Source_Track::TrackReaderSequence;
+};
+
+
+
+/**
+ * tracks in text file, one track each line
+ */
+class Particle_Source_Track::TrackReaderEvt : public Particle_Source_Track::TrackReader
+{
+public:
+
+  TrackReaderEvt(const Particle_Source_Track & source, const std::string & filename, Real lateral_char)
+    : TrackReader(source), _lateral_char(lateral_char)
+  {
+    if(Genius::processor_id()==0)
+    {
+      _in.open(filename.c_str());
+      if(!_in.good())
+      {
+        MESSAGE<<"ERROR PARTICLE: file "<<filename<<" can't be opened."<<std::endl; RECORD();
+        genius_error();
+      }
+    }
+  }
+
+protected:
+
+  virtual unsigned int _read(std::vector<double> & meta_data, unsigned int n)
+  {
+    unsigned int n_read = 0;
+    while(n_read < n && !_in.eof())
     {
       std::string context;
-      std::getline(in, context);
+      std::getline(_in, context);
       if(context.empty()) continue;
       if(context[0] == '#') continue;
 
@@ -523,7 +680,7 @@ void Particle_Source_Track::_read_particle_profile_track_evt(const std::string &
       ss >> particle;
       if(particle.empty()) continue;
 
-      double p1[3], p2[3], energy, sigma=lateral_char;
+      double p1[3], p2[3], energy, sigma=_lateral_char;
       ss >>  p1[0] >> p1[1] >> p1[2] >> p2[0] >> p2[1] >> p2[2] >> energy;
       if(!ss.eof()) { ss >> sigma;}
 
@@ -535,139 +692,247 @@ void Particle_Source_Track::_read_particle_profile_track_evt(const std::string &
       Point end(p2[0]*um,p2[1]*um,p2[2]*um);
       if( (begin-end).size() < 1e-6*um ) continue;
 
-      meta_data.push_back(p1[0]*um);
-      meta_data.push_back(p1[1]*um);
-      meta_data.push_back(p1[2]*um);
-      meta_data.push_back(p2[0]*um);
-      meta_data.push_back(p2[1]*um);
-      meta_data.push_back(p2[2]*um);
-      meta_data.push_back(energy*1e6*eV);
-      meta_data.push_back(sigma*um);
+      if( _add_track(meta_data, begin, end, energy*1e6*eV, sigma*um) ) n_read++;
     }
-
-    in.close();
+    return n_read;
   }
 
-  Parallel::broadcast(meta_data);
-  for(unsigned int n=0; n<meta_data.size()/8; ++n)
-  {
-    track_t track;
-    track.start.x()    = meta_data[8*n+0];
-    track.start.y()    = meta_data[8*n+1];
-    track.start.z()    = meta_data[8*n+2];
-    track.end.x()      = meta_data[8*n+3];
-    track.end.y()      = meta_data[8*n+4];
-    track.end.z()      = meta_data[8*n+5];
-    track.energy       = meta_data[8*n+6];
-    track.lateral_char = meta_data[8*n+7];
-    _tracks.push_back(track);
-  }
+private:
+
+  std::ifstream _in;
+
+  Real _lateral_char;
+};
 
-  Parallel::verify(_tracks.size());
 
-}
 
 #ifdef HAVE_HDF5
 
 #include "ParticleEvent.h"
-void Particle_Source_Track::_read_particle_profile_track_hdf5(const std::string & filename, const std::string & path, Real lateral_char)
+
+/**
+ * tracks in hdf5 file. the tracks of particle event are read in chunks,
+ * each step of a track gives a track segment
+ */
+class Particle_Source_Track::TrackReaderHDF5 : public Particle_Source_Track::TrackReader
 {
-  std::vector<double> meta_data;
-  if(Genius::processor_id()==0)
-  {
-    hid_t    file_handle;
+public:
 
-    file_handle = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_handle<0)
+  TrackReaderHDF5(const Particle_Source_Track & source, const std::string & filename, const std::string & path, Real lateral_char)
+    : TrackReader(source), _lateral_char(lateral_char), _file_handle(-1), _event(0), _offset(0)
+  {
+    if(Genius::processor_id()==0)
     {
-      MESSAGE<<"ERROR PARTICLE: file "<<filename<<" can't be opened."<<std::endl; RECORD();
-      genius_error();
-    }
+      _file_handle = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      if (_file_handle<0)
+      {
+        MESSAGE<<"ERROR PARTICLE: file "<<filename<<" can't be opened."<<std::endl; RECORD();
+        genius_error();
+      }
 
-    H5G_info_t ginfo;
-    H5Gget_info(file_handle, &ginfo);
+      {
+        hid_t grp;
+        grp = H5Gopen(_file_handle, "target", H5P_DEFAULT);
+        _material_list = CogendaHDF5::getAttribute< std::vector<std::string> >(grp, ".", "MaterialList");
+        _region_lut    = CogendaHDF5::getAttribute< CogendaHDF5::LookupTable >(grp, ".", "RegionList");
+        H5Gclose(grp);
+      }
 
-    CogendaHDF5::LookupTable region_lut;
-    std::vector<std::string> material_list;
-    {
-      hid_t grp;
-      grp = H5Gopen(file_handle, "target", H5P_DEFAULT);
-      material_list = CogendaHDF5::getAttribute< std::vector<std::string> >(grp, ".", "MaterialList");
-      region_lut   = CogendaHDF5::getAttribute< CogendaHDF5::LookupTable >(grp, ".", "RegionList");
+      _event = new CogendaHDF5::GSeat::Event(_region_lut, _material_list);
+      if (!_event->openData(_file_handle, path))
+      {
+        MESSAGE<<"ERROR PARTICLE: file "<<filename<<" path " << path << " can not be opened." <<std::endl; RECORD();
+        genius_error();
+      }
     }
+  }
+
+  ~TrackReaderHDF5()
+  {
+    delete _event;
+    if (_file_handle>=0) H5Fclose(_file_handle);
+  }
 
-    //for(unsigned int n=0; n<material_list.size(); ++n)
-    //  std::cout<<material_list[n]<<std::endl;
+protected:
 
-    //std::string event_path = "./" + path;
-    CogendaHDF5::GSeat::Event evt_hdf5(region_lut, material_list);
-    bool rc = evt_hdf5.readData(file_handle, path);
-    if (!rc)
-    {
-      MESSAGE<<"ERROR PARTICLE: file "<<filename<<" path " << path << " can not be opened." <<std::endl; RECORD();
-      genius_error();
-    }
+  virtual unsigned int _read(std::vector<double> & meta_data, unsigned int n)
+  {
+    // particle tracks read from hdf5 file at once
+    const size_t hdf5_chunk = 4096;
 
-    for (CogendaHDF5::GSeat::Event::TrackIter iTrack = evt_hdf5.track_begin();  iTrack != evt_hdf5.track_end(); ++iTrack)
+    unsigned int n_read = 0;
+    while(n_read < n && _offset < _event->nTracks())
     {
-      const CogendaHDF5::GSeat::Track & track_hdf5 = *iTrack;
-
-      std::vector<double> p = track_hdf5.StartPoint();
-      Point StartPoint(p[0], p[1], p[2]);
+      if (!_event->readChunk(_offset, hdf5_chunk))
+      {
+        MESSAGE<<"ERROR PARTICLE: failed to read particle tracks from hdf5 file." <<std::endl; RECORD();
+        genius_error();
+      }
+      _offset += hdf5_chunk;
 
-      CogendaHDF5::GSeat::Event::StepIter iStep = evt_hdf5.step_begin(track_hdf5);
-      for (unsigned int c=0; iStep != evt_hdf5.step_end(track_hdf5); ++iStep, ++c)
+      for (CogendaHDF5::GSeat::Event::TrackIter iTrack = _event->track_begin();  iTrack != _event->track_end(); ++iTrack)
       {
-        const CogendaHDF5::GSeat::Step & step_hdf5 = *iStep;
+        const CogendaHDF5::GSeat::Track & track_hdf5 = *iTrack;
 
-        std::vector<double> p = step_hdf5.EndPoint();
-        Point EndPoint(p[0], p[1], p[2]);
-        double energy = step_hdf5.EnergyDeposit();
+        std::vector<double> p = track_hdf5.StartPoint();
+        Point StartPoint(p[0], p[1], p[2]);
+
+        CogendaHDF5::GSeat::Event::StepIter iStep = _event->step_begin(track_hdf5);
+        for (; iStep != _event->step_end(track_hdf5); ++iStep)
+        {
+          const CogendaHDF5::GSeat::Step & step_hdf5 = *iStep;
 
-        meta_data.push_back(StartPoint[0]*um);
-        meta_data.push_back(StartPoint[1]*um);
-        meta_data.push_back(StartPoint[2]*um);
-        meta_data.push_back(EndPoint[0]*um);
-        meta_data.push_back(EndPoint[1]*um);
-        meta_data.push_back(EndPoint[2]*um);
-        meta_data.push_back(energy*1e6*eV);
+          std::vector<double> p = step_hdf5.EndPoint();
+          Point EndPoint(p[0], p[1], p[2]);
+          double energy = step_hdf5.EnergyDeposit();
 
-        double sigma=lateral_char;
-        meta_data.push_back(sigma*um);
+          // skip zero length track
+          if( energy > 0.0 && (EndPoint - StartPoint).size() > 0.0 )
+            if( _add_track(meta_data, StartPoint*um, EndPoint*um, energy*1e6*eV, _lateral_char*um) ) n_read++;
 
-        StartPoint = EndPoint;
+          StartPoint = EndPoint;
+        }
       }
     }
-
-    H5Fclose(file_handle);
+    return n_read;
   }
 
-  //std::cout<<meta_data.size() << std::endl;
+private:
+
+  Real _lateral_char;
+
+  hid_t _file_handle;
+
+  CogendaHDF5::LookupTable _region_lut;
+
+  std::vector<std::string> _material_list;
+
+  CogendaHDF5::GSeat::Event * _event;
+
+  /// the first hdf5 track of next chunk
+  size_t _offset;
+};
+
+#endif
+
+
+
+/**
+ * tracks of several readers, read one after another
+ */
+class Particle_Source_Track::TrackReaderSequence : public Particle_Source_Track::TrackReader
+{
+public:
+
+  TrackReaderSequence(const Particle_Source_Track & source)
+    : TrackReader(source), _current(0)
+  {}
 
-  Parallel::broadcast(meta_data);
-  for(unsigned int n=0; n<meta_data.size()/8; ++n)
+  ~TrackReaderSequence()
   {
-    track_t track;
-    track.start.x()    = meta_data[8*n+0];
-    track.start.y()    = meta_data[8*n+1];
-    track.start.z()    = meta_data[8*n+2];
-    track.end.x()      = meta_data[8*n+3];
-    track.end.y()      = meta_data[8*n+4];
-    track.end.z()      = meta_data[8*n+5];
-    track.energy       = meta_data[8*n+6];
-    track.lateral_char = meta_data[8*n+7];
+    for(unsigned int i=0; i<_readers.size(); ++i)
+      delete _readers[i];
+  }
+
+  /**
+   * append a reader, it is owned by this sequence
+   */
+  void add(TrackReader * reader)
+  { _readers.push_back(reader); }
 
-    // skip zero length track
-    if( track.energy <= 0.0 || (track.end - track.start).size() == 0.0 ) continue;
+protected:
 
-    _tracks.push_back(track);
+  virtual unsigned int _read(std::vector<double> & meta_data, unsigned int n)
+  {
+    unsigned int n_read = 0;
+    while(n_read < n && _current < _readers.size())
+    {
+      n_read += _readers[_current]->_read(meta_data, n - n_read);
+      // current reader reaches its file end
+      if(n_read < n) _current++;
+    }
+    return n_read;
   }
 
-  Parallel::verify(_tracks.size());
+private:
+
+  std::vector<TrackReader *> _readers;
+
+  /// the reader in use
+  unsigned int _current;
+};
+
 
-}
 
+Particle_Source_Track::TrackReader * Particle_Source_Track::_open_track_reader() const
+{
+  // tracks of text file first, then hdf5 file. file not given is skipped
+  TrackReaderSequence * reader = new TrackReaderSequence(*this);
+  if(!_track_file.empty())
+    reader->add(new TrackReaderEvt(*this, _track_file, _lateral_char));
+#ifdef HAVE_HDF5
+  if(!_hdf5_file.empty())
+    reader->add(new TrackReaderHDF5(*this, _hdf5_file, _hdf5_path, _lateral_char));
 #endif
+  return reader;
+}
+
+
+
+namespace {
+  const unsigned int invalid_slot = std::numeric_limits<unsigned int>::max();
+}
+
+/**
+ * each on processor fvm node takes a slot in flat arrays. slots of region r are
+ * [offset[r], offset[r+1]), sorted by node id
+ */
+struct Particle_Source_Track::NodeSlots
+{
+  NodeSlots(SimulationSystem & system)
+    : offset(system.n_regions()+1, 0)
+  {
+    for(unsigned int r=0; r<system.n_regions(); r++)
+    {
+      const SimulationRegion * region = system.region(r);
+
+      std::vector< std::pair<unsigned int, const FVM_Node *> > nodes;
+      SimulationRegion::const_processor_node_iterator it = region->on_processor_nodes_begin();
+      SimulationRegion::const_processor_node_iterator it_end = region->on_processor_nodes_end();
+      for(; it!=it_end; ++it)
+        nodes.push_back( std::make_pair((*it)->root_node()->id(), *it) );
+      std::sort(nodes.begin(), nodes.end());
+
+      for(unsigned int n=0; n<nodes.size(); ++n)
+      {
+        id.push_back(nodes[n].first);
+        node.push_back(nodes[n].second);
+        volume.push_back(nodes[n].second->volume());
+      }
+      offset[r+1] = id.size();
+    }
+  }
+
+  unsigned int size() const
+  { return id.size(); }
+
+  /**
+   * @return the slot of node in region r, invalid_slot if it is not on processor
+   */
+  unsigned int find(unsigned int r, unsigned int node_id) const
+  {
+    const std::vector<unsigned int>::const_iterator begin = id.begin() + offset[r];
+    const std::vector<unsigned int>::const_iterator end   = id.begin() + offset[r+1];
+    const std::vector<unsigned int>::const_iterator it = std::lower_bound(begin, end, node_id);
+    if( it == end || *it != node_id ) return invalid_slot;
+    return it - id.begin();
+  }
+
+  std::vector<unsigned int>     offset;
+  std::vector<unsigned int>     id;
+  std::vector<const FVM_Node *> node;
+  std::vector<double>           volume;
+};
 
 
 
@@ -681,135 +946,253 @@ void Particle_Source_Track::update_source()
   const double pi = 3.1415926536;
   genius_assert(_system.mesh().mesh_dimension() == 3);
 
-  std::vector<double> region_energy(_system.n_regions(), 0.0);
-  double total_energy=0.0;
-
   AutoPtr<NearestNodeLocator> nn_locator( new NearestNodeLocator(_system.mesh()) );
 
-  for(unsigned int t=0; t<_tracks.size(); ++t)
+  NodeSlots slots(_system);
+  std::vector<double> slot_energy_density(slots.size(), 0.0);
+
+  // the tracks are streamed from file, only one chunk is in memory
+  AutoPtr<TrackReader> reader(_open_track_reader());
+  std::vector<track_t> tracks;
+  while( reader->next_chunk(tracks, _chunk_size) )
   {
-    if( t%(1+_tracks.size()/20) ==0 )
-    {
-      MESSAGE<< ".";
-      RECORD();
-    }
+    _deposit_tracks(tracks, *nn_locator, slots, slot_energy_density);
 
-    const track_t & track = _tracks[t];
-    genius_assert(track.energy > 0.0 && (track.end - track.start).size() > 0.0);
+    MESSAGE<< ".";
+    RECORD();
+  }
 
-    /*
-    // prevent bad tracks
-    int bad_track = 0;
-    if( track.energy == 0.0 || (track.end - track.start).size() == 0.0) bad_track=1;
-    Parallel::broadcast(bad_track);
-    if(bad_track) continue;
-    */
+  for(unsigned int r=0; r<_system.n_regions(); r++)
+  {
+    const SimulationRegion * region = _system.region(r);
+    const double _quan_eff = quan_eff(region);
+    for(unsigned int n=slots.offset[r]; n<slots.offset[r+1]; ++n)
+      if( slot_energy_density[n] != 0.0 )
+        _fvm_node_particle_deposit[slots.node[n]] += slot_energy_density[n]/_quan_eff/(_t_char/2.0*sqrt(pi)*(1+Erf((_t_max-_t0)/_t_char)));
+  }
 
-    double track_energy = 0.0;
-    std::map<const FVM_Node *, double> track_energy_density;
+  MESSAGE<< "ok" <<std::endl;
+  RECORD();
 
-    const Point track_dir = (track.end - track.start).unit(); // track direction
-    const double dEdx = track.energy/(track.end - track.start).size(); // linear energy density
-    const double lateral_char = track.lateral_char;
-    // find the nodes that near the track
-    for(unsigned int r=0; r<_system.n_regions(); r++)
-    {
-      const SimulationRegion * region = _system.region(r);
+  STOP_LOG("update_source()", "Particle_Source_Track");
 
-      // fast return
-      const std::pair<Point, Real> bsphere = region->boundingsphere();
-      const Point cent = 0.5*(track.start+track.end);
-      const double diag = 0.5*(track.start-track.end).size();
-      if( (bsphere.first - cent).size() > bsphere.second + diag + 5*lateral_char ) continue;
+}
 
 
-      std::vector<const Node *> nn = nn_locator->nearest_nodes(track.start, track.end, 5*lateral_char, r);
-      for(unsigned int n=0; n<nn.size(); ++n)
-      {
-        Point loc = *nn[n];
-        const FVM_Node * fvm_node = region->region_fvm_node(nn[n]); // may be NULL, if not on local
-        if(!fvm_node || !fvm_node->on_processor()) continue;
 
-        Point loc_pp = track.start + (loc-track.start)*track_dir*track_dir;
-        Real r = (loc-loc_pp).size();
-        double e_r = exp(-r*r/(lateral_char*lateral_char));
-        double e_z = Erf((loc_pp-track.start)*track_dir/lateral_char) - Erf((loc_pp-track.end)*track_dir/lateral_char);
-        double energy_density = dEdx/(2*pi*lateral_char*lateral_char)*e_r*e_z;
-        track_energy += energy_density*fvm_node->volume();
-        track_energy_density[fvm_node] += energy_density;
+void Particle_Source_Track::_deposit_tracks(const std::vector<track_t> & tracks, const NearestNodeLocator & nn_locator,
+                                            const NodeSlots & slots, std::vector<double> & slot_energy_density) const
+{
+  const double pi = 3.1415926536;
+
+  const unsigned int n_regions = _system.n_regions();
+  const unsigned int n_tracks  = tracks.size();
+  const unsigned int n_slots   = slots.size();
+
+  // bin the tracks by their center on a uniform grid, so that the tracks processed
+  // together query the same part of the mesh. tracks are processed in this order
+  std::vector<unsigned int> order(n_tracks);
+  {
+    Point lo( 1e30,  1e30,  1e30);
+    Point hi(-1e30, -1e30, -1e30);
+    for(unsigned int t=0; t<n_tracks; ++t)
+    {
+      const Point c = 0.5*(tracks[t].start + tracks[t].end);
+      for(unsigned int d=0; d<3; ++d)
+      {
+        lo(d) = std::min(lo(d), c(d));
+        hi(d) = std::max(hi(d), c(d));
       }
     }
 
-    Parallel::sum(track_energy);
-
-    if(track_energy > 0.0)
+    const unsigned int n_bins = 32;
+    std::vector< std::pair<unsigned int, unsigned int> > keys(n_tracks);
+    for(unsigned int t=0; t<n_tracks; ++t)
     {
-      double alpha = track.energy/track_energy; //used for keep energy conservation track.energy;
-      std::map<const FVM_Node *, double>::const_iterator it = track_energy_density.begin();
-      for(; it != track_energy_density.end(); ++it)
+      const Point c = 0.5*(tracks[t].start + tracks[t].end);
+      unsigned int bin[3];
+      for(unsigned int d=0; d<3; ++d)
       {
-        const FVM_Node * fvm_node = it->first;
-        if(!fvm_node) continue;
+        const double extent = hi(d) - lo(d);
+        bin[d] = extent > 0 ? std::min(n_bins-1, static_cast<unsigned int>((c(d)-lo(d))/extent*n_bins)) : 0;
+      }
+      keys[t] = std::make_pair((bin[2]*n_bins + bin[1])*n_bins + bin[0], t);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    for(unsigned int t=0; t<n_tracks; ++t)
+      order[t] = keys[t].second;
+  }
+
+  // deposition kernel of the i-th processed track: node slot and energy density,
+  // in [kernel_offset[i], kernel_offset[i+1]). track_energy is the energy integral of the kernel
+  std::vector<unsigned int> kernel_offset(1, 0);
+  std::vector<unsigned int> kernel_slot;
+  std::vector<double>       kernel_density;
+  std::vector<double>       track_energy(n_tracks, 0.0);
+
+  // the tracks are processed in blocks, the nodes near the tracks in a block are searched in one batch,
+  // nodes of track k in region r are nn_nodes[r][ nn_offset[r][k] ... ], nn_slot is the slot of each node
+  const unsigned int track_block = 1024;
+  std::vector< std::vector<unsigned int> > nn_offset(n_regions);
+  std::vector< std::vector<const Node *> > nn_nodes(n_regions);
+  std::vector< std::vector<unsigned int> > nn_slot(n_regions);
+
+  for(unsigned int t_begin=0; t_begin<n_tracks; t_begin+=track_block)
+  {
+    const unsigned int t_end = std::min(t_begin+track_block, n_tracks);
+    const unsigned int block_size = t_end - t_begin;
 
-        double energy_density = it->second;
+    std::vector<Point> p1, p2;
+    std::vector<Real>  radius;
+    for(unsigned int i=t_begin; i<t_end; ++i)
+    {
+      const track_t & track = tracks[order[i]];
+      genius_assert(track.energy > 0.0 && (track.end - track.start).size() > 0.0);
+      p1.push_back(track.start);
+      p2.push_back(track.end);
+      radius.push_back(5*track.lateral_char);
+    }
 
-        const SimulationRegion * region = _system.region(fvm_node->subdomain_id());
-        // if( region->type() != SemiconductorRegion) continue;
-        double _quan_eff = quan_eff(region);
+    // the number of kernel entries of each track
+    std::vector<unsigned int> n_entries(block_size, 0);
+    for(unsigned int r=0; r<n_regions; r++)
+    {
+      nn_locator.nearest_nodes(p1, p2, radius, r, nn_offset[r], nn_nodes[r]);
 
-        if(fvm_node && fvm_node->on_local())
+      // nodes of each track are sorted by id, the lower bound of search moves forward
+      const std::vector<unsigned int>::const_iterator begin = slots.id.begin() + slots.offset[r];
+      const std::vector<unsigned int>::const_iterator end   = slots.id.begin() + slots.offset[r+1];
+      nn_slot[r].resize(nn_nodes[r].size());
+      for(unsigned int k=0; k<block_size; ++k)
+      {
+        std::vector<unsigned int>::const_iterator lo = begin;
+        for(unsigned int n=nn_offset[r][k]; n<nn_offset[r][k+1]; ++n)
         {
-          _fvm_node_particle_deposit[fvm_node] += alpha*energy_density/_quan_eff/(_t_char/2.0*sqrt(pi)*(1+Erf((_t_max-_t0)/_t_char)));
-          //node_data->PatE() += alpha*energy_density;
-          total_energy += alpha*energy_density*fvm_node->volume();
-          region_energy[ fvm_node->subdomain_id() ] += alpha*energy_density*fvm_node->volume();
+          lo = std::lower_bound(lo, end, nn_nodes[r][n]->id());
+          if( lo != end && *lo == nn_nodes[r][n]->id() )
+          {
+            nn_slot[r][n] = lo - slots.id.begin();
+            n_entries[k]++;
+          }
+          else
+            nn_slot[r][n] = invalid_slot;
         }
       }
     }
-    else
+
+    for(unsigned int k=0; k<block_size; ++k)
+      kernel_offset.push_back(kernel_offset.back() + n_entries[k]);
+    kernel_slot.resize(kernel_offset.back());
+    kernel_density.resize(kernel_offset.back());
+
+    // evaluate the kernels, each track writes its own entries
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for(int k=0; k<static_cast<int>(block_size); ++k)
     {
-      // find the nearest node of the track
-      const FVM_Node * neraset_node=0;
-      double distance=std::numeric_limits<double>::infinity();
-      for(unsigned int r=0; r<_system.n_regions(); r++)
-      {
-        const SimulationRegion * region = _system.region(r);
-        double dist;
-        const Node * n = nn_locator->nearest_node(0.5*(track.start+track.end), r, dist);
-        if(n == NULL) continue;
+      const unsigned int i = t_begin + k;
+      const track_t & track = tracks[order[i]];
 
-        const FVM_Node * fvm_node = region->region_fvm_node(n); // may be NULL, if not on local
-        if(!fvm_node || !fvm_node->on_processor()) continue;
+      const Point track_dir = (track.end - track.start).unit(); // track direction
+      const double dEdx = track.energy/(track.end - track.start).size(); // linear energy density
+      const double lateral_char = track.lateral_char;
 
-        if( dist < distance)
+      unsigned int pos = kernel_offset[i];
+      double energy = 0.0;
+      for(unsigned int r=0; r<n_regions; r++)
+        for(unsigned int n=nn_offset[r][k]; n<nn_offset[r][k+1]; ++n)
         {
-          distance = dist;
-          neraset_node = fvm_node;
+          const unsigned int slot = nn_slot[r][n];
+          if( slot == invalid_slot ) continue;
+
+          Point loc = *nn_nodes[r][n];
+          Point loc_pp = track.start + (loc-track.start)*track_dir*track_dir;
+          Real d = (loc-loc_pp).size();
+          double e_r = exp(-d*d/(lateral_char*lateral_char));
+          double e_z = Erf((loc_pp-track.start)*track_dir/lateral_char) - Erf((loc_pp-track.end)*track_dir/lateral_char);
+          double energy_density = dEdx/(2*pi*lateral_char*lateral_char)*e_r*e_z;
+
+          kernel_slot[pos] = slot;
+          kernel_density[pos] = energy_density;
+          energy += energy_density*slots.volume[slot];
+          ++pos;
         }
+      track_energy[i] = energy;
+    }
+
+  }
+
+  // the energy integral of all the tracks in one reduction
+  Parallel::sum(track_energy);
+
+  // tracks without any node nearby deposit all the energy to the nearest node
+  std::vector<unsigned int> lost_tracks;
+  for(unsigned int i=0; i<n_tracks; ++i)
+    if( !(track_energy[i] > 0.0) ) lost_tracks.push_back(i);
+
+  std::vector<unsigned int> lost_slot(lost_tracks.size(), invalid_slot);
+  std::vector<double> lost_distance(lost_tracks.size(), std::numeric_limits<double>::infinity());
+  for(unsigned int l=0; l<lost_tracks.size(); ++l)
+  {
+    const track_t & track = tracks[order[lost_tracks[l]]];
+    for(unsigned int r=0; r<n_regions; r++)
+    {
+      double dist;
+      const Node * n = nn_locator.nearest_node(0.5*(track.start+track.end), r, dist);
+      if(n == NULL) continue;
+
+      // not on processor
+      const unsigned int slot = slots.find(r, n->id());
+      if( slot == invalid_slot ) continue;
+
+      if( dist < lost_distance[l] )
+      {
+        lost_distance[l] = dist;
+        lost_slot[l] = slot;
       }
+    }
+  }
 
-      double min_distance=distance;
-      Parallel::min(min_distance);
+  std::vector<double> min_distance(lost_distance);
+  Parallel::min(min_distance);
 
-      if( min_distance == distance && neraset_node)
+  // deposit the normalized kernels. tracks are split into one block for each thread,
+  // each block has its own accumulator and the accumulators are merged in block order
+  {
+    const unsigned int n_blocks = Threads::n_threads();
+    std::vector<unsigned int> block_offset;
+    Threads::block_partition(n_tracks, n_blocks, block_offset);
+    std::vector< std::vector<double> > block_energy_density(n_blocks);
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static, 1)
+#endif
+    for(int b=0; b<static_cast<int>(n_blocks); ++b)
+    {
+      std::vector<double> & energy_density = block_energy_density[b];
+      energy_density.resize(n_slots, 0.0);
+      for(unsigned int i=block_offset[b]; i<block_offset[b+1]; ++i)
       {
-        const SimulationRegion * region = _system.region(neraset_node->subdomain_id());
-        double _quan_eff = quan_eff(region);
-
-        double energy_density = track.energy/neraset_node->volume();
-        _fvm_node_particle_deposit[neraset_node] += energy_density/_quan_eff/(_t_char/2.0*sqrt(pi)*(1+Erf((_t_max-_t0)/_t_char)));
-        //node_data->PatE() += energy_density;
-        total_energy += track.energy;
-        region_energy[neraset_node->subdomain_id()] += track.energy;
+        if( !(track_energy[i] > 0.0) ) continue;
+        const double alpha = tracks[order[i]].energy/track_energy[i]; //used for keep energy conservation
+        for(unsigned int e=kernel_offset[i]; e<kernel_offset[i+1]; ++e)
+          energy_density[kernel_slot[e]] += alpha*kernel_density[e];
       }
     }
 
+    for(unsigned int b=0; b<n_blocks; ++b)
+      for(unsigned int n=0; n<n_slots; ++n)
+        slot_energy_density[n] += block_energy_density[b][n];
   }
 
-  MESSAGE<< "ok" <<std::endl;
-  RECORD();
-
-  STOP_LOG("update_source()", "Particle_Source_Track");
+  for(unsigned int l=0; l<lost_tracks.size(); ++l)
+  {
+    if( lost_slot[l] == invalid_slot || min_distance[l] != lost_distance[l] ) continue;
+    const unsigned int slot = lost_slot[l];
+    slot_energy_density[slot] += tracks[order[lost_tracks[l]]].energy/slots.volume[slot];
+  }
 
 }
 
@@ -19,6 +19,13 @@
 /*                                                                              */
 /********************************************************************************/
 #include <numeric>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <cmath>
 
 
 #include "dose_rate.h"
@@ -27,6 +34,9 @@
 #include "boundary_info.h"
 #include "mesh_tools.h"
 #include "parallel.h"
+#include "threads.h"
+#include "perf_log.h"
+#include "log.h"
 #include "physical_unit.h"
 
 
@@ -35,50 +45,329 @@ using PhysicalUnit::mm;
 using PhysicalUnit::kg;
 
 
-std::vector<double> DoseRate::density;
-std::vector<double> DoseRate::constrain;
-double DoseRate::min_leaf=0.0;
+namespace {
+
+  /**
+   * magic string of the octree file
+   */
+  const char dose_rate_magic[8] = "GDOSE02";
+
+  /**
+   * the refine criterion of dose rate octree
+   */
+  class DoseRateRefinement : public LinearOcTree::Refinement
+  {
+  public:
+    DoseRateRefinement(const std::vector<unsigned int> & subdomain, const std::vector<double> & constrain, double min_leaf)
+      : _subdomain(subdomain), _constrain(constrain), _min_leaf(min_leaf)
+    {}
+
+    bool refine(const LinearOcTree & tree, unsigned int level, const unsigned int * begin, const unsigned int * end) const
+    {
+      const unsigned int n_elems = end - begin;
+      const double volume = tree.cell_volume(level);
+
+      // too many elems
+      if(n_elems > 30) return true;
+
+      if(n_elems>1 && volume > std::pow(_min_leaf, 3.0)) return true;
+
+      // size constrain
+      std::set<unsigned int> subdomain;
+      for(const unsigned int * it=begin; it!=end; ++it)
+        subdomain.insert(_subdomain[*it]);
+      if(subdomain.size() >= 2)
+      {
+        double length = 1e30;
+        std::set<unsigned int>::const_iterator  it = subdomain.begin();
+        for(; it != subdomain.end(); ++it)
+          length = std::min(length, _constrain[*it]);
+
+        if( volume > length*length*length ) return true;
+      }
+
+      // no refine needed
+      return false;
+    }
+
+  private:
+    const std::vector<unsigned int> & _subdomain;
+    const std::vector<double> & _constrain;
+    const double _min_leaf;
+  };
+
+}
 
 
 DoseRate::DoseRate(const SimulationSystem & system )
-  : _system(system), _mesh(system.mesh())
+  : _system(system), _mesh(system.mesh()), _min_leaf(1.0*mm), _built_min_leaf(-1.0)
+{}
+
+
+DoseRate::~DoseRate()
+{}
+
+
+
+void DoseRate::refine()
 {
+  if( !_octree.empty() && _built_min_leaf == _min_leaf ) return;
+
+  START_LOG("refine()", "DoseRate");
+
+  // load the octree on the first processor and broadcast it
+  bool loaded = false;
+  unsigned long long mesh_signature = 0;
+  if( !_octree_file.empty() )
+  {
+    mesh_signature = this->_mesh_signature();
+
+    std::vector<char> buffer;
+    if( Genius::processor_id() == 0 )
+    {
+      std::ifstream in(_octree_file.c_str(), std::ios::in | std::ios::binary);
+      if( in.good() )
+        buffer.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+    }
+    Parallel::broadcast(buffer);
+
+    if( !buffer.empty() )
+    {
+      std::istringstream in( std::string(buffer.begin(), buffer.end()) );
+      loaded = this->_read_octree(in, mesh_signature);
+    }
+  }
 
-  DoseRate::build_region_density(system);
+  if( !loaded )
+  {
+    this->_build_octree();
+
+    if( !_octree_file.empty() && Genius::processor_id() == 0 )
+    {
+      std::ofstream out(_octree_file.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      if( out.good() )
+        this->_write_octree(out, mesh_signature);
+      out.close();
+      // a truncated file fails the checks of _read_octree, the octree is rebuilt next time
+      if( out.fail() )
+      {
+        MESSAGE<<"Warning: failed to write dose rate octree to file " << _octree_file << ".\n"; RECORD();
+      }
+    }
+  }
+
+  _built_min_leaf = _min_leaf;
+  _electron_energy.assign(_octree.n_leaves(), 0.0);
+
+  STOP_LOG("refine()", "DoseRate");
+}
 
-  DoseRate::build_mesh_constrain(system.mesh());
 
-  min_leaf = 1.0*mm;
 
+void DoseRate::_root_box(Point &low, Real &size) const
+{
   // mesh bounding box
   std::pair<Point, Point> bbox = MeshTools::global_bounding_box(_mesh);
 
   const Point cent = 0.5*(bbox.second + bbox.first);
   const Real  rad  = 0.5*(bbox.second - bbox.first).size();
 
-  Point low  = cent - Point(rad, rad, rad);
-  Point high = cent + Point(rad, rad, rad);
+  low  = cent - Point(rad, rad, rad);
+  size = 2*rad;
+}
+
+
+
+void DoseRate::_build_octree()
+{
+  this->build_region_density();
+
+  this->build_mesh_constrain();
+
+  Point low;
+  Real size;
+  this->_root_box(low, size);
+
+  std::vector<CElem> elems;
+  this->mesh_elem(elems);
+
+  std::vector<Point> center(elems.size());
+  std::vector<unsigned int> subdomain(elems.size());
+  for(unsigned int n=0; n<elems.size(); ++n)
+  {
+    center[n] = elems[n].center;
+    subdomain[n] = elems[n].subdomain;
+  }
+  std::vector<CElem>().swap(elems);
+
+  // start with 3 levels of uniform subdivision as before
+  _octree.reinit(low, size);
+  _octree.build(center, DoseRateRefinement(subdomain, _constrain, _min_leaf), 3);
+  _octree.balance();
 
-  OcTreeDataDoseRate * root_data = new OcTreeDataDoseRate();
-  this->mesh_elem(root_data->elems);
-  root_data->calculate_density();
+  // weighted density of the elems in the leaf. leaf without elem (or with zero density)
+  // takes the value of its nearest ancestor which has, the ancestor values are cached
+  // since neighbor leaves share them
+  std::map<std::pair<LinearOcTree::key_type, unsigned int>, double> cell_density;
+  const std::vector<unsigned int> & order = _octree.item_order();
 
-  _octree = new OcTree(low, high, root_data, 3);
-  _octree->refine();
+  _weighted_density.assign(_octree.n_leaves(), 0.0);
+  for(unsigned int i=0; i<_octree.n_leaves(); ++i)
+  {
+    for(int level=_octree.level(i); level>=0; --level)
+    {
+      const LinearOcTree::key_type key = LinearOcTree::ancestor_key(_octree.key(i), level);
+      const std::pair<LinearOcTree::key_type, unsigned int> cell(key, level);
+
+      double weighted_density;
+      if( cell_density.find(cell) != cell_density.end() )
+        weighted_density = cell_density.find(cell)->second;
+      else
+      {
+        const std::pair<unsigned int, unsigned int> range = _octree.cell_items(key, level);
+
+        std::vector<unsigned int> n_elems(_density.size(), 0);
+        for(unsigned int n=range.first; n<range.second; n++)
+          n_elems[subdomain[order[n]]]++;
+
+        const unsigned int total_elems = range.second - range.first;
+
+        weighted_density = 0.0;
+        for(unsigned int n=0; n<_density.size(); ++n)
+          weighted_density += _density[n]*n_elems[n]/(1e-10+total_elems);
+
+        if( static_cast<unsigned int>(level) < _octree.level(i) )
+          cell_density[cell] = weighted_density;
+      }
+
+      if( weighted_density > 0.0 )
+      {
+        _weighted_density[i] = weighted_density;
+        break;
+      }
+    }
+  }
 
+  _octree.release_items();
 }
 
 
-DoseRate::~DoseRate()
+
+unsigned long long DoseRate::_mesh_signature() const
+{
+  // FNV-1a hash of each elem: id, subdomain, type and its nodes (id and coordinates).
+  // the elem hashes are summed, which does not depend on the order or partition of the elems
+  const unsigned long long fnv_offset = 14695981039346656037ULL;
+  const unsigned long long fnv_prime  = 1099511628211ULL;
+
+  unsigned long long signature = 0;
+
+  MeshBase::const_element_iterator       el  = _mesh.this_pid_elements_begin();
+  const MeshBase::const_element_iterator end = _mesh.this_pid_elements_end();
+  for (; el != end; ++el)
+  {
+    const Elem * elem = *el;
+
+    std::vector<unsigned int> id;
+    std::vector<double> location;
+    id.push_back(elem->id());
+    id.push_back(elem->subdomain_id());
+    id.push_back(elem->type());
+    for(unsigned int n=0; n<elem->n_nodes(); ++n)
+    {
+      const Node * node = elem->get_node(n);
+      id.push_back(node->id());
+      location.push_back((*node)(0));
+      location.push_back((*node)(1));
+      location.push_back((*node)(2));
+    }
+
+    unsigned long long hash = fnv_offset;
+    const unsigned char * b = reinterpret_cast<const unsigned char *>(&id[0]);
+    for(unsigned int i=0; i<id.size()*sizeof(unsigned int); ++i)
+      hash = (hash ^ b[i])*fnv_prime;
+    b = reinterpret_cast<const unsigned char *>(&location[0]);
+    for(unsigned int i=0; i<location.size()*sizeof(double); ++i)
+      hash = (hash ^ b[i])*fnv_prime;
+
+    signature += hash;
+  }
+
+  Parallel::sum(signature);
+  return signature;
+}
+
+
+
+void DoseRate::_write_octree(std::ostream &out, unsigned long long mesh_signature) const
 {
-  delete _octree;
+  out.write(dose_rate_magic, sizeof(dose_rate_magic));
+
+  // structure signature
+  out.write(reinterpret_cast<const char *>(&mesh_signature), sizeof(mesh_signature));
+  const unsigned int n_elem = _mesh.n_elem();
+  const unsigned int n_subdomains = _mesh.n_subdomains();
+  const unsigned int n_regions = _density.size();
+  out.write(reinterpret_cast<const char *>(&n_elem), sizeof(n_elem));
+  out.write(reinterpret_cast<const char *>(&n_subdomains), sizeof(n_subdomains));
+  out.write(reinterpret_cast<const char *>(&_min_leaf), sizeof(_min_leaf));
+  out.write(reinterpret_cast<const char *>(&n_regions), sizeof(n_regions));
+  if( n_regions )
+    out.write(reinterpret_cast<const char *>(&_density[0]), n_regions*sizeof(double));
+
+  _octree.write(out);
+
+  if( !_weighted_density.empty() )
+    out.write(reinterpret_cast<const char *>(&_weighted_density[0]), _weighted_density.size()*sizeof(double));
 }
 
 
 
-void DoseRate::refine()
+bool DoseRate::_read_octree(std::istream &in, unsigned long long mesh_signature)
 {
-  _octree->refine();
+  char magic[sizeof(dose_rate_magic)];
+  in.read(magic, sizeof(magic));
+  if( !in.good() || !std::equal(magic, magic+sizeof(magic), dose_rate_magic) ) return false;
+
+  unsigned long long signature;
+  in.read(reinterpret_cast<char *>(&signature), sizeof(signature));
+  if( !in.good() || signature != mesh_signature ) return false;
+
+  unsigned int n_elem, n_subdomains, n_regions;
+  double min_leaf;
+  in.read(reinterpret_cast<char *>(&n_elem), sizeof(n_elem));
+  in.read(reinterpret_cast<char *>(&n_subdomains), sizeof(n_subdomains));
+  in.read(reinterpret_cast<char *>(&min_leaf), sizeof(min_leaf));
+  in.read(reinterpret_cast<char *>(&n_regions), sizeof(n_regions));
+  if( !in.good() ) return false;
+
+  if( n_elem != _mesh.n_elem() || n_subdomains != _mesh.n_subdomains() ) return false;
+  if( std::abs(min_leaf - _min_leaf) > 1e-10*_min_leaf ) return false;
+  if( n_regions != _system.n_regions() ) return false;
+
+  std::vector<double> density(n_regions);
+  if( n_regions )
+    in.read(reinterpret_cast<char *>(&density[0]), n_regions*sizeof(double));
+  for(unsigned int r=0; r<n_regions; r++)
+    if( density[r] != _system.region(r)->get_density() ) return false;
+
+  LinearOcTree octree;
+  if( !octree.read(in) ) return false;
+
+  // the root box is decided by the mesh
+  Point low;
+  Real size;
+  this->_root_box(low, size);
+  if( (octree.low() - low).size() > 1e-10*size || std::abs(octree.size() - size) > 1e-10*size ) return false;
+
+  std::vector<double> weighted_density(octree.n_leaves());
+  in.read(reinterpret_cast<char *>(&weighted_density[0]), weighted_density.size()*sizeof(double));
+  if( !in.good() ) return false;
+
+  _density.swap(density);
+  _octree = octree;
+  _weighted_density.swap(weighted_density);
+  return true;
 }
 
 
@@ -88,75 +377,90 @@ void DoseRate::energy_deposite(const Point &p1, const Point &p2, double e)
   const double length = (p2-p1).size();
   if(length == 0.0) return;
 
-  std::vector<std::pair<OcTreeNode, double> > result;
-  _octree->intersect(p1, p2, result);
+  genius_assert(!_octree.empty());
 
-  for(unsigned int n=0; n<result.size(); ++n)
-  {
-    const OcTreeNode & node = result[n].first;
-    const double l = result[n].second;
+  std::vector<std::pair<unsigned int, Real> > result;
+  _octree.intersect(p1, p2, result);
 
-    OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(node.data());
-    dose_rate->electron_energy += e*l/length;
-  }
+  for(unsigned int n=0; n<result.size(); ++n)
+    _electron_energy[result[n].first] += e*result[n].second/length;
 }
 
 
 
-void DoseRate::sync_energy_deposite()
+void DoseRate::energy_deposite(const std::vector<Point> &p1, const std::vector<Point> &p2, const std::vector<double> &e)
 {
-  std::vector<double> energy;
-  OcTree::tree_leaf_iterator leaf_it = _octree->begin_leaf();
-  for ( ; leaf_it != _octree->end_leaf(); ++leaf_it )
+  genius_assert(p1.size() == p2.size() && p1.size() == e.size());
+  genius_assert(!_octree.empty());
+  if(p1.empty()) return;
+
+  START_LOG("energy_deposite()", "DoseRate");
+
+  // each block records the (leaf, energy) it deposited, and the blocks are
+  // merged in block order. the buffers scale with the tracks, not the leaves
+  const unsigned int n_blocks = Threads::n_threads();
+  std::vector<unsigned int> block_offset;
+  Threads::block_partition(p1.size(), n_blocks, block_offset);
+  std::vector< std::vector<std::pair<unsigned int, double> > > block_deposite(n_blocks);
+
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static, 1)
+#endif
+  for(int b=0; b<static_cast<int>(n_blocks); ++b)
   {
-    OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(leaf_it->data());
-    energy.push_back(dose_rate->electron_energy);
+    std::vector<std::pair<unsigned int, double> > & deposite = block_deposite[b];
+    std::vector<std::pair<unsigned int, Real> > result;
+    for(unsigned int i=block_offset[b]; i<block_offset[b+1]; ++i)
+    {
+      const double length = (p2[i]-p1[i]).size();
+      if(length == 0.0) continue;
+
+      result.clear();
+      _octree.intersect(p1[i], p2[i], result);
+      for(unsigned int n=0; n<result.size(); ++n)
+        deposite.push_back( std::make_pair(result[n].first, e[i]*result[n].second/length) );
+    }
   }
-  Parallel::sum(energy);
 
-  leaf_it = _octree->begin_leaf();
-  for (unsigned int n=0 ; leaf_it != _octree->end_leaf(); ++leaf_it, ++n )
+  for(unsigned int b=0; b<n_blocks; ++b)
   {
-    OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(leaf_it->data());
-    dose_rate->electron_energy = energy[n];
+    const std::vector<std::pair<unsigned int, double> > & deposite = block_deposite[b];
+    for(unsigned int n=0; n<deposite.size(); ++n)
+      _electron_energy[deposite[n].first] += deposite[n].second;
   }
+
+  STOP_LOG("energy_deposite()", "DoseRate");
+}
+
+
+
+void DoseRate::sync_energy_deposite()
+{
+  Parallel::sum(_electron_energy);
 }
 
 
 
 void DoseRate::clear_energy_deposite()
 {
-  OcTree::tree_leaf_iterator leaf_it = _octree->begin_leaf();
-  for ( ; leaf_it != _octree->end_leaf(); ++leaf_it )
-  {
-    OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(leaf_it->data());
-    dose_rate->electron_energy = 0.0;
-  }
+  std::fill(_electron_energy.begin(), _electron_energy.end(), 0.0);
 }
 
 
 double DoseRate::total_energy() const
 {
-  double energy = 0.0;
-  OcTree::tree_leaf_iterator leaf_it = _octree->begin_leaf();
-  for ( ; leaf_it != _octree->end_leaf(); ++leaf_it )
-  {
-    OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(leaf_it->data());
-    energy += dose_rate->electron_energy;
-  }
-  return energy;
+  return std::accumulate(_electron_energy.begin(), _electron_energy.end(), 0.0);
 }
 
 
 
 double DoseRate::energy_deposite_density(const Point & p) const
 {
-  OcTree::tree_iterator_base it = _octree->find_leaf_has_point(p);
-  double volume = it->volume();
+  const unsigned int leaf = _octree.find_leaf(p);
+  if( leaf == invalid_uint || _electron_energy.empty() ) return 0.0;
 
-  OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(it->data());
-  if(dose_rate->weighted_density > 0.0)
-    return dose_rate->electron_energy/volume/dose_rate->weighted_density;
+  if(_weighted_density[leaf] > 0.0)
+    return _electron_energy[leaf]/_octree.volume(leaf)/_weighted_density[leaf];
   return 0.0;
 }
 
@@ -164,21 +468,14 @@ double DoseRate::energy_deposite_density(const Point & p) const
 
 void DoseRate::export_vtk(const std::string &file)
 {
-  /*
-  double energy = 0.0;
-  for(double x=0.0*um; x<=3.0*um; x+=0.001*um)
-    for(double z=0.0*um; z<=0.2*um; z+=0.001*um)
+  if(Genius::processor_id() == 0)
   {
-      energy_deposite(Point(x, 0.1*um, z), Point(x, 2*um, z), 100.0);
-      energy += 100.0;
+    std::vector<Real> value(_octree.n_leaves(), 0.0);
+    for(unsigned int i=0; i<value.size() && i<_electron_energy.size(); ++i)
+      if(_weighted_density[i] > 0.0)
+        value[i] = _electron_energy[i]/_weighted_density[i]/_octree.volume(i);
+    _octree.export_vtk(file, value);
   }
-
-
-  sync_energy_deposite();
-  */
-
-  if(Genius::processor_id() == 0)
-    _octree->export_vtk(file);
 }
 
 
@@ -186,52 +483,45 @@ void DoseRate::export_vtk(const std::string &file)
 
 void DoseRate::particle_endpoint(const Point &p)
 {
-  OcTree::tree_iterator_base it = _octree->find_leaf_has_point(p);
-  if( it.node==0 ) return;
-  OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(it->data());
-  dose_rate->electron_endpoint.push_back(p);
+  if( _octree.find_leaf(p) == invalid_uint ) return;
+  _electron_endpoint.push_back(p);
 }
 
 
 void DoseRate::clear_particle_endpoint()
 {
-  OcTree::tree_leaf_iterator leaf_it = _octree->begin_leaf();
-  for ( ; leaf_it != _octree->end_leaf(); ++leaf_it )
-  {
-    OcTreeDataDoseRate * dose_rate = dynamic_cast<OcTreeDataDoseRate *>(leaf_it->data());
-    dose_rate->electron_endpoint.clear();
-  }
+  _electron_endpoint.clear();
 }
 
 
 
-void DoseRate::build_mesh_constrain(const MeshBase & mesh)
+void DoseRate::build_mesh_constrain()
 {
-  constrain.clear();
-  constrain.resize(mesh.n_subdomains(), 1e30);
+  _constrain.clear();
+  _constrain.resize(_mesh.n_subdomains(), 1e30);
 
   std::vector<unsigned int>       el;
   std::vector<unsigned short int> sl;
   std::vector<short int>          il;
-  mesh.boundary_info->build_on_processor_side_list(el, sl, il);
+  _mesh.boundary_info->build_on_processor_side_list(el, sl, il);
   for(unsigned int n=0; n<el.size(); n++)
   {
-    const Elem * elem = mesh.elem(el[n]);
-    constrain[elem->subdomain_id()] = std::min(constrain[elem->subdomain_id()] ,elem->hmin());
+    const Elem * elem = _mesh.elem(el[n]);
+    _constrain[elem->subdomain_id()] = std::min(_constrain[elem->subdomain_id()] ,elem->hmin());
   }
 
-  Parallel::min(constrain);
+  Parallel::min(_constrain);
 }
 
 
-void DoseRate::build_region_density(const SimulationSystem & system)
+void DoseRate::build_region_density()
 {
-  density.clear();
+  _density.clear();
   // density of each region
-  for(unsigned int r=0; r<system.n_regions(); r++)
+  for(unsigned int r=0; r<_system.n_regions(); r++)
   {
-    const SimulationRegion * region = system.region(r);
-    density.push_back(region->get_density());
+    const SimulationRegion * region = _system.region(r);
+    _density.push_back(region->get_density());
   }
 }
 
@@ -271,106 +561,3 @@ void DoseRate::mesh_elem(std::vector<CElem> &elems) const
   }
 }
 
-
-//------------------------------------------------------------------------------------------------
-
-std::vector<OcTreeDataBase *> DoseRate::OcTreeDataDoseRate::subdivide(const OcTreeNode & node)
-{
-  std::vector<OcTreeDataDoseRate *> child;
-  for(unsigned int n=0; n<8; ++n)
-    child.push_back(new OcTreeDataDoseRate());
-
-  for( unsigned int e=0; e<elems.size(); ++e)
-  {
-    const Point & center = elems[e].center;
-    OcTreeLocation loc = node.get_sub_location(center);
-    if(loc.key() != -1)
-      child[loc.key()]->elems.push_back(elems[e]);
-  }
-
-
-  for( unsigned int e=0; e<electron_endpoint.size(); ++e)
-  {
-    const Point & p = electron_endpoint[e];
-    OcTreeLocation loc = node.get_sub_location(p);
-    if(loc.key() != -1)
-      child[loc.key()]->electron_endpoint.push_back(p);
-  }
-
-
-  for(unsigned int n=0; n<child.size(); ++n)
-  {
-    child[n]->calculate_density();
-    if(child[n]->weighted_density == 0.0)
-      child[n]->weighted_density = this->weighted_density;
-  }
-
-  for(unsigned int n=0; n<child.size(); ++n)
-    child[n]->electron_energy = electron_energy/8.0;
-
-  elems.clear();
-  electron_endpoint.clear();
-  electron_energy = 0.0;
-
-  std::vector<OcTreeDataBase *> ret;
-  for(unsigned int n=0; n<child.size(); ++n)
-    ret.push_back((OcTreeDataBase *)child[n]);
-  return ret;
-}
-
-
-bool DoseRate::OcTreeDataDoseRate::refine(const OcTreeNode & node, const std::vector<OcTreeNode> &neighbor) const
-{
-  // too many elems
-  if(elems.size() > 30) return true;
-
-
-  if(elems.size()>1 && node.volume() > std::pow(DoseRate::min_leaf, 3.0)) return true;
-
-
-  // size constrain
-  std::set<unsigned int> subdomain;
-  for(unsigned int n=0; n<elems.size(); ++n)
-    subdomain.insert(elems[n].subdomain);
-  if(subdomain.size() >= 2)
-  {
-    double length = 1e30;
-    std::set<unsigned int>::const_iterator  it = subdomain.begin();
-    for(; it != subdomain.end(); ++it)
-      length = std::min(length, DoseRate::constrain[*it]);
-
-    if( node.volume() > length*length*length ) return true;
-  }
-
-
-  // stop electron
-
-
-  // no refine needed
-  return false;
-}
-
-
-double DoseRate::OcTreeDataDoseRate::value(const std::string &) const
-{
-  if(weighted_density > 0.0)
-    return electron_energy/weighted_density;
-  return 0.0;
-}
-
-
-void DoseRate::OcTreeDataDoseRate::calculate_density()
-{
-  std::vector<unsigned int> n_elems(DoseRate::density.size(), 0);
-  for(unsigned int n=0; n<elems.size(); n++)
-    n_elems[elems[n].subdomain]++;
-
-  unsigned int total_elems = std::accumulate(n_elems.begin(), n_elems.end(), 0 );
-
-  weighted_density = 0.0;
-  for(unsigned int n=0; n<DoseRate::density.size(); ++n)
-    weighted_density += DoseRate::density[n]*n_elems[n]/(1e-10+total_elems);
-
-}
-
-
@@ -0,0 +1,686 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+
+// Local includes
+#include "elem.h"
+#include "mesh_base.h"
+#include "boundary_info.h"
+#include "elem_intersection.h"
+#include "elem_bvh.h"
+
+
+namespace {
+
+  /**
+   * max depth of the tree, the traversal stack has fixed size
+   */
+  const unsigned int bvh_max_depth = 64;
+
+  /**
+   * SAH split is used above this depth, median split below it
+   * keeps the depth bounded
+   */
+  const unsigned int bvh_sah_depth = 24;
+
+  /**
+   * number of bins for SAH
+   */
+  const unsigned int bvh_n_bins = 16;
+
+  /**
+   * order element index by centroid on axis
+   */
+  struct CentroidLess
+  {
+    CentroidLess(const std::vector<Real> & c, unsigned int a) : centroid(c), axis(a) {}
+    bool operator() (unsigned int a, unsigned int b) const
+    { return centroid[3*a+axis] < centroid[3*b+axis]; }
+    const std::vector<Real> & centroid;
+    unsigned int axis;
+  };
+
+  /**
+   * the bin of element centroid on axis
+   */
+  struct CentroidBin
+  {
+    CentroidBin(const std::vector<Real> & c, unsigned int a, Real cmin, Real scale) :
+        centroid(c), axis(a), _cmin(cmin), _scale(scale) {}
+    unsigned int operator() (unsigned int e) const
+    { return std::min(bvh_n_bins-1, static_cast<unsigned int>((centroid[3*e+axis]-_cmin)*_scale)); }
+    const std::vector<Real> & centroid;
+    unsigned int axis;
+    Real _cmin;
+    Real _scale;
+  };
+
+  /**
+   * true when element centroid lies in bins [0, split]
+   */
+  struct CentroidBinLeft
+  {
+    CentroidBinLeft(const CentroidBin & b, unsigned int s) : bin(b), split(s) {}
+    bool operator() (unsigned int e) const
+    { return bin(e) <= split; }
+    CentroidBin bin;
+    unsigned int split;
+  };
+
+  /**
+   * half surface area of box, perimeter in 2D
+   */
+  inline Real box_area(const Real *min, const Real *max, unsigned int dim)
+  {
+    const Real dx = max[0]-min[0];
+    const Real dy = max[1]-min[1];
+    const Real dz = max[2]-min[2];
+    if( dim == 2 ) return dx + dy;
+    return dx*dy + dy*dz + dz*dx;
+  }
+
+  /**
+   * spread the lower bits of x for Morton code, every 3rd bit
+   */
+  inline unsigned int spread_bits_3(unsigned int x)
+  {
+    x &= 0x000003ff;
+    x = (x | (x << 16)) & 0xff0000ff;
+    x = (x | (x <<  8)) & 0x0300f00f;
+    x = (x | (x <<  4)) & 0x030c30c3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+  }
+
+  /**
+   * spread the lower bits of x for Morton code, every 2nd bit
+   */
+  inline unsigned int spread_bits_2(unsigned int x)
+  {
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+  }
+}
+
+
+
+ElemBVH::ElemBVH (const MeshBase& mesh, Trees::BuildType type, unsigned int leaf_size)
+  : _dim(mesh.mesh_dimension() == 3 ? 3 : 2), _leaf_size(std::max(1u, leaf_size))
+{
+  switch(type)
+  {
+    case Trees::NODES    :
+    case Trees::ELEMENTS :
+    {
+      MeshBase::const_element_iterator       it  = mesh.active_elements_begin();
+      const MeshBase::const_element_iterator end = mesh.active_elements_end();
+      for (; it != end; ++it)
+        _elems.push_back(*it);
+      break;
+    }
+    case Trees::ELEMENTS_ON_BOUNDARY :
+    {
+      MeshBase::const_element_iterator       it  = mesh.active_elements_begin();
+      const MeshBase::const_element_iterator end = mesh.active_elements_end();
+      for (; it != end; ++it)
+        if((*it)->on_boundary())
+          _elems.push_back(*it);
+      break;
+    }
+    case Trees::ELEMENTS_ON_SURFACE :
+    {
+      MeshBase::const_element_iterator       it  = mesh.active_elements_begin();
+      const MeshBase::const_element_iterator end = mesh.active_elements_end();
+      for (; it != end; ++it)
+        if((*it)->on_boundary() || (*it)->on_interface())
+          _elems.push_back(*it);
+      break;
+    }
+    case Trees::SURFACE_ELEMENTS :
+    {
+      std::vector<unsigned int>       elems;
+      std::vector<unsigned short int> sides;
+      std::vector<short int>          bds;
+      mesh.boundary_info->build_active_side_list (elems, sides, bds);
+
+      for(unsigned int n=0; n<elems.size(); ++n)
+      {
+        const Elem * surface_elem = mesh.elem(elems[n])->build_side(sides[n], false).release();
+        _elems.push_back(surface_elem);
+        _surface_elems.push_back(surface_elem);
+      }
+      break;
+    }
+    default: genius_error();
+  }
+
+  this->_build();
+}
+
+
+
+ElemBVH::ElemBVH (const std::vector<const Elem *> & elems, unsigned int dim, unsigned int leaf_size)
+  : _elems(elems), _dim(dim == 3 ? 3 : 2), _leaf_size(std::max(1u, leaf_size))
+{
+  this->_build();
+}
+
+
+
+ElemBVH::~ElemBVH()
+{
+  for(unsigned int n=0; n<_surface_elems.size(); ++n)
+    delete _surface_elems[n];
+  _surface_elems.clear();
+}
+
+
+
+void ElemBVH::_build()
+{
+  const unsigned int n_elems = _elems.size();
+
+  _nodes.clear();
+  if( n_elems == 0 ) return;
+
+  // bounding box and centroid of each element
+  std::vector<Real> bmin(3*n_elems), bmax(3*n_elems), centroid(3*n_elems);
+  Real root_min[3] = { 1e30,  1e30,  1e30};
+  Real root_max[3] = {-1e30, -1e30, -1e30};
+  for(unsigned int e=0; e<n_elems; ++e)
+  {
+    const Elem * elem = _elems[e];
+    for(unsigned int d=0; d<3; ++d)
+    { bmin[3*e+d] = 1e30; bmax[3*e+d] = -1e30; }
+
+    for(unsigned int i=0; i<elem->n_nodes(); ++i)
+    {
+      const Point & p = elem->point(i);
+      for(unsigned int d=0; d<3; ++d)
+      {
+        bmin[3*e+d] = std::min(bmin[3*e+d], p(d));
+        bmax[3*e+d] = std::max(bmax[3*e+d], p(d));
+      }
+    }
+
+    for(unsigned int d=0; d<3; ++d)
+    {
+      centroid[3*e+d] = 0.5*(bmin[3*e+d] + bmax[3*e+d]);
+      root_min[d] = std::min(root_min[d], bmin[3*e+d]);
+      root_max[d] = std::max(root_max[d], bmax[3*e+d]);
+    }
+  }
+
+  // enlarge the element box a bit, points/rays on element surface should not be missed
+  Real diag = 0;
+  for(unsigned int d=0; d<3; ++d)
+    diag = std::max(diag, root_max[d] - root_min[d]);
+  const Real pad = 1e-10*diag + 1e-30;
+  for(unsigned int k=0; k<3*n_elems; ++k)
+  { bmin[k] -= pad; bmax[k] += pad; }
+
+  std::vector<unsigned int> index(n_elems);
+  for(unsigned int e=0; e<n_elems; ++e)
+    index[e] = e;
+
+  _nodes.reserve(2*(n_elems/_leaf_size+1));
+  this->_build_node(0, n_elems, 0, index, bmin, bmax, centroid);
+
+  // elements in the order of leaves
+  std::vector<const Elem *> elems(n_elems);
+  for(unsigned int e=0; e<n_elems; ++e)
+    elems[e] = _elems[index[e]];
+  _elems.swap(elems);
+}
+
+
+
+unsigned int ElemBVH::_build_node(unsigned int begin, unsigned int end, unsigned int depth,
+                                  std::vector<unsigned int> & index,
+                                  const std::vector<Real> & bmin, const std::vector<Real> & bmax,
+                                  const std::vector<Real> & centroid)
+{
+  const unsigned int node_index = _nodes.size();
+  _nodes.push_back(BVHNode());
+
+  BVHNode node;
+  Real cmin[3] = { 1e30,  1e30,  1e30};
+  Real cmax[3] = {-1e30, -1e30, -1e30};
+  for(unsigned int d=0; d<3; ++d)
+  { node.min[d] = 1e30; node.max[d] = -1e30; }
+  for(unsigned int k=begin; k<end; ++k)
+  {
+    const unsigned int e = index[k];
+    for(unsigned int d=0; d<3; ++d)
+    {
+      node.min[d] = std::min(node.min[d], bmin[3*e+d]);
+      node.max[d] = std::max(node.max[d], bmax[3*e+d]);
+      cmin[d] = std::min(cmin[d], centroid[3*e+d]);
+      cmax[d] = std::max(cmax[d], centroid[3*e+d]);
+    }
+  }
+
+  // split along the longest axis of centroids
+  unsigned int axis = 0;
+  for(unsigned int d=1; d<_dim; ++d)
+    if( cmax[d]-cmin[d] > cmax[axis]-cmin[axis] ) axis = d;
+  const Real extent = cmax[axis]-cmin[axis];
+
+  const unsigned int count = end - begin;
+  if( count <= _leaf_size || extent <= 0 || depth+1 >= bvh_max_depth )
+  {
+    node.offset = begin;
+    node.count  = count;
+    _nodes[node_index] = node;
+    return node_index;
+  }
+
+  unsigned int mid = begin + count/2;
+  bool sah_split = false;
+
+  if( depth < bvh_sah_depth )
+  {
+    // binned SAH
+    CentroidBin bin(centroid, axis, cmin[axis], bvh_n_bins*(1-1e-6)/extent);
+    unsigned int bin_count[bvh_n_bins];
+    Real bin_min[bvh_n_bins][3], bin_max[bvh_n_bins][3];
+    for(unsigned int b=0; b<bvh_n_bins; ++b)
+    {
+      bin_count[b] = 0;
+      for(unsigned int d=0; d<3; ++d)
+      { bin_min[b][d] = 1e30; bin_max[b][d] = -1e30; }
+    }
+    for(unsigned int k=begin; k<end; ++k)
+    {
+      const unsigned int e = index[k];
+      const unsigned int b = bin(e);
+      bin_count[b]++;
+      for(unsigned int d=0; d<3; ++d)
+      {
+        bin_min[b][d] = std::min(bin_min[b][d], bmin[3*e+d]);
+        bin_max[b][d] = std::max(bin_max[b][d], bmax[3*e+d]);
+      }
+    }
+
+    // sweep from right, area and count of bins [b+1, n_bins)
+    Real right_area[bvh_n_bins];
+    unsigned int right_count[bvh_n_bins];
+    {
+      Real rmin[3] = { 1e30,  1e30,  1e30};
+      Real rmax[3] = {-1e30, -1e30, -1e30};
+      unsigned int rc = 0;
+      for(unsigned int b=bvh_n_bins-1; b>0; --b)
+      {
+        rc += bin_count[b];
+        for(unsigned int d=0; d<3; ++d)
+        { rmin[d] = std::min(rmin[d], bin_min[b][d]); rmax[d] = std::max(rmax[d], bin_max[b][d]); }
+        right_count[b-1] = rc;
+        right_area[b-1]  = rc ? box_area(rmin, rmax, _dim) : 0;
+      }
+    }
+
+    // sweep from left, find the cheapest split
+    Real best_cost = 1e300;
+    unsigned int best_split = bvh_n_bins;
+    {
+      Real lmin[3] = { 1e30,  1e30,  1e30};
+      Real lmax[3] = {-1e30, -1e30, -1e30};
+      unsigned int lc = 0;
+      for(unsigned int b=0; b<bvh_n_bins-1; ++b)
+      {
+        lc += bin_count[b];
+        for(unsigned int d=0; d<3; ++d)
+        { lmin[d] = std::min(lmin[d], bin_min[b][d]); lmax[d] = std::max(lmax[d], bin_max[b][d]); }
+        if( lc == 0 || right_count[b] == 0 ) continue;
+        const Real cost = lc*box_area(lmin, lmax, _dim) + right_count[b]*right_area[b];
+        if( cost < best_cost ) { best_cost = cost; best_split = b; }
+      }
+    }
+
+    if( best_split < bvh_n_bins )
+    {
+      mid = std::partition(index.begin()+begin, index.begin()+end, CentroidBinLeft(bin, best_split)) - index.begin();
+      sah_split = (mid > begin && mid < end);
+    }
+  }
+
+  if( !sah_split )
+  {
+    mid = begin + count/2;
+    std::nth_element(index.begin()+begin, index.begin()+mid, index.begin()+end, CentroidLess(centroid, axis));
+  }
+
+  // the first child follows this node
+  this->_build_node(begin, mid, depth+1, index, bmin, bmax, centroid);
+  node.offset = this->_build_node(mid, end, depth+1, index, bmin, bmax, centroid);
+  node.count  = 0;
+  _nodes[node_index] = node;
+
+  return node_index;
+}
+
+
+
+std::pair<Point, Point> ElemBVH::bounding_box() const
+{
+  if( _nodes.empty() ) return std::make_pair(Point(), Point());
+  const BVHNode & root = _nodes[0];
+  return std::make_pair(Point(root.min[0], root.min[1], root.min[2]), Point(root.max[0], root.max[1], root.max[2]));
+}
+
+
+
+bool ElemBVH::_bounds_point(const BVHNode & node, const Point & p) const
+{
+  return p(0) >= node.min[0] && p(0) <= node.max[0] &&
+         p(1) >= node.min[1] && p(1) <= node.max[1] &&
+         p(2) >= node.min[2] && p(2) <= node.max[2];
+}
+
+
+
+bool ElemBVH::_hit_box(const BVHNode & node, const Point & p, const Point & inv_dir, Real tmax, Real & t) const
+{
+  Real t0 = 0, t1 = tmax;
+  for(unsigned int d=0; d<3; ++d)
+  {
+    Real ta = (node.min[d] - p(d))*inv_dir(d);
+    Real tb = (node.max[d] - p(d))*inv_dir(d);
+    if( ta > tb ) std::swap(ta, tb);
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+    if( t0 > t1 ) return false;
+  }
+  t = t0;
+  return true;
+}
+
+
+
+const Elem * ElemBVH::find_element(const Point & p, const Elem * hint) const
+{
+  if( hint && hint->contains_point(p) ) return hint;
+  if( _nodes.empty() ) return NULL;
+
+  unsigned int stack[bvh_max_depth+1];
+  unsigned int top = 0;
+  stack[top++] = 0;
+
+  while( top )
+  {
+    const unsigned int n = stack[--top];
+    const BVHNode & node = _nodes[n];
+    if( !_bounds_point(node, p) ) continue;
+
+    if( node.count )
+    {
+      for(unsigned int k=node.offset; k<node.offset+node.count; ++k)
+        if( _elems[k]->contains_point(p) ) return _elems[k];
+    }
+    else
+    {
+      stack[top++] = node.offset;
+      stack[top++] = n+1;
+    }
+  }
+
+  return NULL;
+}
+
+
+
+void ElemBVH::find_elements(const std::vector<Point> & points, std::vector<const Elem *> & elems) const
+{
+  elems.assign(points.size(), static_cast<const Elem *>(NULL));
+
+  std::vector<unsigned int> order;
+  this->_morton_order(points, order);
+
+  // neighbor points in Morton order are likely in the same element
+  const Elem * hint = NULL;
+  for(unsigned int k=0; k<order.size(); ++k)
+  {
+    const unsigned int i = order[k];
+    const Elem * elem = this->find_element(points[i], hint);
+    elems[i] = elem;
+    if( elem ) hint = elem;
+  }
+}
+
+
+
+const Elem * ElemBVH::hit_element(const Point & p, const Point & dir) const
+{
+  if( _nodes.empty() ) return NULL;
+
+  Point inv_dir;
+  for(unsigned int d=0; d<3; ++d)
+    inv_dir(d) = dir(d) != 0 ? 1.0/dir(d) : 1e30;
+
+  const Elem * hit_elem = NULL;
+  Real best_t = 1e30;
+
+  unsigned int stack[bvh_max_depth+1];
+  unsigned int top = 0;
+  stack[top++] = 0;
+
+  while( top )
+  {
+    const unsigned int n = stack[--top];
+    const BVHNode & node = _nodes[n];
+    Real t;
+    if( !_hit_box(node, p, inv_dir, best_t, t) ) continue;
+
+    if( node.count )
+    {
+      for(unsigned int k=node.offset; k<node.offset+node.count; ++k)
+      {
+        IntersectionResult result;
+        _elems[k]->ray_hit(p, dir, result);
+        if( result.state != Missed && result.hit_points[0].t < best_t )
+        {
+          best_t   = result.hit_points[0].t;
+          hit_elem = _elems[k];
+        }
+      }
+    }
+    else
+    {
+      // visit the nearer child first
+      const unsigned int c1 = n+1, c2 = node.offset;
+      Real t1, t2;
+      const bool h1 = _hit_box(_nodes[c1], p, inv_dir, best_t, t1);
+      const bool h2 = _hit_box(_nodes[c2], p, inv_dir, best_t, t2);
+      if( h1 && h2 )
+      {
+        if( t1 <= t2 ) { stack[top++] = c2; stack[top++] = c1; }
+        else           { stack[top++] = c1; stack[top++] = c2; }
+      }
+      else if( h1 ) stack[top++] = c1;
+      else if( h2 ) stack[top++] = c2;
+    }
+  }
+
+  return hit_elem;
+}
+
+
+
+void ElemBVH::hit_elements(const std::vector<Point> & p, const std::vector<Point> & dir, std::vector<const Elem *> & elems) const
+{
+  genius_assert( p.size() == dir.size() );
+  elems.assign(p.size(), static_cast<const Elem *>(NULL));
+
+  // rays with near origin and the same direction octant visit the same nodes
+  std::vector<unsigned int> order;
+  this->_morton_order(p, order, &dir);
+
+  for(unsigned int k=0; k<order.size(); ++k)
+  {
+    const unsigned int i = order[k];
+    elems[i] = this->hit_element(p[i], dir[i]);
+  }
+}
+
+
+
+bool ElemBVH::hit_boundbox(const Point & p, const Point & dir) const
+{
+  if( _nodes.empty() ) return false;
+
+  Point inv_dir;
+  for(unsigned int d=0; d<3; ++d)
+    inv_dir(d) = dir(d) != 0 ? 1.0/dir(d) : 1e30;
+
+  Real t;
+  return _hit_box(_nodes[0], p, inv_dir, 1e30, t);
+}
+
+
+
+bool ElemBVH::hit_domain(const Point & p, const Point & dir, std::pair<double, double> &t) const
+{
+  if( _nodes.empty() ) return false;
+
+  // start the ray outside of the bounding sphere, we need the whole intersection
+  Point start = p;
+  {
+    const std::pair<Point, Point> bbox = this->bounding_box();
+    const Point center = (bbox.first + bbox.second)*0.5;
+    const Real  radius = (bbox.second - bbox.first).size()*0.5;
+    if( (p - center).size() < radius )
+      start = p - 2*radius*dir;
+  }
+
+  Point inv_dir;
+  for(unsigned int d=0; d<3; ++d)
+    inv_dir(d) = dir(d) != 0 ? 1.0/dir(d) : 1e30;
+
+  bool hit = false;
+  t.first  =  1e30;
+  t.second = -1e30;
+
+  unsigned int stack[bvh_max_depth+1];
+  unsigned int top = 0;
+  stack[top++] = 0;
+
+  while( top )
+  {
+    const unsigned int n = stack[--top];
+    const BVHNode & node = _nodes[n];
+    Real tb;
+    if( !_hit_box(node, start, inv_dir, 1e30, tb) ) continue;
+
+    if( node.count )
+    {
+      for(unsigned int k=node.offset; k<node.offset+node.count; ++k)
+      {
+        IntersectionResult result;
+        _elems[k]->ray_hit(start, dir, result);
+        if( result.state == Missed ) continue;
+        hit = true;
+        t.first  = std::min(t.first,  static_cast<double>(result.hit_points.front().t));
+        t.second = std::max(t.second, static_cast<double>(result.hit_points.back().t));
+      }
+    }
+    else
+    {
+      stack[top++] = node.offset;
+      stack[top++] = n+1;
+    }
+  }
+
+  if( !hit ) return false;
+
+  double d = (start-p)*dir;
+  t.first  += d;
+  t.second += d;
+
+  return true;
+}
+
+
+
+void ElemBVH::_morton_order(const std::vector<Point> & points, std::vector<unsigned int> & order,
+                            const std::vector<Point> * dir) const
+{
+  const unsigned int n_points = points.size();
+  std::vector< std::pair<unsigned int, unsigned int> > keys(n_points);
+
+  const std::pair<Point, Point> bbox = this->bounding_box();
+  Real scale[3];
+  for(unsigned int d=0; d<3; ++d)
+  {
+    const Real extent = bbox.second(d) - bbox.first(d);
+    scale[d] = extent > 0 ? 1.0/extent : 0.0;
+  }
+
+  // 3D: 9 bits each axis, 2D: 13 bits each axis. the direction octant takes the high bits
+  const unsigned int bits = (_dim == 3) ? 9 : 13;
+  const Real cells = static_cast<Real>((1u << bits) - 1);
+  for(unsigned int i=0; i<n_points; ++i)
+  {
+    unsigned int c[3];
+    for(unsigned int d=0; d<3; ++d)
+    {
+      Real x = (points[i](d) - bbox.first(d))*scale[d];
+      x = std::max(static_cast<Real>(0), std::min(static_cast<Real>(1), x));
+      c[d] = static_cast<unsigned int>(x*cells);
+    }
+
+    unsigned int key = (_dim == 3) ?
+                       (spread_bits_3(c[0]) | (spread_bits_3(c[1]) << 1) | (spread_bits_3(c[2]) << 2)) :
+                       (spread_bits_2(c[0]) | (spread_bits_2(c[1]) << 1));
+
+    if( dir )
+    {
+      const Point & v = (*dir)[i];
+      const unsigned int octant = (v(0) < 0 ? 1 : 0) | (v(1) < 0 ? 2 : 0) | (v(2) < 0 ? 4 : 0);
+      key |= octant << (_dim*bits);
+    }
+
+    keys[i] = std::make_pair(key, i);
+  }
+
+  std::sort(keys.begin(), keys.end());
+
+  order.resize(n_points);
+  for(unsigned int i=0; i<n_points; ++i)
+    order[i] = keys[i].second;
+}
+
+
+
+size_t ElemBVH::memory_size() const
+{
+  size_t counter = sizeof(*this);
+  counter += _nodes.capacity()*sizeof(BVHNode);
+  counter += _elems.capacity()*sizeof(const Elem *);
+  counter += _surface_elems.capacity()*sizeof(const Elem *);
+  return counter;
+}
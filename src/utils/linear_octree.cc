@@ -0,0 +1,500 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+// Local includes
+#include "genius_env.h"
+#include "linear_octree.h"
+#include "perf_log.h"
+
+
+namespace {
+
+  typedef LinearOcTree::key_type key_type;
+
+  /**
+   * spread the lower 21 bits of x for Morton code, every 3rd bit
+   */
+  inline key_type spread_bits_21(key_type x)
+  {
+    x &= 0x1fffffULL;
+    x = (x | (x << 32)) & 0x1f00000000ffffULL;
+    x = (x | (x << 16)) & 0x1f0000ff0000ffULL;
+    x = (x | (x <<  8)) & 0x100f00f00f00f00fULL;
+    x = (x | (x <<  4)) & 0x10c30c30c30c30c3ULL;
+    x = (x | (x <<  2)) & 0x1249249249249249ULL;
+    return x;
+  }
+
+  /**
+   * inverse of spread_bits_21
+   */
+  inline unsigned int compact_bits_21(key_type x)
+  {
+    x &= 0x1249249249249249ULL;
+    x = (x ^ (x >>  2)) & 0x10c30c30c30c30c3ULL;
+    x = (x ^ (x >>  4)) & 0x100f00f00f00f00fULL;
+    x = (x ^ (x >>  8)) & 0x1f0000ff0000ffULL;
+    x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+    x = (x ^ (x >> 32)) & 0x1fffffULL;
+    return static_cast<unsigned int>(x);
+  }
+
+  inline key_type morton_encode(const unsigned int c[3])
+  {
+    return spread_bits_21(c[0]) | (spread_bits_21(c[1]) << 1) | (spread_bits_21(c[2]) << 2);
+  }
+
+  inline void morton_decode(key_type k, unsigned int c[3])
+  {
+    c[0] = compact_bits_21(k);
+    c[1] = compact_bits_21(k >> 1);
+    c[2] = compact_bits_21(k >> 2);
+  }
+
+  /**
+   * magic string of the binary file
+   */
+  const char linear_octree_magic[8] = "GLOCT01";
+}
+
+
+const unsigned int LinearOcTree::max_level;
+
+
+LinearOcTree::LinearOcTree()
+  : _low(0, 0, 0), _size(0)
+{}
+
+
+LinearOcTree::LinearOcTree(const Point & low, Real size)
+{
+  this->reinit(low, size);
+}
+
+
+void LinearOcTree::reinit(const Point & low, Real size)
+{
+  _low  = low;
+  _size = size;
+
+  _keys.assign(1, 0);
+  _levels.assign(1, 0);
+
+  _item_keys.clear();
+  _item_order.clear();
+}
+
+
+Real LinearOcTree::cell_size(unsigned int level) const
+{
+  return std::ldexp(_size, -static_cast<int>(level));
+}
+
+
+
+bool LinearOcTree::_coordinate(const Point & p, unsigned int c[3]) const
+{
+  const Real n_cells = std::ldexp(1.0, static_cast<int>(max_level));
+  const Real tol = 1e-10;
+
+  bool inside = true;
+  for(unsigned int d=0; d<3; ++d)
+  {
+    Real x = (p(d) - _low(d))/_size;
+    if( x < -tol || x > 1.0 + tol ) inside = false;
+    x = std::max(static_cast<Real>(0), std::min(static_cast<Real>(1), x));
+    c[d] = std::min(static_cast<unsigned int>(x*n_cells), (1u << max_level) - 1);
+  }
+  return inside;
+}
+
+
+
+void LinearOcTree::build(const std::vector<Point> & items, const Refinement & criterion, unsigned int min_level)
+{
+  START_LOG("build()", "LinearOcTree");
+
+  // sort the items along the Morton curve
+  {
+    std::vector< std::pair<key_type, unsigned int> > keys(items.size());
+    for(unsigned int i=0; i<items.size(); ++i)
+    {
+      unsigned int c[3];
+      this->_coordinate(items[i], c);
+      keys[i] = std::make_pair(morton_encode(c), i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    _item_keys.resize(keys.size());
+    _item_order.resize(keys.size());
+    for(unsigned int i=0; i<keys.size(); ++i)
+    {
+      _item_keys[i]  = keys[i].first;
+      _item_order[i] = keys[i].second;
+    }
+  }
+
+  _keys.clear();
+  _levels.clear();
+  min_level = std::min(min_level, max_level);
+
+  // depth first, the children are pushed in reverse order so the leaves come out sorted by key
+  std::vector< std::pair<key_type, unsigned int> > stack;
+  stack.push_back( std::make_pair(static_cast<key_type>(0), 0u) );
+  while( !stack.empty() )
+  {
+    const key_type key = stack.back().first;
+    const unsigned int level = stack.back().second;
+    stack.pop_back();
+
+    bool divide = false;
+    if( level < max_level )
+    {
+      if( level < min_level )
+        divide = true;
+      else
+      {
+        const std::pair<unsigned int, unsigned int> range = this->cell_items(key, level);
+        const unsigned int * order = _item_order.empty() ? 0 : &_item_order[0];
+        divide = criterion.refine(*this, level, order + range.first, order + range.second);
+      }
+    }
+
+    if( !divide )
+    {
+      _keys.push_back(key);
+      _levels.push_back(static_cast<unsigned char>(level));
+      continue;
+    }
+
+    const key_type child_span = _span(level+1);
+    for(int c=7; c>=0; --c)
+      stack.push_back( std::make_pair(key + static_cast<key_type>(c)*child_span, level+1) );
+  }
+
+  STOP_LOG("build()", "LinearOcTree");
+}
+
+
+
+void LinearOcTree::balance()
+{
+  START_LOG("balance()", "LinearOcTree");
+
+  const unsigned int n_cells = 1u << max_level;
+
+  bool modified;
+  do
+  {
+    modified = false;
+    std::vector<bool> flag(_keys.size(), false);
+
+    for(unsigned int i=0; i<_keys.size(); ++i)
+    {
+      const unsigned int level = _levels[i];
+      if( level < 2 ) continue;
+
+      unsigned int c[3];
+      morton_decode(_keys[i], c);
+      const unsigned int h = 1u << (max_level - level);
+
+      // the face neighbors
+      for(unsigned int d=0; d<3; ++d)
+        for(unsigned int s=0; s<2; ++s)
+        {
+          unsigned int nc[3] = {c[0], c[1], c[2]};
+          if( s == 0 )
+          {
+            if( c[d] == 0 ) continue;
+            nc[d] = c[d] - 1;
+          }
+          else
+          {
+            if( c[d] + h >= n_cells ) continue;
+            nc[d] = c[d] + h;
+          }
+
+          const unsigned int j = this->_find_leaf(morton_encode(nc));
+          if( static_cast<unsigned int>(_levels[j]) + 1 < level && !flag[j] )
+          {
+            flag[j] = true;
+            modified = true;
+          }
+        }
+    }
+
+    if( modified )
+      this->_subdivide(flag);
+  }
+  while( modified );
+
+  STOP_LOG("balance()", "LinearOcTree");
+}
+
+
+
+void LinearOcTree::_subdivide(const std::vector<bool> & flag)
+{
+  std::vector<key_type> keys;
+  std::vector<unsigned char> levels;
+  keys.reserve(_keys.size());
+  levels.reserve(_levels.size());
+
+  for(unsigned int i=0; i<_keys.size(); ++i)
+  {
+    const unsigned int level = _levels[i];
+    if( !flag[i] || level >= max_level )
+    {
+      keys.push_back(_keys[i]);
+      levels.push_back(_levels[i]);
+      continue;
+    }
+
+    const key_type child_span = _span(level+1);
+    for(unsigned int c=0; c<8; ++c)
+    {
+      keys.push_back(_keys[i] + static_cast<key_type>(c)*child_span);
+      levels.push_back(static_cast<unsigned char>(level+1));
+    }
+  }
+
+  _keys.swap(keys);
+  _levels.swap(levels);
+}
+
+
+
+std::pair<Point, Point> LinearOcTree::leaf_box(unsigned int leaf) const
+{
+  unsigned int c[3];
+  morton_decode(_keys[leaf], c);
+
+  const Real unit = std::ldexp(_size, -static_cast<int>(max_level));
+  const Real h = this->cell_size(_levels[leaf]);
+
+  const Point low(_low(0) + c[0]*unit, _low(1) + c[1]*unit, _low(2) + c[2]*unit);
+  return std::make_pair(low, low + Point(h, h, h));
+}
+
+
+
+unsigned int LinearOcTree::_find_leaf(key_type k) const
+{
+  std::vector<key_type>::const_iterator it = std::upper_bound(_keys.begin(), _keys.end(), k);
+  genius_assert(it != _keys.begin());
+  return static_cast<unsigned int>(it - _keys.begin()) - 1;
+}
+
+
+
+unsigned int LinearOcTree::find_leaf(const Point & p) const
+{
+  if( _keys.empty() ) return invalid_uint;
+
+  unsigned int c[3];
+  if( !this->_coordinate(p, c) ) return invalid_uint;
+  return this->_find_leaf(morton_encode(c));
+}
+
+
+
+void LinearOcTree::intersect(const Point & p1, const Point & p2, std::vector<std::pair<unsigned int, Real> > & result) const
+{
+  const Real length = (p2-p1).size();
+  if( length == 0.0 || _keys.empty() ) return;
+  const Point dir = (p2-p1)/length;
+
+  // clip the segment by root box
+  Real t0 = 0.0, t1 = length;
+  for(unsigned int d=0; d<3; ++d)
+  {
+    const Real lo = _low(d);
+    const Real hi = _low(d) + _size;
+    if( dir(d) == 0.0 )
+    {
+      if( p1(d) < lo || p1(d) > hi ) return;
+      continue;
+    }
+    Real ta = (lo - p1(d))/dir(d);
+    Real tb = (hi - p1(d))/dir(d);
+    if( ta > tb ) std::swap(ta, tb);
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+  }
+  if( !(t0 < t1) ) return;
+
+  // march from leaf to leaf, the leaf is located a little after the entry point
+  const Real eps = 1e-9*_size;
+  Real t = t0;
+  while( t < t1 )
+  {
+    const Real tp = t + std::min(eps, 0.5*(t1-t));
+    const unsigned int leaf = this->find_leaf(p1 + dir*tp);
+    if( leaf == invalid_uint ) break;
+
+    const std::pair<Point, Point> box = this->leaf_box(leaf);
+    Real t_exit = t1;
+    for(unsigned int d=0; d<3; ++d)
+    {
+      if( dir(d) > 0.0 ) t_exit = std::min(t_exit, (box.second(d) - p1(d))/dir(d));
+      if( dir(d) < 0.0 ) t_exit = std::min(t_exit, (box.first(d)  - p1(d))/dir(d));
+    }
+    t_exit = std::max(t_exit, tp);
+    if( !(t_exit > t) ) break;
+
+    if( !result.empty() && result.back().first == leaf )
+      result.back().second += t_exit - t;
+    else
+      result.push_back( std::make_pair(leaf, t_exit - t) );
+
+    t = t_exit;
+  }
+}
+
+
+
+std::pair<unsigned int, unsigned int> LinearOcTree::cell_items(key_type key, unsigned int level) const
+{
+  std::vector<key_type>::const_iterator b = std::lower_bound(_item_keys.begin(), _item_keys.end(), key);
+  std::vector<key_type>::const_iterator e = std::lower_bound(b, _item_keys.end(), key + _span(level));
+  return std::make_pair( static_cast<unsigned int>(b - _item_keys.begin()),
+                         static_cast<unsigned int>(e - _item_keys.begin()) );
+}
+
+
+
+void LinearOcTree::release_items()
+{
+  std::vector<key_type>().swap(_item_keys);
+  std::vector<unsigned int>().swap(_item_order);
+}
+
+
+
+void LinearOcTree::write(std::ostream & out) const
+{
+  out.write(linear_octree_magic, sizeof(linear_octree_magic));
+
+  const double low[3] = { _low(0), _low(1), _low(2) };
+  const double size = _size;
+  const unsigned int n = _keys.size();
+  out.write(reinterpret_cast<const char *>(low), sizeof(low));
+  out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  if( n )
+  {
+    out.write(reinterpret_cast<const char *>(&_keys[0]), n*sizeof(key_type));
+    out.write(reinterpret_cast<const char *>(&_levels[0]), n*sizeof(unsigned char));
+  }
+}
+
+
+
+bool LinearOcTree::read(std::istream & in)
+{
+  char magic[sizeof(linear_octree_magic)];
+  in.read(magic, sizeof(magic));
+  if( !in.good() || !std::equal(magic, magic+sizeof(magic), linear_octree_magic) ) return false;
+
+  double low[3], size;
+  unsigned int n;
+  in.read(reinterpret_cast<char *>(low), sizeof(low));
+  in.read(reinterpret_cast<char *>(&size), sizeof(size));
+  in.read(reinterpret_cast<char *>(&n), sizeof(n));
+  if( !in.good() || n == 0 || !(size > 0.0) ) return false;
+
+  std::vector<key_type> keys(n);
+  std::vector<unsigned char> levels(n);
+  in.read(reinterpret_cast<char *>(&keys[0]), n*sizeof(key_type));
+  in.read(reinterpret_cast<char *>(&levels[0]), n*sizeof(unsigned char));
+  if( !in.good() ) return false;
+
+  // the leaves should tile the root box in key order
+  key_type next = 0;
+  for(unsigned int i=0; i<n; ++i)
+  {
+    if( levels[i] > max_level || keys[i] != next ) return false;
+    next = keys[i] + _span(levels[i]);
+  }
+  if( next != _span(0) ) return false;
+
+  _low  = Point(low[0], low[1], low[2]);
+  _size = size;
+  _keys.swap(keys);
+  _levels.swap(levels);
+  this->release_items();
+  return true;
+}
+
+
+
+void LinearOcTree::export_vtk(const std::string & file, const std::vector<Real> & value) const
+{
+  std::ofstream fout;
+  fout.open ( file.c_str(), std::ofstream::trunc );
+
+  fout << "# vtk DataFile Version 3.0" <<'\n';
+  fout << "Date calculated by LINEAR OCTREE"  <<'\n';
+  fout << "ASCII"                      <<'\n';
+  fout << "DATASET UNSTRUCTURED_GRID"  <<'\n';
+  fout << "POINTS " << 8*_keys.size()  << " float" << '\n';
+
+  for(unsigned int i=0; i<_keys.size(); ++i)
+  {
+    const std::pair<Point, Point> box = this->leaf_box(i);
+    for(unsigned int v=0; v<8; ++v)
+    {
+      const Point & px = (v & 1) ? box.second : box.first;
+      const Point & py = (v & 2) ? box.second : box.first;
+      const Point & pz = (v & 4) ? box.second : box.first;
+      fout << px.x() << " \t" << py.y() << " \t " << pz.z() << '\n';
+    }
+  }
+  fout << std::endl;
+
+  fout<<"CELLS "<<_keys.size()<<" "<<9*_keys.size()<<'\n';
+  for(unsigned int i=0; i<_keys.size(); ++i)
+  {
+    fout << 8;
+    for(unsigned int v=0; v<8; ++v)
+      fout << " " << 8*i+v;
+    fout << '\n';
+  }
+  fout << std::endl;
+
+  fout << "CELL_TYPES " << _keys.size() << '\n';
+  for(unsigned int i=0; i<_keys.size(); ++i)
+    fout << 11 << '\n'; //VTK_VOXEL
+  fout << std::endl;
+
+  fout<<"CELL_DATA " << _keys.size() <<'\n';
+  fout << "SCALARS "<<"data"<<" float 1" << std::endl;
+  fout << "LOOKUP_TABLE default" << std::endl;
+  for(unsigned int i=0; i<_keys.size(); ++i)
+    fout << (i < value.size() ? value[i] : 0.0) << '\n';
+
+  fout.close();
+}
@@ -0,0 +1,142 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+// C++ includes
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifndef WINDOWS
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+// Local includes
+#include "mapped_file.h"
+
+
+MappedFile::MappedFile()
+  : _data(0), _size(0), _mapped(false)
+{}
+
+
+MappedFile::~MappedFile()
+{
+  this->close();
+}
+
+
+bool MappedFile::open(const std::string &file)
+{
+  this->close();
+
+#ifndef WINDOWS
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if( fd < 0 ) return false;
+
+  struct stat st;
+  if( fstat(fd, &st) != 0 || st.st_size <= 0 )
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void * p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the map is still valid after the file is closed
+  ::close(fd);
+  if( p == MAP_FAILED ) return false;
+
+  _data = static_cast<const char *>(p);
+  _size = st.st_size;
+  _mapped = true;
+  return true;
+#else
+  std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+  if( !in.good() ) return false;
+
+  in.seekg(0, std::ios::end);
+  std::streamoff size = in.tellg();
+  in.seekg(0, std::ios::beg);
+  if( size <= 0 ) return false;
+
+  // double buffer keeps the content 8 byte aligned
+  _buffer.resize( (size + sizeof(double) - 1)/sizeof(double) );
+  in.read(reinterpret_cast<char *>(&_buffer[0]), size);
+  if( !in.good() )
+  {
+    _buffer.clear();
+    return false;
+  }
+
+  _data = reinterpret_cast<const char *>(&_buffer[0]);
+  _size = size;
+  return true;
+#endif
+}
+
+
+void MappedFile::close()
+{
+#ifndef WINDOWS
+  if( _mapped )
+    munmap(const_cast<char *>(_data), _size);
+#endif
+  _buffer.clear();
+  _data = 0;
+  _size = 0;
+  _mapped = false;
+}
+
+
+bool MappedFile::write(const std::string &file, const void *data, std::size_t size)
+{
+  // several jobs may write the same file at the same time, each one has its own temporary file
+  std::ostringstream tmp;
+  tmp << file << ".tmp";
+#ifndef WINDOWS
+  tmp << '.' << getpid();
+#endif
+
+  {
+    std::ofstream out(tmp.str().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if( !out.good() ) return false;
+    out.write(static_cast<const char *>(data), size);
+    if( !out.good() )
+    {
+      out.close();
+      std::remove(tmp.str().c_str());
+      return false;
+    }
+  }
+
+#ifdef WINDOWS
+  // rename does not replace an existing file on windows
+  std::remove(file.c_str());
+#endif
+  if( std::rename(tmp.str().c_str(), file.c_str()) != 0 )
+  {
+    std::remove(tmp.str().c_str());
+    return false;
+  }
+  return true;
+}
@@ -21,6 +21,8 @@
 
 #include <limits>
 #include <set>
+#include <cmath>
+#include <algorithm>
 #include "mesh_base.h"
 #include "nearest_node_locator.h"
 #include "perf_log.h"
@@ -28,6 +30,40 @@
 
 inline Real get_location( const Node *n, unsigned int k ) { return n->coord(k); }
 
+namespace {
+
+  /**
+   * order nodes by id
+   */
+  struct NodeIdLess
+  {
+    bool operator() (const Node * a, const Node * b) const
+    { return a->id() < b->id(); }
+  };
+
+  /**
+   * order grid index by node id
+   */
+  struct GridIndexLess
+  {
+    GridIndexLess(const std::vector<const Node *> & n) : nodes(n) {}
+    bool operator() (unsigned int a, unsigned int b) const
+    { return nodes[a]->id() < nodes[b]->id(); }
+    const std::vector<const Node *> & nodes;
+  };
+
+  /**
+   * square of distance from point q to segment p1-p2, d = p2-p1 and inv_dd = 1/(d*d)
+   */
+  inline Real segment_dist2(const Point & q, const Point & p1, const Point & d, Real inv_dd)
+  {
+    const Point pq = q - p1;
+    Real t = (pq*d)*inv_dd;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    return (pq - t*d).size_sq();
+  }
+}
+
 
 
 NearestNodeLocator::NearestNodeLocator(const MeshBase& mesh)
@@ -56,6 +92,10 @@ NearestNodeLocator::NearestNodeLocator(const MeshBase& mesh)
 
     _kdtrees.push_back(kd_tree);
   }
+
+  _grids.resize(subdomain_nodes.size());
+  for(unsigned int n=0; n<subdomain_nodes.size(); ++n)
+    _build_grid(subdomain_nodes[n], _grids[n]);
 }
 
 
@@ -110,16 +150,13 @@ std::vector<const Node * > NearestNodeLocator::nearest_nodes(const Point &p, Rea
 
 std::vector<const Node * > NearestNodeLocator::nearest_nodes(const Point &p1, const Point &p2, Real radius, unsigned int subdomain) const
 {
-  std::vector<const Node *> nn;
-  std::set<const Node *> nn_set;
-
-  std::vector< const Node * > nn1 = this->nearest_nodes(p1, radius, subdomain);
-  std::vector< const Node * > nn2 = this->nearest_nodes(p2, radius, subdomain);
-  nn_set.insert(nn1.begin(), nn1.end());
-  nn_set.insert(nn2.begin(), nn2.end());
+  std::vector<unsigned int> hits;
+  const NodeGrid & grid = _grids[subdomain];
+  _segment_nodes(grid, p1, p2, radius, hits);
 
-  this->nearest_nodes(p1, p2, radius, subdomain, nn_set);
-  nn.insert(nn.end(), nn_set.begin(), nn_set.end());
+  std::vector<const Node *> nn(hits.size());
+  for(unsigned int n=0; n<hits.size(); ++n)
+    nn[n] = grid.nodes[hits[n]];
 
   return nn;
 }
@@ -141,3 +178,175 @@ void NearestNodeLocator::nearest_nodes(const Point &p1, const Point &p2, Real ra
 
 
 
+void NearestNodeLocator::nearest_nodes(const std::vector<Point> &p1, const std::vector<Point> &p2, const std::vector<Real> &radius,
+                                       unsigned int subdomain, std::vector<unsigned int> &offset, std::vector<const Node *> &nodes) const
+{
+  START_LOG("nearest_nodes()", "NearestNodeLocator");
+
+  genius_assert(p1.size() == p2.size() && p1.size() == radius.size());
+
+  const NodeGrid & grid = _grids[subdomain];
+
+  offset.resize(p1.size()+1);
+  offset[0] = 0;
+  nodes.clear();
+
+  std::vector<unsigned int> hits;
+  for(unsigned int k=0; k<p1.size(); ++k)
+  {
+    _segment_nodes(grid, p1[k], p2[k], radius[k], hits);
+    for(unsigned int n=0; n<hits.size(); ++n)
+      nodes.push_back(grid.nodes[hits[n]]);
+    offset[k+1] = nodes.size();
+  }
+
+  STOP_LOG("nearest_nodes()", "NearestNodeLocator");
+}
+
+
+
+void NearestNodeLocator::_build_grid(const std::set<const Node *> & node_set, NodeGrid & grid)
+{
+  for(unsigned int d=0; d<3; ++d)
+  {
+    grid.min[d] = 0.0;
+    grid.h[d]   = 1.0;
+    grid.n[d]   = 1;
+  }
+  grid.cell_offset.assign(2, 0);
+
+  if(node_set.empty()) return;
+
+  // nodes in id order, the order in each cell is deterministic
+  std::vector<const Node *> nodes(node_set.begin(), node_set.end());
+  std::sort(nodes.begin(), nodes.end(), NodeIdLess());
+
+  Real max[3];
+  for(unsigned int d=0; d<3; ++d)
+  {
+    grid.min[d] =  std::numeric_limits<Real>::max();
+    max[d]      = -std::numeric_limits<Real>::max();
+  }
+  for(unsigned int n=0; n<nodes.size(); ++n)
+    for(unsigned int d=0; d<3; ++d)
+    {
+      grid.min[d] = std::min(grid.min[d], (*nodes[n])(d));
+      max[d]      = std::max(max[d], (*nodes[n])(d));
+    }
+
+  // about 4 nodes in each cell, degenerated direction (i.e. 2D mesh) has one layer of cells
+  Real extent[3], diag = 0.0;
+  for(unsigned int d=0; d<3; ++d)
+  {
+    extent[d] = max[d] - grid.min[d];
+    diag = std::max(diag, extent[d]);
+  }
+
+  Real volume = 1.0;
+  unsigned int dim = 0;
+  for(unsigned int d=0; d<3; ++d)
+    if(extent[d] > 1e-10*diag) { volume *= extent[d]; dim++; }
+
+  const Real n_cells = std::max(1.0, nodes.size()/4.0);
+  const Real h = dim ? std::pow(volume/n_cells, 1.0/dim) : 1.0;
+  for(unsigned int d=0; d<3; ++d)
+  {
+    if(extent[d] > 1e-10*diag && h > 0.0)
+      grid.n[d] = std::max(1u, std::min(1024u, static_cast<unsigned int>(std::ceil(extent[d]/h))));
+    grid.h[d] = extent[d] > 0.0 ? extent[d]/grid.n[d] : 1.0;
+  }
+
+  // counting sort of nodes by cell
+  const unsigned int total_cells = grid.n[0]*grid.n[1]*grid.n[2];
+  std::vector<unsigned int> node_cell(nodes.size());
+  grid.cell_offset.assign(total_cells+1, 0);
+  for(unsigned int n=0; n<nodes.size(); ++n)
+  {
+    unsigned int c[3];
+    for(unsigned int d=0; d<3; ++d)
+      c[d] = std::min(grid.n[d]-1, static_cast<unsigned int>(((*nodes[n])(d) - grid.min[d])/grid.h[d]));
+    node_cell[n] = c[0] + grid.n[0]*(c[1] + grid.n[1]*c[2]);
+    grid.cell_offset[node_cell[n]+1]++;
+  }
+  for(unsigned int c=0; c<total_cells; ++c)
+    grid.cell_offset[c+1] += grid.cell_offset[c];
+
+  std::vector<unsigned int> position(grid.cell_offset.begin(), grid.cell_offset.end()-1);
+  grid.nodes.resize(nodes.size());
+  grid.x.resize(nodes.size());
+  grid.y.resize(nodes.size());
+  grid.z.resize(nodes.size());
+  for(unsigned int n=0; n<nodes.size(); ++n)
+  {
+    const unsigned int i = position[node_cell[n]]++;
+    grid.nodes[i] = nodes[n];
+    grid.x[i] = (*nodes[n])(0);
+    grid.y[i] = (*nodes[n])(1);
+    grid.z[i] = (*nodes[n])(2);
+  }
+}
+
+
+
+void NearestNodeLocator::_segment_nodes(const NodeGrid & grid, const Point &p1, const Point &p2, Real radius, std::vector<unsigned int> & hits) const
+{
+  hits.clear();
+  if(grid.nodes.empty()) return;
+
+  // cells overlap with the bounding box of the capsule
+  unsigned int lo[3], hi[3];
+  for(unsigned int d=0; d<3; ++d)
+  {
+    const Real a = (std::min(p1(d), p2(d)) - radius - grid.min[d])/grid.h[d];
+    const Real b = (std::max(p1(d), p2(d)) + radius - grid.min[d])/grid.h[d];
+    if( b < 0 || a > grid.n[d] ) return;
+    lo[d] = a <= 0 ? 0 : std::min(grid.n[d]-1, static_cast<unsigned int>(a));
+    hi[d] = b >= grid.n[d] ? grid.n[d]-1 : static_cast<unsigned int>(b);
+  }
+
+  const Point dir = p2 - p1;
+  const Real dd = dir.size_sq();
+  const Real inv_dd = dd > 0.0 ? 1.0/dd : 0.0;
+  const Real r2 = radius*radius;
+  const Real half_diag = 0.5*std::sqrt(grid.h[0]*grid.h[0] + grid.h[1]*grid.h[1] + grid.h[2]*grid.h[2]);
+  const Real cell_r2 = (radius + half_diag)*(radius + half_diag);
+
+  const Real px = p1(0), py = p1(1), pz = p1(2);
+  const Real dx = dir(0), dy = dir(1), dz = dir(2);
+
+  std::vector<Real> dist2;
+  for(unsigned int k=lo[2]; k<=hi[2]; ++k)
+    for(unsigned int j=lo[1]; j<=hi[1]; ++j)
+      for(unsigned int i=lo[0]; i<=hi[0]; ++i)
+      {
+        // skip the cell far away from the segment
+        const Point center(grid.min[0] + (i+0.5)*grid.h[0], grid.min[1] + (j+0.5)*grid.h[1], grid.min[2] + (k+0.5)*grid.h[2]);
+        if( segment_dist2(center, p1, dir, inv_dd) > cell_r2 ) continue;
+
+        const unsigned int c = i + grid.n[0]*(j + grid.n[1]*k);
+        const unsigned int begin = grid.cell_offset[c];
+        const unsigned int end   = grid.cell_offset[c+1];
+        if(begin == end) continue;
+
+        // branch free loop over flat arrays, the compiler may vectorize it
+        dist2.resize(end-begin);
+        const Real * x = &grid.x[begin];
+        const Real * y = &grid.y[begin];
+        const Real * z = &grid.z[begin];
+        Real * d2 = &dist2[0];
+        for(unsigned int m=0; m<end-begin; ++m)
+        {
+          const Real qx = x[m]-px, qy = y[m]-py, qz = z[m]-pz;
+          Real t = (qx*dx + qy*dy + qz*dz)*inv_dd;
+          t = t < 0 ? 0 : t;
+          t = t > 1 ? 1 : t;
+          const Real ex = qx-t*dx, ey = qy-t*dy, ez = qz-t*dz;
+          d2[m] = ex*ex + ey*ey + ez*ez;
+        }
+
+        for(unsigned int m=0; m<end-begin; ++m)
+          if(d2[m] <= r2) hits.push_back(begin+m);
+      }
+
+  std::sort(hits.begin(), hits.end(), GridIndexLess(grid.nodes));
+}
@@ -22,42 +22,45 @@
 
 #include "elem.h"
 #include "mesh_base.h"
-#include "mesh_tools.h"
-#include "tree.h"
+#include "elem_bvh.h"
 #include "object_tree.h"
 
 ObjectTree::ObjectTree(const MeshBase& mesh, Trees::BuildType type)
 {
-  if (mesh.mesh_dimension() == 2)
-    _tree = new Trees::QuadTree (mesh, 16, 10, type);
-  else
-    _tree = new Trees::OctTree  (mesh, 36, 10, type);
+  _bvh = new ElemBVH(mesh, type);
 }
 
 
 ObjectTree::~ObjectTree()
 {
-  delete this->_tree;
+  delete this->_bvh;
 }
 
 
+bool ObjectTree::is_octree() const
+{ return _bvh->dim() == 3; }
+
+
+bool ObjectTree::is_quadtree() const
+{ return _bvh->dim() == 2; }
+
 
 const Elem * ObjectTree::hit(const Point & p, const Point & d) const
 {
-  return this->_tree->hit_element(p, d);
+  return this->_bvh->hit_element(p, d);
+}
+
+void ObjectTree::hit(const std::vector<Point> & p, const std::vector<Point> & d, std::vector<const Elem *> & elems) const
+{
+  this->_bvh->hit_elements(p, d, elems);
 }
 
 bool ObjectTree::hit_boundbox(const Point & p, const Point & d) const
 {
-  return this->_tree->hit_boundbox(p, d);
+  return this->_bvh->hit_boundbox(p, d);
 }
 
 bool ObjectTree::hit_domain(const Point & p, const Point & d, std::pair<double, double> &t) const
 {
-  return this->_tree->hit_domain(p, d, t);
+  return this->_bvh->hit_domain(p, d, t);
 }
-
-
-
-
-
@@ -23,9 +23,11 @@
 
 
 // Local Includes
+#include "point.h"
 #include "point_locator_base.h"
 #include "point_locator_tree.h"
 #include "point_locator_list.h"
+#include "point_locator_bvh.h"
 
 
 
@@ -72,6 +74,13 @@ AutoPtr<PointLocatorBase> PointLocatorBase::build (const PointLocatorType t,
 	return ap;
       }
 
+    case PointLocator_BVH:
+      {
+	AutoPtr<PointLocatorBase> ap(new PointLocatorBVH(mesh,
+							 master));
+	return ap;
+      }
+
     default:
       {
 	std::cerr << "ERROR: Bad PointLocatorType = " << t << std::endl;
@@ -84,3 +93,12 @@ AutoPtr<PointLocatorBase> PointLocatorBase::build (const PointLocatorType t,
   return ap;
 }
 
+
+
+
+void PointLocatorBase::operator() (const std::vector<Point> & points, std::vector<const Elem *> & elems) const
+{
+  elems.resize(points.size());
+  for(unsigned int n=0; n<points.size(); ++n)
+    elems[n] = (*this)(points[n]);
+}
@@ -0,0 +1,165 @@
+/********************************************************************************/
+/*     888888    888888888   88     888  88888   888      888    88888888       */
+/*   8       8   8           8 8     8     8      8        8    8               */
+/*  8            8           8  8    8     8      8        8    8               */
+/*  8            888888888   8   8   8     8      8        8     8888888        */
+/*  8      8888  8           8    8  8     8      8        8            8       */
+/*   8       8   8           8     8 8     8      8        8            8       */
+/*     888888    888888888  888     88   88888     88888888     88888888        */
+/*                                                                              */
+/*       A Three-Dimensional General Purpose Semiconductor Simulator.           */
+/*                                                                              */
+/*                                                                              */
+/*  Copyright (C) 2007-2008                                                     */
+/*  Cogenda Pte Ltd                                                             */
+/*                                                                              */
+/*  Please contact Cogenda Pte Ltd for license information                      */
+/*                                                                              */
+/*  Author: Gong Ding   gdiso@ustc.edu                                          */
+/*                                                                              */
+/********************************************************************************/
+
+// C++ includes
+#include <iostream>
+
+// Local Includes
+#include "mesh_base.h"
+#include "elem.h"
+#include "elem_bvh.h"
+#include "point_locator_bvh.h"
+
+
+
+PointLocatorBVH::PointLocatorBVH (const MeshBase& mesh,
+                                  const PointLocatorBase* master) :
+    PointLocatorBase (mesh,master),
+    _bvh             (NULL),
+    _element         (NULL),
+    _out_of_mesh_mode(true)
+{
+  this->init(Trees::NODES);
+}
+
+
+
+PointLocatorBVH::PointLocatorBVH (const MeshBase& mesh,
+                                  const Trees::BuildType build_type,
+                                  const PointLocatorBase* master) :
+    PointLocatorBase (mesh,master),
+    _bvh             (NULL),
+    _element         (NULL),
+    _out_of_mesh_mode(true)
+{
+  this->init(build_type);
+}
+
+
+
+PointLocatorBVH::~PointLocatorBVH ()
+{
+  this->clear ();
+}
+
+
+
+void PointLocatorBVH::clear ()
+{
+  // only delete the BVH when we are the master
+  if (this->_master == NULL)
+    delete this->_bvh;
+  this->_bvh = NULL;
+  this->_initialized = false;
+}
+
+
+
+void PointLocatorBVH::init (const Trees::BuildType build_type)
+{
+  genius_assert (this->_bvh == NULL);
+
+  if (this->_initialized)
+  {
+    std::cerr << "ERROR: Already initialized!  Will ignore this call..." << std::endl;
+    return;
+  }
+
+  if (this->_master == NULL)
+    _bvh = new ElemBVH(this->_mesh, build_type);
+  else
+  {
+    const PointLocatorBVH* my_master = dynamic_cast<const PointLocatorBVH*>(this->_master);
+    if (my_master && my_master->initialized())
+      this->_bvh = my_master->_bvh;
+    else
+    {
+      std::cerr << "ERROR: Initialize master first, then servants!" << std::endl;
+      genius_error();
+    }
+  }
+
+  this->_element = NULL;
+  this->_initialized = true;
+}
+
+
+
+const Elem* PointLocatorBVH::operator() (const Point& p) const
+{
+  genius_assert (this->_initialized);
+
+  this->_element = _bvh->find_element(p, this->_element);
+
+  if (this->_element == NULL && !_out_of_mesh_mode)
+    this->_element = this->_linear_search(p);
+
+  return this->_element;
+}
+
+
+
+void PointLocatorBVH::operator() (const std::vector<Point> & points, std::vector<const Elem *> & elems) const
+{
+  genius_assert (this->_initialized);
+
+  _bvh->find_elements(points, elems);
+
+  if (!_out_of_mesh_mode)
+  {
+    for(unsigned int n=0; n<elems.size(); ++n)
+      if(elems[n] == NULL)
+        elems[n] = this->_linear_search(points[n]);
+  }
+}
+
+
+
+const Elem* PointLocatorBVH::_linear_search (const Point& p) const
+{
+  // the box of curved elements may be slightly inaccurate, search all the elements
+  MeshBase::const_element_iterator       pos     = this->_mesh.active_elements_begin();
+  const MeshBase::const_element_iterator end_pos = this->_mesh.active_elements_end();
+  for ( ; pos != end_pos; ++pos)
+    if ((*pos)->contains_point(p))
+      return (*pos);
+
+  std::cerr << std::endl
+            << " ******** Serious Problem.  Could not find an Element in the Mesh"
+            << std:: endl
+            << " ******** that contains the Point " << p;
+  genius_error();
+  return NULL;
+}
+
+
+
+void PointLocatorBVH::enable_out_of_mesh_mode (void)
+{
+  _out_of_mesh_mode = true;
+}
+
+
+
+void PointLocatorBVH::disable_out_of_mesh_mode (void)
+{
+  _out_of_mesh_mode = false;
+}